@@ -0,0 +1,274 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+// Drives CBitstreamRing with a stub encoder standing in for NvMedia IEP: ring
+// wrap, growth on an oversized frame while older spans are still referenced,
+// a full span table, encoder errors and bits that stay pending. Needs no NVIDIA libraries, so it also
+// builds on a host:
+//   g++ -O2 -std=c++14 -o nvsipl_bitstream_ring_test BitstreamRingTest.cpp CBitstreamRing.cpp
+
+#include "CBitstreamRing.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <vector>
+
+static uint32_t s_numFailures = 0U;
+
+#define CHECK(cond)                                                   \
+    do {                                                              \
+        if (!(cond)) {                                                \
+            printf("  FAILED line %d: %s\n", __LINE__, #cond);        \
+            s_numFailures++;                                          \
+        }                                                             \
+    } while (0)
+
+// Hands out scripted frames. Every byte is a function of the frame number and
+// its position, so a span overwritten by a later frame is detected.
+class CStubEncoderOutput : public CEncoderOutput
+{
+public:
+    // A frame of 0 bytes makes the encoder report an error
+    void Queue(size_t numBytes, uint32_t numPending = 0U)
+    {
+        m_frames.push_back({ numBytes, numPending });
+    }
+
+    virtual BitsStatus BitsAvailable(size_t &numBytes) override
+    {
+        if (m_frames.empty() || m_frames.front().numBytes == 0U) {
+            return BitsStatus::ERROR;
+        }
+        if (m_frames.front().numPending > 0U) {
+            m_frames.front().numPending--;
+            return BitsStatus::PENDING;
+        }
+        numBytes = m_frames.front().numBytes;
+        return BitsStatus::OK;
+    }
+
+    virtual BitsStatus GetBits(uint8_t *pDst, size_t numBytes) override
+    {
+        if (m_frames.empty() || m_frames.front().numBytes != numBytes) {
+            return BitsStatus::ERROR;
+        }
+        for (size_t i = 0U; i < numBytes; i++) {
+            pDst[i] = Pattern(m_frameNum, i);
+        }
+        m_frames.pop_front();
+        m_frameNum++;
+        return BitsStatus::OK;
+    }
+
+    static uint8_t Pattern(uint32_t frameNum, size_t offset)
+    {
+        return (uint8_t)(frameNum * 37U + offset * 11U + (offset >> 8U));
+    }
+
+private:
+    typedef struct {
+        size_t numBytes;
+        uint32_t numPending;
+    } StubFrame;
+
+    std::deque<StubFrame> m_frames;
+    uint32_t m_frameNum = 0U;
+};
+
+typedef struct {
+    BitstreamSpan span;
+    uint32_t frameNum;
+} HeldFrame;
+
+static bool SpanIntact(const HeldFrame &held)
+{
+    for (size_t i = 0U; i < held.span.size; i++) {
+        if (held.span.pData[i] != CStubEncoderOutput::Pattern(held.frameNum, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool Read(CBitstreamRing &ring, CStubEncoderOutput &encoder, uint32_t &frameNum, HeldFrame &held)
+{
+    if (ring.ReadFrame(encoder, held.span) != BitsStatus::OK) {
+        return false;
+    }
+    held.frameNum = frameNum++;
+    return true;
+}
+
+// Frames of a third of the ring, two held at a time: writes wrap to the front
+// once the oldest is released, without ever growing.
+static void TestWrap(void)
+{
+    printf("wrap\n");
+    CBitstreamRing ring(3000U);
+    CStubEncoderOutput encoder;
+    uint32_t frameNum = 0U;
+    std::deque<HeldFrame> held;
+    const uint8_t *pBase = nullptr;
+    uint32_t numWraps = 0U;
+
+    for (uint32_t i = 0U; i < 20U; i++) {
+        encoder.Queue(900U + (i % 3U) * 50U, i % 2U);
+        HeldFrame frame;
+        CHECK(Read(ring, encoder, frameNum, frame));
+        if (pBase == nullptr) {
+            pBase = frame.span.pData;
+        } else if (frame.span.pData == pBase) {
+            numWraps++;
+        }
+        held.push_back(frame);
+        if (held.size() > 2U) {
+            CHECK(SpanIntact(held.front()));
+            CBitstreamRing::Release(held.front().span);
+            held.pop_front();
+        }
+    }
+    for (auto &frame : held) {
+        CHECK(SpanIntact(frame));
+        CBitstreamRing::Release(frame.span);
+    }
+    CHECK(numWraps > 0U);
+    CHECK(ring.GetGrowCount() == 0U);
+    CHECK(ring.GetCapacity() == 3000U);
+}
+
+// A frame larger than the free space grows the ring. The spans in the old
+// storage stay readable until released, also when held by a second reference.
+static void TestOverflow(void)
+{
+    printf("overflow\n");
+    CBitstreamRing ring(4096U);
+    CStubEncoderOutput encoder;
+    uint32_t frameNum = 0U;
+    HeldFrame small[2];
+    for (auto &frame : small) {
+        encoder.Queue(1500U);
+        CHECK(Read(ring, encoder, frameNum, frame));
+    }
+    // A sink such as the dump writer keeps the first span past the consumer
+    CBitstreamRing::AddRef(small[0].span);
+
+    HeldFrame large;
+    encoder.Queue(10000U);
+    CHECK(Read(ring, encoder, frameNum, large));
+    CHECK(ring.GetGrowCount() == 1U);
+    CHECK(ring.GetCapacity() >= 10000U);
+    CHECK(SpanIntact(small[0]));
+    CHECK(SpanIntact(small[1]));
+    CHECK(SpanIntact(large));
+
+    CBitstreamRing::Release(small[0].span);
+    CBitstreamRing::Release(small[1].span);
+    CHECK(SpanIntact(small[0]));
+    CBitstreamRing::OnSinkDone(small[0].span.pRing, small[0].span.entry);
+    CBitstreamRing::Release(large.span);
+
+    // Everything released: the next frames reuse the grown storage from the start
+    HeldFrame next;
+    encoder.Queue(8000U);
+    CHECK(Read(ring, encoder, frameNum, next));
+    CHECK(ring.GetGrowCount() == 1U);
+    CHECK(SpanIntact(next));
+    CBitstreamRing::Release(next.span);
+}
+
+// Sized with H264MaxFrameBytes(), a worst-case intra frame behind the frames a
+// dump writer holds fits without growing.
+static void TestWorstCaseSize(void)
+{
+    printf("worst case size\n");
+    const uint32_t numHeld = 5U;
+    const size_t maxFrameBytes = H264MaxFrameBytes(1920U, 1208U);
+    CBitstreamRing ring((numHeld + 1U) * maxFrameBytes);
+    CStubEncoderOutput encoder;
+    uint32_t frameNum = 0U;
+    std::vector<HeldFrame> held(numHeld + 1U);
+    for (auto &frame : held) {
+        encoder.Queue(maxFrameBytes);
+        CHECK(Read(ring, encoder, frameNum, frame));
+    }
+    CHECK(ring.GetGrowCount() == 0U);
+    for (auto &frame : held) {
+        CHECK(SpanIntact(frame));
+        CBitstreamRing::Release(frame.span);
+    }
+}
+
+// With every span table entry outstanding no frame is read. Encoder errors and
+// empty frames fail the read without publishing a span.
+static void TestErrors(void)
+{
+    printf("errors\n");
+    CBitstreamRing ring(BITSTREAM_MAX_SPANS * 64U);
+    CStubEncoderOutput encoder;
+    uint32_t frameNum = 0U;
+    std::vector<HeldFrame> held(BITSTREAM_MAX_SPANS);
+    for (auto &frame : held) {
+        encoder.Queue(64U);
+        CHECK(Read(ring, encoder, frameNum, frame));
+    }
+    HeldFrame extra;
+    encoder.Queue(64U);
+    CHECK(!Read(ring, encoder, frameNum, extra));
+    CBitstreamRing::Release(held[0].span);
+    CHECK(Read(ring, encoder, frameNum, extra));
+    CHECK(SpanIntact(extra));
+    CBitstreamRing::Release(extra.span);
+    for (uint32_t i = 1U; i < held.size(); i++) {
+        CHECK(SpanIntact(held[i]));
+        CBitstreamRing::Release(held[i].span);
+    }
+
+    encoder.Queue(0U);
+    CHECK(ring.ReadFrame(encoder, extra.span) == BitsStatus::ERROR);
+}
+
+// Bits pending for a while are still read. Bits that never come back
+// PENDING once the timeout passed, without publishing a span.
+static void TestPending(void)
+{
+    printf("pending\n");
+    CBitstreamRing ring(4096U);
+    CStubEncoderOutput encoder;
+    uint32_t frameNum = 0U;
+    HeldFrame frame {};
+    // Past the yields, into the sleeps
+    encoder.Queue(100U, 40U);
+    const bool bRead = Read(ring, encoder, frameNum, frame);
+    CHECK(bRead);
+    if (bRead) {
+        CHECK(SpanIntact(frame));
+        CBitstreamRing::Release(frame.span);
+    }
+
+    const int64_t timeoutUs = 20000;
+    encoder.Queue(100U, 0xFFFFFFFFU);
+    const auto start = std::chrono::steady_clock::now();
+    CHECK(ring.ReadFrame(encoder, frame.span, timeoutUs) == BitsStatus::PENDING);
+    const int64_t elapsedUs =
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK(elapsedUs >= timeoutUs);
+    CHECK(elapsedUs < timeoutUs + 500000);
+    CHECK(ring.ReadFrame(encoder, frame.span, 0) == BitsStatus::PENDING);
+}
+
+int main(void)
+{
+    TestWrap();
+    TestOverflow();
+    TestWorstCaseSize();
+    TestErrors();
+    TestPending();
+    printf("%s, %u failures\n", (s_numFailures == 0U) ? "PASSED" : "FAILED", s_numFailures);
+    return (s_numFailures == 0U) ? 0 : 1;
+}
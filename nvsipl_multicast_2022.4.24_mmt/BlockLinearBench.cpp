@@ -0,0 +1,234 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+// Throughput of the CPU block-linear <-> pitch-linear NV12 conversion on
+// synthetic frames, SIMD with 1 and all threads against the scalar reference,
+// for block heights of 1, 4 and 16 GOBs. Then the in-place kernels of
+// CBlockLinearKernels on the luma plane against a full detile followed by the
+// same computation on the pitch-linear copy. Every result is compared with the
+// reference. Needs no NVIDIA libraries, so it also builds on a host:
+//   g++ -O2 -mavx2 -std=c++14 -o nvsipl_blocklinear_bench BlockLinearBench.cpp
+//       CBlockLinear.cpp CBlockLinearKernels.cpp CBoxFilter.cpp -lpthread
+
+#include "CBlockLinear.hpp"
+#include "CBlockLinearKernels.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+constexpr double BENCH_MIN_SECONDS = 0.2;
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+} Resolution;
+
+static const Resolution RESOLUTIONS[] = { { 1920U, 1208U }, { 3840U, 2160U } };
+
+// Shaped like BufferAttrs, for CBlockLinear::GetPlane()
+typedef struct {
+    uint32_t planeCount;
+    uint32_t planeWidths[2];
+    uint32_t planeHeights[2];
+    uint32_t planePitches[2];
+    uint32_t planeBitsPerPixels[2];
+    uint32_t planeAlignedHeights[2];
+    uint32_t planeBlockHeights[2];
+    uint64_t planeOffsets[2];
+    uint64_t size;
+} Nv12Attrs;
+
+static Nv12Attrs MakeNv12Attrs(const Resolution &res, uint32_t blockHeightLog2)
+{
+    Nv12Attrs attrs {};
+    attrs.planeCount = 2U;
+    const uint32_t blockRows = BL_GOB_HEIGHT << blockHeightLog2;
+    for (uint32_t p = 0U; p < 2U; p++) {
+        attrs.planeWidths[p] = (p == 0U) ? res.width : res.width / 2U;
+        attrs.planeHeights[p] = (p == 0U) ? res.height : res.height / 2U;
+        attrs.planeBitsPerPixels[p] = (p == 0U) ? 8U : 16U;
+        attrs.planePitches[p] = (res.width + BL_GOB_WIDTH - 1U) / BL_GOB_WIDTH * BL_GOB_WIDTH;
+        attrs.planeAlignedHeights[p] = (attrs.planeHeights[p] + blockRows - 1U) / blockRows * blockRows;
+        attrs.planeBlockHeights[p] = blockHeightLog2;
+    }
+    attrs.planeOffsets[0] = 0U;
+    attrs.planeOffsets[1] = (uint64_t)attrs.planePitches[0] * attrs.planeAlignedHeights[0];
+    attrs.size = attrs.planeOffsets[1] + (uint64_t)attrs.planePitches[1] * attrs.planeAlignedHeights[1];
+    return attrs;
+}
+
+// Seconds per call, repeated until BENCH_MIN_SECONDS have passed
+static double TimeCall(const std::function<void(void)> &func)
+{
+    func(); // warm up caches and page in the destination
+    uint32_t calls = 0U;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    do {
+        func();
+        calls++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < BENCH_MIN_SECONDS);
+    return elapsed / calls;
+}
+
+static void PrintRow(const char *name, uint32_t numThreads, const Resolution &res, double seconds,
+                     double refSeconds, bool bMatch)
+{
+    const double frameBytes = (double)res.width * res.height * 3.0 / 2.0;
+    printf("    %-8s %2u thr %8.3f ms %7.2f GB/s  x%.1f vs scalar%s\n", name, numThreads, seconds * 1000.0,
+           frameBytes / seconds / 1e9, refSeconds / seconds, bMatch ? "" : "  MISMATCH");
+}
+
+static bool RunBlockHeight(const Resolution &res, uint32_t blockHeightLog2, uint32_t maxThreads)
+{
+    const Nv12Attrs attrs = MakeNv12Attrs(res, blockHeightLog2);
+    BlockLinearPlane planes[2];
+    for (uint32_t p = 0U; p < 2U; p++) {
+        if (!CBlockLinear::GetPlane(attrs, p, planes[p])) {
+            printf("  invalid plane %u\n", p);
+            return false;
+        }
+    }
+    printf("  block height %u GOBs\n", 1U << blockHeightLog2);
+
+    // Packed pitch-linear NV12, both planes with pitch = Y width
+    const size_t plSize = (size_t)res.width * res.height * 3U / 2U;
+    std::vector<uint8_t> surface(attrs.size);
+    std::vector<uint8_t> plRef(plSize), pl(plSize);
+    std::vector<uint8_t> blRef(attrs.size), bl(attrs.size);
+    for (auto &byte : surface) {
+        byte = (uint8_t)rand();
+    }
+
+    const uint8_t *pChroma = surface.data() + attrs.planeOffsets[1];
+    const size_t lumaBytes = (size_t)res.width * res.height;
+    double refSeconds = TimeCall([&]() {
+        CBlockLinear::BlToPlReference(planes[0], surface.data(), plRef.data(), res.width, 0U, planes[0].height);
+        CBlockLinear::BlToPlReference(planes[1], pChroma, plRef.data() + lumaBytes, res.width, 0U, planes[1].height);
+    });
+    double plToBlRefSeconds = TimeCall([&]() {
+        CBlockLinear::PlToBlReference(planes[0], plRef.data(), res.width, blRef.data(), 0U, planes[0].height);
+        CBlockLinear::PlToBlReference(planes[1], plRef.data() + lumaBytes, res.width,
+                                      blRef.data() + attrs.planeOffsets[1], 0U, planes[1].height);
+    });
+
+    bool bAllMatch = true;
+    for (uint32_t numThreads : { 1U, maxThreads }) {
+        CBlockLinearConverter converter(numThreads);
+        bool bOk = true;
+        double seconds = TimeCall([&]() { bOk = converter.BlToPlNv12(attrs, surface.data(), pl.data()) && bOk; });
+        bool bMatch = bOk && (pl == plRef);
+        PrintRow("BL->PL", numThreads, res, seconds, refSeconds, bMatch);
+        bAllMatch = bAllMatch && bMatch;
+
+        // Padding bytes are not written, both start zeroed
+        std::fill(bl.begin(), bl.end(), 0U);
+        seconds = TimeCall([&]() { bOk = converter.PlToBlNv12(attrs, plRef.data(), bl.data()) && bOk; });
+        bMatch = bOk && (bl == blRef);
+        PrintRow("PL->BL", numThreads, res, seconds, plToBlRefSeconds, bMatch);
+        bAllMatch = bAllMatch && bMatch;
+        if (maxThreads == 1U) {
+            break;
+        }
+    }
+    return bAllMatch;
+}
+
+static void PrintKernelRow(const char *name, double seconds, double detileSeconds, bool bMatch)
+{
+    printf("    %-10s %8.3f ms in place %8.3f ms detile + plain  x%.1f%s\n", name, seconds * 1000.0,
+           detileSeconds * 1000.0, detileSeconds / seconds, bMatch ? "" : "  MISMATCH");
+}
+
+// Luma plane with blocks of 16 GOBs, single thread on both sides
+static bool RunKernels(const Resolution &res)
+{
+    const Nv12Attrs attrs = MakeNv12Attrs(res, 4U);
+    BlockLinearPlane plane;
+    if (!CBlockLinear::GetPlane(attrs, 0U, plane)) {
+        printf("  invalid plane\n");
+        return false;
+    }
+    printf("  kernels, luma plane, block height %u GOBs\n", 1U << plane.blockHeightLog2);
+
+    const size_t plSize = (size_t)plane.widthBytes * plane.height;
+    std::vector<uint8_t> surfaceA(CBlockLinear::PlaneSize(plane)), surfaceB(surfaceA.size());
+    for (size_t i = 0U; i < surfaceA.size(); i++) {
+        surfaceA[i] = (uint8_t)rand();
+        surfaceB[i] = (uint8_t)rand();
+    }
+    std::vector<uint8_t> plA(plSize), plB(plSize);
+    CBlockLinearConverter converter;
+    bool bAllMatch = true;
+
+    uint32_t hist[BL_HISTOGRAM_BINS], refHist[BL_HISTOGRAM_BINS];
+    double seconds = TimeCall([&]() { (void)CBlockLinearKernels::Histogram(plane, surfaceA.data(), hist); });
+    double detileSeconds = TimeCall([&]() {
+        (void)converter.BlToPl(plane, surfaceA.data(), plA.data(), plane.widthBytes);
+        memset(refHist, 0, sizeof(refHist));
+        for (uint8_t value : plA) {
+            refHist[value]++;
+        }
+    });
+    bool bMatch = (memcmp(hist, refHist, sizeof(hist)) == 0);
+    PrintKernelRow("histogram", seconds, detileSeconds, bMatch);
+    bAllMatch = bAllMatch && bMatch;
+
+    uint64_t sad = 0U, refSad = 0U;
+    seconds = TimeCall([&]() { (void)CBlockLinearKernels::Sad(plane, surfaceA.data(), surfaceB.data(), sad); });
+    detileSeconds = TimeCall([&]() {
+        (void)converter.BlToPl(plane, surfaceA.data(), plA.data(), plane.widthBytes);
+        (void)converter.BlToPl(plane, surfaceB.data(), plB.data(), plane.widthBytes);
+        refSad = 0U;
+        for (size_t i = 0U; i < plSize; i++) {
+            refSad += (plA[i] > plB[i]) ? (plA[i] - plB[i]) : (plB[i] - plA[i]);
+        }
+    });
+    bMatch = (sad == refSad);
+    PrintKernelRow("sad", seconds, detileSeconds, bMatch);
+    bAllMatch = bAllMatch && bMatch;
+
+    // The centre quarter, as a detector ROI would be
+    const BlockLinearRect roi { plane.widthBytes / 4U, plane.height / 4U, plane.widthBytes / 2U, plane.height / 2U };
+    std::vector<uint8_t> crop((size_t)roi.width * roi.height), refCrop(crop.size());
+    seconds = TimeCall([&]() { (void)CBlockLinearKernels::CropToPl(plane, surfaceA.data(), roi, crop.data(), roi.width); });
+    detileSeconds = TimeCall([&]() {
+        (void)converter.BlToPl(plane, surfaceA.data(), plA.data(), plane.widthBytes);
+        for (uint32_t y = 0U; y < roi.height; y++) {
+            memcpy(refCrop.data() + (size_t)y * roi.width, plA.data() + (size_t)(roi.y + y) * plane.widthBytes + roi.x,
+                   roi.width);
+        }
+    });
+    bMatch = (crop == refCrop);
+    PrintKernelRow("crop 1/4", seconds, detileSeconds, bMatch);
+    bAllMatch = bAllMatch && bMatch;
+
+    return bAllMatch;
+}
+
+int main(void)
+{
+    const uint32_t maxThreads = std::max(std::thread::hardware_concurrency(), 1U);
+    bool bAllMatch = true;
+    srand(1U);
+    for (const auto &res : RESOLUTIONS) {
+        printf("NV12 %ux%u\n", res.width, res.height);
+        for (uint32_t blockHeightLog2 = 0U; blockHeightLog2 <= 4U; blockHeightLog2 += 2U) {
+            bAllMatch = RunBlockHeight(res, blockHeightLog2, maxThreads) && bAllMatch;
+        }
+        bAllMatch = RunKernels(res) && bAllMatch;
+    }
+    return bAllMatch ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+// Checks the block-linear kernels Histogram, CropToPl and Sad against a
+// reference that first detiles the plane with CBlockLinearConverter, on planes
+// with partial GOBs, random padding and block heights of 1 to 16 GOBs. The
+// Makefile links it twice, against the SIMD kernels and against kernels built
+// with -DBL_KERNELS_SCALAR. Needs no NVIDIA libraries, so it also builds on a host:
+//   g++ -O2 -mavx2 -std=c++14 -o nvsipl_blocklinear_kernels_test BlockLinearKernelsTest.cpp
+//       CBlockLinearKernels.cpp CBlockLinear.cpp CBoxFilter.cpp -lpthread
+//   g++ -O2 -std=c++14 -DBL_KERNELS_SCALAR -o nvsipl_blocklinear_kernels_test_scalar <same sources>
+
+#include "CBlockLinearKernels.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static uint32_t s_numFailures = 0U;
+
+#define CHECK(cond)                                                   \
+    do {                                                              \
+        if (!(cond)) {                                                \
+            printf("  FAILED line %d: %s\n", __LINE__, #cond);        \
+            s_numFailures++;                                          \
+        }                                                             \
+    } while (0)
+
+typedef struct {
+    uint32_t widthBytes;
+    uint32_t height;
+} PlaneSize;
+
+// GOB-aligned, partial last GOB column and row, and a plane narrower than one GOB
+static const PlaneSize PLANE_SIZES[] = { { 256U, 64U }, { 1000U, 203U }, { 1920U, 1208U }, { 40U, 5U } };
+
+static BlockLinearPlane MakePlane(const PlaneSize &size, uint32_t blockHeightLog2)
+{
+    const uint32_t blockRows = BL_GOB_HEIGHT << blockHeightLog2;
+    BlockLinearPlane plane;
+    plane.widthBytes = size.widthBytes;
+    plane.height = size.height;
+    plane.pitch = (size.widthBytes + BL_GOB_WIDTH - 1U) / BL_GOB_WIDTH * BL_GOB_WIDTH;
+    plane.alignedHeight = (size.height + blockRows - 1U) / blockRows * blockRows;
+    plane.blockHeightLog2 = blockHeightLog2;
+    return plane;
+}
+
+// Padding is random too, the kernels must not count it
+static std::vector<uint8_t> RandomSurface(const BlockLinearPlane &plane)
+{
+    std::vector<uint8_t> surface(CBlockLinear::PlaneSize(plane));
+    for (auto &byte : surface) {
+        byte = (uint8_t)rand();
+    }
+    return surface;
+}
+
+static std::vector<uint8_t> Detile(CBlockLinearConverter &converter, const BlockLinearPlane &plane,
+                                   const std::vector<uint8_t> &surface)
+{
+    std::vector<uint8_t> pl((size_t)plane.widthBytes * plane.height);
+    CHECK(converter.BlToPl(plane, surface.data(), pl.data(), plane.widthBytes));
+    return pl;
+}
+
+static void TestHistogram(CBlockLinearConverter &converter, const BlockLinearPlane &plane)
+{
+    const std::vector<uint8_t> surface = RandomSurface(plane);
+    uint32_t refHist[BL_HISTOGRAM_BINS] = {};
+    for (uint8_t value : Detile(converter, plane, surface)) {
+        refHist[value]++;
+    }
+
+    uint32_t hist[BL_HISTOGRAM_BINS];
+    CHECK(CBlockLinearKernels::Histogram(plane, surface.data(), hist));
+    CHECK(memcmp(hist, refHist, sizeof(hist)) == 0);
+}
+
+static void CheckCrop(const BlockLinearPlane &plane, const std::vector<uint8_t> &surface,
+                      const std::vector<uint8_t> &pl, const BlockLinearRect &roi)
+{
+    // One spare byte per row, it must stay untouched
+    const uint32_t dstPitch = roi.width + 1U;
+    std::vector<uint8_t> crop((size_t)dstPitch * roi.height, 0xA5U);
+    CHECK(CBlockLinearKernels::CropToPl(plane, surface.data(), roi, crop.data(), dstPitch));
+    bool bMatch = true;
+    for (uint32_t y = 0U; y < roi.height; y++) {
+        const uint8_t *pRef = pl.data() + (size_t)(roi.y + y) * plane.widthBytes + roi.x;
+        const uint8_t *pRow = crop.data() + (size_t)y * dstPitch;
+        bMatch = bMatch && (memcmp(pRow, pRef, roi.width) == 0) && (pRow[roi.width] == 0xA5U);
+    }
+    if (!bMatch) {
+        printf("  crop %u,%u %ux%u\n", roi.x, roi.y, roi.width, roi.height);
+    }
+    CHECK(bMatch);
+}
+
+static void TestCrop(CBlockLinearConverter &converter, const BlockLinearPlane &plane)
+{
+    const std::vector<uint8_t> surface = RandomSurface(plane);
+    const std::vector<uint8_t> pl = Detile(converter, plane, surface);
+    const uint32_t w = plane.widthBytes;
+    const uint32_t h = plane.height;
+
+    CheckCrop(plane, surface, pl, BlockLinearRect { 0U, 0U, w, h });
+    CheckCrop(plane, surface, pl, BlockLinearRect { w - 1U, h - 1U, 1U, 1U });
+    CheckCrop(plane, surface, pl, BlockLinearRect { w / 3U, h / 3U, w / 3U + 1U, h / 3U + 1U });
+    // Starts and ends inside 16-byte chunks and inside GOB rows
+    if (w > 40U && h > 12U) {
+        CheckCrop(plane, surface, pl, BlockLinearRect { 7U, 3U, w - 40U, h - 12U });
+    }
+    for (uint32_t i = 0U; i < 20U; i++) {
+        BlockLinearRect roi;
+        roi.x = (uint32_t)rand() % w;
+        roi.y = (uint32_t)rand() % h;
+        roi.width = 1U + (uint32_t)rand() % (w - roi.x);
+        roi.height = 1U + (uint32_t)rand() % (h - roi.y);
+        CheckCrop(plane, surface, pl, roi);
+    }
+
+    uint8_t byte = 0U;
+    CHECK(!CBlockLinearKernels::CropToPl(plane, surface.data(), BlockLinearRect { w, 0U, 1U, 1U }, &byte, 1U));
+    CHECK(!CBlockLinearKernels::CropToPl(plane, surface.data(), BlockLinearRect { 0U, 0U, 0U, 1U }, &byte, 1U));
+    CHECK(!CBlockLinearKernels::CropToPl(plane, surface.data(), BlockLinearRect { 0U, 0U, 2U, 1U }, &byte, 1U));
+}
+
+static void TestSad(CBlockLinearConverter &converter, const BlockLinearPlane &plane)
+{
+    const std::vector<uint8_t> surfaceA = RandomSurface(plane);
+    const std::vector<uint8_t> surfaceB = RandomSurface(plane);
+    const std::vector<uint8_t> plA = Detile(converter, plane, surfaceA);
+    const std::vector<uint8_t> plB = Detile(converter, plane, surfaceB);
+    uint64_t refSad = 0U;
+    for (size_t i = 0U; i < plA.size(); i++) {
+        refSad += (plA[i] > plB[i]) ? (plA[i] - plB[i]) : (plB[i] - plA[i]);
+    }
+
+    uint64_t sad = 0U;
+    CHECK(CBlockLinearKernels::Sad(plane, surfaceA.data(), surfaceB.data(), sad));
+    CHECK(sad == refSad);
+    CHECK(CBlockLinearKernels::Sad(plane, surfaceA.data(), surfaceA.data(), sad));
+    CHECK(sad == 0U);
+}
+
+int main(void)
+{
+    CBlockLinearConverter converter;
+    srand(1U);
+    for (const auto &size : PLANE_SIZES) {
+        for (uint32_t blockHeightLog2 = 0U; blockHeightLog2 <= 4U; blockHeightLog2 += 2U) {
+            printf("%ux%u bytes, block height %u GOBs\n", size.widthBytes, size.height, 1U << blockHeightLog2);
+            const BlockLinearPlane plane = MakePlane(size, blockHeightLog2);
+            TestHistogram(converter, plane);
+            TestCrop(converter, plane);
+            TestSad(converter, plane);
+        }
+    }
+    printf("%s, %u failures\n", (s_numFailures == 0U) ? "PASSED" : "FAILED", s_numFailures);
+    return (s_numFailures == 0U) ? 0 : 1;
+}
@@ -0,0 +1,589 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CAsyncLog.hpp"
+#include "CThreadPolicy.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+constexpr std::chrono::milliseconds LOG_WRITER_INTERVAL(5);
+constexpr size_t LOG_MAX_STRING_ARG = 512U;
+
+// Record layout in a ring: RecordHeader, LogRecordInfo, function\0, prefix\0, format\0,
+// then one tag byte plus payload per argument. Records are 8 byte aligned.
+typedef struct {
+    uint32_t size;
+    uint32_t kind;
+} RecordHeader;
+
+enum RecordKind : uint32_t
+{
+    RECORD_MESSAGE = 0,
+    RECORD_PADDING // fills the end of the ring when a record does not fit there
+};
+
+enum ArgTag : uint8_t
+{
+    ARG_SIGNED = 's',
+    ARG_UNSIGNED = 'u',
+    ARG_DOUBLE = 'd',
+    ARG_POINTER = 'p',
+    ARG_STRING = 'S'
+};
+
+// One printf conversion, e.g. "%-8.3lf"
+typedef struct {
+    const char *pBegin;  // the '%'
+    const char *pLength; // first length modifier character, or the conversion
+    const char *pEnd;    // one past the conversion
+    char length[3];
+    char conv;
+    uint32_t numStars;   // '*' width and precision arguments
+} FormatSpec;
+
+thread_local CAsyncLog::LogRing *CAsyncLog::s_pRing = nullptr;
+
+// Returns false at the end of the format or on a conversion we do not know.
+static bool NextSpec(const char *&pFormat, FormatSpec &spec)
+{
+    while (*pFormat != '\0') {
+        if (*pFormat != '%') {
+            pFormat++;
+            continue;
+        }
+        if (pFormat[1] == '%') {
+            pFormat += 2;
+            continue;
+        }
+        spec = FormatSpec {};
+        spec.pBegin = pFormat++;
+        while (*pFormat != '\0' && strchr("-+ #0'", *pFormat) != nullptr) {
+            pFormat++;
+        }
+        for (uint32_t field = 0U; field < 2U; field++) {
+            if (field == 1U) {
+                if (*pFormat != '.') {
+                    break;
+                }
+                pFormat++;
+            }
+            if (*pFormat == '*') {
+                spec.numStars++;
+                pFormat++;
+            } else {
+                while (*pFormat >= '0' && *pFormat <= '9') {
+                    pFormat++;
+                }
+            }
+        }
+        spec.pLength = pFormat;
+        uint32_t n = 0U;
+        while (*pFormat != '\0' && strchr("hljztLq", *pFormat) != nullptr && n < 2U) {
+            spec.length[n++] = *pFormat++;
+        }
+        if (*pFormat == '\0' || strchr("diouxXcfFeEgGaAspn", *pFormat) == nullptr) {
+            return false;
+        }
+        spec.conv = *pFormat++;
+        spec.pEnd = pFormat;
+        return true;
+    }
+    return false;
+}
+
+static bool IsLong(const FormatSpec &spec)
+{
+    return spec.length[0] == 'l' && spec.length[1] == '\0';
+}
+
+static bool IsLongLong(const FormatSpec &spec)
+{
+    return (spec.length[0] == 'l' && spec.length[1] == 'l') || spec.length[0] == 'q';
+}
+
+class RecordWriter
+{
+public:
+    RecordWriter(uint8_t *pBuf, size_t capacity) : m_pBuf(pBuf), m_capacity(capacity) {}
+
+    bool Put(const void *pData, size_t size)
+    {
+        if (m_len + size > m_capacity) {
+            m_bOverflow = true;
+            return false;
+        }
+        memcpy(m_pBuf + m_len, pData, size);
+        m_len += size;
+        return true;
+    }
+
+    template <typename T> void PutArg(ArgTag tag, T value)
+    {
+        uint8_t t = tag;
+        Put(&t, 1U);
+        Put(&value, sizeof(value));
+    }
+
+    void PutString(const char *pStr)
+    {
+        if (pStr == nullptr) {
+            pStr = "(null)";
+        }
+        uint16_t len = (uint16_t)strnlen(pStr, LOG_MAX_STRING_ARG);
+        uint8_t t = ARG_STRING;
+        Put(&t, 1U);
+        Put(&len, sizeof(len));
+        Put(pStr, len);
+    }
+
+    size_t GetLength(void) const
+    {
+        return m_len;
+    }
+    bool IsOverflow(void) const
+    {
+        return m_bOverflow;
+    }
+
+private:
+    uint8_t *m_pBuf;
+    size_t m_capacity;
+    size_t m_len = 0U;
+    bool m_bOverflow = false;
+};
+
+// Copies the arguments the format refers to, nothing is formatted here
+static bool EncodeArgs(RecordWriter &writer, const char *pFormat, va_list ap)
+{
+    FormatSpec spec;
+    while (NextSpec(pFormat, spec)) {
+        for (uint32_t i = 0U; i < spec.numStars; i++) {
+            writer.PutArg<int64_t>(ARG_SIGNED, va_arg(ap, int));
+        }
+        switch (spec.conv) {
+            case 'd':
+            case 'i':
+                if (IsLongLong(spec)) {
+                    writer.PutArg<int64_t>(ARG_SIGNED, va_arg(ap, long long));
+                } else if (IsLong(spec) || spec.length[0] == 'j' || spec.length[0] == 'z' ||
+                           spec.length[0] == 't') {
+                    writer.PutArg<int64_t>(ARG_SIGNED, va_arg(ap, long));
+                } else {
+                    writer.PutArg<int64_t>(ARG_SIGNED, va_arg(ap, int));
+                }
+                break;
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+                if (IsLongLong(spec)) {
+                    writer.PutArg<uint64_t>(ARG_UNSIGNED, va_arg(ap, unsigned long long));
+                } else if (IsLong(spec) || spec.length[0] == 'j' || spec.length[0] == 'z' ||
+                           spec.length[0] == 't') {
+                    writer.PutArg<uint64_t>(ARG_UNSIGNED, va_arg(ap, unsigned long));
+                } else {
+                    writer.PutArg<uint64_t>(ARG_UNSIGNED, va_arg(ap, unsigned int));
+                }
+                break;
+            case 'c':
+                writer.PutArg<int64_t>(ARG_SIGNED, va_arg(ap, int));
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                if (spec.length[0] == 'L') {
+                    writer.PutArg<double>(ARG_DOUBLE, (double)va_arg(ap, long double));
+                } else {
+                    writer.PutArg<double>(ARG_DOUBLE, va_arg(ap, double));
+                }
+                break;
+            case 's':
+                writer.PutString(va_arg(ap, const char *));
+                break;
+            case 'p':
+                writer.PutArg<const void *>(ARG_POINTER, va_arg(ap, const void *));
+                break;
+            case 'n':
+                (void)va_arg(ap, int *);
+                break;
+            default:
+                return false;
+        }
+    }
+    return !writer.IsOverflow();
+}
+
+class RecordReader
+{
+public:
+    RecordReader(const uint8_t *pData, size_t size) : m_pData(pData), m_size(size) {}
+
+    bool Get(void *pDst, size_t size)
+    {
+        if (m_pos + size > m_size) {
+            return false;
+        }
+        memcpy(pDst, m_pData + m_pos, size);
+        m_pos += size;
+        return true;
+    }
+
+    const char *GetCString(void)
+    {
+        const char *pStr = reinterpret_cast<const char *>(m_pData + m_pos);
+        m_pos += strnlen(pStr, m_size - m_pos) + 1U;
+        return pStr;
+    }
+
+    bool GetArg(uint8_t &tag, uint64_t &bits, std::string &str)
+    {
+        if (!Get(&tag, 1U)) {
+            return false;
+        }
+        if (tag != ARG_STRING) {
+            return Get(&bits, sizeof(bits));
+        }
+        uint16_t len = 0U;
+        if (!Get(&len, sizeof(len)) || m_pos + len > m_size) {
+            return false;
+        }
+        str.assign(reinterpret_cast<const char *>(m_pData + m_pos), len);
+        m_pos += len;
+        return true;
+    }
+
+private:
+    const uint8_t *m_pData;
+    size_t m_size;
+    size_t m_pos = 0U;
+};
+
+// Literal text between conversions, "%%" becomes "%"
+static void AppendLiteral(std::string &message, const char *pBegin, const char *pEnd)
+{
+    for (const char *p = pBegin; p < pEnd; p++) {
+        message += *p;
+        if (p[0] == '%' && p + 1 < pEnd && p[1] == '%') {
+            p++;
+        }
+    }
+}
+
+// Formats the record arguments one conversion at a time
+static std::string DecodeMessage(const char *pFormat, RecordReader &reader)
+{
+    std::string message;
+    char piece[LOG_MAX_LINE];
+    const char *pLiteral = pFormat;
+    FormatSpec spec;
+
+    while (NextSpec(pFormat, spec)) {
+        AppendLiteral(message, pLiteral, spec.pBegin);
+        pLiteral = spec.pEnd;
+
+        int stars[2] = { 0, 0 };
+        uint8_t tag = 0U;
+        uint64_t bits = 0U;
+        std::string str;
+        for (uint32_t i = 0U; i < spec.numStars; i++) {
+            if (!reader.GetArg(tag, bits, str)) {
+                return message;
+            }
+            stars[i] = (int)(int64_t)bits;
+        }
+        if (spec.conv == 'n') {
+            continue;
+        }
+        if (!reader.GetArg(tag, bits, str)) {
+            return message;
+        }
+
+        // Same flags, width and precision, length modifier matching what was stored
+        std::string conv(spec.pBegin, spec.pLength - spec.pBegin);
+        if ((tag == ARG_SIGNED || tag == ARG_UNSIGNED) && spec.conv != 'c') {
+            conv += "ll";
+        }
+        conv += spec.conv;
+
+        int n = 0;
+        switch (tag) {
+            case ARG_SIGNED:
+                if (spec.conv == 'c') {
+                    // %c takes the int it was passed as, not the stored 64 bits
+                    int value = (int)(int64_t)bits;
+                    n = (spec.numStars == 0U) ? snprintf(piece, sizeof(piece), conv.c_str(), value)
+                        : (spec.numStars == 1U) ? snprintf(piece, sizeof(piece), conv.c_str(), stars[0], value)
+                                                : snprintf(piece, sizeof(piece), conv.c_str(), stars[0], stars[1],
+                                                           value);
+                    break;
+                }
+                // fall through
+            case ARG_UNSIGNED: {
+                long long value = (long long)bits;
+                n = (spec.numStars == 0U) ? snprintf(piece, sizeof(piece), conv.c_str(), value)
+                    : (spec.numStars == 1U) ? snprintf(piece, sizeof(piece), conv.c_str(), stars[0], value)
+                                            : snprintf(piece, sizeof(piece), conv.c_str(), stars[0], stars[1], value);
+                break;
+            }
+            case ARG_DOUBLE: {
+                double value;
+                memcpy(&value, &bits, sizeof(value));
+                n = (spec.numStars == 0U) ? snprintf(piece, sizeof(piece), conv.c_str(), value)
+                    : (spec.numStars == 1U) ? snprintf(piece, sizeof(piece), conv.c_str(), stars[0], value)
+                                            : snprintf(piece, sizeof(piece), conv.c_str(), stars[0], stars[1], value);
+                break;
+            }
+            case ARG_POINTER: {
+                const void *value;
+                memcpy(&value, &bits, sizeof(value));
+                n = snprintf(piece, sizeof(piece), conv.c_str(), value);
+                break;
+            }
+            case ARG_STRING:
+                n = (spec.numStars == 0U) ? snprintf(piece, sizeof(piece), conv.c_str(), str.c_str())
+                    : (spec.numStars == 1U) ? snprintf(piece, sizeof(piece), conv.c_str(), stars[0], str.c_str())
+                                            : snprintf(piece, sizeof(piece), conv.c_str(), stars[0], stars[1],
+                                                       str.c_str());
+                break;
+            default:
+                return message;
+        }
+        if (n > 0) {
+            message.append(piece, std::min((size_t)n, sizeof(piece) - 1U));
+        }
+    }
+    // Unknown conversions end up verbatim
+    AppendLiteral(message, pLiteral, pLiteral + strlen(pLiteral));
+
+    return message;
+}
+
+std::string CAsyncLog::FormatLine(const LogRecordInfo &info, const char *pPrefix, const std::string &message,
+                                  bool bFunctionLine)
+{
+    char stamp[32];
+    snprintf(stamp, sizeof(stamp), "[%llu.%06llu]", (unsigned long long)(info.timeUs / 1000000U),
+             (unsigned long long)(info.timeUs % 1000000U));
+
+    std::string line(stamp);
+    if (info.pLevelTag != nullptr) {
+        line += "nvsipl_multicast: ";
+        line += info.pLevelTag;
+        if (pPrefix != nullptr && pPrefix[0] != '\0') {
+            line += pPrefix;
+            line += ": ";
+        }
+    }
+    line += message;
+    if (line.size() > LOG_MAX_LINE) {
+        line.resize(LOG_MAX_LINE);
+    }
+    while (!line.empty() && line.back() == '\n') {
+        line.pop_back();
+    }
+    if (bFunctionLine && info.pLevelTag != nullptr && info.pFunction != nullptr) {
+        line += " at ";
+        line += info.pFunction;
+        line += "():" + std::to_string(info.line);
+    }
+    line += '\n';
+
+    return line;
+}
+
+CAsyncLog::~CAsyncLog(void)
+{
+    Stop();
+    for (auto pRing : m_vpRings) {
+        free(pRing);
+    }
+}
+
+void CAsyncLog::Start(bool bFunctionLine)
+{
+    if (IsRunning()) {
+        return;
+    }
+    m_bFunctionLine = bFunctionLine;
+    m_bQuit.store(false, std::memory_order_release);
+    m_writerThread = std::thread(&CAsyncLog::WriterThreadFunc, this);
+    m_bRunning.store(true, std::memory_order_release);
+}
+
+void CAsyncLog::Stop(void)
+{
+    if (!m_writerThread.joinable()) {
+        return;
+    }
+    // Late messages go out synchronously from here on. Sequentially consistent with
+    // Push(): a caller either sees the flag cleared, or is counted and waited for.
+    m_bRunning.store(false, std::memory_order_seq_cst);
+    while (m_numPushing.load(std::memory_order_seq_cst) != 0U) {
+        std::this_thread::yield();
+    }
+    m_bQuit.store(true, std::memory_order_release);
+    m_writerThread.join();
+    // Records queued while the writer made its last pass
+    Drain();
+}
+
+CAsyncLog::LogRing *CAsyncLog::GetRing(void)
+{
+    if (s_pRing != nullptr) {
+        return s_pRing;
+    }
+
+    void *pMem = nullptr;
+    if (posix_memalign(&pMem, 64U, sizeof(LogRing)) != 0) {
+        return nullptr;
+    }
+    LogRing *pRing = static_cast<LogRing *>(pMem);
+    new (&pRing->head) std::atomic<uint64_t>(0U);
+    new (&pRing->tail) std::atomic<uint64_t>(0U);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_vpRings.push_back(pRing);
+    s_pRing = pRing;
+    return pRing;
+}
+
+bool CAsyncLog::Push(const LogRecordInfo &info, const char *pPrefix, const char *pFormat, va_list ap)
+{
+    alignas(8) uint8_t record[LOG_MAX_RECORD_SIZE];
+    RecordWriter writer(record, sizeof(record));
+    RecordHeader header { 0U, RECORD_MESSAGE };
+    writer.Put(&header, sizeof(header));
+    writer.Put(&info, sizeof(info));
+    // The function name may come from a temporary std::string
+    const char *pFunction = (info.pFunction != nullptr) ? info.pFunction : "";
+    writer.Put(pFunction, strlen(pFunction) + 1U);
+    writer.Put(pPrefix, strlen(pPrefix) + 1U);
+    writer.Put(pFormat, strlen(pFormat) + 1U);
+    if (!EncodeArgs(writer, pFormat, ap)) {
+        return false;
+    }
+
+    m_numPushing.fetch_add(1U, std::memory_order_seq_cst);
+    if (!m_bRunning.load(std::memory_order_seq_cst)) {
+        m_numPushing.fetch_sub(1U, std::memory_order_release);
+        return false;
+    }
+    const bool bQueued = PushRecord(record, writer.GetLength());
+    m_numPushing.fetch_sub(1U, std::memory_order_release);
+
+    return bQueued;
+}
+
+bool CAsyncLog::PushRecord(uint8_t *pRecord, size_t length)
+{
+    LogRing *pRing = GetRing();
+    if (pRing == nullptr) {
+        return false;
+    }
+    RecordHeader header { 0U, RECORD_MESSAGE };
+    const size_t size = (length + 7U) & ~(size_t)7U;
+    header.size = (uint32_t)size;
+    memcpy(pRecord, &header, sizeof(header));
+
+    uint64_t head = pRing->head.load(std::memory_order_relaxed);
+    const uint64_t tail = pRing->tail.load(std::memory_order_acquire);
+    const size_t offset = head & (LOG_RING_SIZE - 1U);
+    const size_t contiguous = LOG_RING_SIZE - offset;
+    const size_t needed = size + ((contiguous < size) ? contiguous : 0U);
+    if (LOG_RING_SIZE - (head - tail) < needed) {
+        m_dropped.fetch_add(1U, std::memory_order_relaxed);
+        return true;
+    }
+    if (contiguous < size) {
+        RecordHeader padding { (uint32_t)contiguous, RECORD_PADDING };
+        memcpy(pRing->data + offset, &padding, sizeof(padding));
+        head += contiguous;
+    }
+    memcpy(pRing->data + (head & (LOG_RING_SIZE - 1U)), pRecord, size);
+    pRing->head.store(head + size, std::memory_order_release);
+
+    return true;
+}
+
+// Formats what is queued in all rings, oldest first. Returns false when idle.
+bool CAsyncLog::Drain(void)
+{
+    std::vector<LogRing *> vpRings;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        vpRings = m_vpRings;
+    }
+
+    std::vector<PendingLine> vLines;
+    for (auto pRing : vpRings) {
+        const uint64_t head = pRing->head.load(std::memory_order_acquire);
+        uint64_t tail = pRing->tail.load(std::memory_order_relaxed);
+        while (tail < head) {
+            const uint8_t *pRecord = pRing->data + (tail & (LOG_RING_SIZE - 1U));
+            RecordHeader header;
+            memcpy(&header, pRecord, sizeof(header));
+            if (header.kind == RECORD_MESSAGE) {
+                RecordReader reader(pRecord + sizeof(header), header.size - sizeof(header));
+                LogRecordInfo info;
+                reader.Get(&info, sizeof(info));
+                info.pFunction = reader.GetCString();
+                const char *pPrefix = reader.GetCString();
+                const char *pFormat = reader.GetCString();
+                std::string message = DecodeMessage(pFormat, reader);
+                vLines.push_back(PendingLine{ info.timeUs, FormatLine(info, pPrefix, message, m_bFunctionLine) });
+            }
+            tail += header.size;
+        }
+        pRing->tail.store(tail, std::memory_order_release);
+    }
+
+    uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+    if (dropped != m_reportedDrops) {
+        std::string line = "nvsipl_multicast: WARNING: " + std::to_string(dropped - m_reportedDrops) +
+                           " log messages dropped, log rings full\n";
+        fwrite(line.data(), 1U, line.size(), stdout);
+        fflush(stdout);
+        m_reportedDrops = dropped;
+    }
+    if (vLines.empty()) {
+        return false;
+    }
+
+    // Stable, so lines of one thread with the same timestamp keep their order
+    std::stable_sort(vLines.begin(), vLines.end(), [](const PendingLine &a, const PendingLine &b) {
+        return a.timeUs < b.timeUs;
+    });
+    for (const auto &pending : vLines) {
+        fwrite(pending.line.data(), 1U, pending.line.size(), stdout);
+    }
+    fflush(stdout);
+
+    return true;
+}
+
+void CAsyncLog::WriterThreadFunc(void)
+{
+    CThreadPolicy::GetInstance().Apply(ThreadRole::LOG, THREAD_ANY_INSTANCE, "LogWriter");
+
+    while (!m_bQuit.load(std::memory_order_acquire)) {
+        if (!Drain()) {
+            std::this_thread::sleep_for(LOG_WRITER_INTERVAL);
+        }
+    }
+    Drain();
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CASYNCLOG_HPP
+#define CASYNCLOG_HPP
+
+#include <atomic>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr size_t LOG_RING_SIZE = 64U * 1024U; // per thread, power of two
+constexpr size_t LOG_MAX_RECORD_SIZE = 2048U;
+constexpr size_t LOG_MAX_LINE = 1024U;
+
+// What a record needs besides the arguments, see CLogger
+typedef struct {
+    uint64_t timeUs;       // CLOCK_REALTIME
+    const char *pLevelTag; // "ERROR: " etc., nullptr for LOG_MSG style lines
+    const char *pFunction; // __FUNCTION__
+    uint32_t line;
+} LogRecordInfo;
+
+/* Turns printf style calls into binary records.
+ * The calling thread only parses the format to copy the arguments (strings by
+ * value) into its own lock-free ring, it never formats or does I/O. A writer
+ * thread formats the records of all threads in timestamp order and writes
+ * them to stdout. A full ring drops the record and counts it. */
+class CAsyncLog
+{
+public:
+    CAsyncLog(void) = default;
+    ~CAsyncLog(void);
+
+    CAsyncLog(const CAsyncLog &) = delete;
+    CAsyncLog &operator=(const CAsyncLog &) = delete;
+
+    void Start(bool bFunctionLine);
+    // Writes everything queued so far, then stops the writer thread.
+    void Stop(void);
+    bool IsRunning(void) const
+    {
+        return m_bRunning.load(std::memory_order_acquire);
+    }
+
+    // False when the record did not fit or the writer is stopping, the caller may
+    // log synchronously. A record accepted here is always written before Stop() returns.
+    bool Push(const LogRecordInfo &info, const char *pPrefix, const char *pFormat, va_list ap);
+
+    // Formats one message the way the writer thread does, for synchronous logging.
+    static std::string FormatLine(const LogRecordInfo &info, const char *pPrefix, const std::string &message,
+                                  bool bFunctionLine);
+
+private:
+    typedef struct {
+        std::atomic<uint64_t> head; // written by the owner thread
+        std::atomic<uint64_t> tail; // written by the writer thread
+        uint8_t data[LOG_RING_SIZE];
+    } LogRing;
+
+    typedef struct {
+        uint64_t timeUs;
+        std::string line;
+    } PendingLine;
+
+    LogRing *GetRing(void);
+    // Copies a complete record into the calling thread's ring
+    bool PushRecord(uint8_t *pRecord, size_t length);
+    void WriterThreadFunc(void);
+    bool Drain(void);
+
+    static thread_local LogRing *s_pRing;
+
+    std::mutex m_mutex; // guards m_vpRings
+    std::vector<LogRing *> m_vpRings;
+    std::thread m_writerThread;
+    std::atomic<bool> m_bRunning {false};
+    std::atomic<uint32_t> m_numPushing {0U}; // Push() calls past the running check
+    std::atomic<bool> m_bQuit {false};
+    std::atomic<uint64_t> m_dropped {0U};
+    uint64_t m_reportedDrops = 0U;
+    bool m_bFunctionLine = false;
+};
+
+#endif
@@ -0,0 +1,230 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CBitstreamRing.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+// Polls of BitsAvailable() that only yield, before ReadFrame() starts sleeping
+constexpr uint32_t BITSTREAM_SPIN_POLLS = 16U;
+constexpr int64_t BITSTREAM_MIN_SLEEP_US = 10;
+constexpr int64_t BITSTREAM_MAX_SLEEP_US = 1000;
+
+CBitstreamRing::CBitstreamRing(size_t capacity) :
+    m_upEntries(new SpanEntry[BITSTREAM_MAX_SPANS])
+{
+    for (uint32_t i = 0U; i < BITSTREAM_MAX_SPANS; i++) {
+        m_upEntries[i].refs.store(0U, std::memory_order_relaxed);
+        m_upEntries[i].pBuf = nullptr;
+        m_upEntries[i].offset = 0U;
+        m_upEntries[i].size = 0U;
+    }
+    m_pBuf = static_cast<uint8_t *>(malloc(capacity));
+    m_capacity = (m_pBuf != nullptr) ? capacity : 0U;
+}
+
+CBitstreamRing::~CBitstreamRing(void)
+{
+    for (auto pBuf : m_vRetired) {
+        free(pBuf);
+    }
+    free(m_pBuf);
+}
+
+void CBitstreamRing::AddRef(const BitstreamSpan &span)
+{
+    span.pRing->m_upEntries[span.entry].refs.fetch_add(1U, std::memory_order_relaxed);
+}
+
+void CBitstreamRing::Release(const BitstreamSpan &span)
+{
+    span.pRing->ReleaseEntry(span.entry);
+}
+
+void CBitstreamRing::OnSinkDone(void *pContext, uint32_t tag)
+{
+    static_cast<CBitstreamRing *>(pContext)->ReleaseEntry(tag);
+}
+
+void CBitstreamRing::ReleaseEntry(uint32_t entry)
+{
+    m_upEntries[entry].refs.fetch_sub(1U, std::memory_order_release);
+}
+
+void CBitstreamRing::Reclaim(void)
+{
+    while (m_count > 0U && m_upEntries[m_oldest].refs.load(std::memory_order_acquire) == 0U) {
+        m_oldest = (m_oldest + 1U) % BITSTREAM_MAX_SPANS;
+        m_count--;
+    }
+    if (m_count == 0U) {
+        m_writePos = 0U;
+    }
+
+    // Retired storage is freed once no outstanding span points into it. Spans are
+    // released in FIFO order, so everything retired before the oldest span's
+    // storage is unreferenced.
+    if (!m_vRetired.empty()) {
+        const uint8_t *pOldestBuf = (m_count > 0U) ? m_upEntries[m_oldest].pBuf : m_pBuf;
+        size_t numFree = 0U;
+        while (numFree < m_vRetired.size() && m_vRetired[numFree] != pOldestBuf) {
+            free(m_vRetired[numFree]);
+            numFree++;
+        }
+        m_vRetired.erase(m_vRetired.begin(), m_vRetired.begin() + numFree);
+    }
+}
+
+bool CBitstreamRing::Grow(size_t size)
+{
+    size_t newCapacity = (m_capacity > 0U) ? m_capacity * 2U : size;
+    while (newCapacity < size) {
+        newCapacity *= 2U;
+    }
+    uint8_t *pBuf = static_cast<uint8_t *>(malloc(newCapacity));
+    if (pBuf == nullptr) {
+        return false;
+    }
+
+    bool bReferenced = false;
+    for (uint32_t i = 0U; i < m_count; i++) {
+        if (m_upEntries[(m_oldest + i) % BITSTREAM_MAX_SPANS].pBuf == m_pBuf) {
+            bReferenced = true;
+            break;
+        }
+    }
+    if (bReferenced) {
+        m_vRetired.push_back(m_pBuf);
+    } else {
+        free(m_pBuf);
+    }
+
+    m_pBuf = pBuf;
+    m_capacity = newCapacity;
+    m_writePos = 0U;
+    m_growCount++;
+    return true;
+}
+
+uint8_t *CBitstreamRing::Reserve(size_t size)
+{
+    Reclaim();
+    if (size == 0U || m_count == BITSTREAM_MAX_SPANS) {
+        return nullptr;
+    }
+
+    // Locate the outstanding spans that live in the current storage
+    bool bHasCurrent = false;
+    size_t oldestOffset = 0U;
+    size_t newestOffset = 0U;
+    for (uint32_t i = 0U; i < m_count; i++) {
+        const SpanEntry &entry = m_upEntries[(m_oldest + i) % BITSTREAM_MAX_SPANS];
+        if (entry.pBuf != m_pBuf) {
+            continue;
+        }
+        if (!bHasCurrent) {
+            oldestOffset = entry.offset;
+            bHasCurrent = true;
+        }
+        newestOffset = entry.offset;
+    }
+
+    size_t offset = 0U;
+    bool bFits = false;
+    if (!bHasCurrent) {
+        bFits = (size <= m_capacity);
+    } else if (newestOffset >= oldestOffset) {
+        // Used bytes are [oldest, writePos), free space is both ends
+        if (m_capacity - m_writePos >= size) {
+            offset = m_writePos;
+            bFits = true;
+        } else if (oldestOffset >= size) {
+            bFits = true;
+        }
+    } else {
+        // Wrapped, free space is [writePos, oldest)
+        if (oldestOffset - m_writePos >= size) {
+            offset = m_writePos;
+            bFits = true;
+        }
+    }
+
+    if (!bFits) {
+        if (!Grow(size)) {
+            return nullptr;
+        }
+        offset = 0U;
+    }
+
+    m_reserved = size;
+    m_reservedOffset = offset;
+    return m_pBuf + offset;
+}
+
+bool CBitstreamRing::Commit(size_t size, BitstreamSpan &span)
+{
+    if (size > m_reserved || m_count == BITSTREAM_MAX_SPANS) {
+        return false;
+    }
+
+    const uint32_t index = (m_oldest + m_count) % BITSTREAM_MAX_SPANS;
+    SpanEntry &entry = m_upEntries[index];
+    entry.pBuf = m_pBuf;
+    entry.offset = m_reservedOffset;
+    entry.size = size;
+    entry.refs.store(1U, std::memory_order_relaxed);
+    m_count++;
+    m_writePos = m_reservedOffset + size;
+    m_reserved = 0U;
+
+    span.pRing = this;
+    span.entry = index;
+    span.pData = m_pBuf + entry.offset;
+    span.size = size;
+    return true;
+}
+
+BitsStatus CBitstreamRing::ReadFrame(CEncoderOutput &output, BitstreamSpan &span, int64_t timeoutUs)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeoutUs);
+    int64_t sleepUs = BITSTREAM_MIN_SLEEP_US;
+    size_t numBytes = 0U;
+    BitsStatus status;
+    for (uint32_t poll = 0U; (status = output.BitsAvailable(numBytes)) == BitsStatus::PENDING; poll++) {
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            return BitsStatus::PENDING;
+        }
+        if (poll < BITSTREAM_SPIN_POLLS) {
+            std::this_thread::yield();
+            continue;
+        }
+        const auto sleep = std::min(std::chrono::microseconds(sleepUs),
+                                    std::chrono::duration_cast<std::chrono::microseconds>(deadline - now));
+        std::this_thread::sleep_for(sleep);
+        sleepUs = std::min(sleepUs * 2, BITSTREAM_MAX_SLEEP_US);
+    }
+    if (status != BitsStatus::OK || numBytes == 0U) {
+        return BitsStatus::ERROR;
+    }
+
+    uint8_t *pDst = Reserve(numBytes);
+    if (pDst == nullptr) {
+        return BitsStatus::ERROR;
+    }
+    // The encoder overwrites every byte it reports, no need to clear the span first
+    status = output.GetBits(pDst, numBytes);
+    if (status != BitsStatus::OK) {
+        return status;
+    }
+
+    return Commit(numBytes, span) ? BitsStatus::OK : BitsStatus::ERROR;
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CBITSTREAMRING_HPP
+#define CBITSTREAMRING_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+constexpr uint32_t BITSTREAM_MAX_SPANS = 32U;
+// How long ReadFrame() waits for bits the encoder reports as pending
+constexpr int64_t BITSTREAM_READ_TIMEOUT_US = 100000;
+// H.264 level limit on a coded 8-bit 4:2:0 macroblock, 3200 bits (ITU-T H.264 A.3.1)
+constexpr size_t H264_MAX_MB_BYTES = 400U;
+// SPS, PPS, AUD and SEI in front of the slices
+constexpr size_t H264_MAX_HEADER_BYTES = 4096U;
+
+// Largest H.264 access unit for an 8-bit 4:2:0 frame, whatever the rate control does
+inline size_t H264MaxFrameBytes(uint32_t width, uint32_t height)
+{
+    const size_t numMbs = (size_t)((width + 15U) / 16U) * ((height + 15U) / 16U);
+    return numMbs * H264_MAX_MB_BYTES + H264_MAX_HEADER_BYTES;
+}
+
+class CBitstreamRing;
+
+// One encoded frame inside a CBitstreamRing. Plain data so it can travel
+// through queues; every AddRef() must be matched by one Release().
+typedef struct {
+    CBitstreamRing *pRing;
+    uint32_t entry;
+    const uint8_t *pData;
+    size_t size;
+} BitstreamSpan;
+
+enum class BitsStatus
+{
+    OK = 0,
+    PENDING,
+    ERROR
+};
+
+// Where encoded bits come from, NvMedia IEP on target, a stub on a host.
+class CEncoderOutput
+{
+public:
+    virtual ~CEncoderOutput(void) = default;
+
+    // Size of the next encoded frame, PENDING while it is not ready yet.
+    virtual BitsStatus BitsAvailable(size_t &numBytes) = 0;
+    // Copies exactly numBytes of the frame reported by BitsAvailable().
+    virtual BitsStatus GetBits(uint8_t *pDst, size_t numBytes) = 0;
+};
+
+/* Preallocated byte ring for encoded frames.
+ * The encoder thread writes frames back to back and hands them out as
+ * ref-counted spans. Sinks may release spans from any thread. Space is reclaimed
+ * in FIFO order on the encoder thread. When the ring cannot fit a frame it grows,
+ * and the old storage lives on until its last span is released. */
+class CBitstreamRing
+{
+public:
+    explicit CBitstreamRing(size_t capacity);
+    ~CBitstreamRing(void);
+
+    CBitstreamRing(const CBitstreamRing &) = delete;
+    CBitstreamRing &operator=(const CBitstreamRing &) = delete;
+
+    // Encoder thread: pulls one frame from the encoder output into the ring.
+    // The span comes back with one reference held by the caller. While the bits
+    // are pending it yields, then sleeps with backoff; PENDING once timeoutUs passed.
+    BitsStatus ReadFrame(CEncoderOutput &output, BitstreamSpan &span,
+                         int64_t timeoutUs = BITSTREAM_READ_TIMEOUT_US);
+
+    // Encoder thread: contiguous room for size bytes, then publish what was written.
+    uint8_t *Reserve(size_t size);
+    bool Commit(size_t size, BitstreamSpan &span);
+
+    // Any thread
+    static void AddRef(const BitstreamSpan &span);
+    static void Release(const BitstreamSpan &span);
+    // CDumpWriter completion hook, pContext is the ring, tag the span entry.
+    static void OnSinkDone(void *pContext, uint32_t tag);
+
+    size_t GetCapacity(void) const
+    {
+        return m_capacity;
+    }
+    uint64_t GetGrowCount(void) const
+    {
+        return m_growCount;
+    }
+
+private:
+    typedef struct {
+        std::atomic<uint32_t> refs;
+        uint8_t *pBuf;
+        size_t offset;
+        size_t size;
+    } SpanEntry;
+
+    void Reclaim(void);
+    bool Grow(size_t size);
+    void ReleaseEntry(uint32_t entry);
+
+    uint8_t *m_pBuf = nullptr;
+    size_t m_capacity = 0U;
+    size_t m_writePos = 0U;
+    size_t m_reserved = 0U;
+    size_t m_reservedOffset = 0U;
+    // Storage replaced by Grow() that still backs outstanding spans
+    std::vector<uint8_t *> m_vRetired;
+
+    std::unique_ptr<SpanEntry[]> m_upEntries;
+    uint32_t m_oldest = 0U; // oldest outstanding entry
+    uint32_t m_count = 0U;  // outstanding entries
+    uint64_t m_growCount = 0U;
+};
+
+#endif
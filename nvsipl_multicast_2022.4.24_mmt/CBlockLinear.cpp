@@ -0,0 +1,315 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CBlockLinear.hpp"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+/* Within a GOB, row y occupies four 16-byte chunks at
+ * ((y & 7) >> 1) * 64 + (y & 1) * 16 + {0, 32, 256, 288}.
+ * Rows y and y + 1 (y even) are interleaved chunk by chunk, so a row pair is
+ * read as two contiguous 64-byte runs at offsets 0 and 256. */
+static constexpr uint32_t kGobHalfOffset = 256U;
+
+static inline void GobRowPairToPl(const uint8_t *pSrc, uint8_t *pDst0, uint8_t *pDst1)
+{
+#if defined(__AVX2__)
+    for (uint32_t half = 0U; half < 2U; half++) {
+        const uint8_t *s = pSrc + half * kGobHalfOffset;
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 32));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(pDst0 + half * 32U), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(pDst1 + half * 32U), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+#elif defined(__ARM_NEON)
+    for (uint32_t half = 0U; half < 2U; half++) {
+        const uint8_t *s = pSrc + half * kGobHalfOffset;
+        uint8x16_t q0 = vld1q_u8(s);
+        uint8x16_t q1 = vld1q_u8(s + 16);
+        uint8x16_t q2 = vld1q_u8(s + 32);
+        uint8x16_t q3 = vld1q_u8(s + 48);
+        vst1q_u8(pDst0 + half * 32U, q0);
+        vst1q_u8(pDst0 + half * 32U + 16U, q2);
+        vst1q_u8(pDst1 + half * 32U, q1);
+        vst1q_u8(pDst1 + half * 32U + 16U, q3);
+    }
+#else
+    for (uint32_t half = 0U; half < 2U; half++) {
+        const uint8_t *s = pSrc + half * kGobHalfOffset;
+        memcpy(pDst0 + half * 32U, s, 16U);
+        memcpy(pDst1 + half * 32U, s + 16, 16U);
+        memcpy(pDst0 + half * 32U + 16U, s + 32, 16U);
+        memcpy(pDst1 + half * 32U + 16U, s + 48, 16U);
+    }
+#endif
+}
+
+static inline void PlRowPairToGob(const uint8_t *pSrc0, const uint8_t *pSrc1, uint8_t *pDst)
+{
+#if defined(__AVX2__)
+    for (uint32_t half = 0U; half < 2U; half++) {
+        uint8_t *d = pDst + half * kGobHalfOffset;
+        __m256i r0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pSrc0 + half * 32U));
+        __m256i r1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pSrc1 + half * 32U));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(d), _mm256_permute2x128_si256(r0, r1, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + 32), _mm256_permute2x128_si256(r0, r1, 0x31));
+    }
+#elif defined(__ARM_NEON)
+    for (uint32_t half = 0U; half < 2U; half++) {
+        uint8_t *d = pDst + half * kGobHalfOffset;
+        vst1q_u8(d, vld1q_u8(pSrc0 + half * 32U));
+        vst1q_u8(d + 16, vld1q_u8(pSrc1 + half * 32U));
+        vst1q_u8(d + 32, vld1q_u8(pSrc0 + half * 32U + 16U));
+        vst1q_u8(d + 48, vld1q_u8(pSrc1 + half * 32U + 16U));
+    }
+#else
+    for (uint32_t half = 0U; half < 2U; half++) {
+        uint8_t *d = pDst + half * kGobHalfOffset;
+        memcpy(d, pSrc0 + half * 32U, 16U);
+        memcpy(d + 16, pSrc1 + half * 32U, 16U);
+        memcpy(d + 32, pSrc0 + half * 32U + 16U, 16U);
+        memcpy(d + 48, pSrc1 + half * 32U + 16U, 16U);
+    }
+#endif
+}
+
+static inline void GobRowToPl(const uint8_t *pSrc, uint8_t *pDst)
+{
+    memcpy(pDst, pSrc, 16U);
+    memcpy(pDst + 16, pSrc + 32, 16U);
+    memcpy(pDst + 32, pSrc + kGobHalfOffset, 16U);
+    memcpy(pDst + 48, pSrc + kGobHalfOffset + 32U, 16U);
+}
+
+static inline void PlRowToGob(const uint8_t *pSrc, uint8_t *pDst)
+{
+    memcpy(pDst, pSrc, 16U);
+    memcpy(pDst + 32, pSrc + 16, 16U);
+    memcpy(pDst + kGobHalfOffset, pSrc + 32, 16U);
+    memcpy(pDst + kGobHalfOffset + 32U, pSrc + 48, 16U);
+}
+
+void CBlockLinear::BlToPlReference(const BlockLinearPlane &plane, const uint8_t *pSrc,
+                                   uint8_t *pDst, uint32_t dstPitch, uint32_t yBegin, uint32_t yEnd)
+{
+    for (uint32_t y = yBegin; y < yEnd; y++) {
+        uint8_t *pRow = pDst + (size_t)y * dstPitch;
+        for (uint32_t x = 0U; x < plane.widthBytes; x++) {
+            pRow[x] = pSrc[Offset(plane, x, y)];
+        }
+    }
+}
+
+void CBlockLinear::PlToBlReference(const BlockLinearPlane &plane, const uint8_t *pSrc, uint32_t srcPitch,
+                                   uint8_t *pDst, uint32_t yBegin, uint32_t yEnd)
+{
+    for (uint32_t y = yBegin; y < yEnd; y++) {
+        const uint8_t *pRow = pSrc + (size_t)y * srcPitch;
+        for (uint32_t x = 0U; x < plane.widthBytes; x++) {
+            pDst[Offset(plane, x, y)] = pRow[x];
+        }
+    }
+}
+
+void CBlockLinear::BlToPlRows(const BlockLinearPlane &plane, const uint8_t *pSrc,
+                              uint8_t *pDst, uint32_t dstPitch, uint32_t yBegin, uint32_t yEnd)
+{
+    const uint32_t fullGobs = plane.widthBytes / BL_GOB_WIDTH;
+    const uint32_t tailX = fullGobs * BL_GOB_WIDTH;
+    const size_t gobStride = (size_t)BL_GOB_SIZE << plane.blockHeightLog2;
+    uint32_t y = yBegin;
+
+    if ((y < yEnd) && ((y & 1U) != 0U)) {
+        const uint8_t *pGob = pSrc + GobBase(plane, 0U, y) + GobOffset(0U, y & 7U);
+        uint8_t *pRow = pDst + (size_t)y * dstPitch;
+        for (uint32_t g = 0U; g < fullGobs; g++) {
+            GobRowToPl(pGob + g * gobStride, pRow + g * BL_GOB_WIDTH);
+        }
+        for (uint32_t x = tailX; x < plane.widthBytes; x++) {
+            pRow[x] = pSrc[Offset(plane, x, y)];
+        }
+        y++;
+    }
+    for (; y + 1U < yEnd; y += 2U) {
+        const uint8_t *pGob = pSrc + GobBase(plane, 0U, y) + GobOffset(0U, y & 7U);
+        uint8_t *pRow0 = pDst + (size_t)y * dstPitch;
+        uint8_t *pRow1 = pRow0 + dstPitch;
+        for (uint32_t g = 0U; g < fullGobs; g++) {
+            GobRowPairToPl(pGob + g * gobStride, pRow0 + g * BL_GOB_WIDTH, pRow1 + g * BL_GOB_WIDTH);
+        }
+        for (uint32_t x = tailX; x < plane.widthBytes; x++) {
+            pRow0[x] = pSrc[Offset(plane, x, y)];
+            pRow1[x] = pSrc[Offset(plane, x, y + 1U)];
+        }
+    }
+    if (y < yEnd) {
+        const uint8_t *pGob = pSrc + GobBase(plane, 0U, y) + GobOffset(0U, y & 7U);
+        uint8_t *pRow = pDst + (size_t)y * dstPitch;
+        for (uint32_t g = 0U; g < fullGobs; g++) {
+            GobRowToPl(pGob + g * gobStride, pRow + g * BL_GOB_WIDTH);
+        }
+        for (uint32_t x = tailX; x < plane.widthBytes; x++) {
+            pRow[x] = pSrc[Offset(plane, x, y)];
+        }
+    }
+}
+
+void CBlockLinear::PlToBlRows(const BlockLinearPlane &plane, const uint8_t *pSrc, uint32_t srcPitch,
+                              uint8_t *pDst, uint32_t yBegin, uint32_t yEnd)
+{
+    const uint32_t fullGobs = plane.widthBytes / BL_GOB_WIDTH;
+    const uint32_t tailX = fullGobs * BL_GOB_WIDTH;
+    const size_t gobStride = (size_t)BL_GOB_SIZE << plane.blockHeightLog2;
+    uint32_t y = yBegin;
+
+    if ((y < yEnd) && ((y & 1U) != 0U)) {
+        uint8_t *pGob = pDst + GobBase(plane, 0U, y) + GobOffset(0U, y & 7U);
+        const uint8_t *pRow = pSrc + (size_t)y * srcPitch;
+        for (uint32_t g = 0U; g < fullGobs; g++) {
+            PlRowToGob(pRow + g * BL_GOB_WIDTH, pGob + g * gobStride);
+        }
+        for (uint32_t x = tailX; x < plane.widthBytes; x++) {
+            pDst[Offset(plane, x, y)] = pRow[x];
+        }
+        y++;
+    }
+    for (; y + 1U < yEnd; y += 2U) {
+        uint8_t *pGob = pDst + GobBase(plane, 0U, y) + GobOffset(0U, y & 7U);
+        const uint8_t *pRow0 = pSrc + (size_t)y * srcPitch;
+        const uint8_t *pRow1 = pRow0 + srcPitch;
+        for (uint32_t g = 0U; g < fullGobs; g++) {
+            PlRowPairToGob(pRow0 + g * BL_GOB_WIDTH, pRow1 + g * BL_GOB_WIDTH, pGob + g * gobStride);
+        }
+        for (uint32_t x = tailX; x < plane.widthBytes; x++) {
+            pDst[Offset(plane, x, y)] = pRow0[x];
+            pDst[Offset(plane, x, y + 1U)] = pRow1[x];
+        }
+    }
+    if (y < yEnd) {
+        uint8_t *pGob = pDst + GobBase(plane, 0U, y) + GobOffset(0U, y & 7U);
+        const uint8_t *pRow = pSrc + (size_t)y * srcPitch;
+        for (uint32_t g = 0U; g < fullGobs; g++) {
+            PlRowToGob(pRow + g * BL_GOB_WIDTH, pGob + g * gobStride);
+        }
+        for (uint32_t x = tailX; x < plane.widthBytes; x++) {
+            pDst[Offset(plane, x, y)] = pRow[x];
+        }
+    }
+}
+
+CBlockLinearConverter::CBlockLinearConverter(uint32_t numThreads)
+{
+    m_numThreads = (numThreads == 0U) ? 1U : numThreads;
+    m_bandBegin.resize(m_numThreads + 1U, 0U);
+    m_bandThreads.reserve(m_numThreads - 1U);
+    for (uint32_t band = 1U; band < m_numThreads; band++) {
+        m_bandThreads.emplace_back(&CBlockLinearConverter::BandThreadFunc, this, band);
+    }
+}
+
+CBlockLinearConverter::~CBlockLinearConverter(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bQuit = true;
+    }
+    m_startCond.notify_all();
+    for (auto &thread : m_bandThreads) {
+        thread.join();
+    }
+}
+
+void CBlockLinearConverter::RunRows(const BandJob &job, uint32_t yBegin, uint32_t yEnd)
+{
+    if (job.bToPl) {
+        CBlockLinear::BlToPlRows(job.plane, job.pSrc, job.pDst, job.plPitch, yBegin, yEnd);
+    } else {
+        CBlockLinear::PlToBlRows(job.plane, job.pSrc, job.plPitch, job.pDst, yBegin, yEnd);
+    }
+}
+
+void CBlockLinearConverter::BandThreadFunc(uint32_t band)
+{
+    uint64_t lastGeneration = 0U;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_startCond.wait(lock, [this, lastGeneration]() { return m_bQuit || m_generation != lastGeneration; });
+        if (m_bQuit) {
+            return;
+        }
+        lastGeneration = m_generation;
+        if (band >= m_numBands) {
+            continue;
+        }
+        const BandJob job = m_job;
+        const uint32_t yBegin = m_bandBegin[band];
+        const uint32_t yEnd = m_bandBegin[band + 1U];
+        lock.unlock();
+        RunRows(job, yBegin, yEnd);
+        lock.lock();
+        if (--m_numRunning == 0U) {
+            m_doneCond.notify_one();
+        }
+    }
+}
+
+void CBlockLinearConverter::RunBands(const BandJob &job)
+{
+    const BlockLinearPlane &plane = job.plane;
+    const uint32_t blockRows = BL_GOB_HEIGHT << plane.blockHeightLog2;
+    const uint32_t numBlocks = (plane.height + blockRows - 1U) / blockRows;
+    const uint32_t numBands = (m_numThreads < numBlocks) ? m_numThreads : numBlocks;
+    if (numBands <= 1U) {
+        RunRows(job, 0U, plane.height);
+        return;
+    }
+
+    std::lock_guard<std::mutex> runLock(m_runMutex);
+    uint32_t yEnd = 0U;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (uint32_t b = 0U; b <= numBands; b++) {
+            uint32_t y = (uint32_t)(((uint64_t)numBlocks * b / numBands) * blockRows);
+            m_bandBegin[b] = (y < plane.height) ? y : plane.height;
+        }
+        yEnd = m_bandBegin[1];
+        m_job = job;
+        m_numBands = numBands;
+        m_numRunning = numBands - 1U;
+        m_generation++;
+    }
+    m_startCond.notify_all();
+    RunRows(job, 0U, yEnd);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCond.wait(lock, [this]() { return m_numRunning == 0U; });
+}
+
+bool CBlockLinearConverter::BlToPl(const BlockLinearPlane &plane, const uint8_t *pSrc, uint8_t *pDst, uint32_t dstPitch)
+{
+    if (pSrc == nullptr || pDst == nullptr || dstPitch < plane.widthBytes || !CBlockLinear::IsValid(plane)) {
+        return false;
+    }
+    RunBands(BandJob { true, plane, pSrc, pDst, dstPitch });
+    return true;
+}
+
+bool CBlockLinearConverter::PlToBl(const BlockLinearPlane &plane, const uint8_t *pSrc, uint32_t srcPitch, uint8_t *pDst)
+{
+    if (pSrc == nullptr || pDst == nullptr || srcPitch < plane.widthBytes || !CBlockLinear::IsValid(plane)) {
+        return false;
+    }
+    RunBands(BandJob { false, plane, pSrc, pDst, srcPitch });
+    return true;
+}
@@ -0,0 +1,196 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CBLOCKLINEAR_HPP
+#define CBLOCKLINEAR_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* NVIDIA block-linear layout: a GOB is 64 bytes x 8 rows (512 bytes), GOBs are
+ * stacked vertically into blocks of 2^blockHeightLog2 GOBs, and blocks are laid
+ * out left to right, then top to bottom. Inside a GOB the 16-byte row chunks are
+ * swizzled, see CBlockLinear::GobOffset(). */
+constexpr uint32_t BL_GOB_WIDTH = 64U;
+constexpr uint32_t BL_GOB_HEIGHT = 8U;
+constexpr uint32_t BL_GOB_SIZE = BL_GOB_WIDTH * BL_GOB_HEIGHT;
+constexpr uint32_t BL_MAX_BLOCK_HEIGHT_LOG2 = 5U;
+
+// Geometry of one block-linear plane
+typedef struct {
+    uint32_t widthBytes;      /* valid bytes per row (width * bpp / 8) */
+    uint32_t height;          /* valid rows */
+    uint32_t pitch;           /* surface bytes per row, multiple of BL_GOB_WIDTH */
+    uint32_t alignedHeight;   /* surface rows, multiple of the block height */
+    uint32_t blockHeightLog2; /* log2 of the number of GOBs per block */
+} BlockLinearPlane;
+
+class CBlockLinear
+{
+public:
+    // A block height for surfaces made without NvSciBuf, e.g. in the benches: 16 GOBs,
+    // reduced for short planes and to whatever evenly divides the aligned height.
+    // Buffers from NvSciBuf carry theirs in NvSciBufImageAttrKey_PlaneBlockHeight.
+    static uint32_t DefaultBlockHeightLog2(uint32_t height, uint32_t alignedHeight)
+    {
+        uint32_t gobRows = (height + BL_GOB_HEIGHT - 1U) / BL_GOB_HEIGHT;
+        uint32_t log2 = 0U;
+        while (log2 < 4U && (1U << log2) < gobRows) {
+            log2++;
+        }
+        while (log2 > 0U && (alignedHeight % (BL_GOB_HEIGHT << log2)) != 0U) {
+            log2--;
+        }
+        return log2;
+    }
+
+    // Builds the plane geometry from any attribute set shaped like BufferAttrs,
+    // including the reconciled planeBlockHeights.
+    template <typename Attrs>
+    static bool GetPlane(const Attrs &attrs, uint32_t planeId, BlockLinearPlane &plane)
+    {
+        if (planeId >= attrs.planeCount) {
+            return false;
+        }
+        plane.widthBytes = attrs.planeWidths[planeId] * attrs.planeBitsPerPixels[planeId] / 8U;
+        plane.height = attrs.planeHeights[planeId];
+        plane.pitch = attrs.planePitches[planeId];
+        plane.alignedHeight = attrs.planeAlignedHeights[planeId];
+        plane.blockHeightLog2 = attrs.planeBlockHeights[planeId];
+        return IsValid(plane);
+    }
+
+    static bool IsValid(const BlockLinearPlane &plane)
+    {
+        return (plane.pitch != 0U) && (plane.pitch % BL_GOB_WIDTH == 0U) &&
+               (plane.widthBytes <= plane.pitch) && (plane.height <= plane.alignedHeight) &&
+               (plane.blockHeightLog2 <= BL_MAX_BLOCK_HEIGHT_LOG2) &&
+               (plane.alignedHeight % (BL_GOB_HEIGHT << plane.blockHeightLog2) == 0U);
+    }
+
+    static size_t PlaneSize(const BlockLinearPlane &plane)
+    {
+        return (size_t)plane.pitch * plane.alignedHeight;
+    }
+
+    // Offset of byte (x, y) inside its GOB
+    static inline uint32_t GobOffset(uint32_t x, uint32_t y)
+    {
+        return ((x >> 5U) << 8U) | ((y >> 1U) << 6U) | (((x >> 4U) & 1U) << 5U) | ((y & 1U) << 4U) | (x & 15U);
+    }
+
+    // Offset of the GOB holding byte (x, y) from the start of the plane
+    static inline size_t GobBase(const BlockLinearPlane &plane, uint32_t x, uint32_t y)
+    {
+        const uint32_t bhl = plane.blockHeightLog2;
+        const size_t gobsPerRow = plane.pitch / BL_GOB_WIDTH;
+        const size_t block = (size_t)(y >> (3U + bhl)) * gobsPerRow + (x >> 6U);
+        const size_t gobInBlock = (y >> 3U) & ((1U << bhl) - 1U);
+        return ((block << bhl) + gobInBlock) * BL_GOB_SIZE;
+    }
+
+    static inline size_t Offset(const BlockLinearPlane &plane, uint32_t x, uint32_t y)
+    {
+        return GobBase(plane, x, y) + GobOffset(x & (BL_GOB_WIDTH - 1U), y & (BL_GOB_HEIGHT - 1U));
+    }
+
+    /* Bit-exact scalar reference, one byte at a time, for rows [yBegin, yEnd). */
+    static void BlToPlReference(const BlockLinearPlane &plane, const uint8_t *pSrc,
+                                uint8_t *pDst, uint32_t dstPitch, uint32_t yBegin, uint32_t yEnd);
+    static void PlToBlReference(const BlockLinearPlane &plane, const uint8_t *pSrc, uint32_t srcPitch,
+                                uint8_t *pDst, uint32_t yBegin, uint32_t yEnd);
+
+    /* Vectorized (AVX2 / NEON, 16-byte chunks otherwise) versions of the above. */
+    static void BlToPlRows(const BlockLinearPlane &plane, const uint8_t *pSrc,
+                           uint8_t *pDst, uint32_t dstPitch, uint32_t yBegin, uint32_t yEnd);
+    static void PlToBlRows(const BlockLinearPlane &plane, const uint8_t *pSrc, uint32_t srcPitch,
+                           uint8_t *pDst, uint32_t yBegin, uint32_t yEnd);
+};
+
+/* Multi-threaded converter, each call splits the plane into bands of block rows.
+ * The band threads are started once and wait for work between calls, the
+ * calling thread converts the first band. Calls from several threads run one
+ * after the other. */
+class CBlockLinearConverter
+{
+public:
+    explicit CBlockLinearConverter(uint32_t numThreads = 1U);
+    ~CBlockLinearConverter(void);
+
+    CBlockLinearConverter(const CBlockLinearConverter &) = delete;
+    CBlockLinearConverter &operator=(const CBlockLinearConverter &) = delete;
+
+    bool BlToPl(const BlockLinearPlane &plane, const uint8_t *pSrc, uint8_t *pDst, uint32_t dstPitch);
+    bool PlToBl(const BlockLinearPlane &plane, const uint8_t *pSrc, uint32_t srcPitch, uint8_t *pDst);
+
+    // Detiles an NV12 surface into packed pitch-linear NV12 (Y rows, then UV rows,
+    // both with pitch = Y width), the same output CCudaConsumer::BlToPlConvert makes.
+    template <typename Attrs>
+    bool BlToPlNv12(const Attrs &attrs, const uint8_t *pBase, uint8_t *pDst)
+    {
+        BlockLinearPlane luma, chroma;
+        if (attrs.planeCount < 2U || !CBlockLinear::GetPlane(attrs, 0U, luma) ||
+            !CBlockLinear::GetPlane(attrs, 1U, chroma)) {
+            return false;
+        }
+        if (!BlToPl(luma, pBase + attrs.planeOffsets[0], pDst, luma.widthBytes)) {
+            return false;
+        }
+        uint8_t *pDstChroma = pDst + (size_t)luma.widthBytes * luma.height;
+        return BlToPl(chroma, pBase + attrs.planeOffsets[1], pDstChroma, luma.widthBytes);
+    }
+
+    // Inverse of BlToPlNv12
+    template <typename Attrs>
+    bool PlToBlNv12(const Attrs &attrs, const uint8_t *pSrc, uint8_t *pBase)
+    {
+        BlockLinearPlane luma, chroma;
+        if (attrs.planeCount < 2U || !CBlockLinear::GetPlane(attrs, 0U, luma) ||
+            !CBlockLinear::GetPlane(attrs, 1U, chroma)) {
+            return false;
+        }
+        if (!PlToBl(luma, pSrc, luma.widthBytes, pBase + attrs.planeOffsets[0])) {
+            return false;
+        }
+        const uint8_t *pSrcChroma = pSrc + (size_t)luma.widthBytes * luma.height;
+        return PlToBl(chroma, pSrcChroma, luma.widthBytes, pBase + attrs.planeOffsets[1]);
+    }
+
+private:
+    typedef struct {
+        bool bToPl;
+        BlockLinearPlane plane;
+        const uint8_t *pSrc;
+        uint8_t *pDst;
+        uint32_t plPitch; /* destination pitch for BL->PL, source pitch for PL->BL */
+    } BandJob;
+
+    static void RunRows(const BandJob &job, uint32_t yBegin, uint32_t yEnd);
+    void RunBands(const BandJob &job);
+    void BandThreadFunc(uint32_t band);
+
+    uint32_t m_numThreads;
+    std::vector<std::thread> m_bandThreads; // bands 1 .. m_numThreads - 1
+    std::mutex m_runMutex;                  // one conversion at a time
+
+    std::mutex m_mutex; // guards the members below
+    std::condition_variable m_startCond;
+    std::condition_variable m_doneCond;
+    BandJob m_job;
+    std::vector<uint32_t> m_bandBegin; // first row of each band, then the plane height
+    uint32_t m_numBands = 0U;
+    uint32_t m_numRunning = 0U;
+    uint64_t m_generation = 0U;
+    bool m_bQuit = false;
+};
+
+#endif
@@ -0,0 +1,267 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CBlockLinearKernels.hpp"
+#include "CBoxFilter.hpp"
+
+#include <cstring>
+
+// -DBL_KERNELS_SCALAR keeps the plain C paths, nvsipl_blocklinear_kernels_test checks both builds
+#if defined(BL_KERNELS_SCALAR)
+#elif defined(__AVX2__)
+#define BL_KERNELS_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#define BL_KERNELS_SIMD_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define BL_KERNELS_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+/* Visits the GOBs of gob columns [gx0, gx1) and gob rows [gy0, gy1) in memory
+ * order: block row by block row, left to right, top to bottom inside a block. */
+template <typename Func>
+static void ForEachGob(const BlockLinearPlane &plane, uint32_t gx0, uint32_t gx1,
+                       uint32_t gy0, uint32_t gy1, Func func)
+{
+    const uint32_t bhl = plane.blockHeightLog2;
+    const size_t gobsPerRow = plane.pitch / BL_GOB_WIDTH;
+    for (uint32_t by = gy0 >> bhl; (by << bhl) < gy1; by++) {
+        const uint32_t gyBegin = ((by << bhl) > gy0) ? (by << bhl) : gy0;
+        const uint32_t gyEnd = (((by + 1U) << bhl) < gy1) ? ((by + 1U) << bhl) : gy1;
+        for (uint32_t gx = gx0; gx < gx1; gx++) {
+            const size_t blockBase = (((size_t)by * gobsPerRow + gx) << bhl) * BL_GOB_SIZE;
+            for (uint32_t gy = gyBegin; gy < gyEnd; gy++) {
+                func(blockBase + (size_t)(gy & ((1U << bhl) - 1U)) * BL_GOB_SIZE, gx, gy);
+            }
+        }
+    }
+}
+
+static inline uint32_t ValidExtent(uint32_t total, uint32_t start, uint32_t unit)
+{
+    return (total - start < unit) ? (total - start) : unit;
+}
+
+// Detiles one whole GOB into tile[row][x]
+static inline void LoadGob(const uint8_t *pGob, uint8_t tile[BL_GOB_HEIGHT][BL_GOB_WIDTH])
+{
+    for (uint32_t y = 0U; y < BL_GOB_HEIGHT; y++) {
+        for (uint32_t x = 0U; x < BL_GOB_WIDTH; x += 16U) {
+            memcpy(&tile[y][x], pGob + CBlockLinear::GobOffset(x, y), 16U);
+        }
+    }
+}
+
+static inline uint64_t SadGob(const uint8_t *pA, const uint8_t *pB)
+{
+#if defined(BL_KERNELS_SIMD_AVX2)
+    __m256i acc = _mm256_setzero_si256();
+    for (uint32_t i = 0U; i < BL_GOB_SIZE; i += 32U) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pA + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pB + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(a, b));
+    }
+    return (uint64_t)_mm256_extract_epi64(acc, 0) + (uint64_t)_mm256_extract_epi64(acc, 1) +
+           (uint64_t)_mm256_extract_epi64(acc, 2) + (uint64_t)_mm256_extract_epi64(acc, 3);
+#elif defined(BL_KERNELS_SIMD_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    for (uint32_t i = 0U; i < BL_GOB_SIZE; i += 16U) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pA + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pB + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(a, b));
+    }
+    return (uint64_t)_mm_cvtsi128_si64(acc) + (uint64_t)_mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc));
+#elif defined(BL_KERNELS_SIMD_NEON)
+    // 32 iterations x 2 x 255 fits in the 16-bit lanes
+    uint16x8_t acc = vdupq_n_u16(0U);
+    for (uint32_t i = 0U; i < BL_GOB_SIZE; i += 16U) {
+        acc = vpadalq_u8(acc, vabdq_u8(vld1q_u8(pA + i), vld1q_u8(pB + i)));
+    }
+    uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(acc));
+    return vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1);
+#else
+    uint64_t sum = 0U;
+    for (uint32_t i = 0U; i < BL_GOB_SIZE; i++) {
+        sum += (pA[i] > pB[i]) ? (pA[i] - pB[i]) : (pB[i] - pA[i]);
+    }
+    return sum;
+#endif
+}
+
+bool CBlockLinearKernels::Histogram(const BlockLinearPlane &plane, const uint8_t *pSrc, uint32_t hist[BL_HISTOGRAM_BINS])
+{
+    if (pSrc == nullptr || hist == nullptr || !CBlockLinear::IsValid(plane)) {
+        return false;
+    }
+
+    // Four sub-histograms break the store-to-load dependency on runs of equal values
+    uint32_t subHist[4][BL_HISTOGRAM_BINS];
+    memset(subHist, 0, sizeof(subHist));
+
+    const uint32_t gobsX = (plane.widthBytes + BL_GOB_WIDTH - 1U) / BL_GOB_WIDTH;
+    const uint32_t gobsY = (plane.height + BL_GOB_HEIGHT - 1U) / BL_GOB_HEIGHT;
+    ForEachGob(plane, 0U, gobsX, 0U, gobsY, [&](size_t offset, uint32_t gx, uint32_t gy) {
+        const uint8_t *pGob = pSrc + offset;
+        const uint32_t validW = ValidExtent(plane.widthBytes, gx * BL_GOB_WIDTH, BL_GOB_WIDTH);
+        const uint32_t validH = ValidExtent(plane.height, gy * BL_GOB_HEIGHT, BL_GOB_HEIGHT);
+        if (validW == BL_GOB_WIDTH && validH == BL_GOB_HEIGHT) {
+            for (uint32_t i = 0U; i < BL_GOB_SIZE; i += 4U) {
+                subHist[0][pGob[i]]++;
+                subHist[1][pGob[i + 1U]]++;
+                subHist[2][pGob[i + 2U]]++;
+                subHist[3][pGob[i + 3U]]++;
+            }
+        } else {
+            for (uint32_t y = 0U; y < validH; y++) {
+                for (uint32_t x = 0U; x < validW; x++) {
+                    subHist[x & 3U][pGob[CBlockLinear::GobOffset(x, y)]]++;
+                }
+            }
+        }
+    });
+
+    for (uint32_t v = 0U; v < BL_HISTOGRAM_BINS; v++) {
+        hist[v] = subHist[0][v] + subHist[1][v] + subHist[2][v] + subHist[3][v];
+    }
+    return true;
+}
+
+// Whole pixels only, a trailing partial pixel or pair is dropped
+static uint32_t DownscaledRowBytes(uint32_t widthBytes, uint32_t factor, uint32_t channels)
+{
+    return widthBytes / channels / factor * channels;
+}
+
+template <uint32_t Factor>
+static void DownscaleGobs(const BlockLinearPlane &plane, const uint8_t *pSrc, uint8_t *pDst, uint32_t dstPitch,
+                          uint32_t channels)
+{
+    constexpr uint32_t area = Factor * Factor;
+    const uint32_t outW = DownscaledRowBytes(plane.widthBytes, Factor, channels);
+    const uint32_t outH = plane.height / Factor;
+    const uint32_t gobsX = (outW * Factor + BL_GOB_WIDTH - 1U) / BL_GOB_WIDTH;
+    const uint32_t gobsY = (outH * Factor + BL_GOB_HEIGHT - 1U) / BL_GOB_HEIGHT;
+
+    ForEachGob(plane, 0U, gobsX, 0U, gobsY, [&](size_t offset, uint32_t gx, uint32_t gy) {
+        uint8_t tile[BL_GOB_HEIGHT][BL_GOB_WIDTH];
+        LoadGob(pSrc + offset, tile);
+
+        const uint32_t ox0 = gx * (BL_GOB_WIDTH / Factor);
+        const uint32_t oy0 = gy * (BL_GOB_HEIGHT / Factor);
+        const uint32_t validW = ValidExtent(outW, ox0, BL_GOB_WIDTH / Factor);
+        const uint32_t validH = ValidExtent(outH, oy0, BL_GOB_HEIGHT / Factor);
+        // The detiled GOB is a small pitch-linear plane
+        if (Factor == 2U && validW == BL_GOB_WIDTH / 2U && validH == BL_GOB_HEIGHT / 2U) {
+            (void)CBoxFilter::Halve(&tile[0][0], BL_GOB_WIDTH, validW / channels, validH, channels,
+                                    pDst + (size_t)oy0 * dstPitch + ox0, dstPitch);
+            return;
+        }
+        for (uint32_t r = 0U; r < validH; r++) {
+            uint8_t *pRow = pDst + (size_t)(oy0 + r) * dstPitch + ox0;
+            for (uint32_t c = 0U; c < validW; c++) {
+                const uint32_t ch = c % channels;
+                const uint32_t px = c / channels;
+                uint32_t sum = 0U;
+                for (uint32_t j = 0U; j < Factor; j++) {
+                    for (uint32_t i = 0U; i < Factor; i++) {
+                        sum += tile[r * Factor + j][(px * Factor + i) * channels + ch];
+                    }
+                }
+                pRow[c] = (uint8_t)((sum + area / 2U) / area);
+            }
+        }
+    });
+}
+
+bool CBlockLinearKernels::Downscale(const BlockLinearPlane &plane, const uint8_t *pSrc, uint32_t factor,
+                                   uint8_t *pDst, uint32_t dstPitch, uint32_t channels)
+{
+    if (pSrc == nullptr || pDst == nullptr || !CBlockLinear::IsValid(plane) ||
+        (factor != 2U && factor != 4U) || (channels != 1U && channels != 2U) ||
+        dstPitch < DownscaledRowBytes(plane.widthBytes, factor, channels)) {
+        return false;
+    }
+
+    if (factor == 2U) {
+        DownscaleGobs<2U>(plane, pSrc, pDst, dstPitch, channels);
+    } else {
+        DownscaleGobs<4U>(plane, pSrc, pDst, dstPitch, channels);
+    }
+    return true;
+}
+
+bool CBlockLinearKernels::CropToPl(const BlockLinearPlane &plane, const uint8_t *pSrc, const BlockLinearRect &roi,
+                                  uint8_t *pDst, uint32_t dstPitch)
+{
+    if (pSrc == nullptr || pDst == nullptr || !CBlockLinear::IsValid(plane) ||
+        roi.width == 0U || roi.height == 0U || dstPitch < roi.width ||
+        roi.x > plane.widthBytes || roi.width > plane.widthBytes - roi.x ||
+        roi.y > plane.height || roi.height > plane.height - roi.y) {
+        return false;
+    }
+
+    const uint32_t xEnd = roi.x + roi.width;
+    const uint32_t yEnd = roi.y + roi.height;
+    const uint32_t gx0 = roi.x / BL_GOB_WIDTH;
+    const uint32_t gx1 = (xEnd + BL_GOB_WIDTH - 1U) / BL_GOB_WIDTH;
+    const uint32_t gy0 = roi.y / BL_GOB_HEIGHT;
+    const uint32_t gy1 = (yEnd + BL_GOB_HEIGHT - 1U) / BL_GOB_HEIGHT;
+
+    ForEachGob(plane, gx0, gx1, gy0, gy1, [&](size_t offset, uint32_t gx, uint32_t gy) {
+        const uint8_t *pGob = pSrc + offset;
+        const uint32_t gobX = gx * BL_GOB_WIDTH;
+        const uint32_t gobY = gy * BL_GOB_HEIGHT;
+        const uint32_t xBegin = (roi.x > gobX) ? roi.x : gobX;
+        const uint32_t xStop = (xEnd < gobX + BL_GOB_WIDTH) ? xEnd : gobX + BL_GOB_WIDTH;
+        const uint32_t yBegin = (roi.y > gobY) ? roi.y : gobY;
+        const uint32_t yStop = (yEnd < gobY + BL_GOB_HEIGHT) ? yEnd : gobY + BL_GOB_HEIGHT;
+
+        for (uint32_t y = yBegin; y < yStop; y++) {
+            uint8_t *pRow = pDst + (size_t)(y - roi.y) * dstPitch;
+            // Bytes are contiguous within each 16-byte chunk of a GOB row
+            for (uint32_t x = xBegin; x < xStop;) {
+                const uint32_t chunkEnd = ((x | 15U) + 1U < xStop) ? (x | 15U) + 1U : xStop;
+                memcpy(pRow + (x - roi.x), pGob + CBlockLinear::GobOffset(x - gobX, y - gobY), chunkEnd - x);
+                x = chunkEnd;
+            }
+        }
+    });
+    return true;
+}
+
+bool CBlockLinearKernels::Sad(const BlockLinearPlane &plane, const uint8_t *pSrcA, const uint8_t *pSrcB, uint64_t &sad)
+{
+    if (pSrcA == nullptr || pSrcB == nullptr || !CBlockLinear::IsValid(plane)) {
+        return false;
+    }
+
+    uint64_t sum = 0U;
+    const uint32_t gobsX = (plane.widthBytes + BL_GOB_WIDTH - 1U) / BL_GOB_WIDTH;
+    const uint32_t gobsY = (plane.height + BL_GOB_HEIGHT - 1U) / BL_GOB_HEIGHT;
+    ForEachGob(plane, 0U, gobsX, 0U, gobsY, [&](size_t offset, uint32_t gx, uint32_t gy) {
+        const uint8_t *pA = pSrcA + offset;
+        const uint8_t *pB = pSrcB + offset;
+        const uint32_t validW = ValidExtent(plane.widthBytes, gx * BL_GOB_WIDTH, BL_GOB_WIDTH);
+        const uint32_t validH = ValidExtent(plane.height, gy * BL_GOB_HEIGHT, BL_GOB_HEIGHT);
+        if (validW == BL_GOB_WIDTH && validH == BL_GOB_HEIGHT) {
+            sum += SadGob(pA, pB);
+        } else {
+            for (uint32_t y = 0U; y < validH; y++) {
+                for (uint32_t x = 0U; x < validW; x++) {
+                    const uint32_t off = CBlockLinear::GobOffset(x, y);
+                    sum += (pA[off] > pB[off]) ? (pA[off] - pB[off]) : (pB[off] - pA[off]);
+                }
+            }
+        }
+    });
+
+    sad = sum;
+    return true;
+}
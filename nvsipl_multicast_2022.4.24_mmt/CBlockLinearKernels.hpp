@@ -0,0 +1,47 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CBLOCKLINEARKERNELS_HPP
+#define CBLOCKLINEARKERNELS_HPP
+
+#include "CBlockLinear.hpp"
+
+#define BL_HISTOGRAM_BINS (256U)
+
+typedef struct {
+    uint32_t x; /* in bytes */
+    uint32_t y;
+    uint32_t width; /* in bytes */
+    uint32_t height;
+} BlockLinearRect;
+
+/* Kernels that read block-linear 8-bit planes (e.g. the NV12 luma plane) in
+ * place. GOBs are visited in memory order, so every surface byte is read at
+ * most once and no pitch-linear copy of the frame is made. Bytes outside
+ * widthBytes x height (surface padding) are ignored. */
+class CBlockLinearKernels
+{
+public:
+    // hist[v] = number of valid bytes equal to v
+    static bool Histogram(const BlockLinearPlane &plane, const uint8_t *pSrc, uint32_t hist[BL_HISTOGRAM_BINS]);
+
+    // Box-filter downscale by factor 2 or 4 into a pitch-linear plane of
+    // (widthBytes / channels / factor) pixels x (height / factor) rows, rounding
+    // to nearest. channels 2 treats the plane as interleaved pairs (NV12 UV).
+    static bool Downscale(const BlockLinearPlane &plane, const uint8_t *pSrc, uint32_t factor,
+                          uint8_t *pDst, uint32_t dstPitch, uint32_t channels = 1U);
+
+    // Copies a rectangle out to pitch-linear memory, touching only the GOBs it overlaps.
+    static bool CropToPl(const BlockLinearPlane &plane, const uint8_t *pSrc, const BlockLinearRect &roi,
+                         uint8_t *pDst, uint32_t dstPitch);
+
+    // Sum of absolute differences between two planes sharing the same geometry.
+    static bool Sad(const BlockLinearPlane &plane, const uint8_t *pSrcA, const uint8_t *pSrcB, uint64_t &sad);
+};
+
+#endif
@@ -0,0 +1,125 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CBoxFilter.hpp"
+
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Output pixels [x, n) of one row, for the SIMD tails
+static inline void HalveRowScalar(const uint8_t *pRow0, const uint8_t *pRow1, uint32_t channels,
+                                  uint32_t x, uint32_t n, uint8_t *pDst)
+{
+    for (; x < n; x++) {
+        for (uint32_t c = 0U; c < channels; c++) {
+            const uint32_t i = 2U * x * channels + c;
+            pDst[x * channels + c] =
+                (uint8_t)((pRow0[i] + pRow0[i + channels] + pRow1[i] + pRow1[i + channels] + 2U) >> 2);
+        }
+    }
+}
+
+static inline void HalveRowLuma(const uint8_t *pRow0, const uint8_t *pRow1, uint32_t n, uint8_t *pDst)
+{
+    uint32_t x = 0U;
+#if defined(__SSE2__)
+    // Each 16-bit lane holds a horizontal pixel pair
+    const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+    const __m128i two = _mm_set1_epi16(2);
+    for (; x + 16U <= n; x += 16U) {
+        __m128i sums[2];
+        for (uint32_t h = 0U; h < 2U; h++) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pRow0 + 2U * x + 16U * h));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pRow1 + 2U * x + 16U * h));
+            __m128i sum = _mm_add_epi16(_mm_and_si128(a, lowBytes), _mm_srli_epi16(a, 8));
+            sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_and_si128(b, lowBytes), _mm_srli_epi16(b, 8)));
+            sums[h] = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + x), _mm_packus_epi16(sums[0], sums[1]));
+    }
+#elif defined(__ARM_NEON)
+    for (; x + 16U <= n; x += 16U) {
+        uint16x8_t sum0 = vpadalq_u8(vpaddlq_u8(vld1q_u8(pRow0 + 2U * x)), vld1q_u8(pRow1 + 2U * x));
+        uint16x8_t sum1 = vpadalq_u8(vpaddlq_u8(vld1q_u8(pRow0 + 2U * x + 16U)), vld1q_u8(pRow1 + 2U * x + 16U));
+        vst1q_u8(pDst + x, vcombine_u8(vrshrn_n_u16(sum0, 2), vrshrn_n_u16(sum1, 2)));
+    }
+#endif
+    HalveRowScalar(pRow0, pRow1, 1U, x, n, pDst);
+}
+
+static inline void HalveRowChroma(const uint8_t *pRow0, const uint8_t *pRow1, uint32_t n, uint8_t *pDst)
+{
+    uint32_t x = 0U;
+#if defined(__SSE2__)
+    // Each 16-bit lane holds one UV pair: vertical sums per channel first,
+    // then madd adds horizontally neighbouring pixels into 32-bit lanes.
+    const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i two = _mm_set1_epi16(2);
+    for (; x + 8U <= n; x += 8U) {
+        __m128i uSums[2];
+        __m128i vSums[2];
+        for (uint32_t h = 0U; h < 2U; h++) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pRow0 + 4U * x + 16U * h));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pRow1 + 4U * x + 16U * h));
+            __m128i u = _mm_add_epi16(_mm_and_si128(a, lowBytes), _mm_and_si128(b, lowBytes));
+            __m128i v = _mm_add_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+            uSums[h] = _mm_madd_epi16(u, ones);
+            vSums[h] = _mm_madd_epi16(v, ones);
+        }
+        __m128i u = _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(uSums[0], uSums[1]), two), 2);
+        __m128i v = _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(vSums[0], vSums[1]), two), 2);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + 2U * x), _mm_or_si128(u, _mm_slli_epi16(v, 8)));
+    }
+#elif defined(__ARM_NEON)
+    for (; x + 8U <= n; x += 8U) {
+        uint8x16x2_t a = vld2q_u8(pRow0 + 4U * x);
+        uint8x16x2_t b = vld2q_u8(pRow1 + 4U * x);
+        uint8x8x2_t out;
+        out.val[0] = vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(a.val[0]), b.val[0]), 2);
+        out.val[1] = vrshrn_n_u16(vpadalq_u8(vpaddlq_u8(a.val[1]), b.val[1]), 2);
+        vst2_u8(pDst + 2U * x, out);
+    }
+#endif
+    HalveRowScalar(pRow0, pRow1, 2U, x, n, pDst);
+}
+
+bool CBoxFilter::Halve(const uint8_t *pSrc, uint32_t srcPitch, uint32_t dstWidth, uint32_t dstHeight,
+                       uint32_t channels, uint8_t *pDst, uint32_t dstPitch)
+{
+    if (pSrc == nullptr || pDst == nullptr || (channels != 1U && channels != 2U) ||
+        srcPitch < 2U * dstWidth * channels || dstPitch < dstWidth * channels) {
+        return false;
+    }
+
+    for (uint32_t y = 0U; y < dstHeight; y++) {
+        const uint8_t *pRow0 = pSrc + (size_t)(2U * y) * srcPitch;
+        const uint8_t *pRow1 = pRow0 + srcPitch;
+        uint8_t *pRow = pDst + (size_t)y * dstPitch;
+        if (channels == 1U) {
+            HalveRowLuma(pRow0, pRow1, dstWidth, pRow);
+        } else {
+            HalveRowChroma(pRow0, pRow1, dstWidth, pRow);
+        }
+    }
+    return true;
+}
+
+void CBoxFilter::HalveScalar(const uint8_t *pSrc, uint32_t srcPitch, uint32_t dstWidth, uint32_t dstHeight,
+                             uint32_t channels, uint8_t *pDst, uint32_t dstPitch)
+{
+    for (uint32_t y = 0U; y < dstHeight; y++) {
+        const uint8_t *pRow0 = pSrc + (size_t)(2U * y) * srcPitch;
+        HalveRowScalar(pRow0, pRow0 + srcPitch, channels, 0U, dstWidth, pDst + (size_t)y * dstPitch);
+    }
+}
@@ -0,0 +1,31 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CBOXFILTER_HPP
+#define CBOXFILTER_HPP
+
+#include <cstdint>
+
+/* 2x2 box filter that halves a pitch-linear 8-bit plane, rounding to nearest.
+ * With 2 channels the plane holds interleaved pairs (the NV12 UV plane) and
+ * each channel is averaged on its own. At a scale of exactly 1/2 this is also
+ * the bilinear filter. Uses SSE2 or NEON when the target has them. */
+class CBoxFilter
+{
+public:
+    // Writes dstWidth x dstHeight pixels of 'channels' bytes each, reading
+    // 2 * dstWidth pixels of source rows 0 .. 2 * dstHeight - 1.
+    static bool Halve(const uint8_t *pSrc, uint32_t srcPitch, uint32_t dstWidth, uint32_t dstHeight,
+                      uint32_t channels, uint8_t *pDst, uint32_t dstPitch);
+
+    // Scalar reference of Halve(), for checking and benchmarking the SIMD paths.
+    static void HalveScalar(const uint8_t *pSrc, uint32_t srcPitch, uint32_t dstWidth, uint32_t dstHeight,
+                            uint32_t channels, uint8_t *pDst, uint32_t dstPitch);
+};
+
+#endif
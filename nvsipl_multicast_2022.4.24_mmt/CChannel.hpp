@@ -12,12 +12,12 @@
 /* STL Headers */
 #include <unistd.h>
 #include <cstring>
-#include <thread>
-#include <atomic>
 
 #include "CCmdLineParser.hpp"
 #include "CUtils.hpp"
 #include "CClientCommon.hpp"
+#include "CEventReactor.hpp"
+#include "CWorkerPool.hpp"
 
 #include "nvscibuf.h"
 #include "NvSIPLCamera.hpp"
@@ -29,12 +29,14 @@ class CChannel
 {
 public:
     CChannel() = delete;
-    CChannel(string name, NvSciBufModule& bufMod, NvSciSyncModule& syncMod, SensorInfo *pSensorInfo)
+    CChannel(string name, NvSciBufModule& bufMod, NvSciSyncModule& syncMod, SensorInfo *pSensorInfo,
+             CEventReactor *pReactor)
     {
         m_name = name + std::to_string(pSensorInfo->id);
         m_bufModule = bufMod;
         m_syncModule = syncMod;
         m_pSensorInfo = pSensorInfo;
+        m_pReactor = pReactor;
     }
     virtual ~CChannel() {}
 
@@ -42,104 +44,76 @@ public:
     virtual SIPLStatus Connect(void) = 0;
     virtual SIPLStatus InitBlocks(void) = 0;
 
-    SIPLStatus Reconcile(void)
+    // Binds every block handler to the event service, before the blocks are connected.
+    SIPLStatus AttachEventHandlers(void)
     {
-        LOG_MSG("name:%s Reconcile\n",m_name.c_str());
+        std::vector<CEventHandler*> vEventHandlers;
 
-        m_bRunning = true;
-        std::vector<std::unique_ptr<std::thread>> vupThreads;
-        std::vector<CEventHandler*> vEventThreadHandlers;
-
-        GetEventThreadHandlers(false, vEventThreadHandlers);
-        for (const auto& pEventHandler : vEventThreadHandlers) {
-            vupThreads.push_back(std::make_unique<std::thread>(EventThreadFunc, pEventHandler, this));
+        GetEventHandlers(false, vEventHandlers);
+        for (const auto& pEventHandler : vEventHandlers) {
+            auto status = m_pReactor->Attach(pEventHandler);
+            PCHK_STATUS_AND_RETURN(status, (pEventHandler->GetName() + " attach").c_str());
         }
 
-        for (auto& upThread: vupThreads) {
-            if (upThread != nullptr) {
-                upThread->join();
-                upThread.reset();
-                LOG_DBG("upThread->join.\n");
-            }
-        }
-        if (!m_bRunning) {
+        return NVSIPL_STATUS_OK;
+    }
+
+    SIPLStatus Reconcile(void)
+    {
+        LOG_MSG("name:%s Reconcile\n",m_name.c_str());
+
+        std::vector<CEventHandler*> vEventHandlers;
+        GetEventHandlers(false, vEventHandlers);
+        auto status = m_pReactor->RunUntilComplete(vEventHandlers);
+        if (status != NVSIPL_STATUS_OK) {
             PLOG_ERR("SetupStream failed.\n");
-            return NVSIPL_STATUS_ERROR;
+            return status;
         }
 
         LOG_MSG("name:%s  SetupStream succeed\n",m_name.c_str());
         return NVSIPL_STATUS_OK;
     }
 
-    void Start(void)
+    SIPLStatus Start(void)
     {
-        std::vector<CEventHandler*> vEventThreadHandlers;
+        std::vector<CEventHandler*> vEventHandlers;
 
         PLOG_DBG("Start.\n");
 
-        m_bRunning = true;
-        GetEventThreadHandlers(true, vEventThreadHandlers);
-        for (const auto& pEventHandler : vEventThreadHandlers) {
-            m_vupThreads.push_back(std::make_unique<std::thread>(EventThreadFunc, pEventHandler, this));
-        }
+        GetEventHandlers(true, vEventHandlers);
+        return m_pReactor->Register(this, vEventHandlers);
     }
 
     void Stop(void)
     {
         PLOG_DBG("Stop.\n");
 
-        m_bRunning = false;
-        for (auto& upThread: m_vupThreads) {
-            if (upThread != nullptr) {
-                upThread->join();
-                upThread.reset();
-            }
+        m_pReactor->Unregister(this);
+        PLOG_DBG("Stop, no more events are dispatched.\n");
+
+        // Frames still on the worker pool may hand fences to the completer, drain them first
+        std::vector<CEventHandler*> vEventHandlers;
+        GetEventHandlers(true, vEventHandlers);
+        for (const auto& pEventHandler : vEventHandlers) {
+            CWorkerPool::GetInstance().Drain(pEventHandler);
         }
-        PLOG_DBG("Stop, all threads exit now.\n");
-    }
+        PLOG_DBG("Stop, no more frames are processed on the worker pool.\n");
 
-    /* The per-thread loop function for each block */
-    static void EventThreadFunc(CEventHandler* pEventHandler, CChannel* pChannel)
-    {
-        uint32_t timeouts = 0U;
-        EventStatus eventStatus = EVENT_STATUS_OK;
-
-        string threadName = pEventHandler->GetName();
-        pthread_setname_np(pthread_self(), threadName.c_str());
- 
-        /* Simple loop, waiting for events on the block until the block is done */
-        while (pChannel->m_bRunning) {
-            eventStatus = pEventHandler->HandleEvents();
-            if (eventStatus == EVENT_STATUS_TIMED_OUT) {
-                // if query timeouts - keep waiting for event until wait threshold is reached
-                if (timeouts < MAX_QUERY_TIMEOUTS) {
-                    timeouts++;
-                    continue;
-                }
-                LOG_WARN((pEventHandler->GetName() + ": HandleEvents() seems to be taking forever!\n").c_str());
-            } else if (eventStatus == EVENT_STATUS_OK) {
-                timeouts = 0U;
-                continue;
-            } else if (eventStatus == EVENT_STATUS_COMPLETE) {
-                break;
-            } else {
-               pChannel->m_bRunning = false;
-               break;
-            }
+        // Presents and releases still pending on the fence completer call into the clients
+        for (const auto& pEventHandler : vEventHandlers) {
+            CFenceCompleter::GetInstance().Drain(pEventHandler);
         }
+        PLOG_DBG("Stop, no more fence completions are pending.\n");
     }
 
 protected:
-    virtual void GetEventThreadHandlers(bool isStreamRunning, std::vector<CEventHandler*>& vEventHandlers) = 0;
+    virtual void GetEventHandlers(bool isStreamRunning, std::vector<CEventHandler*>& vEventHandlers) = 0;
 
     string m_name;
     NvSciBufModule m_bufModule = nullptr;
     NvSciSyncModule m_syncModule = nullptr;
     SensorInfo *m_pSensorInfo = nullptr;
-
-private:
-    atomic<bool> m_bRunning;
-    vector<unique_ptr<thread>> m_vupThreads;
+    CEventReactor *m_pReactor = nullptr;
 };
 
 #endif
@@ -6,7 +6,11 @@
 // of this software and related documentation without an express license
 // agreement from NVIDIA Corporation is strictly prohibited.
 
+#include <algorithm>
+#include <memory>
+
 #include "CClientCommon.hpp"
+#include "CTracer.hpp"
 
 CClientCommon::CClientCommon(std::string name, NvSciStreamBlock handle, uint32_t uSensor) :
         CEventHandler(name, handle, uSensor)
@@ -20,11 +24,13 @@ CClientCommon::CClientCommon(std::string name, NvSciStreamBlock handle, uint32_t
         m_bufAttrLists[i] = nullptr;
     }
 
-    for (uint32_t i = 0U; i < MAX_PACKETS; i++) {
-        m_packets[i].dataObj = nullptr;
-        m_packets[i].metaObj = nullptr;
-    }
     m_numWaitSyncObj = 1U;
+
+    CMetrics &metrics = CMetrics::GetInstance();
+    m_fenceWaits = metrics.Register("nvsipl_fence_waits_total", "CPU waits on sync fences", MetricType::COUNTER,
+                                    GetMetricLabels());
+    m_fenceWaitNs = metrics.Register("nvsipl_fence_wait_ns_total", "Time spent in CPU waits on sync fences",
+                                     MetricType::COUNTER, GetMetricLabels());
 }
 
 CClientCommon::~CClientCommon(void)
@@ -59,14 +65,14 @@ CClientCommon::~CClientCommon(void)
         }
     }
 
-    for (uint32_t i = 0U; i < MAX_PACKETS; i++) {
-        if (m_packets[i].dataObj != nullptr) {
-           NvSciBufObjFree(m_packets[i].dataObj);
-           m_packets[i].dataObj = nullptr;
+    for (auto &packet : m_packets) {
+        if (packet.dataObj != nullptr) {
+           NvSciBufObjFree(packet.dataObj);
+           packet.dataObj = nullptr;
         }
-        if (m_packets[i].metaObj != nullptr) {
-           NvSciBufObjFree(m_packets[i].metaObj);
-           m_packets[i].metaObj = nullptr;
+        if (packet.metaObj != nullptr) {
+           NvSciBufObjFree(packet.metaObj);
+           packet.metaObj = nullptr;
         }
     }
 
@@ -74,6 +80,10 @@ CClientCommon::~CClientCommon(void)
         NvSciSyncCpuWaitContextFree(m_cpuWaitContext);
         m_cpuWaitContext = nullptr;
     }
+    if (m_fenceWaitContext != nullptr) {
+        NvSciSyncCpuWaitContextFree(m_fenceWaitContext);
+        m_fenceWaitContext = nullptr;
+    }
 }
 
 SIPLStatus CClientCommon::Init(NvSciBufModule bufModule, NvSciSyncModule syncModule)
@@ -93,6 +103,84 @@ SIPLStatus CClientCommon::Init(NvSciBufModule bufModule, NvSciSyncModule syncMod
     return NVSIPL_STATUS_OK;
 }
 
+MetricLabels CClientCommon::GetMetricLabels(void)
+{
+    return { { "sensor", std::to_string(m_uSensorId) }, { "client", m_name } };
+}
+
+NvSciError CClientCommon::CpuWaitFence(const NvSciSyncFence *pFence)
+{
+    const uint64_t startNs = CTimeBase::NowNs();
+    NvSciError sciErr;
+    {
+        std::lock_guard<std::mutex> lock(m_cpuWaitMutex);
+        sciErr = NvSciSyncFenceWait(pFence, m_cpuWaitContext, FENCE_FRAME_TIMEOUT_US);
+    }
+    const uint64_t endNs = CTimeBase::NowNs();
+    m_fenceWaitNs.Add((int64_t)(endNs - startNs));
+    m_fenceWaits.Inc();
+    CFlightRecorder::GetInstance().Record(FLIGHT_FENCE_WAIT, m_uSensorId, (uint32_t)sciErr);
+    if (CTracer::GetInstance().IsEnabled()) {
+        CTracer::GetInstance().Complete("FenceWait", startNs, endNs, 0U);
+    }
+
+    return sciErr;
+}
+
+SIPLStatus CClientCommon::CompleteOnFences(const NvSciSyncFence *pFences, uint32_t numFences, FenceCallback callback)
+{
+    if (m_fenceWaitContext == nullptr) {
+        PLOG_ERR("CompleteOnFences without a CPU wait context\n");
+        return NVSIPL_STATUS_ERROR;
+    }
+
+    // Copies live until the completer is done with them, signaled ones are cleared on the way
+    std::shared_ptr<std::vector<NvSciSyncFence>> spFences(
+        new std::vector<NvSciSyncFence>(numFences, NvSciSyncFenceInitializer),
+        [](std::vector<NvSciSyncFence> *pvFences) {
+            for (auto &fence : *pvFences) {
+                NvSciSyncFenceClear(&fence);
+            }
+            delete pvFences;
+        });
+    for (uint32_t i = 0U; i < numFences; i++) {
+        auto sciErr = NvSciSyncFenceDup(&pFences[i], &(*spFences)[i]);
+        PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciSyncFenceDup");
+    }
+
+    NvSciSyncCpuWaitContext waitContext = m_fenceWaitContext;
+    const uint32_t uSensor = m_uSensorId;
+    auto wait = [spFences, waitContext, uSensor](int64_t timeoutUs) {
+        for (auto &fence : *spFences) {
+            auto sciErr = NvSciSyncFenceWait(&fence, waitContext, timeoutUs);
+            if (sciErr == NvSciError_Timeout) {
+                return FenceResult::TIMED_OUT;
+            }
+            CFlightRecorder::GetInstance().Record(FLIGHT_FENCE_WAIT, uSensor, (uint32_t)sciErr);
+            if (sciErr != NvSciError_Success) {
+                return FenceResult::FAILED;
+            }
+            NvSciSyncFenceClear(&fence);
+        }
+        return FenceResult::SIGNALED;
+    };
+
+    const uint64_t submitNs = CTimeBase::NowNs();
+    // Keyed like the handlers CChannel::Stop() drains
+    CFenceCompleter::GetInstance().Submit(static_cast<CEventHandler *>(this), wait, [this, callback, submitNs](FenceResult result) {
+        if (result != FenceResult::SIGNALED) {
+            PLOG_ERR("Fence completion failed: %s\n", FenceResultName(result));
+            m_bCompletionFailed.store(true, std::memory_order_relaxed);
+        }
+        if (CTracer::GetInstance().IsEnabled()) {
+            CTracer::GetInstance().Complete("FenceComplete", submitNs, CTimeBase::NowNs(), (uint32_t)result);
+        }
+        callback(result);
+    }, FENCE_FRAME_TIMEOUT_US);
+
+    return NVSIPL_STATUS_OK;
+}
+
 void CClientCommon::SetProfiler(CProfiler *pProfiler)
 {
     m_pProfiler = pProfiler;
@@ -104,11 +192,10 @@ EventStatus CClientCommon::HandleEvents(void)
     SIPLStatus status = NVSIPL_STATUS_OK;
     NvSciError sciStatus;
 
-    auto sciErr = NvSciStreamBlockEventQuery(m_handle, QUERY_TIMEOUT, &event);
-    //auto sciErr = NvSciStreamBlockEventQuery(m_handle, NV_SCI_EVENT_INFINITE_WAIT, &event);
+    // Runs when the block's notifier fired, returns TIMED_OUT once drained
+    auto sciErr = QueryEvent(0, &event);
     if (NvSciError_Success != sciErr) {
         if (NvSciError_Timeout == sciErr) {
-            PLOG_WARN("Event query, timed out.\n");
             return EVENT_STATUS_TIMED_OUT;
         }
         PLOG_ERR("Event query, failed with error 0x%x", sciErr);
@@ -182,6 +269,9 @@ EventStatus CClientCommon::HandleEvents(void)
             break;
     }
     PLOG_DBG("HandleEvent, status = %u\n", status);
+    if (status != NVSIPL_STATUS_OK) {
+        CFlightRecorder::GetInstance().Record(FLIGHT_ERROR, m_uSensorId, (uint32_t)status);
+    }
     return (status == NVSIPL_STATUS_OK) ? EVENT_STATUS_OK : EVENT_STATUS_ERROR;
 }
 
@@ -209,11 +299,12 @@ SIPLStatus CClientCommon::SetBufAttrLists(void)
 
 SIPLStatus CClientCommon::SetMetaBufAttrList(void)
 {
-    /* Meta buffer requires write access by CPU. */
+    /* Meta buffer requires write access by CPU. The versioned layout of
+     * CFrameMeta.hpp lets every client ask for the size it needs. */
     NvSciBufAttrValAccessPerm metaPerm = GetMetaPerm();
     bool metaCpu                       = true;
     NvSciBufType metaBufType           = NvSciBufType_RawBuffer;
-    uint64_t metaSize                  = 64U;//sizeof(MetaData);
+    uint64_t metaSize                  = GetMetaSize();
     uint64_t metaAlign                 = 1U;
     NvSciBufAttrKeyValuePair metaKeyVals[] = {
         { NvSciBufGeneralAttrKey_Types, &metaBufType, sizeof(metaBufType) },
@@ -282,6 +373,8 @@ SIPLStatus CClientCommon::HandleSyncSupport(NvSciSyncModule syncModule)
         /* Create a context for CPU waiting */
         sciErr = NvSciSyncCpuWaitContextAlloc(syncModule, &m_cpuWaitContext);
         PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciSyncCpuWaitContextAlloc");
+        sciErr = NvSciSyncCpuWaitContextAlloc(syncModule, &m_fenceWaitContext);
+        PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciSyncCpuWaitContextAlloc");
     }
 
     return NVSIPL_STATUS_OK;
@@ -349,9 +442,12 @@ SIPLStatus CClientCommon::HandlePacketCreate(void)
         sciErr = NvSciStreamBlockPacketStatusSet(m_handle, packetHandle,
                                               NvSciStreamCookie_Invalid, NvSciError_Overflow);
         PCHK_NVSCISTATUS_AND_RETURN(sciErr, "Inform pool of packet status");
+        return NVSIPL_STATUS_ERROR;
     }
     PLOG_DBG("Received PacketCreate from pool, m_numPackets: %u.\n", m_numPacket);
     m_numPacket++;
+    // The pool decides the packet count, per-packet state grows as packets arrive
+    ResizePackets(m_numPacket);
 
     NvSciStreamCookie cookie = AssignPacketCookie();
     ClientPacket *packet = GetPacketByCookie(cookie);
@@ -390,6 +486,11 @@ SIPLStatus CClientCommon::HandlePacketCreate(void)
     return NVSIPL_STATUS_OK;
 }
 
+void CClientCommon::ResizePackets(uint32_t numPackets)
+{
+    m_packets.resize(numPackets, ClientPacket{ 0U, 0U, nullptr, nullptr });
+}
+
 SIPLStatus CClientCommon::HandleSyncExport(void)
 {
     NvSciSyncAttrList waiterAttr = nullptr;
@@ -461,3 +562,99 @@ SIPLStatus CClientCommon::HandleSyncImport(void)
 
     return NVSIPL_STATUS_OK;
 }
+
+SIPLStatus CClientCommon::PopulateBufAttr(const NvSciBufObj& sciBufObj, BufferAttrs &bufAttrs)
+{
+    NvSciBufAttrList attrList;
+    auto sciErr = NvSciBufObjGetAttrList(sciBufObj, &attrList);
+    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciBufObjGetAttrList");
+
+    NvSciBufAttrKeyValuePair imgattrs[] = {
+        { NvSciBufImageAttrKey_Size, nullptr, 0 },               //0
+        { NvSciBufImageAttrKey_Layout, nullptr, 0 },             //1
+        { NvSciBufImageAttrKey_PlaneCount, nullptr, 0 },         //2
+        { NvSciBufImageAttrKey_PlaneWidth, nullptr, 0 },         //3
+        { NvSciBufImageAttrKey_PlaneHeight, nullptr, 0 },        //4
+        { NvSciBufImageAttrKey_PlanePitch, nullptr, 0 },         //5
+        { NvSciBufImageAttrKey_PlaneBitsPerPixel, nullptr, 0 },  //6
+        { NvSciBufImageAttrKey_PlaneAlignedHeight, nullptr, 0 }, //7
+        { NvSciBufImageAttrKey_PlaneAlignedSize, nullptr, 0 },   //8
+        { NvSciBufImageAttrKey_PlaneOffset, nullptr, 0 },        //9
+        { NvSciBufImageAttrKey_PlaneColorFormat, nullptr, 0 },   //10
+        { NvSciBufImageAttrKey_PlaneChannelCount, nullptr, 0 }   //11
+    };
+    sciErr = NvSciBufAttrListGetAttrs(attrList, imgattrs, sizeof(imgattrs) / sizeof(NvSciBufAttrKeyValuePair));
+    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciBufAttrListGetAttrs");
+
+    bufAttrs.bufType = NvSciBufType_Image;
+    bufAttrs.size = *(static_cast<const uint64_t*>(imgattrs[0].value));
+    bufAttrs.layout = *(static_cast<const NvSciBufAttrValImageLayoutType*>(imgattrs[1].value));
+    bufAttrs.planeCount = *(static_cast<const uint32_t*>(imgattrs[2].value));
+    if (bufAttrs.planeCount > NUM_PLANES) {
+        PLOG_ERR("Unsupported plane count: %u\n", bufAttrs.planeCount);
+        return NVSIPL_STATUS_NOT_SUPPORTED;
+    }
+    memcpy(bufAttrs.planeWidths, static_cast<const uint32_t*>(imgattrs[3].value), bufAttrs.planeCount * sizeof(uint32_t));
+    memcpy(bufAttrs.planeHeights, static_cast<const uint32_t*>(imgattrs[4].value), bufAttrs.planeCount * sizeof(uint32_t));
+    memcpy(bufAttrs.planePitches, static_cast<const uint32_t*>(imgattrs[5].value), bufAttrs.planeCount * sizeof(uint32_t));
+    memcpy(bufAttrs.planeBitsPerPixels, static_cast<const uint32_t*>(imgattrs[6].value), bufAttrs.planeCount * sizeof(uint32_t));
+    memcpy(bufAttrs.planeAlignedHeights, static_cast<const uint32_t*>(imgattrs[7].value), bufAttrs.planeCount * sizeof(uint32_t));
+    memcpy(bufAttrs.planeAlignedSizes, static_cast<const uint64_t*>(imgattrs[8].value), bufAttrs.planeCount * sizeof(uint64_t));
+    memcpy(bufAttrs.planeOffsets, static_cast<const uint64_t*>(imgattrs[9].value), bufAttrs.planeCount * sizeof(uint64_t));
+    memcpy(bufAttrs.planeColorFormats, static_cast<const NvSciBufAttrValColorFmt*>(imgattrs[10].value),
+           bufAttrs.planeCount * sizeof(NvSciBufAttrValColorFmt));
+    memcpy(bufAttrs.planeChannelCounts, static_cast<const uint8_t*>(imgattrs[11].value), bufAttrs.planeCount * sizeof(uint8_t));
+
+    /* Only reconciled for block-linear buffers. Engines detile on their own, so a
+     * missing value is only fatal where the CPU detiles, see CCpuConsumer::MapDataBuffer(). */
+    memset(bufAttrs.planeBlockHeights, 0, sizeof(bufAttrs.planeBlockHeights));
+    bufAttrs.hasBlockHeights = (bufAttrs.layout != NvSciBufImage_BlockLinearType);
+    if (bufAttrs.layout == NvSciBufImage_BlockLinearType) {
+        NvSciBufAttrKeyValuePair blockAttrs[] = {
+            { NvSciBufImageAttrKey_PlaneBlockHeight, nullptr, 0 }
+        };
+        sciErr = NvSciBufAttrListGetAttrs(attrList, blockAttrs, sizeof(blockAttrs) / sizeof(NvSciBufAttrKeyValuePair));
+        if (sciErr == NvSciError_Success && blockAttrs[0].value != nullptr &&
+            blockAttrs[0].len >= bufAttrs.planeCount * sizeof(uint32_t)) {
+            memcpy(bufAttrs.planeBlockHeights, static_cast<const uint32_t*>(blockAttrs[0].value),
+                   bufAttrs.planeCount * sizeof(uint32_t));
+            bufAttrs.hasBlockHeights = true;
+        } else {
+            PLOG_DBG("Block-linear buffer without plane block heights, error: 0x%x\n", sciErr);
+        }
+    }
+
+    //Print sciBuf attributes
+    PLOG_DBG("YUV: size=%lu, layout=%u, planeCount=%u\n", bufAttrs.size, bufAttrs.layout, bufAttrs.planeCount);
+    for (auto i = 0U; i < bufAttrs.planeCount; i++) {
+        PLOG_DBG("plane %u: planeWidth=%u, planeHeight=%u, planePitch=%u, planeBitsPerPixels=%u, planeAlignedHeight=%u, planeAlignedSize=%lu, planeOffset=%lu, planeColorFormat=%u, planeChannelCount=%u, planeBlockHeight=%u\n",
+            i, bufAttrs.planeWidths[i], bufAttrs.planeHeights[i], bufAttrs.planePitches[i], bufAttrs.planeBitsPerPixels[i],
+            bufAttrs.planeAlignedHeights[i], bufAttrs.planeAlignedSizes[i], bufAttrs.planeOffsets[i], bufAttrs.planeColorFormats[i],
+            bufAttrs.planeChannelCounts[i], bufAttrs.planeBlockHeights[i]);
+    }
+
+    return NVSIPL_STATUS_OK;
+}
+
+SIPLStatus CClientCommon::PopulateMetaSize(const NvSciBufObj& sciBufObj, uint32_t &size)
+{
+    NvSciBufAttrList attrList;
+    auto sciErr = NvSciBufObjGetAttrList(sciBufObj, &attrList);
+    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciBufObjGetAttrList");
+
+    NvSciBufAttrKeyValuePair rawAttrs[] = {
+        { NvSciBufRawBufferAttrKey_Size, nullptr, 0 }
+    };
+    sciErr = NvSciBufAttrListGetAttrs(attrList, rawAttrs, sizeof(rawAttrs) / sizeof(NvSciBufAttrKeyValuePair));
+    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciBufAttrListGetAttrs(meta)");
+
+    const uint64_t metaSize = *(static_cast<const uint64_t*>(rawAttrs[0].value));
+    if (metaSize < FRAME_META_MIN_SIZE) {
+        PLOG_ERR("Meta element of %lu bytes, at least %u needed\n", metaSize, FRAME_META_MIN_SIZE);
+        return NVSIPL_STATUS_NOT_SUPPORTED;
+    }
+    size = (uint32_t)std::min<uint64_t>(metaSize, UINT32_MAX);
+    PLOG_DBG("Meta element: %u bytes\n", size);
+
+    return NVSIPL_STATUS_OK;
+}
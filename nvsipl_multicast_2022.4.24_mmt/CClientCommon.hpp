@@ -10,13 +10,20 @@
 #define CCLIENTCOMMON_H
 
 #include <string.h>
+#include <atomic>
 #include <iostream>
 #include <cstdarg>
+#include <mutex>
+#include <vector>
 #include "nvscistream.h"
 #include "CUtils.hpp"
 #include "Common.hpp"
 #include "CEventHandler.hpp"
 #include "CProfiler.hpp"
+#include "CMetrics.hpp"
+#include "CFlightRecorder.hpp"
+#include "CFrameMeta.hpp"
+#include "CFenceCompleter.hpp"
 
 constexpr NvSciStreamCookie cookieBase = 0xC00C1E4U;
 
@@ -36,12 +43,26 @@ typedef struct {
     NvSciBufObj metaObj;
 } ClientPacket;
 
-typedef struct
-{
-    /** Holds the TSC timestamp of the frame capture */
-    uint64_t frameCaptureTSC;
-    uint64_t frame_count;
-} MetaData;
+#define NUM_PLANES (3U)
+
+// Reconciled image attributes of a packet's data buffer
+typedef struct {
+    NvSciBufType bufType;
+    uint64_t size;
+    uint32_t planeCount;
+    NvSciBufAttrValImageLayoutType layout;
+    uint32_t planeWidths[NUM_PLANES];
+    uint32_t planeHeights[NUM_PLANES];
+    uint32_t planePitches[NUM_PLANES];
+    uint32_t planeBitsPerPixels[NUM_PLANES];
+    uint32_t planeAlignedHeights[NUM_PLANES];
+    uint64_t planeAlignedSizes[NUM_PLANES];
+    uint64_t planeOffsets[NUM_PLANES];
+    NvSciBufAttrValColorFmt planeColorFormats[NUM_PLANES];
+    uint8_t planeChannelCounts[NUM_PLANES];
+    uint32_t planeBlockHeights[NUM_PLANES]; /* log2 of the GOBs per block, 0 for pitch-linear */
+    bool hasBlockHeights;                   /* false when a block-linear buffer did not report them */
+} BufferAttrs;
 
 class CClientCommon : public CEventHandler
 {
@@ -51,7 +72,7 @@ class CClientCommon : public CEventHandler
         virtual ~CClientCommon(void);
         virtual EventStatus HandleEvents(void) override;
         SIPLStatus Init(NvSciBufModule bufModule, NvSciSyncModule syncModule);
-        void SetProfiler(CProfiler *pProfiler);
+        virtual void SetProfiler(CProfiler *pProfiler);
 
     protected:
         virtual SIPLStatus HandleStreamInit(void) {return NVSIPL_STATUS_OK;};
@@ -69,6 +90,11 @@ class CClientCommon : public CEventHandler
         virtual SIPLStatus UnregisterSyncObjs(void) {return NVSIPL_STATUS_OK;};
         virtual bool HasCpuWait(void) {return false;};
         virtual NvSciBufAttrValAccessPerm GetMetaPerm(void) = 0;
+        // Meta element bytes this client asks for, NvSciBuf reconciles to the largest request
+        virtual uint64_t GetMetaSize(void) {return FRAME_META_MIN_SIZE;};
+        // Grows the per-packet state to numPackets entries. Overrides resize their own
+        // per-packet arrays and call the base. Only called while packets are created.
+        virtual void ResizePackets(uint32_t numPackets);
         inline SIPLStatus GetIndexFromCookie(NvSciStreamCookie cookie, uint32_t &index)
         {
             if (cookie <= cookieBase) {
@@ -91,18 +117,40 @@ class CClientCommon : public CEventHandler
             uint32_t id = 0;
             auto status = GetIndexFromCookie(cookie, id);
             PLOG_DBG("GetPacketByCookie: packetId: %u\n", id);
-            if (status != NVSIPL_STATUS_OK) {
+            if (status != NVSIPL_STATUS_OK || id >= m_packets.size()) {
                 return nullptr;
             }
             return &(m_packets[id]);
         }
 
+        SIPLStatus PopulateBufAttr(const NvSciBufObj& sciBufObj, BufferAttrs &bufAttrs);
+        // Reconciled size of a packet's meta element
+        SIPLStatus PopulateMetaSize(const NvSciBufObj& sciBufObj, uint32_t &size);
+
         virtual SIPLStatus InsertPrefence(uint32_t packetIndex, NvSciSyncFence &prefence) = 0;
         virtual SIPLStatus SetEofSyncObj(void) {return NVSIPL_STATUS_OK;};
+        // NvSciSyncFenceWait() on m_cpuWaitContext, accounted in the fence wait metrics.
+        // Pool workers of one client take turns on the context.
+        NvSciError CpuWaitFence(const NvSciSyncFence *pFence);
+        // Runs callback on the CFenceCompleter thread once all fences signaled or one
+        // failed, the calling thread continues. The fences are duplicated, callbacks of
+        // this client run in submission order. Needs HasCpuWait().
+        SIPLStatus CompleteOnFences(const NvSciSyncFence *pFences, uint32_t numFences, FenceCallback callback);
+        // Set when a completion failed, reported by the next call on the event or frame thread
+        bool HasCompletionFailed(void) const
+        {
+            return m_bCompletionFailed.load(std::memory_order_relaxed);
+        }
+        // Labels that identify this client's series
+        MetricLabels GetMetricLabels(void);
 
         NvSciSyncAttrList       m_signalerAttrList = nullptr;
         NvSciSyncAttrList       m_waiterAttrList = nullptr;
         NvSciSyncCpuWaitContext m_cpuWaitContext = nullptr;
+        std::mutex              m_cpuWaitMutex;
+        /* Used by the CFenceCompleter thread only, a wait context is not shared between threads */
+        NvSciSyncCpuWaitContext m_fenceWaitContext = nullptr;
+        std::atomic<bool>       m_bCompletionFailed {false};
         /* Sync attributes for CPU waiting */
         NvSciSyncAttrList       m_cpuWaitAttr;
         NvSciSyncAttrList       m_cpuSignalAttr;
@@ -116,10 +164,12 @@ class CClientCommon : public CEventHandler
         NvSciBufAttrList        m_bufAttrLists[MAX_ELEMENTS];
 
         uint32_t                m_numPacket = 0U;
-        ClientPacket            m_packets[MAX_PACKETS];
+        std::vector<ClientPacket> m_packets;
         int64_t                 m_waitTime;
 
         CProfiler *m_pProfiler = nullptr;
+        CMetric                 m_fenceWaits;
+        CMetric                 m_fenceWaitNs;
         uint32_t                m_dataIndex;
         uint32_t                m_metaIndex;
     private:
@@ -16,6 +16,8 @@
 #include <iomanip>
 
 #include "NvSIPLTrace.hpp" // NvSIPLTrace to set library trace level
+#include "Common.hpp"
+#include "CTracer.hpp"
 
 #ifndef CCMDLINEPARSER_HPP
 #define CCMDLINEPARSER_HPP
@@ -36,6 +38,18 @@ class CCmdLineParser
     bool bIsConsumer = false;
     string sConsumerType = "";
     bool bIgnoreError = false;
+    uint32_t uNumEventLoops = NUM_EVENT_LOOPS;
+    string sThreadPolicyFile = "";
+    string sMetricsSocket = "";
+    string sMetricsJsonFile = "";
+    string sTraceDir = "";
+    uint32_t uTraceWindowSec = TRACE_DEFAULT_WINDOW_S;
+    uint32_t uTraceSpikeMs = 0U;
+    string sFlightDir = ".";
+    string sDumpDir = "";
+    string sTopologyFile = "";
+    bool bWorkerPool = false;
+    uint32_t uNumWorkers = 0U; // 0: one per usable CPU
     vector<uint32_t> vMasks;
 
     static void ShowUsage(void)
@@ -58,7 +72,18 @@ class CCmdLineParser
         cout << "-u                                         :consumer id\n";
         cout << "-p                                         :producer resides in this process\n";
         cout << "-c 'type'                                  :consumer resides in this process.\n";
-        cout << "                                           :Supported type: 'enc': encoder customer, 'cuda': cuda customer.\n";
+        cout << "                                           :Supported type: 'enc': encoder customer, 'cuda': cuda customer, 'cpu': cpu customer, 'sync': cpu customer grouped with the other sensors by capture time.\n";
+        cout << "--thread-policy <file>                     :CPU affinity, scheduling and memory locking rules for pipeline threads\n";
+        cout << "--metrics-socket <path>                    :Serve Prometheus text metrics on a Unix domain socket\n";
+        cout << "--metrics-json <file>                      :Append a JSON line with all metrics at every periodic report\n";
+        cout << "--trace <dir>                              :Record trace points, 'kill -USR1 <pid>' dumps Chrome trace JSON to dir\n";
+        cout << "--trace-window <seconds>                   :Length of a trace dump, default is " << TRACE_DEFAULT_WINDOW_S << "\n";
+        cout << "--trace-spike-ms <ms>                      :Dump automatically when a frame's capture-to-done latency exceeds this\n";
+        cout << "--flight-dir <dir>                         :Where the flight recorder dumps on crashes and pipeline errors, default is .\n";
+        cout << "--dump <dir>                               :Write frames " << DUMP_START_FRAME << ".." << DUMP_END_FRAME << " of the cuda and enc consumers to dir\n";
+        cout << "--topology <file>                          :YAML or JSON per-sensor consumers, IPC endpoints, queue types and packet counts\n";
+        cout << "--event-loops <count>                      :Number of threads dispatching stream events, default is " << NUM_EVENT_LOOPS << "\n";
+        cout << "--workers <count|auto>                     :Process consumer frames on a shared worker pool, auto is one worker per CPU\n";
         return;
     }
 
@@ -70,6 +95,17 @@ class CCmdLineParser
             { "help",                 no_argument,       0, 'h' },
             { "verbosity",            required_argument, 0, 'v' },
             { "nito",                 required_argument, 0, 'N' },
+            { "event-loops",          required_argument, 0, 'E' },
+            { "thread-policy",        required_argument, 0, 'P' },
+            { "metrics-socket",       required_argument, 0, 'S' },
+            { "metrics-json",         required_argument, 0, 'J' },
+            { "trace",                required_argument, 0, 'T' },
+            { "trace-window",         required_argument, 0, 'W' },
+            { "trace-spike-ms",       required_argument, 0, 'L' },
+            { "flight-dir",           required_argument, 0, 'F' },
+            { "dump",                 required_argument, 0, 'D' },
+            { "topology",             required_argument, 0, 'O' },
+            { "workers",              required_argument, 0, 'w' },
             { 0,                      0,                 0,  0 }
         };
 
@@ -124,6 +160,50 @@ class CCmdLineParser
             case 'u':
                 consumerId = atoi(optarg);
                 break;
+            case 'P':
+                sThreadPolicyFile = string(optarg);
+                break;
+            case 'S':
+                sMetricsSocket = string(optarg);
+                break;
+            case 'J':
+                sMetricsJsonFile = string(optarg);
+                break;
+            case 'T':
+                sTraceDir = string(optarg);
+                break;
+            case 'W':
+                uTraceWindowSec = atoi(optarg);
+                break;
+            case 'L':
+                uTraceSpikeMs = atoi(optarg);
+                break;
+            case 'F':
+                sFlightDir = string(optarg);
+                break;
+            case 'D':
+                sDumpDir = string(optarg);
+                break;
+            case 'O':
+                sTopologyFile = string(optarg);
+                break;
+            case 'w':
+                bWorkerPool = true;
+                if (string(optarg) != "auto") {
+                    uNumWorkers = atoi(optarg);
+                    if (uNumWorkers == 0U) {
+                        cout << "Invalid worker count\n";
+                        return -1;
+                    }
+                }
+                break;
+            case 'E':
+                uNumEventLoops = atoi(optarg);
+                if (uNumEventLoops == 0U) {
+                    cout << "Invalid event loop count\n";
+                    return -1;
+                }
+                break;
             }
         }
 
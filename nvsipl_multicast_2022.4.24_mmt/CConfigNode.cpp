@@ -0,0 +1,170 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CConfigNode.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include <yaml-cpp/yaml.h>
+
+typedef std::unique_ptr<CConfigNode> NodePtr;
+
+// yaml-cpp marks count lines from 0
+static uint32_t LineOf(const YAML::Mark &mark)
+{
+    return (mark.line >= 0) ? (uint32_t)mark.line + 1U : 0U;
+}
+
+// An empty value is marked where the next token starts, it reports keyLine instead
+static NodePtr Convert(const YAML::Node &node, uint32_t keyLine, std::string &error)
+{
+    const uint32_t line = node.IsNull() ? keyLine : LineOf(node.Mark());
+    NodePtr upNode;
+    switch (node.Type()) {
+        case YAML::NodeType::Map:
+            upNode.reset(new CConfigNode(CConfigNode::Kind::MAP, line));
+            for (const auto &member : node) {
+                if (!member.first.IsScalar()) {
+                    error = std::to_string(LineOf(member.first.Mark())) + ": key must be a scalar";
+                    return nullptr;
+                }
+                const std::string &key = member.first.Scalar();
+                NodePtr upValue = Convert(member.second, LineOf(member.first.Mark()), error);
+                if (upValue == nullptr) {
+                    return nullptr;
+                }
+                if (upNode->Add(key, std::move(upValue)) == nullptr) {
+                    error = std::to_string(LineOf(member.first.Mark())) + ": duplicate key '" + key + "'";
+                    return nullptr;
+                }
+            }
+            break;
+        case YAML::NodeType::Sequence:
+            upNode.reset(new CConfigNode(CConfigNode::Kind::SEQUENCE, line));
+            for (const auto &item : node) {
+                NodePtr upItem = Convert(item, line, error);
+                if (upItem == nullptr) {
+                    return nullptr;
+                }
+                upNode->Append(std::move(upItem));
+            }
+            break;
+        case YAML::NodeType::Scalar:
+            upNode.reset(new CConfigNode(CConfigNode::Kind::SCALAR, line));
+            upNode->SetValue(node.Scalar());
+            break;
+        default:
+            // "key:" or "-" with nothing after it
+            upNode.reset(new CConfigNode(CConfigNode::Kind::SCALAR, line));
+            break;
+    }
+    return upNode;
+}
+
+std::unique_ptr<CConfigNode> CConfigNode::ParseString(const std::string &text, std::string &error)
+{
+    YAML::Node root;
+    try {
+        root = YAML::Load(text);
+    } catch (const YAML::Exception &e) {
+        error = std::to_string(LineOf(e.mark)) + ": " + e.msg;
+        return nullptr;
+    }
+    // An empty file is an empty map
+    if (!root.IsDefined() || root.IsNull()) {
+        return NodePtr(new CConfigNode(CConfigNode::Kind::MAP));
+    }
+    return Convert(root, 1U, error);
+}
+
+std::unique_ptr<CConfigNode> CConfigNode::ParseFile(const std::string &path, std::string &error)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        error = path + ": cannot open";
+        return nullptr;
+    }
+    std::stringstream text;
+    text << file.rdbuf();
+
+    NodePtr upRoot = ParseString(text.str(), error);
+    if (upRoot == nullptr) {
+        error = path + ":" + error;
+    }
+    return upRoot;
+}
+
+const CConfigNode *CConfigNode::Get(const std::string &key) const
+{
+    for (const auto &member : m_members) {
+        if (member.first == key) {
+            return member.second.get();
+        }
+    }
+    return nullptr;
+}
+
+bool CConfigNode::AsUint(uint32_t &value) const
+{
+    if (!IsScalar() || m_value.empty() || m_value[0] == '-') {
+        return false;
+    }
+    char *pEnd = nullptr;
+    errno = 0;
+    unsigned long parsed = strtoul(m_value.c_str(), &pEnd, 0);
+    if (errno != 0 || *pEnd != '\0' || parsed > UINT32_MAX) {
+        return false;
+    }
+    value = (uint32_t)parsed;
+    return true;
+}
+
+bool CConfigNode::AsDouble(double &value) const
+{
+    if (!IsScalar() || m_value.empty()) {
+        return false;
+    }
+    char *pEnd = nullptr;
+    double parsed = strtod(m_value.c_str(), &pEnd);
+    if (*pEnd != '\0') {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+bool CConfigNode::AsBool(bool &value) const
+{
+    if (m_value == "true" || m_value == "yes" || m_value == "on") {
+        value = true;
+        return true;
+    }
+    if (m_value == "false" || m_value == "no" || m_value == "off") {
+        value = false;
+        return true;
+    }
+    return false;
+}
+
+CConfigNode *CConfigNode::Add(const std::string &key, std::unique_ptr<CConfigNode> upNode)
+{
+    if (Get(key) != nullptr) {
+        return nullptr;
+    }
+    m_members.emplace_back(key, std::move(upNode));
+    return m_members.back().second.get();
+}
+
+CConfigNode *CConfigNode::Append(std::unique_ptr<CConfigNode> upNode)
+{
+    m_items.push_back(std::move(upNode));
+    return m_items.back().get();
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CCONFIGNODE_HPP
+#define CCONFIGNODE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Tree of maps, sequences and scalars read from a YAML file by yaml-cpp.
+ * JSON is read as YAML flow style. Scalars keep their text as written,
+ * duplicate keys are an error and only the first document is read. */
+class CConfigNode
+{
+public:
+    enum class Kind
+    {
+        SCALAR = 0,
+        MAP,
+        SEQUENCE
+    };
+
+    // Returns nullptr and sets error ("file:line: reason") on failure.
+    static std::unique_ptr<CConfigNode> ParseFile(const std::string &path, std::string &error);
+    static std::unique_ptr<CConfigNode> ParseString(const std::string &text, std::string &error);
+
+    explicit CConfigNode(Kind kind, uint32_t line = 0U) : m_kind(kind), m_line(line) {}
+
+    Kind GetKind(void) const
+    {
+        return m_kind;
+    }
+    bool IsScalar(void) const
+    {
+        return m_kind == Kind::SCALAR;
+    }
+    bool IsMap(void) const
+    {
+        return m_kind == Kind::MAP;
+    }
+    bool IsSequence(void) const
+    {
+        return m_kind == Kind::SEQUENCE;
+    }
+    // Source line, for error messages
+    uint32_t GetLine(void) const
+    {
+        return m_line;
+    }
+
+    // Map member, nullptr when absent or not a map
+    const CConfigNode *Get(const std::string &key) const;
+    const std::vector<std::pair<std::string, std::unique_ptr<CConfigNode>>> &GetMembers(void) const
+    {
+        return m_members;
+    }
+
+    // Sequence items
+    size_t Size(void) const
+    {
+        return m_items.size();
+    }
+    const CConfigNode *At(size_t index) const
+    {
+        return (index < m_items.size()) ? m_items[index].get() : nullptr;
+    }
+
+    const std::string &AsString(void) const
+    {
+        return m_value;
+    }
+    bool AsUint(uint32_t &value) const;
+    bool AsDouble(double &value) const;
+    bool AsBool(bool &value) const;
+
+    void SetValue(const std::string &value)
+    {
+        m_value = value;
+    }
+    CConfigNode *Add(const std::string &key, std::unique_ptr<CConfigNode> upNode);
+    CConfigNode *Append(std::unique_ptr<CConfigNode> upNode);
+
+private:
+    Kind m_kind;
+    uint32_t m_line;
+    std::string m_value;
+    std::vector<std::pair<std::string, std::unique_ptr<CConfigNode>>> m_members;
+    std::vector<std::unique_ptr<CConfigNode>> m_items;
+};
+
+#endif
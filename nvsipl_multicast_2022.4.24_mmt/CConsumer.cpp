@@ -8,82 +8,465 @@
 
 #include "CConsumer.hpp"
 
+#include <algorithm>
+
+std::string CConsumer::s_dumpDir = "";
+
 CConsumer::CConsumer(std::string name, NvSciStreamBlock handle, uint32_t uSensor, NvSciStreamBlock queueHandle) :
     CClientCommon(name, handle, uSensor)
 {
     m_queueHandle = queueHandle;
+
+    CMetrics &metrics = CMetrics::GetInstance();
+    m_framesMetric = metrics.Register("nvsipl_consumer_frames_total", "Frames processed by the consumer",
+                                      MetricType::COUNTER, GetMetricLabels());
+    m_skipsMetric = metrics.Register("nvsipl_consumer_skipped_frames_total", "Frames released without processing",
+                                     MetricType::COUNTER, GetMetricLabels());
+}
+
+void CConsumer::SetQueueType(QueueType queueType)
+{
+    m_queueType = queueType;
+
+    MetricLabels labels = GetMetricLabels();
+    labels.push_back({ "queue", QueueTypeName(queueType) });
+    m_queueDropsMetric = CMetrics::GetInstance().Register("nvsipl_consumer_queue_drops_total",
+                                                          "Frames the producer posted that never reached the consumer",
+                                                          MetricType::COUNTER, labels);
+}
+
+void CConsumer::SetDecimation(const DecimationConfig &decimation)
+{
+    m_decimator.Configure(m_name, decimation, GetMetricLabels());
+}
+
+void CConsumer::SetDeadline(double deadlineMs)
+{
+    m_deadlineNs = (uint64_t)(deadlineMs * 1000000.0);
+    if (m_deadlineNs != 0U) {
+        m_staleMetric = CMetrics::GetInstance().Register("nvsipl_consumer_stale_frames_total",
+                                                         "Frames released unprocessed because they missed the deadline",
+                                                         MetricType::COUNTER, GetMetricLabels());
+    }
+}
+
+void CConsumer::SetInFlight(uint32_t depth)
+{
+    m_inFlightDepth = std::min(std::max(depth, 1U), MAX_INFLIGHT);
+    if (m_inFlightDepth != depth) {
+        PLOG_WARN("In-flight depth %u clamped to %u.\n", depth, m_inFlightDepth);
+    }
+}
+
+void CConsumer::SetDumpDir(const std::string &dir)
+{
+    s_dumpDir = dir;
+}
+
+SIPLStatus CConsumer::ReleaseUnprocessed(ClientPacket *packet, uint32_t packetIndex)
+{
+    auto sciErr = NvSciStreamConsumerPacketRelease(m_handle, packet->handle);
+    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciStreamConsumerPacketRelease");
+    CFlightRecorder::GetInstance().Record(FLIGHT_PACKET_RELEASE, m_uSensorId, packetIndex);
+
+    return NVSIPL_STATUS_OK;
+}
+
+SIPLStatus CConsumer::ReleaseDeferred(uint32_t packetIndex)
+{
+    if (packetIndex >= m_packets.size()) {
+        PLOG_ERR("ReleaseDeferred: invalid packet index %u\n", packetIndex);
+        return NVSIPL_STATUS_BAD_ARGUMENT;
+    }
+
+    return ReleaseUnprocessed(&m_packets[packetIndex], packetIndex);
+}
+
+void CConsumer::CountQueueDrops(uint64_t frameCount)
+{
+    /* The producer numbers every posted frame. A mailbox hands a packet it
+     * replaces straight back to the producer, so the consumer only sees the gap. */
+    if (m_bFrameCountValid && frameCount > m_nextFrameCount) {
+        uint64_t drops = frameCount - m_nextFrameCount;
+        m_queueDropsMetric.Add((int64_t)drops);
+        if (m_pLatencyStats != nullptr) {
+            m_pLatencyStats->RecordQueueDrops(drops);
+        }
+        PLOG_DBG("%lu frames dropped in %s queue before frame %lu.\n", drops, QueueTypeName(m_queueType), frameCount);
+    }
+    // A smaller count means the producer restarted numbering, follow it
+    m_nextFrameCount = frameCount + 1U;
+    m_bFrameCountValid = true;
+}
+
+void CConsumer::SetProfiler(CProfiler *pProfiler)
+{
+    CClientCommon::SetProfiler(pProfiler);
+    m_pLatencyStats = (pProfiler != nullptr) ? pProfiler->AddLatencyStats(m_name) : nullptr;
+}
+
+void CConsumer::CloseDumpWriter(void)
+{
+    if (m_upDumpWriter != nullptr) {
+        m_upDumpWriter->Close();
+        PLOG_INFO("Dump: %lu frames (%lu bytes) written, %lu dropped, %lu write errors.\n",
+                  m_upDumpWriter->GetWrittenFrames(), m_upDumpWriter->GetWrittenBytes(),
+                  m_upDumpWriter->GetDroppedFrames(), m_upDumpWriter->GetWriteErrors());
+        m_upDumpWriter.reset();
+    }
+}
+
+SIPLStatus CConsumer::CreateDumpWriter(const std::string &fileName, uint32_t numSlots)
+{
+    if (s_dumpDir.empty()) {
+        return NVSIPL_STATUS_OK;
+    }
+
+    const std::string path = s_dumpDir + "/" + fileName;
+    m_upDumpWriter = std::make_unique<CDumpWriter>(DUMP_QUEUE_DEPTH, numSlots, m_uSensorId);
+    if (!m_upDumpWriter->Open(path)) {
+        PLOG_ERR("Failed to open dump file %s\n", path.c_str());
+        m_upDumpWriter.reset();
+        return NVSIPL_STATUS_ERROR;
+    }
+    PLOG_INFO("Dumping frames %u..%u to %s\n", DUMP_START_FRAME, DUMP_END_FRAME, path.c_str());
+
+    return NVSIPL_STATUS_OK;
+}
+
+EventStatus CConsumer::HandleEvents(void)
+{
+    if (m_numReadyPackets != 0U && AcquireReady() != NVSIPL_STATUS_OK) {
+        return EVENT_STATUS_ERROR;
+    }
+    return CClientCommon::HandleEvents();
 }
 
 SIPLStatus CConsumer::HandlePayload(void)
 {
+    m_numReadyPackets++;
+    return AcquireReady();
+}
+
+SIPLStatus CConsumer::AcquireReady(void)
+{
+    /* Processing runs ahead of the releases by up to m_inFlightDepth frames.
+     * When the engine falls that far behind the packets stay in the queue, the
+     * event thread goes on and ReleaseDone() re-arms it once a slot is free. */
+    while (m_numReadyPackets != 0U && HasInFlightSlot()) {
+        m_numReadyPackets--;
+        auto status = AcquirePayload();
+        PCHK_STATUS_AND_RETURN(status, "AcquirePayload");
+    }
+
+    return NVSIPL_STATUS_OK;
+}
+
+SIPLStatus CConsumer::AcquirePayload(void)
+{
+    CTraceScope trace("ConsumerHandlePayload");
     NvSciStreamCookie cookie;
     uint32_t packetIndex = 0;
+    FrameTimestamps ts {};
 
     /* Obtain packet with the new payload */
     auto sciErr = NvSciStreamConsumerPacketAcquire(m_handle, &cookie);
+    if (sciErr == NvSciError_NoStreamPacket) {
+        // A mailbox replaced the queued packets while they waited for a slot
+        m_numReadyPackets = 0U;
+        return NVSIPL_STATUS_OK;
+    }
     PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciStreamConsumerPacketAcquire");
+    ts.acquireNs = CTimeBase::NowNs();
     PLOG_DBG("Acquired a packet (cookie = %u).\n", cookie);
 
     auto status = GetIndexFromCookie(cookie, packetIndex);
     PCHK_STATUS_AND_RETURN(status, "PacketCookie2Id");
+    trace.SetArg(packetIndex);
+    CFlightRecorder::GetInstance().Record(FLIGHT_PACKET_ACQUIRE, m_uSensorId, packetIndex);
+
+    if (HasCompletionFailed()) {
+        PLOG_ERR("A fence completion failed earlier\n");
+        return NVSIPL_STATUS_ERROR;
+    }
 
     ClientPacket *packet = GetPacketByCookie(cookie);
     PCHK_PTR_AND_RETURN(packet, "GetPacketByCookie");
 
-    m_frameNum++;
-    if (ToSkipFrame(m_frameNum)) {
-        /* Release the packet back to the producer */
-        sciErr = NvSciStreamConsumerPacketRelease(m_handle, packet->handle);
-        PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciStreamConsumerPacketRelease");
-        return NVSIPL_STATUS_OK;
+    /* The producer rewrites the meta buffer once the packet is released, copy the stamps now */
+    const MetaData *pMeta = GetMeta(packetIndex).GetCore();
+    if (pMeta == nullptr && m_metaBufs[packetIndex] != nullptr && !m_bMetaWarned) {
+        PLOG_WARN("Packet %u carries no meta of version %u, frame stamps are not used.\n", packetIndex,
+                  FRAME_META_VERSION);
+        m_bMetaWarned = true;
+    }
+    if (pMeta != nullptr) {
+        CountQueueDrops(pMeta->frame_count);
+        ts.captureNs = (pMeta->frameCaptureTSC != 0U) ? CTimeBase::TscToNs(pMeta->frameCaptureTSC) : 0U;
+        ts.postNs = pMeta->postTimeNs;
+        ts.presentNs = pMeta->presentTimeNs;
+    }
+    // Decimation runs on capture time, the acquire time stands in when the producer did not stamp it
+    const uint64_t frameTimeNs = (ts.captureNs != 0U) ? ts.captureNs : ts.acquireNs;
+
+    /* A frame past its deadline goes straight back, so a backlog costs one
+     * release per packet instead of one ProcessPayload per packet. */
+    if (m_deadlineNs != 0U && ts.captureNs != 0U && ts.acquireNs > ts.captureNs + m_deadlineNs) {
+        const uint64_t ageNs = ts.acquireNs - ts.captureNs;
+        m_staleMetric.Inc();
+        if (m_pLatencyStats != nullptr) {
+            m_pLatencyStats->RecordStale(ageNs);
+        }
+        PLOG_DBG("Packet %u is %.1f ms past capture, released unprocessed.\n", packetIndex, ageNs / 1000000.0);
+        return RetireUnprocessed(packet, packetIndex);
     }
 
-    if (m_pProfiler != nullptr) {
-        m_pProfiler->OnFrameAvailable();
+    m_frameNum++;
+    bool bSkip = ToSkipFrame(m_frameNum);
+    if (!bSkip) {
+        std::lock_guard<std::mutex> lock(m_decimatorMutex);
+        bSkip = !m_decimator.ToProcess(frameTimeNs);
+    }
+    if (bSkip) {
+        m_skipsMetric.Inc();
+        return RetireUnprocessed(packet, packetIndex);
     }
+    m_packetFrameNums[packetIndex] = m_frameNum;
 
     /* If the received waiter obj if NULL,
      * the producer is done writing data into this element, skip waiting on pre-fence.
      */
+    NvSciSyncFence prefence = NvSciSyncFenceInitializer;
     if (nullptr != m_waiterSyncObjs[0]) {
-        NvSciSyncFence prefence = NvSciSyncFenceInitializer;
         /* Query fences for this element from producer */
         sciErr = NvSciStreamBlockPacketFenceGet(m_handle, packet->handle, 0U, 0U, &prefence);
         PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciStreamBlockPacketFenceGet");
+    }
 
-        status = InsertPrefence(packetIndex, prefence);
-        PCHK_STATUS_AND_RETURN(status, ": InsertPrefence");
+    // Takes its place in the release order now, wherever it is processed
+    PushInFlight(InFlightFrame { packet, packetIndex, true, false, false, frameTimeNs, ts, NvSciSyncFenceInitializer });
 
-        NvSciSyncFenceClear(&prefence);
+    CWorkerPool &pool = CWorkerPool::GetInstance();
+    if (!pool.IsRunning()) {
+        return RunPayload(packetIndex, prefence, ts);
     }
+    /* The event thread is done with the frame, a pool worker processes it.
+     * Errors fail the stream at the next acquire. */
+    pool.Submit(static_cast<CEventHandler *>(this), m_uSensorId, HasOrderedProcessing(),
+                [this, packetIndex, prefence, ts]() {
+                    NvSciSyncFence workerPrefence = prefence;
+                    if (RunPayload(packetIndex, workerPrefence, ts) != NVSIPL_STATUS_OK) {
+                        m_bCompletionFailed.store(true, std::memory_order_relaxed);
+                    }
+                });
+
+    return NVSIPL_STATUS_OK;
+}
 
-    status = SetEofSyncObj();
-    PCHK_STATUS_AND_RETURN(status, "SetEofSyncObj");
+SIPLStatus CConsumer::RunPayload(uint32_t packetIndex, NvSciSyncFence &prefence, FrameTimestamps ts)
+{
+    SIPLStatus status = NVSIPL_STATUS_OK;
+    if (nullptr != m_waiterSyncObjs[0]) {
+        status = InsertPrefence(packetIndex, prefence);
+    }
+    NvSciSyncFenceClear(&prefence);
+    if (status == NVSIPL_STATUS_OK) {
+        status = SetEofSyncObj();
+    }
 
     NvSciSyncFence postfence = NvSciSyncFenceInitializer;
-    status = ProcessPayload(packetIndex, &postfence);
-    PCHK_STATUS_AND_RETURN(status, "ProcessPayload");
+    if (status == NVSIPL_STATUS_OK) {
+        ts.startNs = CTimeBase::NowNs();
+        status = ProcessPayload(packetIndex, &postfence);
+        ts.endNs = CTimeBase::NowNs();
+    }
+    if (status != NVSIPL_STATUS_OK) {
+        PLOG_ERR("Processing packet %u failed, status: %u\n", packetIndex, status);
+        NvSciSyncFenceClear(&postfence);
+        MarkDone(packetIndex, true);
+        (void)ReleaseDone();
+        return status;
+    }
+    if (CTracer::GetInstance().IsEnabled()) {
+        CTracer::GetInstance().Complete("ProcessPayload", ts.startNs, ts.endNs, packetIndex);
+    }
 
-    if (m_cpuWaitContext != nullptr) {
-        sciErr = NvSciSyncFenceWait(&postfence, m_cpuWaitContext, FENCE_FRAME_TIMEOUT_US);
-        PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciSyncFenceWait");
+    /* Dumps and the release run on the fence completer once the engine is done,
+     * this thread goes on with the next frame. */
+    if (m_cpuWaitContext != nullptr && HasAsyncPostfence()) {
+        UpdateInFlight(packetIndex, ts, NvSciSyncFenceInitializer, false);
+        status = CompleteOnFences(&postfence, 1U, [this, packetIndex](FenceResult result) {
+            MarkDone(packetIndex, result != FenceResult::SIGNALED);
+            if (ReleaseDone() != NVSIPL_STATUS_OK) {
+                m_bCompletionFailed.store(true, std::memory_order_relaxed);
+            }
+        });
+        NvSciSyncFenceClear(&postfence);
+        if (status != NVSIPL_STATUS_OK) {
+            MarkDone(packetIndex, true);
+            (void)ReleaseDone();
+        }
+        PCHK_STATUS_AND_RETURN(status, "CompleteOnFences postfence");
+        return NVSIPL_STATUS_OK;
     }
 
-    status = OnProcessPayloadDone(packetIndex);
+    // The ring takes over the postfence, the producer waits on it instead
+    UpdateInFlight(packetIndex, ts, postfence, true);
+
+    return ReleaseDone();
+}
+
+SIPLStatus CConsumer::RetireUnprocessed(ClientPacket *packet, uint32_t packetIndex)
+{
+    PushInFlight(InFlightFrame { packet, packetIndex, false, true, false, 0U, {}, NvSciSyncFenceInitializer });
+    return ReleaseDone();
+}
+
+SIPLStatus CConsumer::FinishPayload(ClientPacket *packet, uint32_t packetIndex, NvSciSyncFence *pPostfence,
+                                    uint64_t frameTimeNs, FrameTimestamps &ts)
+{
+    auto status = OnProcessPayloadDone(packetIndex);
     PCHK_STATUS_AND_RETURN(status, "OnProcessPayloadDone");
 
-    sciErr = NvSciStreamBlockPacketFenceSet(m_handle, packet->handle, 0U, &postfence);
+    if (DefersRelease()) {
+        /* The subclass keeps the packet and calls ReleaseDeferred() later. Only
+         * CPU consumers defer, their postfence is always empty. */
+        m_framesMetric.Inc();
+        {
+            std::lock_guard<std::mutex> lock(m_decimatorMutex);
+            m_decimator.RecordBusyTime(frameTimeNs, ts.endNs - ts.startNs);
+        }
+        if (m_pLatencyStats != nullptr) {
+            m_pLatencyStats->Record(ts);
+        }
+        return NVSIPL_STATUS_OK;
+    }
+
+    auto sciErr = NvSciStreamBlockPacketFenceSet(m_handle, packet->handle, 0U, pPostfence);
+    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciStreamBlockPacketFenceSet");
 
     /* Release the packet back to the producer */
     sciErr = NvSciStreamConsumerPacketRelease(m_handle, packet->handle);
     PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciStreamConsumerPacketRelease");
+    ts.releaseNs = CTimeBase::NowNs();
+    CFlightRecorder::GetInstance().Record(FLIGHT_PACKET_RELEASE, m_uSensorId, packetIndex);
 
-    NvSciSyncFenceClear(&postfence);
-    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciStreamBlockPacketFenceSet");
+    // Frames in flight overlap, a frame is only busy for the time since the previous release
+    const uint64_t busyStartNs = std::max(ts.startNs, m_lastReleaseNs);
+    m_lastReleaseNs = ts.releaseNs;
+    m_framesMetric.Inc();
+    {
+        std::lock_guard<std::mutex> lock(m_decimatorMutex);
+        m_decimator.RecordBusyTime(frameTimeNs, ts.releaseNs - busyStartNs);
+    }
+    if (m_pLatencyStats != nullptr) {
+        m_pLatencyStats->Record(ts);
+    }
+    if (ts.captureNs != 0U && ts.releaseNs >= ts.captureNs) {
+        CTracer::GetInstance().CheckLatency(ts.releaseNs - ts.captureNs);
+    }
 
     return NVSIPL_STATUS_OK;
 }
 
+bool CConsumer::HasInFlightSlot(void)
+{
+    std::lock_guard<std::mutex> lock(m_inFlightMutex);
+    return m_numProcessing < m_inFlightDepth;
+}
+
+void CConsumer::PushInFlight(const InFlightFrame &frame)
+{
+    std::lock_guard<std::mutex> lock(m_inFlightMutex);
+    // Each packet is acquired at most once before its release, so the ring never overflows
+    m_inFlight[(m_inFlightHead + m_inFlightCount) % m_inFlight.size()] = frame;
+    m_inFlightCount++;
+    if (frame.bProcessed) {
+        m_numProcessing++;
+    }
+}
+
+CConsumer::InFlightFrame *CConsumer::FindInFlight(uint32_t packetIndex)
+{
+    for (uint32_t i = 0U; i < m_inFlightCount; i++) {
+        InFlightFrame &frame = m_inFlight[(m_inFlightHead + i) % m_inFlight.size()];
+        if (frame.packetIndex == packetIndex) {
+            return &frame;
+        }
+    }
+    return nullptr;
+}
+
+void CConsumer::UpdateInFlight(uint32_t packetIndex, const FrameTimestamps &ts, const NvSciSyncFence &postfence,
+                               bool bDone)
+{
+    std::lock_guard<std::mutex> lock(m_inFlightMutex);
+    InFlightFrame *pFrame = FindInFlight(packetIndex);
+    if (pFrame != nullptr) {
+        pFrame->ts = ts;
+        pFrame->postfence = postfence;
+        pFrame->bDone = bDone;
+    }
+}
+
+void CConsumer::MarkDone(uint32_t packetIndex, bool bFailed)
+{
+    std::lock_guard<std::mutex> lock(m_inFlightMutex);
+    InFlightFrame *pFrame = FindInFlight(packetIndex);
+    if (pFrame != nullptr) {
+        pFrame->bDone = true;
+        pFrame->bFailed = bFailed;
+    }
+}
+
+SIPLStatus CConsumer::ReleaseDone(void)
+{
+    std::lock_guard<std::mutex> releaseLock(m_releaseMutex);
+    SIPLStatus result = NVSIPL_STATUS_OK;
+    while (true) {
+        InFlightFrame frame;
+        {
+            std::lock_guard<std::mutex> lock(m_inFlightMutex);
+            if (m_inFlightCount == 0U || !m_inFlight[m_inFlightHead].bDone) {
+                break;
+            }
+            frame = m_inFlight[m_inFlightHead];
+            m_inFlightHead = (m_inFlightHead + 1U) % m_inFlight.size();
+            m_inFlightCount--;
+        }
+
+        SIPLStatus status = NVSIPL_STATUS_OK;
+        if (frame.bFailed) {
+            PLOG_ERR("Packet %u is not released, its processing failed\n", frame.packetIndex);
+            OnProcessPayloadFailed(frame.packetIndex);
+            status = NVSIPL_STATUS_ERROR;
+        } else if (frame.bProcessed) {
+            status = FinishPayload(frame.packet, frame.packetIndex, &frame.postfence, frame.frameTimeNs, frame.ts);
+        } else {
+            status = ReleaseUnprocessed(frame.packet, frame.packetIndex);
+        }
+        NvSciSyncFenceClear(&frame.postfence);
+
+        if (frame.bProcessed) {
+            bool bWasFull = false;
+            {
+                std::lock_guard<std::mutex> lock(m_inFlightMutex);
+                bWasFull = (m_numProcessing == m_inFlightDepth);
+                m_numProcessing--;
+            }
+            // The event thread may have left packets queued for this slot
+            if (bWasFull) {
+                Rearm();
+            }
+        }
+        if (result == NVSIPL_STATUS_OK) {
+            result = status;
+        }
+    }
+
+    return result;
+}
+
 NvSciStreamBlock CConsumer::GetQueueHandle(void)
 {
     return m_queueHandle;
@@ -95,11 +478,34 @@ NvSciBufAttrValAccessPerm CConsumer::GetMetaPerm(void)
 }
 
 // Create client buffer objects from NvSciBufObj
+void CConsumer::ResizePackets(uint32_t numPackets)
+{
+    CClientCommon::ResizePackets(numPackets);
+    m_metaBufs.resize(numPackets, nullptr);
+    m_packetFrameNums.resize(numPackets, 0U);
+    m_inFlight.resize(numPackets);
+}
+
+uint32_t CConsumer::GetFrameNum(uint32_t packetIndex) const
+{
+    return (packetIndex < m_packetFrameNums.size()) ? m_packetFrameNums[packetIndex] : 0U;
+}
+
 SIPLStatus CConsumer::MapMetaBuffer(uint32_t packetIndex)
 {
     PLOG_DBG("Mapping meta buffer, packetIndex: %u.\n", packetIndex);
-    auto sciErr = NvSciBufObjGetConstCpuPtr(m_packets[packetIndex].metaObj, (void const**)&m_metaPtrs[packetIndex]);
+    auto sciErr = NvSciBufObjGetConstCpuPtr(m_packets[packetIndex].metaObj, &m_metaBufs[packetIndex]);
     PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciBufObjGetCpuPtr");
+    auto status = PopulateMetaSize(m_packets[packetIndex].metaObj, m_metaSize);
+    PCHK_STATUS_AND_RETURN(status, "PopulateMetaSize");
 
     return NVSIPL_STATUS_OK;
 }
+
+CFrameMetaReader CConsumer::GetMeta(uint32_t packetIndex) const
+{
+    if (packetIndex >= m_metaBufs.size()) {
+        return CFrameMetaReader();
+    }
+    return CFrameMetaReader(m_metaBufs[packetIndex], m_metaSize);
+}
@@ -10,7 +10,13 @@
 
 #include "nvscibuf.h"
 #include "CClientCommon.hpp"
+#include "CDumpWriter.hpp"
+#include "CTracer.hpp"
+#include "CTopology.hpp"
+#include "CDecimator.hpp"
+#include "CWorkerPool.hpp"
 #include <atomic>
+#include <mutex>
 
 class CConsumer: public CClientCommon
 {
@@ -22,23 +28,129 @@ public:
     /** @brief Default destructor. */
     virtual ~CConsumer() = default;
 
+    // Also creates this consumer's latency histograms in the profiler.
+    virtual void SetProfiler(CProfiler *pProfiler) override;
+
+    // Also registers the queue drop counter, labelled with the queue type.
+    void SetQueueType(QueueType queueType);
+    void SetDecimation(const DecimationConfig &decimation);
+    // Frames older than deadlineMs at acquire are released unprocessed, 0 disables the check.
+    void SetDeadline(double deadlineMs);
+    // Frames processed ahead of the oldest unreleased one, 1 keeps the consumer serial.
+    void SetInFlight(uint32_t depth);
+    // Directory the CUDA and encoder consumers created afterwards dump frames to, empty disables dumps.
+    static void SetDumpDir(const std::string &dir);
+
     // Streaming functions
     NvSciStreamBlock GetQueueHandle(void);
 
+    // Also acquires the packets left queued while the in-flight ring was full
+    virtual EventStatus HandleEvents(void) override;
+
 protected:
     SIPLStatus HandlePayload(void) override;
     virtual SIPLStatus ProcessPayload(uint32_t packetIndex, NvSciSyncFence *pPostfence) = 0;
     virtual SIPLStatus OnProcessPayloadDone(uint32_t packetIndex) = 0;
+    // Takes the place of OnProcessPayloadDone() when processing or the postfence failed, in release order.
+    // The packet is not released, the engine may still use it.
+    virtual void OnProcessPayloadFailed(uint32_t packetIndex) {};
     virtual bool ToSkipFrame(uint32_t frameNum) {return false;};
+    // True when the subclass holds packets past HandlePayload and returns them with ReleaseDeferred()
+    virtual bool DefersRelease(void) const {return false;};
+    // False when ProcessPayload finishes the frame on the CPU and leaves the postfence empty
+    virtual bool HasAsyncPostfence(void) const {return true;};
+    // False when frames may be processed in parallel on the worker pool, up to the in-flight depth
+    virtual bool HasOrderedProcessing(void) const {return true;};
+    // May be called from another thread
+    SIPLStatus ReleaseDeferred(uint32_t packetIndex);
     virtual NvSciBufAttrValAccessPerm GetMetaPerm(void) override;
     virtual SIPLStatus MapMetaBuffer(uint32_t packetIndex) override;
+    virtual void ResizePackets(uint32_t numPackets) override;
+    // Dumps are written by a CDumpWriter thread, one busy slot per packet buffer.
+    // Creates no writer and succeeds when no dump directory is set.
+    SIPLStatus CreateDumpWriter(const std::string &fileName, uint32_t numSlots);
+    // Must run before the dumped buffers are freed.
+    void CloseDumpWriter(void);
 
     uint32_t m_frameNum = 0U;
-    MetaData const* m_metaPtrs[MAX_PACKETS];
+    // m_frameNum of the frame the packet holds, set before ProcessPayload()
+    uint32_t GetFrameNum(uint32_t packetIndex) const;
+    // View of the packet's meta element, valid until the packet is released
+    CFrameMetaReader GetMeta(uint32_t packetIndex) const;
+
+    std::vector<const void *> m_metaBufs;
+    uint32_t m_metaSize = 0U;
+    std::unique_ptr<CDumpWriter> m_upDumpWriter {nullptr};
+    CLatencyStats *m_pLatencyStats = nullptr;
 
 private:
+    // An acquired packet, released once it and every packet acquired before it are done
+    typedef struct {
+        ClientPacket *packet;
+        uint32_t packetIndex;
+        bool bProcessed; // false for skipped and stale frames, they go back without a postfence
+        bool bDone;      // nothing left to wait for
+        bool bFailed;    // the engine may still use it, so it is never released
+        uint64_t frameTimeNs;
+        FrameTimestamps ts;
+        NvSciSyncFence postfence; // handed to the producer, empty once CPU-waited
+    } InFlightFrame;
+
+    // Acquires ready packets while the in-flight ring has room, on the event thread
+    SIPLStatus AcquireReady(void);
+    // Acquire, stale and decimation checks, then RunPayload() here or on a pool worker
+    SIPLStatus AcquirePayload(void);
+    // Prefence, ProcessPayload() and the hand-off to the release, on the event thread or a pool worker
+    SIPLStatus RunPayload(uint32_t packetIndex, NvSciSyncFence &prefence, FrameTimestamps ts);
+
+    void CountQueueDrops(uint64_t frameCount);
+    // OnProcessPayloadDone() and the release, on the fence completer when the postfence is CPU-waited
+    SIPLStatus FinishPayload(ClientPacket *packet, uint32_t packetIndex, NvSciSyncFence *pPostfence,
+                             uint64_t frameTimeNs, FrameTimestamps &ts);
+    // True while fewer than m_inFlightDepth processed frames are unreleased
+    bool HasInFlightSlot(void);
+    void PushInFlight(const InFlightFrame &frame);
+    // Called with m_inFlightMutex held
+    InFlightFrame *FindInFlight(uint32_t packetIndex);
+    void UpdateInFlight(uint32_t packetIndex, const FrameTimestamps &ts, const NvSciSyncFence &postfence,
+                        bool bDone);
+    void MarkDone(uint32_t packetIndex, bool bFailed);
+    // Releases the done frames at the head of the ring, from any thread
+    SIPLStatus ReleaseDone(void);
+    // Queues a skipped or stale frame behind the frames in flight
+    SIPLStatus RetireUnprocessed(ClientPacket *packet, uint32_t packetIndex);
+    // Returns a packet to the producer without waiting on its fences
+    SIPLStatus ReleaseUnprocessed(ClientPacket *packet, uint32_t packetIndex);
+
+    static std::string s_dumpDir;
+
     NvSciStreamBlock m_queueHandle = 0U;
-    /* Virtual address for the meta buffer */
+    QueueType m_queueType = QueueType::MAILBOX;
+    CMetric m_framesMetric;
+    CMetric m_skipsMetric;
+    CMetric m_queueDropsMetric;
+    // ToProcess() runs on the event thread, RecordBusyTime() where the frame is released
+    std::mutex m_decimatorMutex;
+    CDecimator m_decimator;
+    uint64_t m_lastReleaseNs = 0U;
+    uint64_t m_deadlineNs = 0U;
+    CMetric m_staleMetric;
+    // Producer frame count expected in the next acquired packet
+    uint64_t m_nextFrameCount = 0U;
+    bool m_bFrameCountValid = false;
+    bool m_bMetaWarned = false;
+    std::vector<uint32_t> m_packetFrameNums;
+
+    // Acquired packets in acquire order, one slot per packet
+    uint32_t m_inFlightDepth = 1U;
+    std::mutex m_inFlightMutex;
+    std::vector<InFlightFrame> m_inFlight;
+    uint32_t m_inFlightHead = 0U;
+    uint32_t m_inFlightCount = 0U;
+    uint32_t m_numProcessing = 0U; // processed frames in the ring
+    std::mutex m_releaseMutex;     // one ReleaseDone() at a time keeps the release order
+    // PacketReady events not acquired yet, event thread only
+    uint32_t m_numReadyPackets = 0U;
 };
 #endif
 
@@ -0,0 +1,247 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CCpuConsumer.hpp"
+
+std::mutex CCpuConsumer::s_callbackMutex;
+CpuFrameCallback CCpuConsumer::s_defaultCallback = nullptr;
+
+CCpuConsumer::CCpuConsumer(NvSciStreamBlock handle, uint32_t uSensor, NvSciStreamBlock queueHandle) :
+    CCpuConsumer("CpuConsumer", handle, uSensor, queueHandle)
+{
+}
+
+CCpuConsumer::CCpuConsumer(std::string name, NvSciStreamBlock handle, uint32_t uSensor,
+                           NvSciStreamBlock queueHandle) :
+    CConsumer(name, handle, uSensor, queueHandle)
+{
+    std::lock_guard<std::mutex> lock(s_callbackMutex);
+    m_frameCallback = s_defaultCallback;
+}
+
+CCpuConsumer::~CCpuConsumer(void)
+{
+    PLOG_DBG("release.\n");
+}
+
+void CCpuConsumer::SetFrameCallback(CpuFrameCallback callback)
+{
+    m_frameCallback = callback;
+}
+
+void CCpuConsumer::SetPyramid(uint32_t numLevels)
+{
+    m_pyramidLevels = numLevels;
+    if (numLevels != 0U) {
+        CPyramidStage::GetInstance(m_uSensorId).Configure(numLevels);
+    }
+}
+
+void CCpuConsumer::SetDefaultFrameCallback(CpuFrameCallback callback)
+{
+    std::lock_guard<std::mutex> lock(s_callbackMutex);
+    s_defaultCallback = callback;
+}
+
+SIPLStatus CCpuConsumer::HandleClientInit(void)
+{
+    m_numWaitSyncObj = 1U;
+
+    return NVSIPL_STATUS_OK;
+}
+
+SIPLStatus CCpuConsumer::SetDataBufAttrList(void)
+{
+    NvSciBufType bufType = NvSciBufType_Image;
+    NvSciBufAttrValAccessPerm perm = NvSciBufAccessPerm_Readonly;
+    bool cpuaccess_flag = true;
+
+    NvSciBufAttrKeyValuePair bufAttrs[] = {
+        { NvSciBufGeneralAttrKey_Types, &bufType, sizeof(bufType) },
+        { NvSciBufGeneralAttrKey_RequiredPerm, &perm, sizeof(perm) },
+        { NvSciBufGeneralAttrKey_NeedCpuAccess, &cpuaccess_flag, sizeof(cpuaccess_flag) },
+    };
+
+    auto sciErr = NvSciBufAttrListSetAttrs(m_bufAttrLists[DATA_ELEMENT_INDEX], bufAttrs, sizeof(bufAttrs) / sizeof(NvSciBufAttrKeyValuePair));
+    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciBufAttrListSetAttrs");
+
+    return NVSIPL_STATUS_OK;
+}
+
+// The CPU both waits for the producer and signals its own (always empty) postfence.
+SIPLStatus CCpuConsumer::SetSyncAttrList(void)
+{
+    bool cpuAccess = true;
+    NvSciSyncAccessPerm signalPerm = NvSciSyncAccessPerm_SignalOnly;
+    NvSciSyncAttrKeyValuePair signalKeyVals[] = {
+        { NvSciSyncAttrKey_NeedCpuAccess, &cpuAccess, sizeof(cpuAccess) },
+        { NvSciSyncAttrKey_RequiredPerm, &signalPerm, sizeof(signalPerm) }
+    };
+    auto sciErr = NvSciSyncAttrListSetAttrs(m_signalerAttrList, signalKeyVals, 2);
+    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "CPU signaler NvSciSyncAttrListSetAttrs");
+
+    NvSciSyncAccessPerm waitPerm = NvSciSyncAccessPerm_WaitOnly;
+    NvSciSyncAttrKeyValuePair waitKeyVals[] = {
+        { NvSciSyncAttrKey_NeedCpuAccess, &cpuAccess, sizeof(cpuAccess) },
+        { NvSciSyncAttrKey_RequiredPerm, &waitPerm, sizeof(waitPerm) }
+    };
+    sciErr = NvSciSyncAttrListSetAttrs(m_waiterAttrList, waitKeyVals, 2);
+    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "CPU waiter NvSciSyncAttrListSetAttrs");
+
+    return NVSIPL_STATUS_OK;
+}
+
+SIPLStatus CCpuConsumer::MapPlanes(const void *pBase, const BufferAttrs &bufAttrs, CpuFrame &frame)
+{
+    if (pBase == nullptr || bufAttrs.planeCount == 0U || bufAttrs.planeCount > NUM_PLANES) {
+        return NVSIPL_STATUS_BAD_ARGUMENT;
+    }
+
+    frame.layout = bufAttrs.layout;
+    frame.planeCount = bufAttrs.planeCount;
+    for (auto i = 0U; i < bufAttrs.planeCount; i++) {
+        if (bufAttrs.planeOffsets[i] >= bufAttrs.size) {
+            return NVSIPL_STATUS_BAD_ARGUMENT;
+        }
+        frame.planePtrs[i] = static_cast<const uint8_t *>(pBase) + bufAttrs.planeOffsets[i];
+        frame.planeWidths[i] = bufAttrs.planeWidths[i];
+        frame.planeHeights[i] = bufAttrs.planeHeights[i];
+        frame.planePitches[i] = bufAttrs.planePitches[i];
+        frame.planeBitsPerPixels[i] = bufAttrs.planeBitsPerPixels[i];
+        frame.planeAlignedHeights[i] = bufAttrs.planeAlignedHeights[i];
+        frame.planeBlockHeights[i] = bufAttrs.planeBlockHeights[i];
+        frame.planeColorFormats[i] = bufAttrs.planeColorFormats[i];
+    }
+
+    return NVSIPL_STATUS_OK;
+}
+
+void CCpuConsumer::ResizePackets(uint32_t numPackets)
+{
+    CConsumer::ResizePackets(numPackets);
+    // Value-initialized, all zero like the memset of the fixed arrays was
+    m_bufAttrs.resize(numPackets, BufferAttrs());
+    m_frames.resize(numPackets, CpuFrame());
+    m_pyramidSources.resize(numPackets, PyramidSource());
+}
+
+// NV12 in either layout: an 8-bit luma plane and an interleaved 16-bit UV plane
+static bool GetPyramidSource(const CpuFrame &frame, PyramidSource &source)
+{
+    if (frame.planeCount != 2U || frame.planeBitsPerPixels[0] != 8U || frame.planeBitsPerPixels[1] != 16U) {
+        return false;
+    }
+    source.bBlockLinear = (frame.layout == NvSciBufImage_BlockLinearType);
+    for (uint32_t p = 0U; p < 2U; p++) {
+        if (source.bBlockLinear) {
+            if (!CBlockLinear::GetPlane(frame, p, source.planes[p])) {
+                return false;
+            }
+        } else {
+            source.planes[p] = BlockLinearPlane{ frame.planeWidths[p] * frame.planeBitsPerPixels[p] / 8U,
+                                                 frame.planeHeights[p], frame.planePitches[p],
+                                                 frame.planeHeights[p], 0U };
+        }
+        source.pPlanes[p] = frame.planePtrs[p];
+    }
+    return true;
+}
+
+void CCpuConsumer::ReleasePyramid(uint32_t packetIndex)
+{
+    CpuFrame &frame = m_frames[packetIndex];
+    if (frame.pPyramid != nullptr) {
+        CPyramidStage::GetInstance(m_uSensorId).Release(frame.pPyramid);
+        frame.pPyramid = nullptr;
+    }
+}
+
+SIPLStatus CCpuConsumer::MapDataBuffer(uint32_t packetIndex)
+{
+    auto status = PopulateBufAttr(m_packets[packetIndex].dataObj, m_bufAttrs[packetIndex]);
+    PCHK_STATUS_AND_RETURN(status, "PopulateBufAttr");
+    // Callbacks and the pyramid detile block-linear frames on the CPU, which cannot guess the block height
+    if (!m_bufAttrs[packetIndex].hasBlockHeights) {
+        PLOG_ERR("Block-linear buffer without plane block heights\n");
+        return NVSIPL_STATUS_NOT_SUPPORTED;
+    }
+
+    const void *pBase = nullptr;
+    auto sciErr = NvSciBufObjGetConstCpuPtr(m_packets[packetIndex].dataObj, &pBase);
+    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciBufObjGetConstCpuPtr");
+
+    status = MapPlanes(pBase, m_bufAttrs[packetIndex], m_frames[packetIndex]);
+    PCHK_STATUS_AND_RETURN(status, "MapPlanes");
+    m_frames[packetIndex].uSensorId = m_uSensorId;
+    m_frames[packetIndex].packetIndex = packetIndex;
+
+    if (m_pyramidLevels != 0U) {
+        if (!GetPyramidSource(m_frames[packetIndex], m_pyramidSources[packetIndex])) {
+            PLOG_WARN("Pyramid needs NV12 frames, running without it.\n");
+            m_pyramidLevels = 0U;
+        } else {
+            status = CPyramidStage::GetInstance(m_uSensorId).Allocate(m_pyramidSources[packetIndex],
+                                                                      (uint32_t)m_packets.size());
+            PCHK_STATUS_AND_RETURN(status, "CPyramidStage::Allocate");
+        }
+    }
+
+    PLOG_DBG("MapDataBuffer, packetIndex: %u, layout: %u, planeCount: %u.\n",
+             packetIndex, m_bufAttrs[packetIndex].layout, m_bufAttrs[packetIndex].planeCount);
+
+    return NVSIPL_STATUS_OK;
+}
+
+SIPLStatus CCpuConsumer::RegisterSignalSyncObj(void)
+{
+    // The postfence is left empty, the buffer is done once ProcessPayload returns.
+    return NVSIPL_STATUS_OK;
+}
+
+SIPLStatus CCpuConsumer::RegisterWaiterSyncObj(uint32_t index)
+{
+    return NVSIPL_STATUS_OK;
+}
+
+SIPLStatus CCpuConsumer::InsertPrefence(uint32_t packetIndex, NvSciSyncFence &prefence)
+{
+    auto sciErr = CpuWaitFence(&prefence);
+    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciSyncFenceWait prefence");
+
+    return NVSIPL_STATUS_OK;
+}
+
+SIPLStatus CCpuConsumer::ProcessPayload(uint32_t packetIndex, NvSciSyncFence *pPostfence)
+{
+    PLOG_DBG("Process payload (packetIndex = 0x%x).\n", packetIndex);
+
+    CpuFrame &frame = m_frames[packetIndex];
+    frame.frameNum = GetFrameNum(packetIndex);
+    frame.meta = GetMeta(packetIndex);
+    frame.pMeta = frame.meta.GetCore();
+    if (m_pyramidLevels != 0U) {
+        // Consumers of the same frame share one pyramid, matched by capture time
+        uint64_t frameKey = (frame.pMeta != nullptr) ? frame.pMeta->frameCaptureTSC : 0U;
+        frame.pPyramid = CPyramidStage::GetInstance(m_uSensorId).Acquire(m_pyramidSources[packetIndex], frameKey);
+    }
+
+    if (m_frameCallback != nullptr) {
+        auto status = m_frameCallback(frame);
+        PCHK_STATUS_AND_RETURN(status, "Frame callback");
+    }
+
+    return NVSIPL_STATUS_OK;
+}
+
+SIPLStatus CCpuConsumer::OnProcessPayloadDone(uint32_t packetIndex)
+{
+    if (!DefersRelease()) {
+        ReleasePyramid(packetIndex);
+    }
+    return NVSIPL_STATUS_OK;
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CCPUCONSUMER_H
+#define CCPUCONSUMER_H
+
+#include <functional>
+#include <mutex>
+
+#include "CConsumer.hpp"
+#include "CPyramidStage.hpp"
+
+// Read-only view of a mapped packet, valid only during the frame callback,
+// or until the packet is released for a consumer that defers the release.
+typedef struct {
+    uint32_t uSensorId;
+    uint32_t frameNum;
+    uint32_t packetIndex;
+    NvSciBufAttrValImageLayoutType layout;
+    uint32_t planeCount;
+    const uint8_t *planePtrs[NUM_PLANES];
+    uint32_t planeWidths[NUM_PLANES];
+    uint32_t planeHeights[NUM_PLANES];
+    uint32_t planePitches[NUM_PLANES];
+    uint32_t planeBitsPerPixels[NUM_PLANES];
+    uint32_t planeAlignedHeights[NUM_PLANES];
+    uint32_t planeBlockHeights[NUM_PLANES]; // log2 of the GOBs per block, block-linear only
+    NvSciBufAttrValColorFmt planeColorFormats[NUM_PLANES];
+    MetaData const *pMeta;   // core of meta, nullptr when the producer wrote none
+    CFrameMetaReader meta;   // exposure, temperature, ... sections, see CFrameMeta.hpp
+    const Pyramid *pPyramid; // shared downscaled copies, nullptr without 'pyramid'
+} CpuFrame;
+
+// With the worker pool and 'inflight' above 1 the callback may run for several
+// frames of the same consumer at once, on different threads.
+typedef std::function<SIPLStatus(const CpuFrame &frame)> CpuFrameCallback;
+
+class CCpuConsumer: public CConsumer
+{
+    public:
+        CCpuConsumer() = delete;
+        CCpuConsumer(NvSciStreamBlock handle, uint32_t uSensor, NvSciStreamBlock queueHandle);
+        virtual ~CCpuConsumer(void);
+
+        void SetFrameCallback(CpuFrameCallback callback);
+        // Hands the callback numLevels halved copies of each NV12 frame.
+        void SetPyramid(uint32_t numLevels);
+        // Callback picked up by every CPU consumer created afterwards.
+        static void SetDefaultFrameCallback(CpuFrameCallback callback);
+        // Fills the plane pointers of a frame from a CPU mapping of the buffer.
+        // Also used with plain host memory when running without NvSciBuf.
+        static SIPLStatus MapPlanes(const void *pBase, const BufferAttrs &bufAttrs, CpuFrame &frame);
+
+    protected:
+        CCpuConsumer(std::string name, NvSciStreamBlock handle, uint32_t uSensor, NvSciStreamBlock queueHandle);
+
+        virtual SIPLStatus HandleClientInit(void) override;
+        virtual SIPLStatus SetDataBufAttrList(void) override;
+        virtual SIPLStatus SetSyncAttrList(void) override;
+        virtual SIPLStatus MapDataBuffer(uint32_t packetIndex) override;
+        virtual SIPLStatus RegisterSignalSyncObj(void) override;
+        virtual SIPLStatus RegisterWaiterSyncObj(uint32_t index) override;
+        virtual SIPLStatus InsertPrefence(uint32_t packetIndex, NvSciSyncFence &prefence) override;
+        virtual SIPLStatus ProcessPayload(uint32_t packetIndex, NvSciSyncFence *pPostfence) override;
+        virtual SIPLStatus OnProcessPayloadDone(uint32_t packetIndex) override;
+        virtual bool HasCpuWait(void) override {return true;}
+        virtual bool HasAsyncPostfence(void) const override {return false;};
+        // Frames only share the packet's own state, any worker may take the next one
+        virtual bool HasOrderedProcessing(void) const override {return false;};
+        virtual void ResizePackets(uint32_t numPackets) override;
+        // Returns the packet's pyramid to the stage, before the packet itself
+        void ReleasePyramid(uint32_t packetIndex);
+
+    private:
+        std::vector<BufferAttrs> m_bufAttrs;
+        std::vector<CpuFrame> m_frames;
+        CpuFrameCallback m_frameCallback;
+        uint32_t m_pyramidLevels = 0U;
+        std::vector<PyramidSource> m_pyramidSources;
+
+        static std::mutex s_callbackMutex;
+        static CpuFrameCallback s_defaultCallback;
+    };
+#endif
@@ -12,16 +12,28 @@ CCudaConsumer::CCudaConsumer(NvSciStreamBlock handle, uint32_t uSensor, NvSciStr
     CConsumer("CudaConsumer", handle, uSensor, queueHandle)
 {
     m_streamWaiter = nullptr;
-    for (uint32_t i = 0U; i < MAX_PACKETS; i++) {
-        m_extMem[i] = 0U;
-        m_pCudaCopyMem[i] = nullptr;
-        m_devPtr[i] = nullptr;
-    }
 
     m_signalerSem = 0U;
     m_waiterSem = 0U;
-    m_hostBufLen = 0;
-    m_pHostBuf = nullptr;
+
+    // Slots are added as packets arrive, see ResizePackets()
+    m_upDevicePool = std::make_unique<CStagingPool>(std::make_unique<CDeviceStagingAllocator>(), 0U);
+    m_upHostPool = std::make_unique<CStagingPool>(std::make_unique<CPinnedStagingAllocator>(), 0U);
+}
+
+void CCudaConsumer::ResizePackets(uint32_t numPackets)
+{
+    CConsumer::ResizePackets(numPackets);
+    m_devPtr.resize(numPackets, nullptr);
+    m_extMem.resize(numPackets, nullptr);
+    m_bufAttrs.resize(numPackets, BufferAttrs());
+    m_packetStreams.resize(numPackets, nullptr);
+    m_packetEvents.resize(numPackets, nullptr);
+    m_hostBufLens.resize(numPackets, 0U);
+    m_mipmapArray.resize(numPackets, std::array<cudaMipmappedArray_t, NUM_PLANES>());
+    m_mipLevelArray.resize(numPackets, std::array<cudaArray_t, NUM_PLANES>());
+    m_upDevicePool->Resize(numPackets);
+    m_upHostPool->Resize(numPackets);
 }
 
 SIPLStatus CCudaConsumer::InitCuda(void)
@@ -46,9 +58,8 @@ SIPLStatus CCudaConsumer::HandleClientInit(void)
     auto status = InitCuda();
     PCHK_STATUS_AND_RETURN(status, "InitCuda");
 
-    // string fileName = "multicast_cuda" + to_string(m_uSensorId) + ".yuv";
-    // m_pOutputFile = fopen(fileName.c_str(), "w+");
-    // PCHK_PTR_AND_RETURN(m_pOutputFile, "Open CUDA output file");
+    status = CreateDumpWriter("multicast_cuda" + std::to_string(m_uSensorId) + ".yuv", MAX_PACKETS);
+    PCHK_STATUS_AND_RETURN(status, "Open CUDA output file");
 
     m_numWaitSyncObj = 1U;
 
@@ -59,10 +70,7 @@ CCudaConsumer::~CCudaConsumer(void)
 {
     PLOG_DBG("release.\n");
 
-    if (m_pOutputFile != nullptr) {
-        fflush(m_pOutputFile);
-        fclose(m_pOutputFile);
-    }
+    CloseDumpWriter();
     if (m_waiterSem != nullptr) {
         (void)cudaDestroyExternalSemaphore(m_waiterSem);
         m_waiterSem = nullptr;
@@ -72,20 +80,24 @@ CCudaConsumer::~CCudaConsumer(void)
         m_signalerSem = nullptr;
     }
 
-    for (uint32_t i = 0U; i < MAX_PACKETS; i++) {
+    for (uint32_t i = 0U; i < m_devPtr.size(); i++) {
         cudaFree(m_devPtr[i]);
         cudaDestroyExternalMemory(m_extMem[i]);
-        if (m_pCudaCopyMem[i]) {
-            cudaFreeHost(m_pCudaCopyMem[i]);
-            m_pCudaCopyMem[i] = nullptr;
-        }
     }
-    for (uint32_t i = 0U; i < MAX_PACKETS; i++) {
+    for (uint32_t i = 0U; i < m_bufAttrs.size(); i++) {
         for (uint32_t j = 0U; j < m_bufAttrs[i].planeCount; j++) {
             cudaFreeMipmappedArray(m_mipmapArray[i][j]);
         }
     }
 
+    for (uint32_t i = 0U; i < m_packetStreams.size(); i++) {
+        if (m_packetEvents[i] != nullptr) {
+            cudaEventDestroy(m_packetEvents[i]);
+        }
+        if (m_packetStreams[i] != nullptr) {
+            cudaStreamDestroy(m_packetStreams[i]);
+        }
+    }
     cudaStreamDestroy(m_streamWaiter);
 }
 
@@ -142,47 +154,8 @@ SIPLStatus CCudaConsumer::MapDataBuffer(uint32_t packetIndex)
 {
     // Create CUDA buffer objects from NvSciBufObj in the packet.
     // Query size from buffer object to set CUDA buffer attribute
-    NvSciBufAttrList attrList;
-    auto sciErr = NvSciBufObjGetAttrList(m_packets[packetIndex].dataObj, &attrList);
-    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciBufObjGetAttrList");
-
-    NvSciBufAttrKeyValuePair imgattrs[] = {
-        { NvSciBufImageAttrKey_Size, nullptr, 0 },               //0
-        { NvSciBufImageAttrKey_Layout, nullptr, 0 },             //1
-        { NvSciBufImageAttrKey_PlaneCount, nullptr, 0 },         //2
-        { NvSciBufImageAttrKey_PlaneWidth, nullptr, 0 },         //3
-        { NvSciBufImageAttrKey_PlaneHeight, nullptr, 0 },        //4
-        { NvSciBufImageAttrKey_PlanePitch, nullptr, 0 },         //5
-        { NvSciBufImageAttrKey_PlaneBitsPerPixel, nullptr, 0 },  //6
-        { NvSciBufImageAttrKey_PlaneAlignedHeight, nullptr, 0 }, //7
-        { NvSciBufImageAttrKey_PlaneAlignedSize, nullptr, 0 },   //8
-        { NvSciBufImageAttrKey_PlaneOffset, nullptr, 0 },        //9
-        { NvSciBufImageAttrKey_PlaneColorFormat, nullptr, 0 },   //10
-        { NvSciBufImageAttrKey_PlaneChannelCount, nullptr, 0 }   //11
-    };
-    sciErr = NvSciBufAttrListGetAttrs(attrList, imgattrs, sizeof(imgattrs) / sizeof(NvSciBufAttrKeyValuePair));
-    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciBufAttrListGetAttrs");
-    m_bufAttrs[packetIndex].size = *(static_cast<const uint64_t*>(imgattrs[0].value));
-    m_bufAttrs[packetIndex].layout = *(static_cast<const NvSciBufAttrValImageLayoutType*>(imgattrs[1].value));
-    m_bufAttrs[packetIndex].planeCount = *(static_cast<const uint32_t*>(imgattrs[2].value));
-    memcpy(m_bufAttrs[packetIndex].planeWidths, static_cast<const uint32_t*>(imgattrs[3].value), m_bufAttrs[packetIndex].planeCount * sizeof(uint32_t));
-    memcpy(m_bufAttrs[packetIndex].planeHeights, static_cast<const uint32_t*>(imgattrs[4].value), m_bufAttrs[packetIndex].planeCount * sizeof(uint32_t));
-    memcpy(m_bufAttrs[packetIndex].planePitches, static_cast<const uint32_t*>(imgattrs[5].value), m_bufAttrs[packetIndex].planeCount * sizeof(uint32_t));
-    memcpy(m_bufAttrs[packetIndex].planeBitsPerPixels, static_cast<const uint32_t*>(imgattrs[6].value), m_bufAttrs[packetIndex].planeCount * sizeof(uint32_t));
-    memcpy(m_bufAttrs[packetIndex].planeAlignedHeights, static_cast<const uint32_t*>(imgattrs[7].value), m_bufAttrs[packetIndex].planeCount * sizeof(uint32_t));
-    memcpy(m_bufAttrs[packetIndex].planeAlignedSizes, static_cast<const uint64_t*>(imgattrs[8].value), m_bufAttrs[packetIndex].planeCount * sizeof(uint64_t));
-    memcpy(m_bufAttrs[packetIndex].planeOffsets, static_cast<const uint64_t*>(imgattrs[9].value), m_bufAttrs[packetIndex].planeCount * sizeof(uint64_t));
-    memcpy(m_bufAttrs[packetIndex].planeColorFormats, static_cast<const NvSciBufAttrValColorFmt*>(imgattrs[10].value),
-           m_bufAttrs[packetIndex].planeCount * sizeof(NvSciBufAttrValColorFmt));
-    memcpy(m_bufAttrs[packetIndex].planeChannelCounts, static_cast<const uint8_t*>(imgattrs[11].value), m_bufAttrs[packetIndex].planeCount * sizeof(uint8_t));
-    //Print sciBuf attributes
-    PLOG_DBG("YUV: size=%lu, layout=%u, planeCount=%u\n", m_bufAttrs[packetIndex].size, m_bufAttrs[packetIndex].layout, m_bufAttrs[packetIndex].planeCount);
-    for (auto i = 0U; i < m_bufAttrs[packetIndex].planeCount; i++) {
-        PLOG_DBG("plane %u: planeWidth=%u, planeHeight=%u, planePitch=%u, planeBitsPerPixels=%u, planeAlignedHeight=%u, planeAlignedSize=%lu, planeOffset=%lu, planeColorFormat=%u, planeChannelCount=%u\n",
-            i, m_bufAttrs[packetIndex].planeWidths[i], m_bufAttrs[packetIndex].planeHeights[i], m_bufAttrs[packetIndex].planePitches[i], m_bufAttrs[packetIndex].planeBitsPerPixels[i],
-            m_bufAttrs[packetIndex].planeAlignedHeights[i],m_bufAttrs[packetIndex].planeAlignedSizes[i], m_bufAttrs[packetIndex].planeOffsets[i], m_bufAttrs[packetIndex].planeColorFormats[i],
-            m_bufAttrs[packetIndex].planeChannelCounts[i]);
-    }
+    auto status = PopulateBufAttr(m_packets[packetIndex].dataObj, m_bufAttrs[packetIndex]);
+    PCHK_STATUS_AND_RETURN(status, "PopulateBufAttr");
 
     cudaExternalMemoryHandleDesc memHandleDesc;
     memset(&memHandleDesc, 0, sizeof(memHandleDesc));
@@ -231,11 +204,23 @@ SIPLStatus CCudaConsumer::MapDataBuffer(uint32_t packetIndex)
         PLOG_ERR("Unsupported layout\n");
         return NVSIPL_STATUS_ERROR;
     }
-    if (m_pCudaCopyMem[packetIndex] == nullptr) {
-        cudaStatus = cudaHostAlloc((void **)&m_pCudaCopyMem[packetIndex], m_bufAttrs[packetIndex].size, cudaHostAllocDefault);
-        CHK_CUDASTATUS_AND_RETURN(cudaStatus, "cudaHostAlloc");
-        PCHK_PTR_AND_RETURN(m_pCudaCopyMem[packetIndex], "m_pCudaCopyMem allocation");
-        (void*)memset(m_pCudaCopyMem[packetIndex], 0, m_bufAttrs[packetIndex].size);
+
+    if (m_packetStreams[packetIndex] == nullptr) {
+        cudaStatus = cudaStreamCreateWithFlags(&m_packetStreams[packetIndex], cudaStreamNonBlocking);
+        CHK_CUDASTATUS_AND_RETURN(cudaStatus, "cudaStreamCreateWithFlags");
+        cudaStatus = cudaEventCreateWithFlags(&m_packetEvents[packetIndex], cudaEventDisableTiming);
+        CHK_CUDASTATUS_AND_RETURN(cudaStatus, "cudaEventCreateWithFlags");
+    }
+
+    // Staging buffers hold the packed pitch-linear NV12 copy of this packet
+    size_t plSize = (size_t)m_bufAttrs[packetIndex].planeWidths[0] * m_bufAttrs[packetIndex].planeHeights[0] * 3U / 2U;
+    if (!m_upDevicePool->Reserve(packetIndex, plSize)) {
+        PLOG_ERR("Device staging buffer allocation failed, size: %zu\n", plSize);
+        return NVSIPL_STATUS_OUT_OF_MEMORY;
+    }
+    if (!m_upHostPool->Reserve(packetIndex, plSize)) {
+        PLOG_ERR("Pinned staging buffer allocation failed, size: %zu\n", plSize);
+        return NVSIPL_STATUS_OUT_OF_MEMORY;
     }
 
     return NVSIPL_STATUS_OK;
@@ -274,7 +259,7 @@ SIPLStatus CCudaConsumer::InsertPrefence(uint32_t packetIndex, NvSciSyncFence &p
     memset(&waitParams, 0, sizeof(waitParams));
     waitParams.params.nvSciSync.fence = &prefence;
     waitParams.flags = 0;
-    auto cudaStatus = cudaWaitExternalSemaphoresAsync(&m_waiterSem, &waitParams, 1, m_streamWaiter);
+    auto cudaStatus = cudaWaitExternalSemaphoresAsync(&m_waiterSem, &waitParams, 1, m_packetStreams[packetIndex]);
     CHK_CUDASTATUS_AND_RETURN(cudaStatus, "cuWaitExternalSemaphoresAsync");
 
     return NVSIPL_STATUS_OK;
@@ -298,9 +283,8 @@ SIPLStatus CCudaConsumer::BlToPlConvert(uint32_t packetIndex, void *dstptr)
                                              (size_t)m_bufAttrs[packetIndex].planeWidths[0U],
                                              (size_t)m_bufAttrs[packetIndex].planeHeights[0U],
                                              cudaMemcpyDeviceToDevice,
-                                             m_streamWaiter);
+                                             m_packetStreams[packetIndex]);
     CHK_CUDASTATUS_AND_RETURN(cudaStatus, "cudaMemcpy2DFromArrayAsync for plane 0");
-    cudaStreamSynchronize(m_streamWaiter);
 
     uint8_t *second_dst = (uint8_t *)dstptr + (size_t)(m_bufAttrs[packetIndex].planeWidths[0U] * m_bufAttrs[packetIndex].planeHeights[0U]);
     cudaStatus = cudaMemcpy2DFromArrayAsync((void *)(second_dst),
@@ -310,105 +294,72 @@ SIPLStatus CCudaConsumer::BlToPlConvert(uint32_t packetIndex, void *dstptr)
                                              (size_t)m_bufAttrs[packetIndex].planeWidths[0U],
                                              (size_t)(m_bufAttrs[packetIndex].planeHeights[0U]/2),
                                              cudaMemcpyDeviceToDevice,
-                                             m_streamWaiter);
+                                             m_packetStreams[packetIndex]);
     CHK_CUDASTATUS_AND_RETURN(cudaStatus, "cudaMemcpy2DFromArrayAsync for plane 1");
-    cudaStreamSynchronize(m_streamWaiter);
 
     return NVSIPL_STATUS_OK;
 }
 
 SIPLStatus CCudaConsumer::ProcessPayload(uint32_t packetIndex, NvSciSyncFence *pPostfence) {
-    uint8_t *plPtr = nullptr;
-    SIPLStatus status = NVSIPL_STATUS_OK;
-    cudaExternalSemaphoreSignalParams signalParams;
-    uint8_t *pBuffer = nullptr;
-    size_t uNumBytes = 0U;
-
-    if (m_bufAttrs[packetIndex].layout == NvSciBufImage_BlockLinearType) {
-        uNumBytes = (size_t)m_bufAttrs[packetIndex].planeWidths[0]*(int)m_bufAttrs[packetIndex].planeHeights[0]*1.5;
-
-        pBuffer = new (std::nothrow) uint8_t[uNumBytes];
-        if (pBuffer == nullptr) {
-            PLOG_ERR("Out of memory\n");
-            return NVSIPL_STATUS_OUT_OF_MEMORY;
-        }
-
-        m_hostBufLen = uNumBytes;
-        m_pHostBuf = pBuffer;
-
-        auto cudaStatus = cudaMalloc((void **)&plPtr, m_hostBufLen);
-        if (cudaStatus != cudaSuccess) {
-            PLOG_ERR("cudaMalloc failed: %u\n", status);
-            status = NVSIPL_STATUS_OUT_OF_MEMORY;
-            goto cleanup;
-        }
-        status = BlToPlConvert(packetIndex, (void *)plPtr);
-        if (status != NVSIPL_STATUS_OK) {
-            PLOG_ERR("BlToPlConvert failed: %u\n", status);
-            goto cleanup;
-        }
-        cudaStatus = cudaMemcpyAsync((void *)m_pHostBuf, (void *)plPtr, m_hostBufLen, cudaMemcpyDeviceToHost, m_streamWaiter);
-        if (cudaStatus != cudaSuccess) {
-            PLOG_ERR("cudaMemcpyAsync failed: %u\n", cudaStatus);
-            status = NVSIPL_STATUS_ERROR;
-            goto cleanup;
-        }
-        cudaStreamSynchronize(m_streamWaiter);
-
-        PLOG_DBG("ProcessPayload succeed.\n");
-        cudaFree(plPtr);
-
-        memset(&signalParams, 0, sizeof(signalParams));
-        signalParams.params.nvSciSync.fence = pPostfence;
-        signalParams.flags = 0;
-        cudaStatus = cudaSignalExternalSemaphoresAsync(&m_signalerSem, &signalParams, 1, m_streamWaiter);
-        if (cudaStatus != cudaSuccess) {
-            PLOG_ERR("cudaSignalExternalSemaphoresAsync failed: %u\n", cudaStatus);
-            status = NVSIPL_STATUS_ERROR;
-            goto cleanup;
-        }
-
-        return status;
-    } else {
+    if (m_bufAttrs[packetIndex].layout != NvSciBufImage_BlockLinearType) {
         PLOG_ERR("Unsupported layout\n");
         return NVSIPL_STATUS_ERROR;
     }
 
-cleanup:
-    cudaFree(plPtr);
-    if(nullptr != m_pHostBuf) {
-        free(m_pHostBuf);
-        m_pHostBuf = nullptr;
+    size_t uNumBytes = (size_t)m_bufAttrs[packetIndex].planeWidths[0] * m_bufAttrs[packetIndex].planeHeights[0] * 3U / 2U;
+    uint8_t *plPtr = m_upDevicePool->GetBuffer(packetIndex);
+    uint8_t *pHostBuf = m_upHostPool->GetBuffer(packetIndex);
+    if (plPtr == nullptr || pHostBuf == nullptr || m_upHostPool->GetCapacity(packetIndex) < uNumBytes) {
+        PLOG_ERR("Staging buffers of packet %u are not mapped\n", packetIndex);
+        return NVSIPL_STATUS_ERROR;
+    }
+    m_hostBufLens[packetIndex] = 0U;
+
+    auto status = BlToPlConvert(packetIndex, (void *)plPtr);
+    PCHK_STATUS_AND_RETURN(status, "BlToPlConvert");
+
+    /* Leave the host copy alone while the dump writer still references it.
+     * The readback completes before the postfence, OnProcessPayloadDone() uses it. */
+    const cudaStream_t stream = m_packetStreams[packetIndex];
+    cudaError_t cudaStatus;
+    if (m_upDumpWriter == nullptr || !m_upDumpWriter->IsSlotBusy(packetIndex)) {
+        cudaStatus = cudaMemcpyAsync((void *)pHostBuf, (void *)plPtr, uNumBytes, cudaMemcpyDeviceToHost, stream);
+        CHK_CUDASTATUS_AND_RETURN(cudaStatus, "cudaMemcpyAsync");
+        m_hostBufLens[packetIndex] = uNumBytes;
     }
 
-    return status;
+    // Fences of one sync object signal in order, so the signal goes behind the earlier frames' signals
+    cudaStatus = cudaEventRecord(m_packetEvents[packetIndex], stream);
+    CHK_CUDASTATUS_AND_RETURN(cudaStatus, "cudaEventRecord");
+    cudaStatus = cudaStreamWaitEvent(m_streamWaiter, m_packetEvents[packetIndex], 0);
+    CHK_CUDASTATUS_AND_RETURN(cudaStatus, "cudaStreamWaitEvent");
+
+    PLOG_DBG("ProcessPayload succeed.\n");
+
+    cudaExternalSemaphoreSignalParams signalParams;
+    memset(&signalParams, 0, sizeof(signalParams));
+    signalParams.params.nvSciSync.fence = pPostfence;
+    signalParams.flags = 0;
+    cudaStatus = cudaSignalExternalSemaphoresAsync(&m_signalerSem, &signalParams, 1, m_streamWaiter);
+    CHK_CUDASTATUS_AND_RETURN(cudaStatus, "cudaSignalExternalSemaphoresAsync");
+
+    return NVSIPL_STATUS_OK;
 }
 
 SIPLStatus CCudaConsumer::OnProcessPayloadDone(uint32_t packetIndex)
 {
-    SIPLStatus status = NVSIPL_STATUS_OK;
-
     //dump frames to local file
-    if (m_frameNum <= DUMP_END_FRAME && m_frameNum >= DUMP_START_FRAME) {
-        if (nullptr != m_pHostBuf && m_hostBufLen > 0 && m_pOutputFile != nullptr) {
-            char *buffer = (char *)m_pHostBuf;
-            auto ret = fwrite(buffer, 1, m_hostBufLen, m_pOutputFile);
-            if(ret != m_hostBufLen) {
-                PLOG_ERR("fwrite failed.\n");
-                status = NVSIPL_STATUS_ERROR;
-                goto cleanup;
-            }             
+    uint32_t frameNum = GetFrameNum(packetIndex);
+    if (frameNum <= DUMP_END_FRAME && frameNum >= DUMP_START_FRAME && m_upDumpWriter != nullptr) {
+        if (m_hostBufLens[packetIndex] > 0) {
+            (void)m_upDumpWriter->Submit(packetIndex, m_upHostPool->GetBuffer(packetIndex), m_hostBufLens[packetIndex]);
+        } else {
+            m_upDumpWriter->RecordDrop();
         }
     }
+    m_hostBufLens[packetIndex] = 0U;
 
-cleanup:
-    if(nullptr != m_pHostBuf) {
-        free(m_pHostBuf);
-        m_pHostBuf = nullptr;
-    }
-    m_hostBufLen = 0;
-
-    return status;
+    return NVSIPL_STATUS_OK;
 }
 
 SIPLStatus CCudaConsumer::UnregisterSyncObjs(void)
@@ -9,14 +9,15 @@
 #ifndef CCUDACONSUMER_H
 #define CCUDACONSUMER_H
 
+#include <array>
+
 #include "CConsumer.hpp"
+#include "CCudaStagingAllocator.hpp"
 
 // cuda includes
 #include "cuda_runtime_api.h"
 #include "cuda.h"
 
-#define NUM_PLANES (3U)
-
 class CCudaConsumer: public CConsumer
 {
     public:
@@ -35,40 +36,31 @@ class CCudaConsumer: public CConsumer
         virtual SIPLStatus ProcessPayload(uint32_t packetIndex, NvSciSyncFence *pPostfence) override;
         virtual SIPLStatus OnProcessPayloadDone(uint32_t packetIndex) override;
         virtual SIPLStatus UnregisterSyncObjs(void) override;
-        virtual bool HasCpuWait(void) {return true;};
+        virtual bool HasCpuWait(void) override {return true;}
+        virtual void ResizePackets(uint32_t numPackets) override;
     private:
         SIPLStatus InitCuda(void);
         SIPLStatus BlToPlConvert(uint32_t packetIndex, void *dstptr);
 
-        typedef struct {
-            NvSciBufType bufType;
-            uint64_t size;
-            uint32_t planeCount;
-            NvSciBufAttrValImageLayoutType layout;
-            uint32_t planeWidths[NUM_PLANES];
-            uint32_t planeHeights[NUM_PLANES];
-            uint32_t planePitches[NUM_PLANES];
-            uint32_t planeBitsPerPixels[NUM_PLANES];
-            uint32_t planeAlignedHeights[NUM_PLANES];
-            uint64_t planeAlignedSizes[NUM_PLANES];
-            uint64_t planeOffsets[NUM_PLANES];
-            NvSciBufAttrValColorFmt planeColorFormats[NUM_PLANES];
-            uint8_t planeChannelCounts[NUM_PLANES];
-        } BufferAttrs;
-
         int m_cudaDeviceId = 0;
-        uint8_t *m_pCudaCopyMem[MAX_PACKETS];
-        void  *m_devPtr[MAX_PACKETS];
-        cudaExternalMemory_t m_extMem[MAX_PACKETS];
+        std::vector<void *> m_devPtr;
+        std::vector<cudaExternalMemory_t> m_extMem;
+        // Signals the postfences only, in acquire order, each after its packet's work
         cudaStream_t m_streamWaiter = nullptr;
+        // Prefence wait, conversion and readback of each packet, so frames in flight overlap
+        std::vector<cudaStream_t> m_packetStreams;
+        std::vector<cudaEvent_t> m_packetEvents;
         cudaExternalSemaphore_t m_signalerSem;
         cudaExternalSemaphore_t m_waiterSem;
-        BufferAttrs m_bufAttrs[MAX_PACKETS];
-        cudaMipmappedArray_t m_mipmapArray[MAX_PACKETS][NUM_PLANES];
-        cudaArray_t  m_mipLevelArray[MAX_PACKETS][NUM_PLANES];
+        std::vector<BufferAttrs> m_bufAttrs;
+        std::vector<std::array<cudaMipmappedArray_t, NUM_PLANES>> m_mipmapArray;
+        std::vector<std::array<cudaArray_t, NUM_PLANES>> m_mipLevelArray;
+
+        // Per-packet pitch-linear copies: converted on the device, then read back
+        std::unique_ptr<CStagingPool> m_upDevicePool {nullptr};
+        std::unique_ptr<CStagingPool> m_upHostPool {nullptr};
 
-        FILE *m_pOutputFile = nullptr;
-        uint8_t *m_pHostBuf = nullptr;
-        size_t m_hostBufLen;
+        // Bytes of the host copy per packet, 0 when the dump writer still held the slot
+        std::vector<size_t> m_hostBufLens;
     };
 #endif
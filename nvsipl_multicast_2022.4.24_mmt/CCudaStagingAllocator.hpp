@@ -0,0 +1,60 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CCUDASTAGINGALLOCATOR_HPP
+#define CCUDASTAGINGALLOCATOR_HPP
+
+#include "CStagingPool.hpp"
+
+// cuda includes
+#include "cuda_runtime_api.h"
+
+// Page-locked host memory, the target of async device-to-host copies.
+class CPinnedStagingAllocator : public CStagingAllocator
+{
+public:
+    virtual void *Alloc(size_t size) override
+    {
+        void *ptr = nullptr;
+        if (cudaHostAlloc(&ptr, size, cudaHostAllocDefault) != cudaSuccess) {
+            return nullptr;
+        }
+        return ptr;
+    }
+    virtual void Free(void *ptr) override
+    {
+        (void)cudaFreeHost(ptr);
+    }
+    virtual StagingMemType GetType(void) const override
+    {
+        return StagingMemType::PINNED;
+    }
+};
+
+class CDeviceStagingAllocator : public CStagingAllocator
+{
+public:
+    virtual void *Alloc(size_t size) override
+    {
+        void *ptr = nullptr;
+        if (cudaMalloc(&ptr, size) != cudaSuccess) {
+            return nullptr;
+        }
+        return ptr;
+    }
+    virtual void Free(void *ptr) override
+    {
+        (void)cudaFree(ptr);
+    }
+    virtual StagingMemType GetType(void) const override
+    {
+        return StagingMemType::DEVICE;
+    }
+};
+
+#endif
@@ -0,0 +1,118 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CDecimator.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr double NS_PER_SEC = 1e9;
+// Share of the frame budget the consumer may be busy before the limit is cut
+constexpr double LOAD_HIGH = 0.85;
+// Load a cut aims for
+constexpr double LOAD_TARGET = 0.7;
+// Below this load the limit is raised by RAISE_STEP per adaptation
+constexpr double LOAD_LOW = 0.5;
+constexpr double RAISE_STEP = 1.1;
+constexpr double MIN_FPS_LIMIT = 1.0;
+constexpr uint64_t ADAPT_PERIOD_NS = 500000000U;
+// Weight of the newest sample in the moving averages
+constexpr double AVERAGE_WEIGHT = 0.125;
+
+static double Average(double average, double sample)
+{
+    return (average == 0.0) ? sample : average + AVERAGE_WEIGHT * (sample - average);
+}
+
+void CDecimator::Configure(const std::string &name, const DecimationConfig &config, const MetricLabels &labels)
+{
+    m_name = name;
+    m_config = config;
+    m_fpsLimit = config.maxFps;
+
+    CMetrics &metrics = CMetrics::GetInstance();
+    m_fpsLimitMetric = metrics.Register("nvsipl_consumer_fps_limit_millihertz",
+                                        "Output rate limit of the consumer's decimation, 0 is unlimited",
+                                        MetricType::GAUGE, labels);
+    m_loadMetric = metrics.Register("nvsipl_consumer_load_permille",
+                                    "Time a frame keeps the consumer busy relative to its frame budget",
+                                    MetricType::GAUGE, labels);
+    Publish();
+}
+
+bool CDecimator::ToProcess(uint64_t captureNs)
+{
+    if (m_lastCaptureNs != 0U && captureNs > m_lastCaptureNs) {
+        m_inputPeriodNs = Average(m_inputPeriodNs, (double)(captureNs - m_lastCaptureNs));
+    }
+    m_lastCaptureNs = captureNs;
+
+    if (m_fpsLimit <= 0.0) {
+        return true;
+    }
+
+    uint64_t intervalNs = (uint64_t)(NS_PER_SEC / m_fpsLimit);
+    // Half an input period of slack, so capture jitter does not push the pick to the next frame
+    uint64_t slackNs = (uint64_t)(m_inputPeriodNs / 2.0);
+    if (m_bStarted && captureNs + slackNs < m_nextDueNs) {
+        return false;
+    }
+    // Keep the average rate exact, but do not catch up after a stall
+    m_nextDueNs = (m_bStarted && captureNs < m_nextDueNs + intervalNs) ? m_nextDueNs + intervalNs
+                                                                        : captureNs + intervalNs;
+    m_bStarted = true;
+
+    return true;
+}
+
+void CDecimator::RecordBusyTime(uint64_t captureNs, uint64_t busyNs)
+{
+    m_busyNs = Average(m_busyNs, (double)busyNs);
+    if (captureNs >= m_lastAdaptNs + ADAPT_PERIOD_NS) {
+        Adapt(captureNs);
+    }
+}
+
+void CDecimator::Adapt(uint64_t nowNs)
+{
+    m_lastAdaptNs = nowNs;
+    if (m_inputPeriodNs <= 0.0 || m_busyNs <= 0.0) {
+        return;
+    }
+
+    double inputFps = NS_PER_SEC / m_inputPeriodNs;
+    double ceiling = (m_config.maxFps > 0.0) ? std::min(m_config.maxFps, inputFps) : inputFps;
+    double outputFps = (m_fpsLimit > 0.0) ? std::min(m_fpsLimit, inputFps) : inputFps;
+    m_load = m_busyNs * outputFps / NS_PER_SEC;
+
+    if (m_config.bAdaptive) {
+        double limit = outputFps;
+        if (m_load > LOAD_HIGH) {
+            limit = std::max(LOAD_TARGET * NS_PER_SEC / m_busyNs, MIN_FPS_LIMIT);
+        } else if (m_load < LOAD_LOW && outputFps < ceiling) {
+            limit = std::min(outputFps * RAISE_STEP, ceiling);
+        }
+        if (limit != outputFps) {
+            LOG_INFO("%s: load %.0f%%, output limit %.1f -> %.1f fps\n", m_name.c_str(), m_load * 100.0, outputFps,
+                     limit);
+            // Without a configured rate the limit goes away once it reaches the sensor rate
+            m_fpsLimit = (m_config.maxFps <= 0.0 && limit >= inputFps) ? 0.0 : limit;
+        }
+    }
+    Publish();
+}
+
+void CDecimator::Publish(void)
+{
+    int64_t fpsLimit = (int64_t)std::llround(m_fpsLimit * 1000.0);
+    int64_t load = (int64_t)std::llround(m_load * 1000.0);
+    m_fpsLimitMetric.Add(fpsLimit - m_publishedFpsLimit);
+    m_loadMetric.Add(load - m_publishedLoad);
+    m_publishedFpsLimit = fpsLimit;
+    m_publishedLoad = load;
+}
@@ -0,0 +1,59 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CDECIMATOR_HPP
+#define CDECIMATOR_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "CMetrics.hpp"
+#include "CTopology.hpp"
+
+/* Per-consumer frame decimation.
+ * Frames are picked by capture time, not by count, so the output rate holds
+ * when the sensor rate changes or the queue drops frames. With 'adaptive' the
+ * rate limit follows the consumer's load: when the time a frame keeps the
+ * consumer busy nears the frame budget the limit is cut so the load falls
+ * back to LOAD_TARGET, and it is raised again in small steps once the load is
+ * below LOAD_LOW, up to the configured fps or the sensor rate.
+ * Not thread safe, the consumer serializes the calls. */
+class CDecimator
+{
+public:
+    void Configure(const std::string &name, const DecimationConfig &config, const MetricLabels &labels);
+
+    // Whether to process the frame captured at captureNs.
+    bool ToProcess(uint64_t captureNs);
+    // Time the processed frame kept the consumer busy, from ProcessPayload (or the previous
+    // release while frames are in flight) to its release.
+    void RecordBusyTime(uint64_t captureNs, uint64_t busyNs);
+
+private:
+    void Adapt(uint64_t nowNs);
+    void Publish(void);
+
+    std::string m_name;
+    DecimationConfig m_config {};
+    double m_fpsLimit = 0.0; // 0 processes every frame
+
+    bool m_bStarted = false;
+    uint64_t m_nextDueNs = 0U;
+    uint64_t m_lastCaptureNs = 0U;
+    double m_inputPeriodNs = 0.0; // moving averages
+    double m_busyNs = 0.0;
+    double m_load = 0.0; // busy time per output frame period
+    uint64_t m_lastAdaptNs = 0U;
+
+    CMetric m_fpsLimitMetric;
+    CMetric m_loadMetric;
+    int64_t m_publishedFpsLimit = 0;
+    int64_t m_publishedLoad = 0;
+};
+
+#endif
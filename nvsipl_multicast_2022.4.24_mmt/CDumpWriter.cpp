@@ -0,0 +1,227 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CDumpWriter.hpp"
+#include "CThreadPolicy.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+constexpr std::chrono::milliseconds DUMP_IDLE_WAIT(10);
+
+CDumpWriter::CDumpWriter(uint32_t queueDepth, uint32_t numSlots, uint32_t instance) :
+    m_ring(queueDepth),
+    m_numSlots(numSlots),
+    m_instance(instance),
+    m_upSlotBusy(new std::atomic<bool>[numSlots])
+{
+    for (uint32_t i = 0U; i < numSlots; i++) {
+        m_upSlotBusy[i].store(false, std::memory_order_relaxed);
+    }
+    m_dropMetric = CMetrics::GetInstance().Register("nvsipl_dump_dropped_frames_total",
+                                                    "Frames not dumped because the writer was behind",
+                                                    MetricType::COUNTER, { { "sensor", std::to_string(instance) } });
+}
+
+CDumpWriter::~CDumpWriter(void)
+{
+    Close();
+}
+
+bool CDumpWriter::Open(const std::string &path, bool bDirectIo)
+{
+    if (m_fd >= 0) {
+        return false;
+    }
+
+    m_bDirectIo = false;
+    if (bDirectIo) {
+        m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        if (m_fd >= 0) {
+            void *pBounce = nullptr;
+            if (posix_memalign(&pBounce, DUMP_IO_ALIGNMENT, DUMP_BOUNCE_SIZE) != 0) {
+                close(m_fd);
+                return false;
+            }
+            m_pBounce = static_cast<uint8_t *>(pBounce);
+            m_bounceLen = 0U;
+            m_bDirectIo = true;
+        }
+    }
+    if (m_fd < 0) {
+        m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (m_fd < 0) {
+            return false;
+        }
+    }
+
+    m_bQuit.store(false, std::memory_order_release);
+    m_ioThread = std::thread(&CDumpWriter::IoThreadFunc, this);
+    return true;
+}
+
+void CDumpWriter::Close(void)
+{
+    if (m_ioThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bQuit.store(true, std::memory_order_release);
+        }
+        m_cond.notify_one();
+        m_ioThread.join();
+    }
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+    if (m_pBounce != nullptr) {
+        free(m_pBounce);
+        m_pBounce = nullptr;
+    }
+}
+
+bool CDumpWriter::IsSlotBusy(uint32_t slot) const
+{
+    return (slot < m_numSlots) && m_upSlotBusy[slot].load(std::memory_order_acquire);
+}
+
+bool CDumpWriter::Submit(uint32_t slot, const uint8_t *pData, size_t size)
+{
+    if (m_fd < 0 || slot >= m_numSlots || pData == nullptr || size == 0U ||
+        m_upSlotBusy[slot].load(std::memory_order_acquire)) {
+        RecordDrop();
+        return false;
+    }
+
+    m_upSlotBusy[slot].store(true, std::memory_order_relaxed);
+    if (!m_ring.Push(DumpRequest{ slot, pData, size, nullptr, nullptr, 0U })) {
+        m_upSlotBusy[slot].store(false, std::memory_order_relaxed);
+        RecordDrop();
+        return false;
+    }
+    m_cond.notify_one();
+
+    return true;
+}
+
+bool CDumpWriter::SubmitRef(const uint8_t *pData, size_t size, DumpDoneFunc pfnDone, void *pContext, uint32_t tag)
+{
+    if (m_fd < 0 || pData == nullptr || size == 0U ||
+        !m_ring.Push(DumpRequest{ DUMP_NO_SLOT, pData, size, pfnDone, pContext, tag })) {
+        RecordDrop();
+        return false;
+    }
+    m_cond.notify_one();
+
+    return true;
+}
+
+void CDumpWriter::IoThreadFunc(void)
+{
+    CThreadPolicy::GetInstance().Apply(ThreadRole::DUMP_WRITER, m_instance, "DumpWriter");
+
+    DumpRequest request;
+    while (true) {
+        if (m_ring.Pop(request)) {
+            if (WriteRequest(request)) {
+                m_writtenFrames.fetch_add(1U, std::memory_order_relaxed);
+                m_writtenBytes.fetch_add(request.size, std::memory_order_relaxed);
+            } else {
+                m_writeErrors.fetch_add(1U, std::memory_order_relaxed);
+            }
+            // The buffer may be refilled from now on
+            if (request.slot < m_numSlots) {
+                m_upSlotBusy[request.slot].store(false, std::memory_order_release);
+            }
+            if (request.pfnDone != nullptr) {
+                request.pfnDone(request.pContext, request.tag);
+            }
+            continue;
+        }
+        if (m_bQuit.load(std::memory_order_acquire)) {
+            break;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait_for(lock, DUMP_IDLE_WAIT, [this] {
+            return m_bQuit.load(std::memory_order_acquire) || m_ring.GetSize() > 0U;
+        });
+    }
+
+    if (m_bDirectIo && !FlushBounce(true)) {
+        m_writeErrors.fetch_add(1U, std::memory_order_relaxed);
+    }
+}
+
+bool CDumpWriter::WriteRequest(const DumpRequest &request)
+{
+    if (!m_bDirectIo) {
+        return WriteAll(request.pData, request.size);
+    }
+
+    const uint8_t *pData = request.pData;
+    size_t remaining = request.size;
+    while (remaining > 0U) {
+        size_t chunk = DUMP_BOUNCE_SIZE - m_bounceLen;
+        if (chunk > remaining) {
+            chunk = remaining;
+        }
+        memcpy(m_pBounce + m_bounceLen, pData, chunk);
+        m_bounceLen += chunk;
+        pData += chunk;
+        remaining -= chunk;
+        if (m_bounceLen == DUMP_BOUNCE_SIZE && !FlushBounce(false)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CDumpWriter::WriteAll(const uint8_t *pData, size_t size)
+{
+    while (size > 0U) {
+        ssize_t ret = write(m_fd, pData, size);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        pData += ret;
+        size -= (size_t)ret;
+    }
+    return true;
+}
+
+// Writes the aligned part of the bounce buffer. On the final flush the
+// unaligned tail is written with O_DIRECT cleared.
+bool CDumpWriter::FlushBounce(bool bFinal)
+{
+    size_t aligned = m_bounceLen & ~((size_t)DUMP_IO_ALIGNMENT - 1U);
+    if (aligned > 0U) {
+        if (!WriteAll(m_pBounce, aligned)) {
+            return false;
+        }
+        memmove(m_pBounce, m_pBounce + aligned, m_bounceLen - aligned);
+        m_bounceLen -= aligned;
+    }
+    if (bFinal && m_bounceLen > 0U) {
+        int flags = fcntl(m_fd, F_GETFL);
+        if (flags < 0 || fcntl(m_fd, F_SETFL, flags & ~O_DIRECT) < 0) {
+            return false;
+        }
+        if (!WriteAll(m_pBounce, m_bounceLen)) {
+            return false;
+        }
+        m_bounceLen = 0U;
+    }
+    return true;
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CDUMPWRITER_HPP
+#define CDUMPWRITER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "CMetrics.hpp"
+#include "CSpscRing.hpp"
+
+constexpr uint32_t DUMP_IO_ALIGNMENT = 4096U;
+constexpr size_t DUMP_BOUNCE_SIZE = 4U * 1024U * 1024U;
+
+constexpr uint32_t DUMP_NO_SLOT = UINT32_MAX;
+
+// Runs on the I/O thread once a referenced buffer is no longer needed.
+typedef void (*DumpDoneFunc)(void *pContext, uint32_t tag);
+
+typedef struct {
+    uint32_t slot;
+    const uint8_t *pData;
+    size_t size;
+    DumpDoneFunc pfnDone;
+    void *pContext;
+    uint32_t tag;
+} DumpRequest;
+
+/* Writes frame dumps from a dedicated I/O thread.
+ * The consumer thread only enqueues a reference to a filled buffer. Either the
+ * buffer belongs to a slot (one per packet) and must not be refilled while
+ * IsSlotBusy() reports it is still queued, or the caller keeps it alive until
+ * the done callback runs. Requests beyond the queue depth, or on a busy slot,
+ * are dropped and counted. */
+class CDumpWriter
+{
+public:
+    // instance selects the thread policy rule of the I/O thread, the sensor id
+    CDumpWriter(uint32_t queueDepth, uint32_t numSlots, uint32_t instance);
+    ~CDumpWriter(void);
+
+    CDumpWriter(const CDumpWriter &) = delete;
+    CDumpWriter &operator=(const CDumpWriter &) = delete;
+
+    // Opens the file and starts the I/O thread. O_DIRECT is dropped when the
+    // file system rejects it.
+    bool Open(const std::string &path, bool bDirectIo = true);
+    // Drains the queue, stops the I/O thread and closes the file.
+    void Close(void);
+
+    // Consumer thread API
+    bool Submit(uint32_t slot, const uint8_t *pData, size_t size);
+    // pfnDone is not called when the request is dropped.
+    bool SubmitRef(const uint8_t *pData, size_t size, DumpDoneFunc pfnDone, void *pContext, uint32_t tag);
+    bool IsSlotBusy(uint32_t slot) const;
+    // Buffers the writer may reference at once, the queue plus the one being written
+    uint32_t GetMaxHeld(void) const
+    {
+        return m_ring.GetCapacity() + 1U;
+    }
+    void RecordDrop(void)
+    {
+        m_droppedFrames.fetch_add(1U, std::memory_order_relaxed);
+        m_dropMetric.Inc();
+    }
+
+    uint64_t GetWrittenFrames(void) const
+    {
+        return m_writtenFrames.load(std::memory_order_relaxed);
+    }
+    uint64_t GetWrittenBytes(void) const
+    {
+        return m_writtenBytes.load(std::memory_order_relaxed);
+    }
+    uint64_t GetDroppedFrames(void) const
+    {
+        return m_droppedFrames.load(std::memory_order_relaxed);
+    }
+    uint64_t GetWriteErrors(void) const
+    {
+        return m_writeErrors.load(std::memory_order_relaxed);
+    }
+
+private:
+    void IoThreadFunc(void);
+    bool WriteRequest(const DumpRequest &request);
+    bool WriteAll(const uint8_t *pData, size_t size);
+    bool FlushBounce(bool bFinal);
+
+    CSpscRing<DumpRequest> m_ring;
+    uint32_t m_numSlots;
+    uint32_t m_instance;
+    std::unique_ptr<std::atomic<bool>[]> m_upSlotBusy;
+
+    int m_fd = -1;
+    bool m_bDirectIo = false;
+    // O_DIRECT needs aligned buffers, sizes and offsets, frames are packed here
+    uint8_t *m_pBounce = nullptr;
+    size_t m_bounceLen = 0U;
+
+    std::thread m_ioThread;
+    std::atomic<bool> m_bQuit {false};
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+
+    std::atomic<uint64_t> m_writtenFrames {0U};
+    std::atomic<uint64_t> m_writtenBytes {0U};
+    std::atomic<uint64_t> m_droppedFrames {0U};
+    std::atomic<uint64_t> m_writeErrors {0U};
+    CMetric m_dropMetric;
+};
+
+#endif
@@ -10,6 +10,58 @@
 #include "nvmedia_image_nvscibuf.h"
 #include "nvmedia_iep_nvscisync.h"
 
+#include <algorithm>
+
+// Pulls encoded bits out of an NvMedia IEP instance.
+class CIepEncoderOutput : public CEncoderOutput
+{
+public:
+    explicit CIepEncoderOutput(NvMediaIEP *pNvMIEP) : m_pNvMIEP(pNvMIEP) {}
+
+    virtual BitsStatus BitsAvailable(size_t &numBytes) override
+    {
+        uint32_t uNumBytesAvailable = 0U;
+        auto nvmStatus = NvMediaIEPBitsAvailable(m_pNvMIEP,
+                                                 &uNumBytesAvailable,
+                                                 NVMEDIA_ENCODE_BLOCKING_TYPE_NEVER,
+                                                 0U); // CBitstreamRing::ReadFrame() waits, bounded
+        switch (nvmStatus) {
+            case NVMEDIA_STATUS_OK:
+                numBytes = uNumBytesAvailable;
+                return BitsStatus::OK;
+            case NVMEDIA_STATUS_PENDING:
+                return BitsStatus::PENDING;
+            case NVMEDIA_STATUS_NONE_PENDING:
+                LOG_ERR("Error - no encoded data is pending\n");
+                return BitsStatus::ERROR;
+            default:
+                LOG_ERR("Error occured\n");
+                return BitsStatus::ERROR;
+        }
+    }
+
+    virtual BitsStatus GetBits(uint8_t *pDst, size_t numBytes) override
+    {
+        NvMediaBitstreamBuffer bitstreams = {0};
+        uint32_t uNumBytes = 0U;
+        bitstreams.bitstream = pDst;
+        bitstreams.bitstreamSize = (uint32_t)numBytes;
+        auto nvmStatus = NvMediaIEPGetBitsEx(m_pNvMIEP, &uNumBytes, 1U, &bitstreams, nullptr);
+        if (nvmStatus != NVMEDIA_STATUS_OK && nvmStatus != NVMEDIA_STATUS_NONE_PENDING) {
+            LOG_ERR("Error getting encoded bits\n");
+            return BitsStatus::ERROR;
+        }
+        if (uNumBytes != numBytes) {
+            LOG_ERR("Error-byte counts do not match %u vs. %u\n", (uint32_t)numBytes, uNumBytes);
+            return BitsStatus::ERROR;
+        }
+        return BitsStatus::OK;
+    }
+
+private:
+    NvMediaIEP *m_pNvMIEP;
+};
+
 CEncConsumer::CEncConsumer(NvSciStreamBlock handle,
                                uint32_t uSensor,
                                NvSciStreamBlock queueHandle,
@@ -20,9 +72,6 @@ CEncConsumer::CEncConsumer(NvSciStreamBlock handle,
     m_encodeWidth = encodeWidth;
     m_encodeHeight = encodeHeight;
 
-    m_encodedBytes = 0;
-    m_pEncodedBuf = nullptr;
-
     NVM_SURF_FMT_DEFINE_ATTR(surfFormatAttrs_input);
     NVM_SURF_FMT_SET_ATTR_YUV(surfFormatAttrs_input, YUV, 420, SEMI_PLANAR, UINT, 8, BL);
     m_surfaceType = NvMediaSurfaceFormatGetType(surfFormatAttrs_input, NVM_SURF_FMT_ATTR_MAX);
@@ -36,9 +85,19 @@ SIPLStatus CEncConsumer::HandleClientInit(void)
     auto status = InitEncoder();
     PCHK_STATUS_AND_RETURN(status, "InitEncoder");
 
-    // string fileName = "multicast_enc" + to_string(m_uSensorId) + ".h264";
-    // m_pOutputFile = fopen(fileName.c_str(), "ab");
-    // PCHK_PTR_AND_RETURN(m_pOutputFile, "Open encoder output file");
+    status = CreateDumpWriter("multicast_enc" + std::to_string(m_uSensorId) + ".h264", 0U);
+    PCHK_STATUS_AND_RETURN(status, "Open encoder output file");
+
+    // Room for the frame being read plus every frame the dump writer may still hold,
+    // each at the largest size the encoder configuration allows
+    const uint32_t numFrames = 1U + ((m_upDumpWriter != nullptr) ? m_upDumpWriter->GetMaxHeld() : 0U);
+    const size_t ringSize = numFrames * GetMaxFrameBytes();
+    m_upBitstreamRing = std::make_unique<CBitstreamRing>(ringSize);
+    if (m_upBitstreamRing->GetCapacity() == 0U) {
+        PLOG_ERR("Bitstream ring allocation failed, size: %zu\n", ringSize);
+        return NVSIPL_STATUS_OUT_OF_MEMORY;
+    }
+    PLOG_DBG("Bitstream ring: %zu bytes for %u frames\n", ringSize, numFrames);
 
     return NVSIPL_STATUS_OK;
 }
@@ -101,27 +160,42 @@ SIPLStatus CEncConsumer::InitEncoder(void)
                                    &encoderInitParams,	 // init params
                                    m_surfaceType, // surfaceType
                                    0, // maxInputBuffering
-                                   0, // maxOutputBuffering
+                                   MAX_INFLIGHT, // maxOutputBuffering, frames fed before their bits are read
                                    NVMEDIA_ENCODER_INSTANCE_0)); // encoder instance
     PCHK_PTR_AND_RETURN(m_pNvMIEP, "NvMediaImageEncoderCreate");
 
     auto status = SetEncodeConfig();
-    return status;
+    PCHK_STATUS_AND_RETURN(status, "SetEncodeConfig");
+
+    m_upEncOutput = std::make_unique<CIepEncoderOutput>(m_pNvMIEP.get());
+
+    return NVSIPL_STATUS_OK;
+}
+
+size_t CEncConsumer::GetMaxFrameBytes(void) const
+{
+    size_t maxBytes = H264MaxFrameBytes(m_encodeWidth, m_encodeHeight);
+    // A CBR encoder keeps every frame within its VBV buffer, given in bits
+    const NvMediaEncodeRCParams &rcParams = m_stEncodeConfigH264Params.rcParams;
+    if (rcParams.rateControlMode == NVMEDIA_ENCODE_PARAMS_RC_CBR && rcParams.params.cbr.vbvBufferSize != 0U) {
+        maxBytes = std::min<size_t>(maxBytes, rcParams.params.cbr.vbvBufferSize / 8U + H264_MAX_HEADER_BYTES);
+    }
+    return maxBytes;
 }
 
 CEncConsumer::~CEncConsumer(void)
 {
     LOG_DBG("CEncConsumer release.\n");
 
-    for (auto i = 0U; i < MAX_PACKETS; i++) {
-        if (m_images[i] == nullptr) {
+    for (auto pImage : m_images) {
+        if (pImage == nullptr) {
             continue;
         }
-        auto nvmStatus = NvMediaIEPImageUnRegister(m_pNvMIEP.get(), m_images[i]);
+        auto nvmStatus = NvMediaIEPImageUnRegister(m_pNvMIEP.get(), pImage);
         if(nvmStatus != NVMEDIA_STATUS_OK) {
             PLOG_WARN("NvMediaIEPImageUnRegister failed: 0x%x\n", nvmStatus);
         }
-        NvMediaImageDestroy(m_images[i]);
+        NvMediaImageDestroy(pImage);
     }
 
     if(m_stEncodeConfigH264Params.h264VUIParameters) {
@@ -129,10 +203,7 @@ CEncConsumer::~CEncConsumer(void)
         m_stEncodeConfigH264Params.h264VUIParameters = nullptr;
     }
 
-    if (m_pOutputFile != nullptr) {
-        fflush(m_pOutputFile);
-        fclose(m_pOutputFile);
-    }
+    CloseDumpWriter();
 }
 
 // Buffer setup functions
@@ -165,6 +236,13 @@ SIPLStatus CEncConsumer::SetSyncAttrList(void)
     return NVSIPL_STATUS_OK;
 }
 
+void CEncConsumer::ResizePackets(uint32_t numPackets)
+{
+    CConsumer::ResizePackets(numPackets);
+    m_images.resize(numPackets, nullptr);
+    m_bitsPending.resize(numPackets, 0U);
+}
+
 SIPLStatus CEncConsumer::MapDataBuffer(uint32_t packetIndex)
 {
     NvMediaStatus nvmStatus =
@@ -222,12 +300,9 @@ SIPLStatus CEncConsumer::SetEofSyncObj(void)
     return NVSIPL_STATUS_OK;
 }
 
-SIPLStatus CEncConsumer::EncodeOneFrame(NvMediaImage *pNvMediaImage, uint8_t **ppOutputBuffer, size_t *pNumBytes, NvSciSyncFence *pPostfence)
+SIPLStatus CEncConsumer::EncodeOneFrame(uint32_t packetIndex, NvSciSyncFence *pPostfence)
 {
     NvMediaEncodePicParamsH264 encodePicParams;
-    uint32_t uNumBytes = 0U;
-    uint32_t uNumBytesAvailable = 0U;
-    uint8_t *pBuffer = nullptr;
 
     //set one frame params, default = 0
     memset(&encodePicParams, 0, sizeof(NvMediaEncodePicParamsH264));
@@ -236,71 +311,17 @@ SIPLStatus CEncConsumer::EncodeOneFrame(NvMediaImage *pNvMediaImage, uint8_t **p
     encodePicParams.encodePicFlags = NVMEDIA_ENCODE_PIC_FLAG_OUTPUT_SPSPPS;
     encodePicParams.nextBFrames    = 0;
     auto nvmStatus = NvMediaIEPFeedFrame(m_pNvMIEP.get(),     // *encoder
-                                 pNvMediaImage,               // *frame
+                                 m_images[packetIndex],       // *frame
                                  nullptr,                     // *sourceRect
                                  &encodePicParams,            // encoder parameter
                                  NVMEDIA_ENCODER_INSTANCE_0); // encoder instance
     PCHK_NVMSTATUS_AND_RETURN(nvmStatus, "NvMediaIEPFeedFrame");
+    // From here on the encoder produces bits for the packet, even if the EOF fence fails
+    m_bitsPending[packetIndex] = 1U;
 
     nvmStatus = NvMediaIEPGetEOFNvSciSyncFence(m_pNvMIEP.get(), m_signalSyncObj, pPostfence);
     PCHK_NVMSTATUS_AND_RETURN(nvmStatus, ": NvMediaIEPGetEOFNvSciSyncFence");
 
-    bool bEncodeFrameDone = false;
-    while(!bEncodeFrameDone) {
-        NvMediaBitstreamBuffer bitstreams = {0};
-        uNumBytesAvailable = 0U;
-        uNumBytes = 0U;
-        nvmStatus = NvMediaIEPBitsAvailable(m_pNvMIEP.get(),
-                                         &uNumBytesAvailable,
-                                         NVMEDIA_ENCODE_BLOCKING_TYPE_IF_PENDING,
-                                         NVMEDIA_VIDEO_ENCODER_TIMEOUT_INFINITE);
-        switch(nvmStatus) {
-            case NVMEDIA_STATUS_OK:
-                pBuffer = new (std::nothrow) uint8_t[uNumBytesAvailable];
-                if (pBuffer == nullptr) {
-                    PLOG_ERR("Out of memory\n");
-                    return NVSIPL_STATUS_OUT_OF_MEMORY;
-                }
-
-                bitstreams.bitstream = pBuffer;
-                bitstreams.bitstreamSize = uNumBytesAvailable;
-                std::fill(pBuffer, pBuffer + uNumBytesAvailable, 0xE5);
-                nvmStatus = NvMediaIEPGetBitsEx(m_pNvMIEP.get(),
-                                             &uNumBytes,
-                                             1U,
-                                             &bitstreams,
-                                             nullptr);
-                if(nvmStatus != NVMEDIA_STATUS_OK && nvmStatus != NVMEDIA_STATUS_NONE_PENDING) {
-                    PLOG_ERR("Error getting encoded bits\n");
-                    free(pBuffer);
-                    return NVSIPL_STATUS_ERROR;
-                }
-
-                if(uNumBytes != uNumBytesAvailable) {
-                    PLOG_ERR("Error-byte counts do not match %d vs. %d\n",
-                            uNumBytesAvailable, uNumBytes);
-                    free(pBuffer);
-                    return NVSIPL_STATUS_ERROR;
-                }
-                *ppOutputBuffer = pBuffer;
-                *pNumBytes = (size_t)uNumBytesAvailable;
-                bEncodeFrameDone = 1;
-                break;
-
-            case NVMEDIA_STATUS_PENDING:
-                PLOG_DBG("Status - pending\n");
-                break;
-
-            case NVMEDIA_STATUS_NONE_PENDING:
-                PLOG_ERR("Error - no encoded data is pending\n");
-                return NVSIPL_STATUS_ERROR;
-
-            default:
-                PLOG_ERR("Error occured\n");
-                return NVSIPL_STATUS_ERROR;
-        }
-    }
-
     return NVSIPL_STATUS_OK;
 }
 
@@ -309,45 +330,71 @@ SIPLStatus CEncConsumer::ProcessPayload(uint32_t packetIndex, NvSciSyncFence *pP
 {
     PLOG_DBG("Process payload (packetIndex = 0x%x).\n", packetIndex);
 
-    auto status = EncodeOneFrame(m_images[packetIndex], &m_pEncodedBuf, &m_encodedBytes, pPostfence);
+    if (m_bBitsLost.load(std::memory_order_relaxed)) {
+        PLOG_ERR("Not encoding packet %u, the encoder output lost track of the frames\n", packetIndex);
+        return NVSIPL_STATUS_ERROR;
+    }
+    auto status = EncodeOneFrame(packetIndex, pPostfence);
     PCHK_STATUS_AND_RETURN(status, "ProcessPayload");
 
     return NVSIPL_STATUS_OK;
 }
 
-bool CEncConsumer::ToSkipFrame(uint32_t frameNum)
+/* Runs once the EOF fence signaled, in feed order, so the bits at the head of
+ * the encoder output belong to this packet and are drained without blocking. */
+SIPLStatus CEncConsumer::OnProcessPayloadDone(uint32_t packetIndex)
 {
-    if (frameNum % 2U != 0) {
-        return true;
+    m_bitsPending[packetIndex] = 0U;
+    if (m_bBitsLost.load(std::memory_order_relaxed)) {
+        PLOG_ERR("Not reading packet %u, the encoder output lost track of the frames\n", packetIndex);
+        return NVSIPL_STATUS_ERROR;
+    }
+    BitstreamSpan span {};
+    auto bitsStatus = m_upBitstreamRing->ReadFrame(*m_upEncOutput, span);
+    if (bitsStatus != BitsStatus::OK) {
+        // Bits that arrive later would be taken for the next frame's
+        m_bBitsLost.store(true, std::memory_order_relaxed);
+        PLOG_ERR("Failed to read the encoded frame%s\n",
+                 (bitsStatus == BitsStatus::PENDING) ? ", no bits within the timeout" : "");
+        return NVSIPL_STATUS_ERROR;
     }
 
-    return false;
-}
-
-SIPLStatus CEncConsumer::OnProcessPayloadDone(uint32_t packetIndex)
-{
-    SIPLStatus status = NVSIPL_STATUS_OK;
-
-    //dump frames to local file
-    if (m_frameNum <= DUMP_END_FRAME && m_frameNum >= DUMP_START_FRAME) {
-        if (m_pOutputFile && m_pEncodedBuf && m_encodedBytes > 0) {
-            if(fwrite(m_pEncodedBuf, m_encodedBytes, 1, m_pOutputFile) != 1) {
-                PLOG_ERR("Error writing %d bytes\n", m_encodedBytes);
-                status = NVSIPL_STATUS_ERROR;
-                goto cleanup;
-            }
-            PLOG_DBG("writing %u bytes, m_frameNum %u\n", m_encodedBytes, m_frameNum);
-            fflush(m_pOutputFile);
+    //dump frames to local file, the writer holds its own reference to the span
+    uint32_t frameNum = GetFrameNum(packetIndex);
+    if (frameNum <= DUMP_END_FRAME && frameNum >= DUMP_START_FRAME && m_upDumpWriter != nullptr) {
+        CBitstreamRing::AddRef(span);
+        if (m_upDumpWriter->SubmitRef(span.pData, span.size, &CBitstreamRing::OnSinkDone, span.pRing, span.entry)) {
+            PLOG_DBG("queued %zu bytes, frameNum %u\n", span.size, frameNum);
+        } else {
+            CBitstreamRing::Release(span);
         }
     }
     PLOG_DBG("ProcessPayload succ.\n");
 
-cleanup:
-    if (m_pEncodedBuf) {
-        free(m_pEncodedBuf);
-        m_pEncodedBuf = nullptr;
-    }
-    m_encodedBytes = 0;
+    CBitstreamRing::Release(span);
 
-    return status;
+    return NVSIPL_STATUS_OK;
+}
+
+/* The EOF fence timed out or failed, or the feed went wrong after the frame was
+ * queued. The encoder still emits the frame's bits once it is done with it, in
+ * feed order ahead of the next frame's, so they are waited for and dropped
+ * here. Without them nothing is read or fed any more, the stream fails. */
+void CEncConsumer::OnProcessPayloadFailed(uint32_t packetIndex)
+{
+    if (m_bitsPending[packetIndex] == 0U || m_bBitsLost.load(std::memory_order_relaxed)) {
+        return;
+    }
+    m_bitsPending[packetIndex] = 0U;
+
+    BitstreamSpan span {};
+    auto bitsStatus = m_upBitstreamRing->ReadFrame(*m_upEncOutput, span);
+    if (bitsStatus != BitsStatus::OK) {
+        m_bBitsLost.store(true, std::memory_order_relaxed);
+        PLOG_ERR("Failed to discard the bits of packet %u%s, encoding stops\n", packetIndex,
+                 (bitsStatus == BitsStatus::PENDING) ? ", the encoder is still busy" : "");
+        return;
+    }
+    PLOG_WARN("Discarded %zu encoded bytes of failed packet %u\n", span.size, packetIndex);
+    CBitstreamRing::Release(span);
 }
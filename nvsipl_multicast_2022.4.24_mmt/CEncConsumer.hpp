@@ -9,7 +9,10 @@
 #ifndef CENCCONSUMER_H
 #define CENCCONSUMER_H
 
+#include <atomic>
+
 #include "CConsumer.hpp"
+#include "CBitstreamRing.hpp"
 #include "NvSIPLClient.hpp"
 #include "nvmedia_iep.h"
 #include "NvSIPLDeviceBlockInfo.hpp"
@@ -36,9 +39,11 @@ class CEncConsumer: public CConsumer
         virtual SIPLStatus SetEofSyncObj(void) override;
         virtual SIPLStatus ProcessPayload(uint32_t packetIndex, NvSciSyncFence *pPostfence) override;
         virtual SIPLStatus UnregisterSyncObjs(void) override;
-        virtual bool ToSkipFrame(uint32_t frameNum) override;
         virtual SIPLStatus OnProcessPayloadDone(uint32_t packetIndex) override;
-        virtual bool HasCpuWait(void) {return true;};
+        // Discards the failed frame's bits, so the next frame does not read them
+        virtual void OnProcessPayloadFailed(uint32_t packetIndex) override;
+        virtual bool HasCpuWait(void) override {return true;}
+        virtual void ResizePackets(uint32_t numPackets) override;
 
     private:
         struct DestroyNvMediaImage
@@ -57,21 +62,25 @@ class CEncConsumer: public CConsumer
         };
 
         SIPLStatus InitEncoder(void);
-        SIPLStatus EncodeOneFrame(NvMediaImage *pNvMediaImage,
-                                       uint8_t **ppOutputBuffer,
-                                       size_t *pNumBytes,
-                                       NvSciSyncFence *pPostfence);
+        // Feeds the packet and returns its EOF fence, the bits are read in OnProcessPayloadDone()
+        SIPLStatus EncodeOneFrame(uint32_t packetIndex, NvSciSyncFence *pPostfence);
         SIPLStatus SetEncodeConfig(void);
+        // Largest encoded frame the configuration allows, sizes the bitstream ring
+        size_t GetMaxFrameBytes(void) const;
 
         std::unique_ptr<NvMediaDevice, CloseNvMediaDevice> m_pDevice {nullptr};
         std::unique_ptr<NvMediaIEP, DestroyNvMediaIEP> m_pNvMIEP {nullptr};
-        NvMediaImage* m_images[MAX_PACKETS];
-        FILE *m_pOutputFile = nullptr;
+        std::vector<NvMediaImage*> m_images;
         NvMediaEncodeConfigH264 m_stEncodeConfigH264Params;
         NvMediaSurfaceType m_surfaceType;
         uint16_t m_encodeWidth;
         uint16_t m_encodeHeight;
-        uint8_t *m_pEncodedBuf = nullptr;
-        size_t m_encodedBytes;
+        std::unique_ptr<CEncoderOutput> m_upEncOutput {nullptr};
+        // Filled in release order, by whichever thread runs OnProcessPayloadDone()
+        std::unique_ptr<CBitstreamRing> m_upBitstreamRing {nullptr};
+        // 1 from a successful feed until the packet's bits are read or discarded, per packet
+        std::vector<uint8_t> m_bitsPending;
+        // Bits could not be read or discarded, the output no longer lines up with the packets
+        std::atomic<bool> m_bBitsLost {false};
     };
 #endif
@@ -10,8 +10,12 @@
 #define CEVENTHANDLER_H
 
 #include "nvscistream.h"
+#include <atomic>
+#include <chrono>
 #include <cstring>
 
+#include "CEventReactor.hpp"
+
 enum EventStatus
 {
     EVENT_STATUS_OK = 0,
@@ -29,7 +33,12 @@ public:
        m_handle = handle;
        m_uSensorId = uSensor;
     }
-    ~CEventHandler(void) {};
+    ~CEventHandler(void)
+    {
+        if (m_pEventNotifier != nullptr) {
+            m_pEventNotifier->Delete(m_pEventNotifier);
+        }
+    };
 
     virtual EventStatus HandleEvents(void) = 0;
 
@@ -43,10 +52,79 @@ public:
         return m_name;
     }
 
+    void SetEventNotifier(CEventReactor *pReactor, NvSciEventNotifier *pNotifier)
+    {
+        m_pReactor = pReactor;
+        m_pEventNotifier = pNotifier;
+    }
+
+    NvSciEventNotifier *GetEventNotifier(void)
+    {
+        return m_pEventNotifier;
+    }
+
+    // Set by CEventReactor::Register()
+    void SetEventLoop(uint32_t loopId)
+    {
+        m_eventLoopId.store(loopId, std::memory_order_relaxed);
+    }
+
+    /* Has the event loop call HandleEvents() again although the notifier did
+     * not fire, for work the handler put off. Callable from any thread. */
+    void Rearm(void)
+    {
+        m_bRearmed.store(true, std::memory_order_release);
+        if (m_pReactor != nullptr) {
+            m_pReactor->WakeLoop(m_eventLoopId.load(std::memory_order_relaxed));
+        }
+    }
+
+    // Clears the request, true if there was one
+    bool TakeRearm(void)
+    {
+        return m_bRearmed.exchange(false, std::memory_order_acq_rel);
+    }
+
+    /* Queries the next block event. Once the block uses the event service the
+     * query itself must not block, so the wait happens on the block's notifier. */
+    NvSciError QueryEvent(int64_t timeoutUs, NvSciStreamEventType *pEvent)
+    {
+        if (m_pReactor == nullptr) {
+            return NvSciStreamBlockEventQuery(m_handle, timeoutUs, pEvent);
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(timeoutUs);
+        while (true) {
+            auto sciErr = NvSciStreamBlockEventQuery(m_handle, 0, pEvent);
+            if (sciErr != NvSciError_Timeout || timeoutUs == 0) {
+                return sciErr;
+            }
+
+            int64_t waitUs = timeoutUs;
+            if (timeoutUs > 0) {
+                waitUs = std::chrono::duration_cast<std::chrono::microseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+                if (waitUs <= 0) {
+                    return NvSciError_Timeout;
+                }
+            }
+            // The notifier may still be set from events drained earlier, so query again
+            bool bNewEvent = false;
+            sciErr = m_pReactor->Wait(&m_pEventNotifier, 1U, waitUs, &bNewEvent);
+            if (sciErr != NvSciError_Success) {
+                return sciErr;
+            }
+        }
+    }
+
 protected:
     uint32_t m_uSensorId;
     NvSciStreamBlock m_handle = 0U;
     std::string m_name;
+    CEventReactor *m_pReactor = nullptr;
+    NvSciEventNotifier *m_pEventNotifier = nullptr;
+    std::atomic<uint32_t> m_eventLoopId {0U};
+    std::atomic<bool> m_bRearmed {false};
 };
 
 #endif
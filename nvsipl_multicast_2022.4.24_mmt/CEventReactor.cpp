@@ -0,0 +1,308 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CEventReactor.hpp"
+#include "CEventHandler.hpp"
+#include "Common.hpp"
+#include "CThreadPolicy.hpp"
+
+#include <string>
+
+// Handles events until the block has none left. A notifier fires once for
+// any number of queued events.
+static EventStatus DrainEvents(CEventHandler *pHandler)
+{
+    EventStatus status;
+    do {
+        status = pHandler->HandleEvents();
+    } while (status == EVENT_STATUS_OK);
+
+    return status;
+}
+
+CEventReactor::~CEventReactor(void)
+{
+    Stop();
+    for (auto &upLoop : m_vupLoops) {
+        if (upLoop->pWakeEvent != nullptr) {
+            upLoop->pWakeEvent->Delete(upLoop->pWakeEvent);
+        }
+    }
+    m_vupLoops.clear();
+    if (m_pLoopService != nullptr) {
+        m_pLoopService->EventService.Delete(&m_pLoopService->EventService);
+        m_pLoopService = nullptr;
+    }
+}
+
+SIPLStatus CEventReactor::Init(uint32_t numLoops)
+{
+    if (numLoops == 0U) {
+        LOG_ERR("EventReactor: at least one event loop is needed\n");
+        return NVSIPL_STATUS_BAD_ARGUMENT;
+    }
+
+    auto sciErr = NvSciEventLoopServiceCreate(numLoops, &m_pLoopService);
+    CHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciEventLoopServiceCreate");
+
+    for (uint32_t i = 0U; i < numLoops; i++) {
+        std::unique_ptr<EventLoop> upLoop(new EventLoop());
+        upLoop->id = i;
+        upLoop->bDirty = true;
+        sciErr = m_pLoopService->EventService.CreateLocalEvent(&m_pLoopService->EventService, &upLoop->pWakeEvent);
+        CHK_NVSCISTATUS_AND_RETURN(sciErr, "CreateLocalEvent");
+        m_vupLoops.push_back(std::move(upLoop));
+    }
+    LOG_INFO("EventReactor: %u event loops\n", numLoops);
+
+    return NVSIPL_STATUS_OK;
+}
+
+SIPLStatus CEventReactor::Attach(CEventHandler *pHandler)
+{
+    NvSciEventNotifier *pNotifier = nullptr;
+
+    auto sciErr = NvSciStreamBlockEventServiceSetup(pHandler->GetHandle(), &m_pLoopService->EventService, &pNotifier);
+    CHK_NVSCISTATUS_AND_RETURN(sciErr, (pHandler->GetName() + " NvSciStreamBlockEventServiceSetup").c_str());
+    pHandler->SetEventNotifier(this, pNotifier);
+
+    return NVSIPL_STATUS_OK;
+}
+
+NvSciError CEventReactor::Wait(NvSciEventNotifier *const *ppNotifiers, size_t count, int64_t timeoutUs, bool *pbNewEvents)
+{
+#ifdef NVMEDIA_QNX
+    return m_pLoopService->WaitForMultipleEvents(ppNotifiers, count, timeoutUs, pbNewEvents);
+#else
+    return m_pLoopService->WaitForMultipleEventsExt(&m_pLoopService->EventService, ppNotifiers, count, timeoutUs,
+                                                    pbNewEvents);
+#endif
+}
+
+SIPLStatus CEventReactor::RunUntilComplete(const std::vector<CEventHandler *> &vHandlers)
+{
+    std::vector<CEventHandler *> vPending(vHandlers);
+    std::vector<NvSciEventNotifier *> vNotifiers;
+    std::unique_ptr<bool[]> upNewEvents(new bool[vHandlers.size() + 1U]);
+    uint32_t timeouts = 0U;
+    // Events may have been queued before anyone waited on the notifiers
+    bool bPollAll = true;
+
+    while (!vPending.empty()) {
+        if (!bPollAll) {
+            vNotifiers.clear();
+            for (auto pHandler : vPending) {
+                vNotifiers.push_back(pHandler->GetEventNotifier());
+            }
+            auto sciErr = Wait(vNotifiers.data(), vNotifiers.size(), QUERY_TIMEOUT, upNewEvents.get());
+            if (sciErr == NvSciError_Timeout) {
+                // keep waiting, but report blocks that stay silent for too long
+                if (++timeouts % MAX_QUERY_TIMEOUTS == 0U) {
+                    for (auto pHandler : vPending) {
+                        LOG_WARN((pHandler->GetName() + ": HandleEvents() seems to be taking forever!\n").c_str());
+                    }
+                }
+                continue;
+            }
+            CHK_NVSCISTATUS_AND_RETURN(sciErr, "EventReactor: wait for setup events");
+            timeouts = 0U;
+        }
+
+        std::vector<CEventHandler *> vStillPending;
+        for (size_t i = 0U; i < vPending.size(); i++) {
+            if (!bPollAll && !upNewEvents[i]) {
+                vStillPending.push_back(vPending[i]);
+                continue;
+            }
+            EventStatus status = DrainEvents(vPending[i]);
+            if (status == EVENT_STATUS_ERROR) {
+                LOG_ERR("%s: setup failed\n", vPending[i]->GetName().c_str());
+                return NVSIPL_STATUS_ERROR;
+            }
+            if (status != EVENT_STATUS_COMPLETE) {
+                vStillPending.push_back(vPending[i]);
+            }
+        }
+        vPending.swap(vStillPending);
+        bPollAll = false;
+    }
+
+    return NVSIPL_STATUS_OK;
+}
+
+SIPLStatus CEventReactor::Register(const void *pOwner, const std::vector<CEventHandler *> &vHandlers)
+{
+    if (m_vupLoops.empty()) {
+        LOG_ERR("EventReactor: not initialized\n");
+        return NVSIPL_STATUS_INVALID_STATE;
+    }
+
+    auto spFailed = std::make_shared<std::atomic<bool>>(false);
+    for (auto pHandler : vHandlers) {
+        if (pHandler->GetEventNotifier() == nullptr) {
+            LOG_ERR("%s: not attached to the event service\n", pHandler->GetName().c_str());
+            return NVSIPL_STATUS_INVALID_STATE;
+        }
+        // Round robin, so the blocks of one sensor end up on different loops
+        EventLoop *pLoop = m_vupLoops[m_nextLoop++ % m_vupLoops.size()].get();
+        {
+            std::lock_guard<std::mutex> lock(pLoop->mutex);
+            pLoop->vEntries.push_back(LoopEntry{ pHandler, pOwner, spFailed, false });
+            pLoop->bDirty = true;
+        }
+        pHandler->SetEventLoop(pLoop->id);
+        Wake(pLoop);
+    }
+
+    return NVSIPL_STATUS_OK;
+}
+
+void CEventReactor::Unregister(const void *pOwner)
+{
+    for (auto &upLoop : m_vupLoops) {
+        {
+            std::lock_guard<std::mutex> lock(upLoop->mutex);
+            auto &vEntries = upLoop->vEntries;
+            auto it = vEntries.begin();
+            while (it != vEntries.end()) {
+                if (it->pOwner == pOwner) {
+                    it = vEntries.erase(it);
+                    upLoop->bDirty = true;
+                } else {
+                    ++it;
+                }
+            }
+        }
+        Wake(upLoop.get());
+    }
+}
+
+void CEventReactor::Start(void)
+{
+    if (!m_bQuit.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    m_bQuit.store(false, std::memory_order_release);
+    for (auto &upLoop : m_vupLoops) {
+        upLoop->thread = std::thread(&CEventReactor::LoopThreadFunc, this, upLoop.get());
+    }
+}
+
+void CEventReactor::Stop(void)
+{
+    m_bQuit.store(true, std::memory_order_release);
+    for (auto &upLoop : m_vupLoops) {
+        if (upLoop->thread.joinable()) {
+            Wake(upLoop.get());
+            upLoop->thread.join();
+        }
+    }
+}
+
+void CEventReactor::Wake(EventLoop *pLoop)
+{
+    auto sciErr = pLoop->pWakeEvent->Signal(pLoop->pWakeEvent);
+    if (sciErr != NvSciError_Success) {
+        // The loop still notices within QUERY_TIMEOUT
+        LOG_WARN("EventLoop%u: wake-up failed, status: %u\n", pLoop->id, sciErr);
+    }
+}
+
+void CEventReactor::WakeLoop(uint32_t loopId)
+{
+    if (loopId < m_vupLoops.size()) {
+        Wake(m_vupLoops[loopId].get());
+    }
+}
+
+void CEventReactor::DispatchEntry(LoopEntry &entry)
+{
+    if (entry.spFailed->load(std::memory_order_acquire)) {
+        entry.bDone = true;
+        return;
+    }
+
+    EventStatus status = DrainEvents(entry.pHandler);
+    if (status == EVENT_STATUS_COMPLETE) {
+        entry.bDone = true;
+    } else if (status == EVENT_STATUS_ERROR) {
+        LOG_ERR("%s: HandleEvents failed, stop dispatching its channel\n", entry.pHandler->GetName().c_str());
+        entry.spFailed->store(true, std::memory_order_release);
+        entry.bDone = true;
+    }
+}
+
+void CEventReactor::LoopThreadFunc(EventLoop *pLoop)
+{
+    std::string threadName = "EventLoop" + std::to_string(pLoop->id);
+    CThreadPolicy::GetInstance().Apply(ThreadRole::EVENT_LOOP, pLoop->id, threadName);
+
+    // Index 0 is the wake-up event, entry i is at index i + 1
+    std::vector<NvSciEventNotifier *> vNotifiers;
+    std::unique_ptr<bool[]> upNewEvents;
+    uint32_t timeouts = 0U;
+    bool bPollAll = true;
+
+    while (!m_bQuit.load(std::memory_order_acquire)) {
+        {
+            std::lock_guard<std::mutex> lock(pLoop->mutex);
+            if (pLoop->bDirty) {
+                vNotifiers.clear();
+                vNotifiers.push_back(pLoop->pWakeEvent->eventNotifier);
+                for (const auto &entry : pLoop->vEntries) {
+                    vNotifiers.push_back(entry.pHandler->GetEventNotifier());
+                }
+                upNewEvents.reset(new bool[vNotifiers.size()]);
+                pLoop->bDirty = false;
+                // Events of new entries may be queued already
+                bPollAll = true;
+            }
+        }
+
+        if (!bPollAll) {
+            auto sciErr = Wait(vNotifiers.data(), vNotifiers.size(), QUERY_TIMEOUT, upNewEvents.get());
+            if (sciErr == NvSciError_Timeout) {
+                if (++timeouts % MAX_QUERY_TIMEOUTS == 0U && vNotifiers.size() > 1U) {
+                    LOG_WARN("%s: no stream events for %u s\n", threadName.c_str(), timeouts);
+                }
+                continue;
+            }
+            if (sciErr != NvSciError_Success) {
+                LOG_ERR("%s: wait failed, status: %u\n", threadName.c_str(), sciErr);
+                break;
+            }
+            timeouts = 0U;
+        }
+
+        std::lock_guard<std::mutex> lock(pLoop->mutex);
+        if (pLoop->bDirty) {
+            // Indices are stale, rebuild and poll everything
+            continue;
+        }
+        bool bPrune = false;
+        for (size_t i = 0U; i < pLoop->vEntries.size(); i++) {
+            LoopEntry &entry = pLoop->vEntries[i];
+            // Taken whether or not the notifier fired, one dispatch serves both
+            const bool bRearmed = !entry.bDone && entry.pHandler->TakeRearm();
+            if (!entry.bDone && (bPollAll || upNewEvents[i + 1U] || bRearmed)) {
+                DispatchEntry(entry);
+            }
+            bPrune = bPrune || entry.bDone;
+        }
+        bPollAll = false;
+        if (bPrune) {
+            auto &vEntries = pLoop->vEntries;
+            auto it = vEntries.begin();
+            while (it != vEntries.end()) {
+                it = it->bDone ? vEntries.erase(it) : it + 1;
+            }
+            pLoop->bDirty = true;
+        }
+    }
+}
@@ -0,0 +1,93 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CEVENTREACTOR_HPP
+#define CEVENTREACTOR_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "nvscievent.h"
+#include "nvscistream.h"
+#include "CUtils.hpp"
+
+using namespace nvsipl;
+
+class CEventHandler;
+
+/* Dispatches stream block events from a fixed number of event loops.
+ * Each block handler is bound to one shared NvSciEventService before its block
+ * is connected, then assigned to a loop. A loop sleeps in a single wait on the
+ * notifiers of all its blocks plus a local wake-up event, and calls
+ * HandleEvents() only for the blocks that signaled. The thread count no longer
+ * grows with the number of sensors and consumers. */
+class CEventReactor
+{
+public:
+    CEventReactor(void) = default;
+    ~CEventReactor(void);
+
+    CEventReactor(const CEventReactor &) = delete;
+    CEventReactor &operator=(const CEventReactor &) = delete;
+
+    SIPLStatus Init(uint32_t numLoops);
+
+    // Must be called before the handler's block is connected.
+    SIPLStatus Attach(CEventHandler *pHandler);
+    // Waits until one of the notifiers fires, a negative timeout waits forever.
+    NvSciError Wait(NvSciEventNotifier *const *ppNotifiers, size_t count, int64_t timeoutUs, bool *pbNewEvents);
+
+    // Setup phase, dispatches on the calling thread until every handler completes.
+    SIPLStatus RunUntilComplete(const std::vector<CEventHandler *> &vHandlers);
+
+    // Streaming phase. When one handler fails, the other handlers of the same
+    // owner are no longer dispatched either.
+    SIPLStatus Register(const void *pOwner, const std::vector<CEventHandler *> &vHandlers);
+    // Returns once none of the owner's handlers is being dispatched.
+    void Unregister(const void *pOwner);
+    void Start(void);
+    void Stop(void);
+    // Wakes one loop, it then dispatches the handlers that asked for it with CEventHandler::Rearm()
+    void WakeLoop(uint32_t loopId);
+
+    uint32_t GetNumLoops(void) const
+    {
+        return (uint32_t)m_vupLoops.size();
+    }
+
+private:
+    typedef struct {
+        CEventHandler *pHandler;
+        const void *pOwner;
+        std::shared_ptr<std::atomic<bool>> spFailed;
+        bool bDone;
+    } LoopEntry;
+
+    typedef struct {
+        uint32_t id;
+        std::thread thread;
+        std::mutex mutex; // guards vEntries, held while dispatching
+        std::vector<LoopEntry> vEntries;
+        bool bDirty;
+        NvSciLocalEvent *pWakeEvent;
+    } EventLoop;
+
+    void LoopThreadFunc(EventLoop *pLoop);
+    void DispatchEntry(LoopEntry &entry);
+    void Wake(EventLoop *pLoop);
+
+    NvSciEventLoopService *m_pLoopService = nullptr;
+    std::vector<std::unique_ptr<EventLoop>> m_vupLoops;
+    uint32_t m_nextLoop = 0U;
+    std::atomic<bool> m_bQuit {true};
+};
+
+#endif
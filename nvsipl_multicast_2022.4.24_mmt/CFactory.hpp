@@ -14,6 +14,9 @@
 #include "CSIPLProducer.hpp"
 #include "CCudaConsumer.hpp"
 #include "CEncConsumer.hpp"
+#include "CCpuConsumer.hpp"
+#include "CSyncConsumer.hpp"
+#include "CTopology.hpp"
 
 #include "nvscibuf.h"
 
@@ -26,15 +29,15 @@ public:
     CFactory() {}
     ~CFactory();
 
-    static std::unique_ptr<CPoolManager> CreatePoolManager(uint32_t uSensor)
+    static std::unique_ptr<CPoolManager> CreatePoolManager(uint32_t uSensor, uint32_t numPackets)
     {
         NvSciStreamBlock poolHandle = 0U;
-        auto sciErr = NvSciStreamStaticPoolCreate(MAX_PACKETS, &poolHandle);
+        auto sciErr = NvSciStreamStaticPoolCreate(numPackets, &poolHandle);
         if (sciErr != NvSciError_Success) {
             LOG_ERR("NvSciStreamStaticPoolCreate failed: 0x%x.\n", sciErr);
             return nullptr;
         }
-        return std::unique_ptr<CPoolManager>(new CPoolManager(poolHandle, uSensor));
+        return std::unique_ptr<CPoolManager>(new CPoolManager(poolHandle, uSensor, numPackets));
     }
 
     static std::unique_ptr<CProducer> CreateProducer(NvSciStreamBlock poolHandle, uint32_t uSensor, INvSIPLCamera* pCamera)
@@ -49,15 +52,18 @@ public:
         return std::unique_ptr<CProducer>(new CSIPLProducer(producerHandle, uSensor, pCamera));
     }
 
-    static std::unique_ptr<CConsumer> CreateConsumer(ConsumerType consumerType, SensorInfo *pSensorInfo)
+    static std::unique_ptr<CConsumer> CreateConsumer(const ConsumerConfig &config, SensorInfo *pSensorInfo)
     {
+        ConsumerType consumerType = config.type;
+        QueueType queueType = config.queueType;
         NvSciStreamBlock queueHandle = 0U;
         NvSciStreamBlock consumerHandle = 0U;
 
-        //auto sciErr = NvSciStreamFifoQueueCreate(&queueHandle);
-        auto sciErr = NvSciStreamMailboxQueueCreate(&queueHandle);
+        // A mailbox keeps only the newest packet, a FIFO keeps them all in order
+        auto sciErr = (queueType == QueueType::FIFO) ? NvSciStreamFifoQueueCreate(&queueHandle)
+                                                      : NvSciStreamMailboxQueueCreate(&queueHandle);
         if (sciErr != NvSciError_Success) {
-            LOG_ERR("NvSciStreamFifoQueueCreate failed: 0x%x.\n", sciErr);
+            LOG_ERR("%s queue create failed: 0x%x.\n", (queueType == QueueType::FIFO) ? "Fifo" : "Mailbox", sciErr);
             return nullptr;
         }
         sciErr = NvSciStreamConsumerCreate(queueHandle, &consumerHandle);
@@ -66,14 +72,32 @@ public:
             return nullptr;
         }
 
+        std::unique_ptr<CConsumer> upConsumer;
         if (consumerType == CUDA_CONSUMER) {
-            return std::unique_ptr<CConsumer>(new CCudaConsumer(consumerHandle, pSensorInfo->id, queueHandle));
+            upConsumer.reset(new CCudaConsumer(consumerHandle, pSensorInfo->id, queueHandle));
+        } else if (consumerType == CPU_CONSUMER) {
+            upConsumer.reset(new CCpuConsumer(consumerHandle, pSensorInfo->id, queueHandle));
+        } else if (consumerType == SYNC_CONSUMER) {
+            upConsumer.reset(new CSyncConsumer(consumerHandle, pSensorInfo->id, queueHandle));
         } else {
             auto encodeWidth = (uint16_t)pSensorInfo->vcInfo.resolution.width;
             auto encodeHeight = (uint16_t)pSensorInfo->vcInfo.resolution.height;
 
-            return std::unique_ptr<CConsumer>(new CEncConsumer(consumerHandle, pSensorInfo->id, queueHandle, encodeWidth, encodeHeight));
+            upConsumer.reset(new CEncConsumer(consumerHandle, pSensorInfo->id, queueHandle, encodeWidth, encodeHeight));
         }
+        upConsumer->SetQueueType(queueType);
+        upConsumer->SetDecimation(config.decimation);
+        upConsumer->SetDeadline(config.deadlineMs);
+        upConsumer->SetInFlight(config.inFlight);
+        if (config.pyramidLevels != 0U) {
+            if (consumerType == CPU_CONSUMER || consumerType == SYNC_CONSUMER) {
+                static_cast<CCpuConsumer *>(upConsumer.get())->SetPyramid(config.pyramidLevels);
+            } else {
+                LOG_WARN("Pyramid is only built for cpu and sync consumers.\n");
+            }
+        }
+
+        return upConsumer;
     }
 
     static SIPLStatus CreateMulticastBlock(uint32_t consumerCount, NvSciStreamBlock& multicastHandle)
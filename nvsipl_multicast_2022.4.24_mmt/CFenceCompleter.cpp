@@ -0,0 +1,215 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CFenceCompleter.hpp"
+#include "CLatencyStats.hpp"
+#include "CLogger.hpp"
+#include "CThreadPolicy.hpp"
+#include "Common.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+static const char *const FENCE_RESULT_NAMES[] = { "signaled", "timeout", "error" };
+
+const char *FenceResultName(FenceResult result)
+{
+    return (result < FenceResult::COUNT) ? FENCE_RESULT_NAMES[(uint32_t)result] : "unknown";
+}
+
+CFenceCompleter &CFenceCompleter::GetInstance(void)
+{
+    static CFenceCompleter instance;
+    return instance;
+}
+
+CFenceCompleter::CFenceCompleter(void)
+{
+    CMetrics &metrics = CMetrics::GetInstance();
+    for (uint32_t i = 0U; i < (uint32_t)FenceResult::COUNT; i++) {
+        m_completionMetrics[i] = metrics.Register("nvsipl_fence_completions_total",
+                                                  "Fences completed off the event threads", MetricType::COUNTER,
+                                                  { { "result", FENCE_RESULT_NAMES[i] } });
+    }
+    m_completionNs = metrics.Register("nvsipl_fence_completion_ns_total",
+                                      "Time from fence submission to its completion callback", MetricType::COUNTER, {});
+    m_pendingMetric = metrics.Register("nvsipl_fences_pending", "Fences submitted and not yet completed",
+                                       MetricType::GAUGE, {});
+}
+
+CFenceCompleter::~CFenceCompleter(void)
+{
+    Stop();
+}
+
+void CFenceCompleter::Start(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_bRunning) {
+        return;
+    }
+    m_bQuit = false;
+    m_bRunning = true;
+    m_thread = std::thread(&CFenceCompleter::CompleterThreadFunc, this);
+}
+
+void CFenceCompleter::Stop(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_bRunning) {
+            return;
+        }
+        m_bQuit = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bRunning = false;
+}
+
+void CFenceCompleter::Submit(const void *pOwner, FenceWaitFunc wait, FenceCallback callback, int64_t timeoutUs)
+{
+    const uint64_t nowNs = CTimeBase::NowNs();
+    PendingFence fence { pOwner, wait, callback, nowNs, nowNs + (uint64_t)timeoutUs * 1000U, false,
+                         FenceResult::TIMED_OUT };
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_bRunning && !m_bQuit) {
+            m_submitted.push_back(fence);
+            m_ownerPending[pOwner]++;
+            m_pendingMetric.Inc();
+            m_cond.notify_one();
+            return;
+        }
+    }
+
+    Poll(fence, timeoutUs);
+    Finish(fence);
+}
+
+void CFenceCompleter::Drain(const void *pOwner)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_drainCond.wait(lock, [this, pOwner]() { return m_ownerPending.count(pOwner) == 0U; });
+}
+
+uint32_t CFenceCompleter::GetNumPending(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t numPending = 0U;
+    for (const auto &owner : m_ownerPending) {
+        numPending += owner.second;
+    }
+    return numPending;
+}
+
+void CFenceCompleter::Poll(PendingFence &fence, int64_t timeoutUs)
+{
+    fence.result = fence.wait(timeoutUs);
+    fence.bDone = (fence.result != FenceResult::TIMED_OUT) || (CTimeBase::NowNs() >= fence.deadlineNs);
+}
+
+void CFenceCompleter::Finish(const PendingFence &fence)
+{
+    if (fence.result != FenceResult::SIGNALED) {
+        LOG_ERR("FenceCompleter: fence %s after %.1f ms\n", FenceResultName(fence.result),
+                (CTimeBase::NowNs() - fence.submitNs) / 1000000.0);
+    }
+    fence.callback(fence.result);
+    m_completionMetrics[(uint32_t)fence.result].Inc();
+    m_completionNs.Add((int64_t)(CTimeBase::NowNs() - fence.submitNs));
+}
+
+void CFenceCompleter::CompleterThreadFunc(void)
+{
+    CThreadPolicy::GetInstance().Apply(ThreadRole::FENCE, THREAD_ANY_INSTANCE, "FenceCompleter");
+
+    // Only this thread touches the fences once they are taken off m_submitted
+    std::deque<PendingFence> active;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this, &active]() { return m_bQuit || !m_submitted.empty() || !active.empty(); });
+            while (!m_submitted.empty()) {
+                active.push_back(m_submitted.front());
+                m_submitted.pop_front();
+            }
+            if (m_bQuit && active.empty()) {
+                break;
+            }
+        }
+
+        // Block on the oldest fence for a slice, then pick up the others that signaled meanwhile
+        const uint64_t nowNs = CTimeBase::NowNs();
+        PendingFence &oldest = active.front();
+        int64_t timeoutUs = (oldest.deadlineNs > nowNs) ? (int64_t)((oldest.deadlineNs - nowNs) / 1000U) : 0;
+        Poll(oldest, std::min<int64_t>(timeoutUs, FENCE_WAIT_SLICE_US));
+        for (size_t i = 1U; i < active.size(); i++) {
+            if (!active[i].bDone) {
+                Poll(active[i], 0);
+            }
+        }
+
+        // An owner's callbacks stay in submission order behind its oldest pending fence
+        std::vector<const void *> vBlockedOwners;
+        uint32_t numFinished = 0U;
+        std::unordered_map<const void *, uint32_t> finishedOwners;
+        for (auto it = active.begin(); it != active.end();) {
+            bool bBlocked = std::find(vBlockedOwners.begin(), vBlockedOwners.end(), it->pOwner) != vBlockedOwners.end();
+            if (!it->bDone || bBlocked) {
+                if (!bBlocked) {
+                    vBlockedOwners.push_back(it->pOwner);
+                }
+                ++it;
+                continue;
+            }
+            Finish(*it);
+            finishedOwners[it->pOwner]++;
+            numFinished++;
+            it = active.erase(it);
+        }
+
+        if (numFinished != 0U) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto &owner : finishedOwners) {
+                auto it = m_ownerPending.find(owner.first);
+                if (it != m_ownerPending.end()) {
+                    it->second -= std::min(it->second, owner.second);
+                    if (it->second == 0U) {
+                        m_ownerPending.erase(it);
+                    }
+                }
+            }
+            m_pendingMetric.Add(-(int64_t)numFinished);
+            m_drainCond.notify_all();
+        }
+    }
+}
+
+void CSoftFence::Signal(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_bSignaled = true;
+    }
+    m_cond.notify_all();
+}
+
+FenceResult CSoftFence::Wait(int64_t timeoutUs)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (timeoutUs < 0) {
+        m_cond.wait(lock, [this]() { return m_bSignaled; });
+        return FenceResult::SIGNALED;
+    }
+    bool bSignaled = m_cond.wait_for(lock, std::chrono::microseconds(timeoutUs), [this]() { return m_bSignaled; });
+    return bSignaled ? FenceResult::SIGNALED : FenceResult::TIMED_OUT;
+}
@@ -0,0 +1,108 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CFENCECOMPLETER_HPP
+#define CFENCECOMPLETER_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "CMetrics.hpp"
+
+enum class FenceResult : uint32_t
+{
+    SIGNALED = 0,
+    TIMED_OUT,
+    FAILED,
+    COUNT
+};
+
+// "signaled", "timeout" or "error", the result label of the completion metrics
+const char *FenceResultName(FenceResult result);
+
+// Waits up to timeoutUs for the fence, 0 only polls. Only called on the completer thread.
+typedef std::function<FenceResult(int64_t timeoutUs)> FenceWaitFunc;
+typedef std::function<void(FenceResult result)> FenceCallback;
+
+/* Completes fences off the stream event threads. A client submits a wait
+ * function with the callback to run once the fence is done, and continues.
+ * The completer thread blocks on the oldest pending fence for at most
+ * FENCE_WAIT_SLICE_US, then polls the others, so one slow engine does not
+ * hold back the completions of another. A fence that does not signal within
+ * its timeout completes as TIMED_OUT.
+ * Callbacks of one owner run in submission order, those of different owners
+ * in the order their fences signal. The process opens a single NvSciSync
+ * module, so a single completer thread serves all of its fences.
+ * Until Start() and after Stop(), Submit() waits and calls back inline. */
+class CFenceCompleter
+{
+public:
+    static CFenceCompleter &GetInstance(void);
+    ~CFenceCompleter(void);
+
+    void Start(void);
+    // Completes every pending fence, then joins the completer thread.
+    void Stop(void);
+
+    void Submit(const void *pOwner, FenceWaitFunc wait, FenceCallback callback, int64_t timeoutUs);
+    // Returns once none of the owner's callbacks is pending or running.
+    void Drain(const void *pOwner);
+    uint32_t GetNumPending(void);
+
+private:
+    typedef struct {
+        const void *pOwner;
+        FenceWaitFunc wait;
+        FenceCallback callback;
+        uint64_t submitNs;
+        uint64_t deadlineNs;
+        bool bDone;
+        FenceResult result;
+    } PendingFence;
+
+    CFenceCompleter(void);
+
+    void CompleterThreadFunc(void);
+    void Poll(PendingFence &fence, int64_t timeoutUs);
+    void Finish(const PendingFence &fence);
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;      // new submissions and Stop()
+    std::condition_variable m_drainCond; // completions
+    std::deque<PendingFence> m_submitted;
+    std::unordered_map<const void *, uint32_t> m_ownerPending;
+    std::thread m_thread;
+    bool m_bRunning = false;
+    bool m_bQuit = false;
+
+    CMetric m_completionMetrics[(uint32_t)FenceResult::COUNT];
+    CMetric m_completionNs;
+    CMetric m_pendingMetric;
+};
+
+/* Host stand-in for a hardware fence, lets the completer run without
+ * NvSciSync. Used by nvsipl_fence_completer_test. */
+class CSoftFence
+{
+public:
+    void Signal(void);
+    // A negative timeout waits forever, 0 only polls
+    FenceResult Wait(int64_t timeoutUs);
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_bSignaled = false;
+};
+
+#endif
@@ -0,0 +1,256 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CFlightRecorder.hpp"
+#include "CLogger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+static const int FATAL_SIGNALS[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+constexpr size_t FLIGHT_ALT_STACK_SIZE = 64U * 1024U;
+
+thread_local CFlightRecorder::FlightRing *CFlightRecorder::s_pRing = nullptr;
+thread_local bool CFlightRecorder::s_bNoRing = false;
+
+// Only the first fatal signal dumps, a crash inside the dump must not loop
+static std::atomic<bool> s_bCrashed {false};
+
+// A stack overflow leaves no stack for the handler, every thread gets a spare one.
+// sigaltstack() is per thread; the stack is released when its thread exits.
+class CAltSignalStack
+{
+public:
+    ~CAltSignalStack(void)
+    {
+        if (m_pStack != nullptr) {
+            stack_t disable {};
+            disable.ss_flags = SS_DISABLE;
+            sigaltstack(&disable, nullptr);
+            free(m_pStack);
+        }
+    }
+
+    void Install(void)
+    {
+        if (m_pStack != nullptr || m_bFailed) {
+            return;
+        }
+        stack_t altStack {};
+        altStack.ss_sp = malloc(FLIGHT_ALT_STACK_SIZE);
+        altStack.ss_size = FLIGHT_ALT_STACK_SIZE;
+        if (altStack.ss_sp == nullptr || sigaltstack(&altStack, nullptr) != 0) {
+            LOG_WARN("FlightRecorder: no alternate signal stack, a stack overflow on this thread will not be dumped\n");
+            free(altStack.ss_sp);
+            m_bFailed = true;
+            return;
+        }
+        m_pStack = altStack.ss_sp;
+    }
+
+private:
+    void *m_pStack = nullptr;
+    bool m_bFailed = false;
+};
+
+static thread_local CAltSignalStack s_altStack;
+
+static void FatalSigHandler(int signum)
+{
+    if (!s_bCrashed.exchange(true)) {
+        CFlightRecorder::GetInstance().Dump(signum);
+    }
+    // SA_RESETHAND restored the default action, re-raise it for the core dump
+    raise(signum);
+}
+
+// strcat/snprintf are not async-signal-safe, these helpers are
+static size_t AppendString(char *pDst, size_t pos, size_t size, const char *pSrc)
+{
+    while (*pSrc != '\0' && pos + 1U < size) {
+        pDst[pos++] = *pSrc++;
+    }
+    pDst[pos] = '\0';
+    return pos;
+}
+
+static size_t AppendDecimal(char *pDst, size_t pos, size_t size, uint32_t value)
+{
+    char digits[10];
+    uint32_t n = 0U;
+    do {
+        digits[n++] = (char)('0' + value % 10U);
+        value /= 10U;
+    } while (value != 0U);
+    while (n > 0U && pos + 1U < size) {
+        pDst[pos++] = digits[--n];
+    }
+    pDst[pos] = '\0';
+    return pos;
+}
+
+static bool WriteAll(int fd, const void *pData, size_t size)
+{
+    const uint8_t *p = static_cast<const uint8_t *>(pData);
+    while (size > 0U) {
+        ssize_t ret = write(fd, p, size);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += ret;
+        size -= (size_t)ret;
+    }
+    return true;
+}
+
+CFlightRecorder &CFlightRecorder::GetInstance(void)
+{
+    static CFlightRecorder instance;
+    return instance;
+}
+
+bool CFlightRecorder::InstallCrashHandlers(const std::string &dir)
+{
+    std::string prefix = (dir.empty() ? std::string(".") : dir) + "/flight_" + std::to_string(getpid()) + "_";
+    if (prefix.size() + 32U >= FLIGHT_MAX_PATH) {
+        LOG_ERR("FlightRecorder: directory name too long: %s\n", dir.c_str());
+        return false;
+    }
+    strncpy(m_pathPrefix, prefix.c_str(), sizeof(m_pathPrefix) - 1U);
+
+    // The other threads get theirs from RegisterThread()
+    s_altStack.Install();
+
+    struct sigaction action {};
+    action.sa_handler = FatalSigHandler;
+    action.sa_flags = SA_RESETHAND | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    for (int signum : FATAL_SIGNALS) {
+        sigaction(signum, &action, nullptr);
+    }
+    LOG_INFO("FlightRecorder: fatal signals and pipeline errors dump to %s*.bin\n", m_pathPrefix);
+
+    return true;
+}
+
+void CFlightRecorder::RegisterThread(void)
+{
+    s_altStack.Install();
+    if (s_pRing == nullptr && !s_bNoRing) {
+        (void)CreateRing();
+    }
+}
+
+CFlightRecorder::FlightRing *CFlightRecorder::CreateRing(void)
+{
+    uint32_t slot = m_numRings.fetch_add(1U, std::memory_order_relaxed);
+    if (slot >= FLIGHT_MAX_THREADS) {
+        m_numRings.store(FLIGHT_MAX_THREADS, std::memory_order_relaxed);
+        s_bNoRing = true;
+        return nullptr;
+    }
+
+    void *pMem = nullptr;
+    if (posix_memalign(&pMem, 64U, sizeof(FlightRing)) != 0) {
+        s_bNoRing = true;
+        return nullptr;
+    }
+    FlightRing *pRing = static_cast<FlightRing *>(pMem);
+    memset(pMem, 0, sizeof(FlightRing));
+    new (&pRing->head) std::atomic<uint64_t>(0U);
+    pRing->tid = (uint32_t)syscall(SYS_gettid);
+    // Threads are named by CThreadPolicy::Apply() before their first event
+    if (pthread_getname_np(pthread_self(), pRing->name, sizeof(pRing->name)) != 0) {
+        snprintf(pRing->name, sizeof(pRing->name), "%u", pRing->tid);
+    }
+
+    // Rings live until exit so a dump can always read them
+    m_apRings[slot].store(pRing, std::memory_order_release);
+    s_pRing = pRing;
+    return pRing;
+}
+
+bool CFlightRecorder::Dump(int signum)
+{
+    if (m_pathPrefix[0] == '\0') {
+        return false;
+    }
+
+    FlightFileHeader header {};
+    header.magic = FLIGHT_FILE_MAGIC;
+    header.version = FLIGHT_FILE_VERSION;
+    header.ringEvents = FLIGHT_RING_EVENTS;
+    header.ticksPerSecond = CTimeBase::TicksPerSecond();
+    header.dumpTicks = CTimeBase::NowTicks();
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    header.dumpRealtimeNs = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+    header.pid = getpid();
+    header.signum = signum;
+
+    char path[FLIGHT_MAX_PATH];
+    size_t pos = AppendString(path, 0U, sizeof(path), m_pathPrefix);
+    if (signum != 0) {
+        pos = AppendString(path, pos, sizeof(path), "sig");
+        pos = AppendDecimal(path, pos, sizeof(path), (uint32_t)signum);
+    } else {
+        pos = AppendString(path, pos, sizeof(path), "error");
+    }
+    pos = AppendString(path, pos, sizeof(path), "_");
+    pos = AppendDecimal(path, pos, sizeof(path), m_dumpCount.fetch_add(1U, std::memory_order_relaxed));
+    AppendString(path, pos, sizeof(path), ".bin");
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    const uint32_t numSlots = std::min(m_numRings.load(std::memory_order_acquire), FLIGHT_MAX_THREADS);
+    for (uint32_t i = 0U; i < numSlots; i++) {
+        if (m_apRings[i].load(std::memory_order_acquire) != nullptr) {
+            header.numRings++;
+        }
+    }
+    bool bOk = WriteAll(fd, &header, sizeof(header));
+
+    uint32_t written = 0U;
+    for (uint32_t i = 0U; i < numSlots && bOk && written < header.numRings; i++) {
+        const FlightRing *pRing = m_apRings[i].load(std::memory_order_acquire);
+        if (pRing == nullptr) {
+            continue;
+        }
+        FlightRingHeader ringHeader {};
+        ringHeader.head = pRing->head.load(std::memory_order_acquire);
+        ringHeader.tid = pRing->tid;
+        memcpy(ringHeader.name, pRing->name, sizeof(ringHeader.name));
+        bOk = WriteAll(fd, &ringHeader, sizeof(ringHeader)) && WriteAll(fd, pRing->events, sizeof(pRing->events));
+        written++;
+    }
+    close(fd);
+
+    const char *pMsg = "nvsipl_multicast: flight recorder written to ";
+    bOk = bOk && (written == header.numRings);
+    WriteAll(STDERR_FILENO, pMsg, strlen(pMsg));
+    WriteAll(STDERR_FILENO, path, strlen(path));
+    WriteAll(STDERR_FILENO, "\n", 1U);
+
+    return bOk;
+}
@@ -0,0 +1,128 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CFLIGHTRECORDER_HPP
+#define CFLIGHTRECORDER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "CLatencyStats.hpp"
+
+constexpr uint32_t FLIGHT_RING_EVENTS = 4096U; // per thread, power of two
+constexpr uint32_t FLIGHT_MAX_THREADS = 128U;
+constexpr uint32_t FLIGHT_THREAD_NAME_LEN = 16U;
+constexpr uint32_t FLIGHT_MAX_PATH = 256U;
+constexpr uint64_t FLIGHT_FILE_MAGIC = 0x544847494c46564eULL; // "NVFLIGHT"
+constexpr uint32_t FLIGHT_FILE_VERSION = 1U;
+
+// Append only, the decoder knows the values by number
+enum FlightEventType : uint16_t
+{
+    FLIGHT_FRAME_CAPTURED = 1,  // id sensor, arg frame sequence of the sensor
+    FLIGHT_PACKET_GET,          // producer got a packet back, arg packet index
+    FLIGHT_PACKET_PRESENT,      // producer presented, arg packet index
+    FLIGHT_PACKET_ACQUIRE,      // consumer acquired, arg packet index
+    FLIGHT_PACKET_RELEASE,      // consumer released, arg packet index
+    FLIGHT_FENCE_WAIT,          // CPU fence wait done, arg NvSciError
+    FLIGHT_PIPELINE_NOTIF,      // id sensor, arg NotificationType
+    FLIGHT_DEVBLK_NOTIF,        // id device block, arg NotificationType
+    FLIGHT_ERROR                // arg SIPLStatus or NvSciError of a failed call
+};
+
+typedef struct {
+    uint64_t ticks; // CTimeBase::NowTicks()
+    uint16_t type;
+    uint16_t id;    // sensor unless noted
+    uint32_t arg;
+} FlightEvent;
+
+/* Dump file layout, little endian: FlightFileHeader, then numRings times a
+ * FlightRingHeader followed by the FLIGHT_RING_EVENTS raw ring slots. Events
+ * [head - FLIGHT_RING_EVENTS, head) are valid, the decoder unwraps them. */
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t ringEvents;
+    uint64_t ticksPerSecond;
+    uint64_t dumpTicks;      // counter at dump time
+    uint64_t dumpRealtimeNs; // CLOCK_REALTIME at dump time, to place ticks on the wall clock
+    int32_t pid;
+    int32_t signum;          // 0 when dumped for a pipeline error
+    uint32_t numRings;
+    uint32_t reserved;
+} FlightFileHeader;
+
+typedef struct {
+    uint64_t head;
+    uint32_t tid;
+    char name[FLIGHT_THREAD_NAME_LEN];
+    uint32_t reserved;
+} FlightRingHeader;
+
+/* Always-on flight recorder of recent pipeline events.
+ * Each thread appends fixed 16 byte events to its own ring, a counter read and
+ * a store, so it can stay on at 16 sensors x 30 fps. Rings are never freed and
+ * are registered in a fixed table, which lets a fatal signal handler write them
+ * with open()/write() only. The dumps are read with nvsipl_flight_decode. */
+class CFlightRecorder
+{
+public:
+    static CFlightRecorder &GetInstance(void);
+
+    // Sets where dumps go and installs the SIGSEGV/SIGBUS/SIGFPE/SIGILL/SIGABRT handlers.
+    bool InstallCrashHandlers(const std::string &dir);
+    // Called by each thread as it starts, from CThreadPolicy::Apply(): creates its
+    // ring and gives it an alternate signal stack, so a stack overflow still dumps.
+    void RegisterThread(void);
+
+    inline void Record(FlightEventType type, uint32_t id, uint32_t arg);
+
+    // Async-signal-safe. signum 0 means a pipeline error rather than a signal.
+    bool Dump(int signum);
+
+private:
+    typedef struct {
+        std::atomic<uint64_t> head;
+        uint32_t tid;
+        char name[FLIGHT_THREAD_NAME_LEN];
+        FlightEvent events[FLIGHT_RING_EVENTS];
+    } FlightRing;
+
+    CFlightRecorder(void) = default;
+
+    FlightRing *CreateRing(void);
+
+    static thread_local FlightRing *s_pRing;
+    static thread_local bool s_bNoRing;
+
+    std::atomic<FlightRing *> m_apRings[FLIGHT_MAX_THREADS] {};
+    std::atomic<uint32_t> m_numRings {0U};
+    std::atomic<uint32_t> m_dumpCount {0U};
+    char m_pathPrefix[FLIGHT_MAX_PATH] {}; // "<dir>/flight_<pid>_", fixed before any dump
+};
+
+inline void CFlightRecorder::Record(FlightEventType type, uint32_t id, uint32_t arg)
+{
+    FlightRing *pRing = s_pRing;
+    if (pRing == nullptr) {
+        if (s_bNoRing) {
+            return;
+        }
+        pRing = CreateRing();
+        if (pRing == nullptr) {
+            return;
+        }
+    }
+    uint64_t head = pRing->head.load(std::memory_order_relaxed);
+    pRing->events[head & (FLIGHT_RING_EVENTS - 1U)] = FlightEvent{ CTimeBase::NowTicks(), type, (uint16_t)id, arg };
+    pRing->head.store(head + 1U, std::memory_order_release);
+}
+
+#endif
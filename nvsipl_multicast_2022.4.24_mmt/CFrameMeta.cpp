@@ -0,0 +1,109 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CFrameMeta.hpp"
+
+#include <cstring>
+
+static uint32_t AlignSection(uint32_t offset)
+{
+    return (offset + 7U) & ~7U;
+}
+
+CFrameMetaWriter::CFrameMetaWriter(void *pBuffer, uint32_t bufferSize)
+    : m_pBuffer(static_cast<uint8_t *>(pBuffer))
+    , m_bufferSize(bufferSize)
+{
+}
+
+MetaData *CFrameMetaWriter::Begin(void)
+{
+    if (m_pBuffer == nullptr || m_bufferSize < FRAME_META_MIN_SIZE) {
+        return nullptr;
+    }
+    FrameMetaHeader *pHeader = reinterpret_cast<FrameMetaHeader *>(m_pBuffer);
+    pHeader->magic = FRAME_META_MAGIC;
+    pHeader->version = FRAME_META_VERSION;
+    pHeader->headerSize = (uint16_t)sizeof(FrameMetaHeader);
+    pHeader->coreSize = (uint32_t)sizeof(MetaData);
+    pHeader->usedSize = AlignSection(FRAME_META_MIN_SIZE);
+    pHeader->bufferSize = m_bufferSize;
+    pHeader->reserved = 0U;
+
+    MetaData *pCore = GetCore();
+    memset(pCore, 0, sizeof(MetaData));
+    return pCore;
+}
+
+MetaData *CFrameMetaWriter::GetCore(void) const
+{
+    if (m_pBuffer == nullptr || m_bufferSize < FRAME_META_MIN_SIZE) {
+        return nullptr;
+    }
+    return reinterpret_cast<MetaData *>(m_pBuffer + sizeof(FrameMetaHeader));
+}
+
+bool CFrameMetaWriter::Add(MetaTag tag, const void *pData, uint16_t size)
+{
+    if (m_pBuffer == nullptr || m_bufferSize < FRAME_META_MIN_SIZE) {
+        return false;
+    }
+    FrameMetaHeader *pHeader = reinterpret_cast<FrameMetaHeader *>(m_pBuffer);
+    const uint32_t offset = pHeader->usedSize;
+    const uint32_t end = AlignSection(offset + (uint32_t)sizeof(MetaSectionHeader) + size);
+    if (end > m_bufferSize) {
+        return false;
+    }
+
+    MetaSectionHeader *pSection = reinterpret_cast<MetaSectionHeader *>(m_pBuffer + offset);
+    pSection->tag = (uint16_t)tag;
+    pSection->size = size;
+    pSection->reserved = 0U;
+    memcpy(pSection + 1, pData, size);
+    pHeader->usedSize = end;
+    return true;
+}
+
+CFrameMetaReader::CFrameMetaReader(const void *pBuffer, uint32_t bufferSize)
+{
+    const FrameMetaHeader *pHeader = static_cast<const FrameMetaHeader *>(pBuffer);
+    if (pHeader == nullptr || bufferSize < FRAME_META_MIN_SIZE || pHeader->magic != FRAME_META_MAGIC ||
+        pHeader->version != FRAME_META_VERSION || pHeader->headerSize < sizeof(FrameMetaHeader) ||
+        pHeader->coreSize < sizeof(MetaData) || pHeader->usedSize > bufferSize ||
+        (uint32_t)pHeader->headerSize + pHeader->coreSize > pHeader->usedSize) {
+        return;
+    }
+    m_pBuffer = static_cast<const uint8_t *>(pBuffer);
+    m_pCore = reinterpret_cast<const MetaData *>(m_pBuffer + pHeader->headerSize);
+}
+
+uint16_t CFrameMetaReader::GetVersion(void) const
+{
+    return (m_pBuffer != nullptr) ? reinterpret_cast<const FrameMetaHeader *>(m_pBuffer)->version : 0U;
+}
+
+const void *CFrameMetaReader::Find(MetaTag tag, uint16_t size) const
+{
+    if (m_pBuffer == nullptr) {
+        return nullptr;
+    }
+    const FrameMetaHeader *pHeader = reinterpret_cast<const FrameMetaHeader *>(m_pBuffer);
+    uint32_t offset = AlignSection((uint32_t)pHeader->headerSize + pHeader->coreSize);
+    while (offset + sizeof(MetaSectionHeader) <= pHeader->usedSize) {
+        const MetaSectionHeader *pSection = reinterpret_cast<const MetaSectionHeader *>(m_pBuffer + offset);
+        const uint32_t end = offset + (uint32_t)sizeof(MetaSectionHeader) + pSection->size;
+        if (end > pHeader->usedSize) {
+            break;
+        }
+        if (pSection->tag == (uint16_t)tag) {
+            return (pSection->size >= size) ? pSection + 1 : nullptr;
+        }
+        offset = AlignSection(end);
+    }
+    return nullptr;
+}
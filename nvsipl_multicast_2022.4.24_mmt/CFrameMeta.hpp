@@ -0,0 +1,150 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CFRAMEMETA_HPP
+#define CFRAMEMETA_HPP
+
+#include <cstdint>
+
+/* Layout of the meta element of a packet, written by the producer for every
+ * frame and read in place by the consumers holding the packet:
+ *     FrameMetaHeader   magic, version, section offsets and sizes
+ *     MetaData          fixed-offset core, stamps every consumer reads
+ *     sections          tag + size + payload records, 8-byte aligned
+ * The core only grows at its end and readers skip section tags they do not
+ * know, so a consumer built against an older layout of the same version keeps
+ * working. A new version is only needed when a field changes its meaning. */
+constexpr uint32_t FRAME_META_MAGIC = 0x4154454DU; // "META"
+constexpr uint16_t FRAME_META_VERSION = 1U;
+constexpr uint32_t FRAME_META_SIZE = 256U;         // bytes the producer asks for, see SetMetaBufAttrList()
+constexpr uint32_t FRAME_META_MAX_VALUES = 4U;     // exposures and temperatures per frame
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize; // offset of the core
+    uint32_t coreSize;   // sizeof(MetaData) of the writer
+    uint32_t usedSize;   // header, core and the sections written so far
+    uint32_t bufferSize; // reconciled size of the meta element
+    uint32_t reserved;
+} FrameMetaHeader;
+
+typedef struct
+{
+    /** Holds the TSC timestamp of the frame capture */
+    uint64_t frameCaptureTSC;
+    uint64_t frame_count;
+    /** CTimeBase stamps taken by the producer, consumers stamp their own stages locally */
+    uint64_t postTimeNs;
+    uint64_t presentTimeNs;
+} MetaData;
+
+enum class MetaTag : uint16_t
+{
+    SEQUENCE = 1U,    // MetaSequence
+    EXPOSURE = 2U,    // MetaExposure
+    TEMPERATURE = 3U, // MetaTemperature
+    CALIBRATION = 4U  // MetaCalibration
+};
+
+typedef struct {
+    uint16_t tag;  // MetaTag
+    uint16_t size; // payload bytes following this header
+    uint32_t reserved;
+} MetaSectionHeader;
+
+// Frame counter of the sensor itself, it also counts frames dropped before the producer
+typedef struct {
+    uint64_t sensorFrameSequence;
+} MetaSequence;
+
+typedef struct {
+    uint32_t numExposures;
+    uint32_t bExposureValid;
+    uint32_t bGainValid;
+    uint32_t reserved;
+    float exposureTimeMs[FRAME_META_MAX_VALUES];
+    float sensorGain[FRAME_META_MAX_VALUES];
+} MetaExposure;
+
+typedef struct {
+    uint32_t numTemperatures;
+    uint32_t reserved;
+    float sensorTempCelsius[FRAME_META_MAX_VALUES];
+} MetaTemperature;
+
+// 'calibration_version' of the sensor's topology entry
+typedef struct {
+    uint32_t version;
+    uint32_t reserved;
+} MetaCalibration;
+
+// Smallest meta element a reader of this layout can use
+constexpr uint32_t FRAME_META_MIN_SIZE = sizeof(FrameMetaHeader) + sizeof(MetaData);
+static_assert(FRAME_META_MIN_SIZE <= FRAME_META_SIZE, "MetaData does not fit the meta buffer");
+
+/* Producer side. Begin() starts a frame, the core and the sections are then
+ * written in place. Not thread safe, one writer per packet. */
+class CFrameMetaWriter
+{
+public:
+    CFrameMetaWriter(void) = default;
+    CFrameMetaWriter(void *pBuffer, uint32_t bufferSize);
+
+    // Writes the header and clears the core, drops the sections of the previous frame.
+    // nullptr when the buffer is too small for the core.
+    MetaData *Begin(void);
+    MetaData *GetCore(void) const;
+
+    // Appends a section, false when it does not fit the buffer.
+    bool Add(MetaTag tag, const void *pData, uint16_t size);
+    template <typename T>
+    bool Add(MetaTag tag, const T &payload)
+    {
+        return Add(tag, &payload, (uint16_t)sizeof(T));
+    }
+
+private:
+    uint8_t *m_pBuffer = nullptr;
+    uint32_t m_bufferSize = 0U;
+};
+
+/* Consumer side, views the meta element of an acquired packet without copying.
+ * Pointers it returns stay valid until the packet is released. */
+class CFrameMetaReader
+{
+public:
+    CFrameMetaReader(void) = default;
+    CFrameMetaReader(const void *pBuffer, uint32_t bufferSize);
+
+    // Magic, version and sizes are consistent
+    bool IsValid(void) const
+    {
+        return m_pCore != nullptr;
+    }
+    // nullptr when the buffer holds no valid frame
+    const MetaData *GetCore(void) const
+    {
+        return m_pCore;
+    }
+    uint16_t GetVersion(void) const;
+
+    // First section with this tag, nullptr when absent or shorter than size
+    const void *Find(MetaTag tag, uint16_t size) const;
+    template <typename T>
+    const T *Find(MetaTag tag) const
+    {
+        return static_cast<const T *>(Find(tag, (uint16_t)sizeof(T)));
+    }
+
+private:
+    const uint8_t *m_pBuffer = nullptr;
+    const MetaData *m_pCore = nullptr;
+};
+
+#endif
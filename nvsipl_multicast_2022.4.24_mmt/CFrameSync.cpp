@@ -0,0 +1,255 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CFrameSync.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+static uint64_t Distance(uint64_t a, uint64_t b)
+{
+    return (a > b) ? a - b : b - a;
+}
+
+CFrameSync &CFrameSync::GetInstance(void)
+{
+    static CFrameSync instance;
+    return instance;
+}
+
+void CFrameSync::Configure(const SyncConfig &config)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_config = config;
+    m_toleranceNs = (uint64_t)(config.toleranceMs * 1000000.0);
+    m_maxWaitNs = (uint64_t)(config.maxWaitMs * 1000000.0);
+
+    CMetrics &metrics = CMetrics::GetInstance();
+    const char *help = "Frame groups closed by the synchronizer";
+    m_completeMetric = metrics.Register("nvsipl_sync_groups_total", help, MetricType::COUNTER,
+                                        { { "result", "complete" } });
+    m_partialMetric = metrics.Register("nvsipl_sync_groups_total", help, MetricType::COUNTER,
+                                       { { "result", "partial" } });
+    m_droppedMetric = metrics.Register("nvsipl_sync_groups_total", help, MetricType::COUNTER,
+                                       { { "result", "dropped" } });
+    m_lateMetric = metrics.Register("nvsipl_sync_late_frames_total", "Frames that arrived after their group closed",
+                                    MetricType::COUNTER, {});
+}
+
+void CFrameSync::SetGroupCallback(SyncGroupCallback callback)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_callback = callback;
+}
+
+void CFrameSync::AddSensor(uint32_t uSensor, SyncReleaseFunc release)
+{
+    if (uSensor >= MAX_NUM_SENSORS) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_releasers[uSensor] = release;
+    m_sensorMask |= 1U << uSensor;
+}
+
+void CFrameSync::RemoveSensor(uint32_t uSensor)
+{
+    if (uSensor >= MAX_NUM_SENSORS) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sensorMask &= ~(1U << uSensor);
+    m_releasers[uSensor] = nullptr;
+    for (auto &group : m_groups) {
+        group.sensorMask &= ~(1U << uSensor);
+    }
+}
+
+bool CFrameSync::HasSensors(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_sensorMask != 0U;
+}
+
+void CFrameSync::Push(const SyncFrame &frame)
+{
+    if (frame.uSensorId >= MAX_NUM_SENSORS) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint32_t sensorBit = 1U << frame.uSensorId;
+    const uint64_t nowNs = CTimeBase::NowNs();
+    if ((m_sensorMask & sensorBit) == 0U) {
+        return;
+    }
+    if (frame.captureNs > m_lastCaptureNs[frame.uSensorId]) {
+        m_lastCaptureNs[frame.uSensorId] = frame.captureNs;
+    }
+
+    // Closest pending group in the window that still misses this sensor
+    PendingGroup *pGroup = nullptr;
+    for (auto &group : m_groups) {
+        if ((group.sensorMask & sensorBit) == 0U && Distance(group.captureNs, frame.captureNs) <= m_toleranceNs &&
+            (pGroup == nullptr || Distance(group.captureNs, frame.captureNs) <
+                                      Distance(pGroup->captureNs, frame.captureNs))) {
+            pGroup = &group;
+        }
+    }
+
+    if (pGroup == nullptr) {
+        // Its group was already delivered or dropped, delivery stays in capture order
+        if (m_lastClosedNs != 0U && frame.captureNs <= m_lastClosedNs + m_toleranceNs) {
+            m_counts.late++;
+            m_lateMetric.Inc();
+            Release(frame);
+            return;
+        }
+        PendingGroup group {};
+        group.captureNs = frame.captureNs;
+        group.firstPushNs = nowNs;
+        auto it = m_groups.begin();
+        while (it != m_groups.end() && it->captureNs <= frame.captureNs) {
+            ++it;
+        }
+        pGroup = &*m_groups.insert(it, group);
+    }
+    pGroup->frames[frame.uSensorId] = frame;
+    pGroup->sensorMask |= sensorBit;
+
+    DeliverReady(nowNs);
+}
+
+void CFrameSync::Flush(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint64_t nowNs = CTimeBase::NowNs();
+    while (!m_groups.empty()) {
+        Close(m_groups.front(), nowNs);
+        m_groups.pop_front();
+    }
+}
+
+bool CFrameSync::IsClosed(const PendingGroup &group, uint64_t nowNs) const
+{
+    if (group.sensorMask == m_sensorMask || nowNs >= group.firstPushNs + m_maxWaitNs) {
+        return true;
+    }
+    // Every missing sensor already delivered a frame past the window
+    for (uint32_t i = 0U; i < MAX_NUM_SENSORS; i++) {
+        uint32_t bit = 1U << i;
+        if ((m_sensorMask & bit) != 0U && (group.sensorMask & bit) == 0U &&
+            m_lastCaptureNs[i] <= group.captureNs + m_toleranceNs) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CFrameSync::DeliverReady(uint64_t nowNs)
+{
+    // The newest complete group closes everything older than it
+    size_t numClosing = 0U;
+    for (size_t i = 0U; i < m_groups.size(); i++) {
+        if (m_groups[i].sensorMask == m_sensorMask) {
+            numClosing = i + 1U;
+        }
+    }
+    while (!m_groups.empty()) {
+        if (numClosing == 0U && m_groups.size() <= m_config.maxPending && !IsClosed(m_groups.front(), nowNs)) {
+            break;
+        }
+        Close(m_groups.front(), nowNs);
+        m_groups.pop_front();
+        numClosing = (numClosing > 0U) ? numClosing - 1U : 0U;
+    }
+}
+
+void CFrameSync::Close(PendingGroup &group, uint64_t nowNs)
+{
+    SyncFrame frames[MAX_NUM_SENSORS];
+    uint32_t numFrames = 0U;
+    uint64_t minNs = UINT64_MAX;
+    uint64_t maxNs = 0U;
+    for (uint32_t i = 0U; i < MAX_NUM_SENSORS; i++) {
+        if ((group.sensorMask & (1U << i)) != 0U) {
+            frames[numFrames++] = group.frames[i];
+            minNs = std::min(minNs, group.frames[i].captureNs);
+            maxNs = std::max(maxNs, group.frames[i].captureNs);
+        }
+    }
+    m_lastClosedNs = std::max(m_lastClosedNs, group.captureNs);
+
+    const bool bComplete = (numFrames != 0U && group.sensorMask == m_sensorMask);
+    if (bComplete || (numFrames != 0U && numFrames >= m_config.minSensors)) {
+        if (bComplete) {
+            m_counts.complete++;
+            m_completeMetric.Inc();
+        } else {
+            m_counts.partial++;
+            m_partialMetric.Inc();
+        }
+        m_waitHistogram.Record(nowNs - group.firstPushNs);
+        m_skewHistogram.Record(maxNs - minNs);
+        if (m_callback != nullptr) {
+            m_callback(SyncGroup{ group.captureNs, group.sensorMask, bComplete, numFrames, frames });
+        }
+    } else if (numFrames != 0U) {
+        m_counts.dropped++;
+        m_droppedMetric.Inc();
+    }
+
+    for (uint32_t i = 0U; i < numFrames; i++) {
+        Release(frames[i]);
+    }
+}
+
+void CFrameSync::Release(const SyncFrame &frame)
+{
+    if (m_releasers[frame.uSensorId] != nullptr) {
+        m_releasers[frame.uSensorId](frame.packetIndex);
+    }
+}
+
+CFrameSync::SyncCounts CFrameSync::GetCounts(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_counts;
+}
+
+void CFrameSync::Report(std::ostream &os, double elapsedSec)
+{
+    SyncCounts counts;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        counts.complete = m_counts.complete - m_prevCounts.complete;
+        counts.partial = m_counts.partial - m_prevCounts.partial;
+        counts.dropped = m_counts.dropped - m_prevCounts.dropped;
+        counts.late = m_counts.late - m_prevCounts.late;
+        m_prevCounts = m_counts;
+    }
+    const LatencySummary wait = m_waitHistogram.ReadInterval();
+    const LatencySummary skew = m_skewHistogram.ReadInterval();
+
+    const uint64_t total = counts.complete + counts.partial + counts.dropped;
+    auto ms = [](uint64_t ns) { return ns / 1000000.0; };
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+    os << "FrameSync\tgroups " << total << ", " << ((elapsedSec > 0.0) ? total / elapsedSec : 0.0) << " per s, "
+       << counts.complete << " complete (" << ((total != 0U) ? 100.0 * counts.complete / total : 0.0) << "%), "
+       << counts.partial << " partial, " << counts.dropped << " dropped, " << counts.late
+       << " late frames, (ms) p50/p99/p99.9/max" << std::endl;
+    if (wait.count != 0U) {
+        os << "    " << std::left << std::setw(18) << "group wait" << std::right << ms(wait.p50Ns) << " / "
+           << ms(wait.p99Ns) << " / " << ms(wait.p999Ns) << " / " << ms(wait.maxNs) << std::endl;
+        os << "    " << std::left << std::setw(18) << "capture skew" << std::right << ms(skew.p50Ns) << " / "
+           << ms(skew.p99Ns) << " / " << ms(skew.p999Ns) << " / " << ms(skew.maxNs) << std::endl;
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
@@ -0,0 +1,132 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CFRAMESYNC_HPP
+#define CFRAMESYNC_HPP
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ostream>
+
+#include "CLatencyStats.hpp"
+#include "CMetrics.hpp"
+#include "Common.hpp"
+
+// Grouping of the 'sync' consumers' frames across sensors, the topology's 'sync' key
+typedef struct {
+    double toleranceMs;  // largest capture time difference within a group
+    uint32_t minSensors; // smaller incomplete groups are released without a callback
+    uint32_t maxPending; // groups in the reorder buffer, each holds a packet per sensor
+    double maxWaitMs;    // an incomplete group is closed after this long
+} SyncConfig;
+
+// One sensor's frame in a group. pFrame is the pushing consumer's view of
+// the packet (a CpuFrame for CSyncConsumer) and is valid until released.
+typedef struct {
+    uint32_t uSensorId;
+    uint32_t packetIndex;
+    uint64_t captureNs;
+    const void *pFrame;
+} SyncFrame;
+
+typedef struct {
+    uint64_t captureNs;   // capture time of the group's first frame
+    uint32_t sensorMask;  // sensors present in the group
+    bool bComplete;       // every registered sensor is present
+    uint32_t numFrames;
+    const SyncFrame *pFrames; // ordered by sensor id
+} SyncGroup;
+
+typedef std::function<void(const SyncGroup &group)> SyncGroupCallback;
+// Returns a frame's packet to its stream
+typedef std::function<void(uint32_t packetIndex)> SyncReleaseFunc;
+
+/* Groups frames of several sensors by capture time.
+ * Each sensor's consumer pushes its frames and keeps the packets until the
+ * synchronizer releases them. A frame joins the pending group whose capture
+ * time is within the tolerance and that has no frame of its sensor yet. A
+ * group is delivered to the callback once every registered sensor is in it.
+ * It is closed early when all of its missing sensors have moved past it, when
+ * it waited longer than max_wait_ms, when more than max_pending groups are
+ * buffered, or when a newer group completes. A closed group with at least
+ * min_sensors frames is delivered as partial, a smaller one is released
+ * without a callback. Groups are delivered in capture order.
+ * Push() may be called from any consumer thread. The callback and the
+ * releases run on the pushing thread with the synchronizer locked, so the
+ * callback must not block for long. Needs no NVIDIA headers or libraries,
+ * nvsipl_frame_sync_test drives it with simulated sensors. */
+class CFrameSync
+{
+public:
+    typedef struct {
+        uint64_t complete;
+        uint64_t partial;
+        uint64_t dropped;
+        uint64_t late; // frames whose group was already closed
+    } SyncCounts;
+
+    // The process shares GetInstance(), a test builds its own synchronizers
+    CFrameSync(void) = default;
+    static CFrameSync &GetInstance(void);
+
+    void Configure(const SyncConfig &config);
+    void SetGroupCallback(SyncGroupCallback callback);
+
+    // Registration is a setup-time operation. Removing a sensor drops its
+    // pending frames without releasing them, for stream teardown.
+    void AddSensor(uint32_t uSensor, SyncReleaseFunc release);
+    void RemoveSensor(uint32_t uSensor);
+    bool HasSensors(void);
+
+    void Push(const SyncFrame &frame);
+    // Closes every pending group, e.g. before the streams stop.
+    void Flush(void);
+
+    // Groups, match rate, wait and skew since the previous report.
+    void Report(std::ostream &os, double elapsedSec);
+    // Totals since the synchronizer was created
+    SyncCounts GetCounts(void);
+
+private:
+    typedef struct {
+        uint64_t captureNs;
+        uint64_t firstPushNs;
+        uint32_t sensorMask;
+        SyncFrame frames[MAX_NUM_SENSORS];
+    } PendingGroup;
+
+    void DeliverReady(uint64_t nowNs);
+    bool IsClosed(const PendingGroup &group, uint64_t nowNs) const;
+    void Close(PendingGroup &group, uint64_t nowNs);
+    void Release(const SyncFrame &frame);
+
+    std::mutex m_mutex;
+    SyncConfig m_config {};
+    uint64_t m_toleranceNs = 0U;
+    uint64_t m_maxWaitNs = 0U;
+    SyncGroupCallback m_callback;
+    SyncReleaseFunc m_releasers[MAX_NUM_SENSORS];
+    uint32_t m_sensorMask = 0U;
+    uint64_t m_lastCaptureNs[MAX_NUM_SENSORS] {};
+    uint64_t m_lastClosedNs = 0U;
+    std::deque<PendingGroup> m_groups;
+
+    CMetric m_completeMetric;
+    CMetric m_partialMetric;
+    CMetric m_droppedMetric;
+    CMetric m_lateMetric;
+    CLatencyHistogram m_waitHistogram; // first push to delivery
+    CLatencyHistogram m_skewHistogram; // capture spread within a delivered group
+
+    SyncCounts m_counts {};
+    SyncCounts m_prevCounts {};
+};
+
+#endif
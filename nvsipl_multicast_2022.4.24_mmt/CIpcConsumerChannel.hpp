@@ -20,11 +20,13 @@ class CIpcConsumerChannel: public CChannel
 public:
     CIpcConsumerChannel() = delete;
     CIpcConsumerChannel(NvSciBufModule& bufMod,
-        NvSciSyncModule& syncMod, SensorInfo *pSensorInfo, ConsumerType consumerType,uint32_t consumerId) :
-        CChannel("IpcConsChan", bufMod, syncMod, pSensorInfo)
+        NvSciSyncModule& syncMod, SensorInfo *pSensorInfo, ConsumerType consumerType,uint32_t consumerId,
+        CEventReactor *pReactor) :
+        CChannel("IpcConsChan", bufMod, syncMod, pSensorInfo, pReactor)
     {
         m_consumerType = consumerType;
-        m_dstChannel = "nvscistream_" + std::to_string(pSensorInfo->id * NUM_CONSUMERS * 2 + 2 * consumerId + 1);
+        m_consumerId = consumerId;
+        m_dstChannel = "nvscistream_" + std::to_string(pSensorInfo->id * MAX_IPC_CONSUMERS * 2 + 2 * consumerId + 1);
         m_dstIpcHandle = 0U;
     }
 
@@ -50,7 +52,25 @@ public:
     {
         PLOG_DBG("CreateBlocks.\n");
 
-        m_upConsumer = CFactory::CreateConsumer(m_consumerType, m_pSensorInfo);
+        // The producer process decides which endpoints exist, how frames are consumed is ours to pick
+        ConsumerConfig config { m_consumerType, QueueType::MAILBOX, { 0.0, false }, 0.0, 0U, 1U };
+        bool bListed = false;
+        for (const auto &endpoint : CTopology::GetInstance().GetSensor(m_pSensorInfo->id).vIpcEndpoints) {
+            if (endpoint.id == m_consumerId) {
+                config.queueType = endpoint.queueType;
+                config.decimation = endpoint.decimation;
+                config.deadlineMs = endpoint.deadlineMs;
+                config.pyramidLevels = endpoint.pyramidLevels;
+                config.inFlight = endpoint.inFlight;
+                bListed = true;
+            }
+        }
+        if (m_consumerId >= MAX_IPC_CONSUMERS || (!bListed && CTopology::GetInstance().IsLoaded())) {
+            PLOG_ERR("Topology lists no IPC endpoint %u for sensor %u.\n", m_consumerId, m_pSensorInfo->id);
+            return NVSIPL_STATUS_BAD_ARGUMENT;
+        }
+
+        m_upConsumer = CFactory::CreateConsumer(config, m_pSensorInfo);
         PCHK_PTR_AND_RETURN(m_upConsumer, "CFactory::CreateConsumer");
         m_upConsumer->SetProfiler(pProfiler);
         PLOG_DBG((m_upConsumer->GetName() + " is created.\n").c_str());
@@ -84,7 +104,7 @@ public:
         PLOG_DBG("Queue is connected.\n");
 
         PLOG_DBG("Query consumer connection.\n");
-        sciErr = NvSciStreamBlockEventQuery(m_upConsumer->GetHandle(), QUERY_TIMEOUT_FOREVER, &event);
+        sciErr = m_upConsumer->QueryEvent(QUERY_TIMEOUT_FOREVER, &event);
         PCHK_NVSCICONNECT_AND_RETURN(sciErr, event, "consumer");
         PLOG_DBG("Consumer is connected.\n");
         LOG_MSG((m_upConsumer->GetName() + " is connected to the stream!\n").c_str());
@@ -103,13 +123,14 @@ public:
     }
 
 protected:
-    virtual void GetEventThreadHandlers(bool isStreamRunning, std::vector<CEventHandler*>& vEventHandlers)
+    virtual void GetEventHandlers(bool isStreamRunning, std::vector<CEventHandler*>& vEventHandlers)
     {
         vEventHandlers.push_back(m_upConsumer.get());
     }
 
 private:
     ConsumerType m_consumerType;
+    uint32_t m_consumerId;
     std::unique_ptr<CConsumer> m_upConsumer = nullptr;
     NvSciStreamBlock m_dstIpcHandle;
     string m_dstChannel;
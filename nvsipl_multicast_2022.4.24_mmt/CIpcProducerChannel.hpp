@@ -21,14 +21,14 @@ class CIpcProducerChannel: public CChannel
 public:
     CIpcProducerChannel() = delete;
     CIpcProducerChannel(NvSciBufModule& bufMod,
-        NvSciSyncModule& syncMod, SensorInfo *pSensorInfo, INvSIPLCamera* pCamera) :
-        CChannel("IpcProdChan", bufMod, syncMod, pSensorInfo)
+        NvSciSyncModule& syncMod, SensorInfo *pSensorInfo, INvSIPLCamera* pCamera, CEventReactor *pReactor) :
+        CChannel("IpcProdChan", bufMod, syncMod, pSensorInfo, pReactor)
     {
         m_pCamera = pCamera;
-        for (auto i = 0U; i < NUM_CONSUMERS; i++) {
-            m_srcChannels[i] = "nvscistream_" + std::to_string(pSensorInfo->id * NUM_CONSUMERS * 2 + 2*i + 0);
-            m_srcIpcHandles[i] = 0U;
+        for (const auto &endpoint : CTopology::GetInstance().GetSensor(pSensorInfo->id).vIpcEndpoints) {
+            m_vSrcChannels.push_back("nvscistream_" + std::to_string(pSensorInfo->id * MAX_IPC_CONSUMERS * 2 + 2 * endpoint.id + 0));
         }
+        m_vSrcIpcHandles.assign(m_vSrcChannels.size(), 0U);
     }
 
     ~CIpcProducerChannel(void)
@@ -54,9 +54,9 @@ public:
                 (void)NvSciStreamBlockDelete(pConsumer->GetQueueHandle());
             }
         }
-        for (auto i = 0U; i < NUM_CONSUMERS; i++) {
-            if (m_srcIpcHandles[i] != 0U) {
-                (void)NvSciStreamBlockDelete(m_srcIpcHandles[i]);
+        for (auto srcIpcHandle : m_vSrcIpcHandles) {
+            if (srcIpcHandle != 0U) {
+                (void)NvSciStreamBlockDelete(srcIpcHandle);
             }
         }
     }
@@ -75,7 +75,9 @@ public:
     {
         PLOG_DBG("CreateBlocks.\n");
 
-        m_upPoolManager = CFactory::CreatePoolManager(m_pSensorInfo->id);
+        const SensorTopology &topology = CTopology::GetInstance().GetSensor(m_pSensorInfo->id);
+
+        m_upPoolManager = CFactory::CreatePoolManager(m_pSensorInfo->id, topology.numPackets);
         PCHK_PTR_AND_RETURN(m_upPoolManager, "CFactory::CreatePoolManager");
         PLOG_DBG("PoolManager is created.\n");
 
@@ -84,31 +86,27 @@ public:
         m_upPoducer->SetProfiler(pProfiler);
         PLOG_DBG("Producer is created.\n");
 
-        if (NUM_CONSUMERS + NUM_LOCAL_CUDA_CONSUMERS + NUM_LOCAL_ENC_CONSUMERS > 1){
-            auto status = CFactory::CreateMulticastBlock(NUM_CONSUMERS+NUM_LOCAL_CONSUMERS, m_multicastHandle);
+        uint32_t numDownstream = (uint32_t)(topology.vLocalConsumers.size() + m_vSrcChannels.size());
+        if (numDownstream > 1U) {
+            auto status = CFactory::CreateMulticastBlock(numDownstream, m_multicastHandle);
             PCHK_STATUS_AND_RETURN(status, "CFactory::CreateMulticastBlock");
             PLOG_DBG("Multicast block is created.\n");
         }
 
         //add inside consumer  by zhl
-        if(NUM_LOCAL_CUDA_CONSUMERS > 0){
-            std::unique_ptr<CConsumer> upCUDAConsumer = CFactory::CreateConsumer(CUDA_CONSUMER, m_pSensorInfo);
-            PCHK_PTR_AND_RETURN(upCUDAConsumer, "CFactory::Create CUDA consumer.");
-            m_vClients.push_back(std::move(upCUDAConsumer));
-            printf("CUDA inside consumer is created.\n");
-        }
-        if(NUM_LOCAL_ENC_CONSUMERS > 0){
-            std::unique_ptr<CConsumer> upEncConsumer = CFactory::CreateConsumer(ENC_CONSUMER, m_pSensorInfo);
-            PCHK_PTR_AND_RETURN(upEncConsumer, "CFactory::Create encoder consumer.");
-            m_vClients.push_back(std::move(upEncConsumer));
-            PLOG_DBG("Encoder inside consumer is created.\n");
-            //add end
+        for (const auto &consumer : topology.vLocalConsumers) {
+            std::unique_ptr<CConsumer> upConsumer = CFactory::CreateConsumer(consumer, m_pSensorInfo);
+            PCHK_PTR_AND_RETURN(upConsumer, "CFactory::CreateConsumer");
+            upConsumer->SetProfiler(pProfiler);
+            PLOG_DBG("%s inside consumer is created.\n", upConsumer->GetName().c_str());
+            m_vClients.push_back(std::move(upConsumer));
         }
+        //add end
 
-        for (auto i = 0U; i < NUM_CONSUMERS; i++) {
-            auto status = CFactory::CreateIpcBlock(m_syncModule, m_bufModule, m_srcChannels[i].c_str(), true, &m_srcIpcHandles[i]);
+        for (auto i = 0U; i < m_vSrcChannels.size(); i++) {
+            auto status = CFactory::CreateIpcBlock(m_syncModule, m_bufModule, m_vSrcChannels[i].c_str(), true, &m_vSrcIpcHandles[i]);
             PCHK_STATUS_AND_RETURN(status, "CFactory::Create ipc src Block");
-            PLOG_DBG("Ipc src block: %u is created.\n", i);
+            PLOG_DBG("Ipc src block: %s is created.\n", m_vSrcChannels[i].c_str());
         }
 
         return NVSIPL_STATUS_OK;
@@ -120,10 +118,12 @@ public:
 
         PLOG_DBG("Connect.\n");
 
-        if (NUM_CONSUMERS == 1U){
-            auto sciErr = NvSciStreamBlockConnect(m_upPoducer->GetHandle(), m_srcIpcHandles[0]);
-            PCHK_NVSCISTATUS_AND_RETURN(sciErr, "Producer connect to ipc src");
-            PLOG_DBG("Producer is connected to ipc src.\n");
+        if (m_multicastHandle == 0U) {
+            // A single downstream block needs no multicast
+            NvSciStreamBlock downstream = m_vClients.empty() ? m_vSrcIpcHandles[0] : m_vClients[0]->GetHandle();
+            auto sciErr = NvSciStreamBlockConnect(m_upPoducer->GetHandle(), downstream);
+            PCHK_NVSCISTATUS_AND_RETURN(sciErr, "Producer connect to downstream");
+            PLOG_DBG("Producer is connected to %s.\n", m_vClients.empty() ? "ipc src" : "inside consumer");
         } else {
             //connect producer with multicast
             auto sciErr = NvSciStreamBlockConnect(m_upPoducer->GetHandle(), m_multicastHandle);
@@ -138,8 +138,8 @@ public:
             }
             //add end
 
-            for (auto i = 0U; i < NUM_CONSUMERS; i++) {
-                sciErr = NvSciStreamBlockConnect(m_multicastHandle, m_srcIpcHandles[i]);
+            for (auto i = 0U; i < m_vSrcIpcHandles.size(); i++) {
+                sciErr = NvSciStreamBlockConnect(m_multicastHandle, m_vSrcIpcHandles[i]);
                 PCHK_NVSCISTATUS_AND_RETURN(sciErr, "Multicast connect to ipc src");
                 PLOG_DBG("Multicast is connected to ipc src: %u\n", i);
             }
@@ -148,12 +148,12 @@ public:
         LOG_MSG("Producer is connecting to the stream...\n");
         //query producer
         PLOG_DBG("Query producer connection.\n");
-        auto sciErr = NvSciStreamBlockEventQuery(m_upPoducer->GetHandle(), QUERY_TIMEOUT_FOREVER, &event);
+        auto sciErr = m_upPoducer->QueryEvent(QUERY_TIMEOUT_FOREVER, &event);
         PCHK_NVSCICONNECT_AND_RETURN(sciErr, event, "Producer");
         PLOG_DBG("Producer is connected.\n");
 
         PLOG_DBG("Query pool connection.\n");
-        sciErr = NvSciStreamBlockEventQuery(m_upPoolManager->GetHandle(), QUERY_TIMEOUT_FOREVER, &event);
+        sciErr = m_upPoolManager->QueryEvent(QUERY_TIMEOUT_FOREVER, &event);
         PCHK_NVSCICONNECT_AND_RETURN(sciErr, event, "Pool");
         PLOG_DBG("Pool is connected.\n");
 
@@ -166,7 +166,7 @@ public:
             PCHK_NVSCICONNECT_AND_RETURN(sciErr, event, "queue");
             //printf("Queue:%u is connected.\n", i);
 
-            sciErr = NvSciStreamBlockEventQuery(pConsumer->GetHandle(), QUERY_TIMEOUT_FOREVER, &event);
+            sciErr = pConsumer->QueryEvent(QUERY_TIMEOUT_FOREVER, &event);
             PCHK_NVSCICONNECT_AND_RETURN(sciErr, event, "consumer");
             printf("inside Consumer:%u is connected.\n", i);
         }
@@ -174,8 +174,8 @@ public:
 
 
         //query consumers and queues
-        for (auto i = 0U; i < NUM_CONSUMERS; i++) {
-            sciErr = NvSciStreamBlockEventQuery(m_srcIpcHandles[i], QUERY_TIMEOUT_FOREVER, &event);
+        for (auto i = 0U; i < m_vSrcIpcHandles.size(); i++) {
+            sciErr = NvSciStreamBlockEventQuery(m_vSrcIpcHandles[i], QUERY_TIMEOUT_FOREVER, &event);
             PCHK_NVSCICONNECT_AND_RETURN(sciErr, event, "Ipc src");
             PLOG_DBG("Ipc src: %u is connected.\n", i);
         }
@@ -213,7 +213,7 @@ public:
     }
 
 protected:
-    virtual void GetEventThreadHandlers(bool isStreamRunning, std::vector<CEventHandler*>& vEventHandlers)
+    virtual void GetEventHandlers(bool isStreamRunning, std::vector<CEventHandler*>& vEventHandlers)
     {
         if (!isStreamRunning) {
             vEventHandlers.push_back(m_upPoolManager.get());
@@ -233,8 +233,8 @@ private:
     unique_ptr<CPoolManager> m_upPoolManager = nullptr;
     NvSciStreamBlock m_multicastHandle = 0U;
     std::unique_ptr<CProducer> m_upPoducer = nullptr;
-    NvSciStreamBlock m_srcIpcHandles[NUM_CONSUMERS];
-    string m_srcChannels[NUM_CONSUMERS];
+    vector<NvSciStreamBlock> m_vSrcIpcHandles;
+    vector<string> m_vSrcChannels;
     vector<unique_ptr<CClientCommon>> m_vClients; //add by zhl
 };
 
@@ -0,0 +1,239 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CLatencyStats.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <time.h>
+
+static const char *const STAGE_NAMES[LATENCY_STAGE_COUNT] = {
+    "capture->post", "post->present", "present->acquire", "acquire->start",
+    "process",       "end->release",  "capture->done"
+};
+
+#if defined(__aarch64__)
+static inline uint64_t ReadCounter(void)
+{
+    uint64_t value;
+    __asm__ volatile("isb; mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+}
+
+static inline uint64_t ReadCounterFreq(void)
+{
+    uint64_t value;
+    __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(value));
+    return value;
+}
+
+uint64_t CTimeBase::NowNs(void)
+{
+    return TscToNs(ReadCounter());
+}
+
+uint64_t CTimeBase::TscToNs(uint64_t tsc)
+{
+    static const uint64_t freq = ReadCounterFreq();
+    // Split to avoid overflowing tsc * 1e9
+    return (tsc / freq) * 1000000000ULL + ((tsc % freq) * 1000000000ULL) / freq;
+}
+
+uint64_t CTimeBase::NowTicks(void)
+{
+    return ReadCounter();
+}
+
+uint64_t CTimeBase::TicksPerSecond(void)
+{
+    return ReadCounterFreq();
+}
+#else
+uint64_t CTimeBase::NowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t CTimeBase::TscToNs(uint64_t tsc)
+{
+    return tsc;
+}
+
+uint64_t CTimeBase::NowTicks(void)
+{
+    return NowNs();
+}
+
+uint64_t CTimeBase::TicksPerSecond(void)
+{
+    return 1000000000ULL;
+}
+#endif
+
+CLatencyHistogram::CLatencyHistogram(void) :
+    m_upCounts(new std::atomic<uint64_t>[LATENCY_NUM_BUCKETS]),
+    m_upPrevCounts(new uint64_t[LATENCY_NUM_BUCKETS]())
+{
+    for (uint32_t i = 0U; i < LATENCY_NUM_BUCKETS; i++) {
+        m_upCounts[i].store(0U, std::memory_order_relaxed);
+    }
+}
+
+uint32_t CLatencyHistogram::BucketIndex(uint64_t valueNs)
+{
+    if (valueNs < LATENCY_SUB_BUCKETS) {
+        return (uint32_t)valueNs;
+    }
+    uint32_t exp = 63U - (uint32_t)__builtin_clzll(valueNs);
+    if (exp > LATENCY_MAX_EXP) {
+        return LATENCY_NUM_BUCKETS - 1U;
+    }
+    uint32_t sub = (uint32_t)(valueNs >> (exp - LATENCY_SUB_BUCKET_BITS)) - LATENCY_SUB_BUCKETS;
+    return (exp - LATENCY_SUB_BUCKET_BITS + 1U) * LATENCY_SUB_BUCKETS + sub;
+}
+
+uint64_t CLatencyHistogram::BucketValue(uint32_t index)
+{
+    if (index < LATENCY_SUB_BUCKETS) {
+        return index;
+    }
+    uint32_t shift = index / LATENCY_SUB_BUCKETS - 1U;
+    uint64_t lower = (uint64_t)(LATENCY_SUB_BUCKETS + index % LATENCY_SUB_BUCKETS) << shift;
+    return lower + ((1ULL << shift) >> 1U);
+}
+
+void CLatencyHistogram::Record(uint64_t valueNs)
+{
+    // Single writer, a plain load and store is enough
+    std::atomic<uint64_t> &count = m_upCounts[BucketIndex(valueNs)];
+    count.store(count.load(std::memory_order_relaxed) + 1U, std::memory_order_relaxed);
+
+    uint64_t curMax = m_intervalMax.load(std::memory_order_relaxed);
+    while (valueNs > curMax && !m_intervalMax.compare_exchange_weak(curMax, valueNs, std::memory_order_relaxed)) {
+    }
+}
+
+LatencySummary CLatencyHistogram::ReadInterval(void)
+{
+    LatencySummary summary {};
+    std::unique_ptr<uint64_t[]> upDelta(new uint64_t[LATENCY_NUM_BUCKETS]);
+
+    for (uint32_t i = 0U; i < LATENCY_NUM_BUCKETS; i++) {
+        uint64_t count = m_upCounts[i].load(std::memory_order_relaxed);
+        upDelta[i] = count - m_upPrevCounts[i];
+        m_upPrevCounts[i] = count;
+        summary.count += upDelta[i];
+    }
+    summary.maxNs = m_intervalMax.exchange(0U, std::memory_order_relaxed);
+    if (summary.count == 0U) {
+        return summary;
+    }
+
+    const uint64_t rank50 = (summary.count * 500U + 999U) / 1000U;
+    const uint64_t rank99 = (summary.count * 990U + 999U) / 1000U;
+    const uint64_t rank999 = (summary.count * 999U + 999U) / 1000U;
+    uint64_t seen = 0U;
+    for (uint32_t i = 0U; i < LATENCY_NUM_BUCKETS && seen < rank999; i++) {
+        if (upDelta[i] == 0U) {
+            continue;
+        }
+        seen += upDelta[i];
+        uint64_t value = BucketValue(i);
+        if (summary.p50Ns == 0U && seen >= rank50) {
+            summary.p50Ns = value;
+        }
+        if (summary.p99Ns == 0U && seen >= rank99) {
+            summary.p99Ns = value;
+        }
+        if (seen >= rank999) {
+            summary.p999Ns = value;
+        }
+    }
+    // Bucket midpoints may overshoot the largest exact value
+    if (summary.maxNs > 0U) {
+        summary.p50Ns = std::min(summary.p50Ns, summary.maxNs);
+        summary.p99Ns = std::min(summary.p99Ns, summary.maxNs);
+        summary.p999Ns = std::min(summary.p999Ns, summary.maxNs);
+    }
+
+    return summary;
+}
+
+CLatencyStats::CLatencyStats(const std::string &name) :
+    m_name(name)
+{
+}
+
+static void RecordStage(CLatencyHistogram &histogram, uint64_t beginNs, uint64_t endNs)
+{
+    // Skip stages that were not stamped, or clocks from different domains
+    if (beginNs != 0U && endNs >= beginNs) {
+        histogram.Record(endNs - beginNs);
+    }
+}
+
+void CLatencyStats::Record(const FrameTimestamps &ts)
+{
+    RecordStage(m_histograms[LATENCY_CAPTURE_TO_POST], ts.captureNs, ts.postNs);
+    RecordStage(m_histograms[LATENCY_POST_TO_PRESENT], ts.postNs, ts.presentNs);
+    RecordStage(m_histograms[LATENCY_PRESENT_TO_ACQUIRE], ts.presentNs, ts.acquireNs);
+    RecordStage(m_histograms[LATENCY_ACQUIRE_TO_START], ts.acquireNs, ts.startNs);
+    RecordStage(m_histograms[LATENCY_PROCESS], ts.startNs, ts.endNs);
+    RecordStage(m_histograms[LATENCY_END_TO_RELEASE], ts.endNs, ts.releaseNs);
+    // Fall back to the acquire time when the producer did not stamp the capture
+    RecordStage(m_histograms[LATENCY_CAPTURE_TO_DONE], (ts.captureNs != 0U) ? ts.captureNs : ts.acquireNs,
+                ts.releaseNs);
+}
+
+void CLatencyStats::RecordQueueDrops(uint64_t drops)
+{
+    // Only the consumer's event thread writes
+    m_queueDrops.store(m_queueDrops.load(std::memory_order_relaxed) + drops, std::memory_order_relaxed);
+}
+
+void CLatencyStats::RecordStale(uint64_t ageNs)
+{
+    m_staleAges.Record(ageNs);
+}
+
+void CLatencyStats::Report(std::ostream &os, double elapsedSec)
+{
+    LatencySummary summaries[LATENCY_STAGE_COUNT];
+    for (uint32_t i = 0U; i < LATENCY_STAGE_COUNT; i++) {
+        summaries[i] = m_histograms[i].ReadInterval();
+    }
+
+    const LatencySummary &total = summaries[LATENCY_CAPTURE_TO_DONE];
+    uint64_t queueDrops = m_queueDrops.load(std::memory_order_relaxed);
+    uint64_t intervalDrops = queueDrops - m_prevQueueDrops;
+    m_prevQueueDrops = queueDrops;
+    const LatencySummary stale = m_staleAges.ReadInterval();
+    auto ms = [](uint64_t ns) { return ns / 1000000.0; };
+    std::ios::fmtflags flags = os.flags();
+    std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+    os << m_name << "\tframes " << total.count << ", " << ((elapsedSec > 0.0) ? total.count / elapsedSec : 0.0)
+       << " fps, " << intervalDrops << " dropped in queue, " << stale.count
+       << " stale, latency (ms) p50/p99/p99.9/max" << std::endl;
+    for (uint32_t i = 0U; i < LATENCY_STAGE_COUNT; i++) {
+        const LatencySummary &s = summaries[i];
+        if (s.count == 0U) {
+            continue;
+        }
+        os << "    " << std::left << std::setw(18) << STAGE_NAMES[i] << std::right << ms(s.p50Ns) << " / "
+           << ms(s.p99Ns) << " / " << ms(s.p999Ns) << " / " << ms(s.maxNs) << std::endl;
+    }
+    if (stale.count != 0U) {
+        os << "    " << std::left << std::setw(18) << "stale age" << std::right << ms(stale.p50Ns) << " / "
+           << ms(stale.p99Ns) << " / " << ms(stale.p999Ns) << " / " << ms(stale.maxNs) << std::endl;
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CLATENCYSTATS_HPP
+#define CLATENCYSTATS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+
+/* Timestamps in the capture clock domain.
+ * On Tegra the ARM generic timer counts the same TSC that SIPL stamps into
+ * frameCaptureTSC, so stamps taken in different processes can be subtracted
+ * from each other and from the capture time. Elsewhere CLOCK_MONOTONIC is used
+ * and the capture stage is not meaningful. */
+class CTimeBase
+{
+public:
+    static uint64_t NowNs(void);
+    static uint64_t TscToNs(uint64_t tsc);
+    // Raw counter for recorders that convert offline
+    static uint64_t NowTicks(void);
+    static uint64_t TicksPerSecond(void);
+};
+
+// Log-linear buckets: 2^LATENCY_SUB_BUCKET_BITS per power of two, so every
+// recorded value is kept within ~3% of its true value up to 2^LATENCY_MAX_EXP ns.
+constexpr uint32_t LATENCY_SUB_BUCKET_BITS = 5U;
+constexpr uint32_t LATENCY_SUB_BUCKETS = 1U << LATENCY_SUB_BUCKET_BITS;
+constexpr uint32_t LATENCY_MAX_EXP = 40U;
+constexpr uint32_t LATENCY_NUM_BUCKETS = (LATENCY_MAX_EXP - LATENCY_SUB_BUCKET_BITS + 2U) * LATENCY_SUB_BUCKETS;
+
+typedef struct {
+    uint64_t count;
+    uint64_t p50Ns;
+    uint64_t p99Ns;
+    uint64_t p999Ns;
+    uint64_t maxNs;
+} LatencySummary;
+
+/* HDR-style histogram of nanosecond values.
+ * One thread records, one other thread reads interval summaries. Counts are
+ * cumulative; the reader diffs them against its previous read, so nothing is
+ * ever reset under the writer. */
+class CLatencyHistogram
+{
+public:
+    CLatencyHistogram(void);
+
+    CLatencyHistogram(const CLatencyHistogram &) = delete;
+    CLatencyHistogram &operator=(const CLatencyHistogram &) = delete;
+
+    void Record(uint64_t valueNs);
+    // Summary of the values recorded since the previous call.
+    LatencySummary ReadInterval(void);
+
+    static uint32_t BucketIndex(uint64_t valueNs);
+    // Middle of the bucket's value range
+    static uint64_t BucketValue(uint32_t index);
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> m_upCounts;
+    std::atomic<uint64_t> m_intervalMax {0U};
+    std::unique_ptr<uint64_t[]> m_upPrevCounts; // reader only
+};
+
+enum LatencyStage
+{
+    LATENCY_CAPTURE_TO_POST = 0, // SIPL capture to producer Post()
+    LATENCY_POST_TO_PRESENT,     // ISP done, fences set
+    LATENCY_PRESENT_TO_ACQUIRE,  // stream delivery
+    LATENCY_ACQUIRE_TO_START,    // prefence handling
+    LATENCY_PROCESS,             // ProcessPayload()
+    LATENCY_END_TO_RELEASE,      // CPU wait, OnProcessPayloadDone()
+    LATENCY_CAPTURE_TO_DONE,     // end to end
+    LATENCY_STAGE_COUNT
+};
+
+// One frame's way through the stream. Zero means not stamped.
+typedef struct {
+    uint64_t captureNs;
+    uint64_t postNs;
+    uint64_t presentNs;
+    uint64_t acquireNs;
+    uint64_t startNs;
+    uint64_t endNs;
+    uint64_t releaseNs;
+} FrameTimestamps;
+
+// Per consumer latency histograms, recorded by one thread at a time: the
+// consumer's event thread or the fence completer finishing its frame.
+class CLatencyStats
+{
+public:
+    explicit CLatencyStats(const std::string &name);
+
+    void Record(const FrameTimestamps &ts);
+    // Frames the consumer's queue dropped before they were acquired
+    void RecordQueueDrops(uint64_t drops);
+    // Capture age of a frame released unprocessed because it missed its deadline
+    void RecordStale(uint64_t ageNs);
+    // One line per stage, for the frames since the previous report.
+    void Report(std::ostream &os, double elapsedSec);
+
+    const std::string &GetName(void) const
+    {
+        return m_name;
+    }
+
+private:
+    std::string m_name;
+    CLatencyHistogram m_histograms[LATENCY_STAGE_COUNT];
+    CLatencyHistogram m_staleAges;
+    std::atomic<uint64_t> m_queueDrops {0U};
+    uint64_t m_prevQueueDrops = 0U; // reader only
+};
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2022, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#include "CLogger.hpp"
+#include <cstdio>
+#include <sys/time.h>
+
+// Log utils
+CLogger& CLogger::GetInstance()
+{
+    static CLogger instance;
+    return instance;
+}
+
+std::atomic<int> CLogger::s_level {LEVEL_ERR};
+
+static uint64_t NowUs(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (uint64_t)tv.tv_sec * 1000000U + (uint64_t)tv.tv_usec;
+}
+
+void CLogger::SetLogLevel(LogLevel level)
+{
+    s_level.store((level > LEVEL_DBG) ? LEVEL_DBG : level, std::memory_order_relaxed);
+}
+
+CLogger::LogLevel CLogger::GetLogLevel(void)
+{
+    return (LogLevel)s_level.load(std::memory_order_relaxed);
+}
+
+void CLogger::SetLogStyle(LogStyle style)
+{
+    m_style = (style > LOG_STYLE_FUNCTION_LINE) ? LOG_STYLE_FUNCTION_LINE
+                                                : style;
+}
+
+void CLogger::StartAsync(void)
+{
+    m_asyncLog.Start(m_style == LOG_STYLE_FUNCTION_LINE);
+}
+
+void CLogger::StopAsync(void)
+{
+    m_asyncLog.Stop();
+}
+
+void CLogger::Output(const LogRecordInfo &info, const char *prefix, const char *format, va_list ap)
+{
+    if (m_asyncLog.IsRunning()) {
+        va_list apCopy;
+        va_copy(apCopy, ap);
+        bool bQueued = m_asyncLog.Push(info, prefix, format, apCopy);
+        va_end(apCopy);
+        if (bQueued) {
+            return;
+        }
+    }
+
+    // Before StartAsync(), after StopAsync() and for oversized records
+    char message[LOG_MAX_LINE];
+    vsnprintf(message, sizeof(message), format, ap);
+    std::string line = CAsyncLog::FormatLine(info, prefix, message, m_style == LOG_STYLE_FUNCTION_LINE);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    fwrite(line.data(), 1U, line.size(), stdout);
+    fflush(stdout);
+}
+
+void CLogger::LogLevelMessageVa(LogLevel level, const char *functionName,
+                                       uint32_t lineNumber, const char *prefix, const char *format,
+                                                                    va_list ap)
+{
+    if (!IsEnabled(level)) {
+        return;
+    }
+
+    const char *levelTag = "";
+    switch (level) {
+        case LEVEL_ERR:
+            levelTag = "ERROR: ";
+            break;
+        case LEVEL_WARN:
+            levelTag = "WARNING: ";
+            break;
+        default:
+            break;
+    }
+
+    Output(LogRecordInfo{ NowUs(), levelTag, functionName, lineNumber }, prefix, format, ap);
+}
+
+void CLogger::LogLevelMessage(LogLevel level, const char *functionName,
+                               uint32_t lineNumber, const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    LogLevelMessageVa(level, functionName, lineNumber, "", format, ap);
+    va_end(ap);
+}
+
+void CLogger::LogLevelMessage(LogLevel level, std::string functionName,
+                               uint32_t lineNumber, std::string format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    LogLevelMessageVa(level, functionName.c_str(), lineNumber, "",
+                                                       format.c_str(), ap);
+    va_end(ap);
+}
+
+void CLogger::PLogLevelMessage(LogLevel level, const char *functionName,
+                               uint32_t lineNumber, const std::string &prefix, const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    
+    LogLevelMessageVa(level, functionName, lineNumber, prefix.c_str(), format, ap);
+    va_end(ap);
+}
+
+void CLogger::PLogLevelMessage(LogLevel level, std::string functionName,
+                               uint32_t lineNumber, const std::string &prefix, std::string format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    LogLevelMessageVa(level, functionName.c_str(), lineNumber, prefix.c_str(),
+                                                       format.c_str(), ap);
+    va_end(ap);
+}
+
+void CLogger::LogMessageVa(const char *format, va_list ap)
+{
+    Output(LogRecordInfo{ NowUs(), nullptr, nullptr, 0U }, "", format, ap);
+}
+
+void CLogger::LogMessage(const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    LogMessageVa(format, ap);
+    va_end(ap);
+}
+
+void CLogger::LogMessage(std::string format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    LogMessageVa(format.c_str(), ap);
+    va_end(ap);
+}
+
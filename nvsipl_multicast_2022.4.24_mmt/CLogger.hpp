@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2022, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#ifndef CLOGGER_HPP
+#define CLOGGER_HPP
+
+// The LOG_* macros and CLogger without any NVIDIA header, for the modules that
+// also build on a host. CUtils.hpp includes it for everything else.
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "CAsyncLog.hpp"
+
+#define LINE_INFO __FUNCTION__, __LINE__
+
+// Levels above this are compiled out, e.g. make LOG_COMPILE_LEVEL=2 keeps errors and warnings
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 4
+#endif
+
+// Checked before any argument of a LOG_* macro is evaluated
+#define LOG_IS_ENABLED(level) \
+    (((int)(level) <= LOG_COMPILE_LEVEL) && CLogger::IsEnabled(level))
+
+#define LOG_LEVEL_MESSAGE(level, ...) \
+    do { \
+        if (LOG_IS_ENABLED(level)) { \
+            CLogger::GetInstance().LogLevelMessage((level), LINE_INFO, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define PLOG_LEVEL_MESSAGE(level, ...) \
+    do { \
+        if (LOG_IS_ENABLED(level)) { \
+            CLogger::GetInstance().PLogLevelMessage((level), LINE_INFO, m_name, __VA_ARGS__); \
+        } \
+    } while (0)
+
+//! Quick-log a message at debugging level
+#define LOG_DBG(...) LOG_LEVEL_MESSAGE(LEVEL_DBG, __VA_ARGS__)
+
+#define PLOG_DBG(...) PLOG_LEVEL_MESSAGE(LEVEL_DBG, __VA_ARGS__)
+
+//! Quick-log a message at info level
+#define LOG_INFO(...) LOG_LEVEL_MESSAGE(LEVEL_INFO, __VA_ARGS__)
+
+#define PLOG_INFO(...) PLOG_LEVEL_MESSAGE(LEVEL_INFO, __VA_ARGS__)
+
+//! Quick-log a message at warning level
+#define LOG_WARN(...) LOG_LEVEL_MESSAGE(LEVEL_WARN, __VA_ARGS__)
+
+#define PLOG_WARN(...) PLOG_LEVEL_MESSAGE(LEVEL_WARN, __VA_ARGS__)
+
+//! Quick-log a message at error level
+#define LOG_ERR(...) LOG_LEVEL_MESSAGE(LEVEL_ERR, __VA_ARGS__)
+
+#define PLOG_ERR(...) PLOG_LEVEL_MESSAGE(LEVEL_ERR, __VA_ARGS__)
+
+//! Quick-log a message at preset level
+#define LOG_MSG(...) \
+    CLogger::GetInstance().LogMessage(__VA_ARGS__)
+
+#define LEVEL_NONE CLogger::LogLevel::LEVEL_NO_LOG
+
+#define LEVEL_ERR CLogger::LogLevel::LEVEL_ERROR
+
+#define LEVEL_WARN CLogger::LogLevel::LEVEL_WARNING
+
+#define LEVEL_INFO CLogger::LogLevel::LEVEL_INFORMATION
+
+#define LEVEL_DBG CLogger::LogLevel::LEVEL_DEBUG
+
+//! \brief Logger utility class
+//! This is a singleton class - at most one instance can exist at all times.
+class CLogger
+{
+public:
+    //! enum describing the different levels for logging
+    enum LogLevel
+    {
+        /** no log */
+        LEVEL_NO_LOG = 0,
+        /** error level */
+        LEVEL_ERROR,
+        /** warning level */
+        LEVEL_WARNING,
+        /** info level */
+        LEVEL_INFORMATION,
+        /** debug level */
+        LEVEL_DEBUG
+    };
+
+    //! enum describing the different styles for logging
+    enum LogStyle
+    {
+        LOG_STYLE_NORMAL = 0,
+        LOG_STYLE_FUNCTION_LINE = 1
+    };
+
+    //! Get the logging instance.
+    //! \return Reference to the Logger object.
+    static CLogger& GetInstance();
+
+    //! Set the level for logging.
+    //! \param[in] eLevel The logging level.
+    void SetLogLevel(LogLevel eLevel);
+
+    //! Get the level for logging.
+    LogLevel GetLogLevel(void);
+
+    //! Whether messages of a level are logged, a single relaxed load.
+    static bool IsEnabled(LogLevel eLevel)
+    {
+        return (int)eLevel <= s_level.load(std::memory_order_relaxed);
+    }
+
+    //! Set the style for logging.
+    //! \param[in] eStyle The logging style.
+    void SetLogStyle(LogStyle eStyle);
+
+    //! Hand formatting and output to a writer thread, call after SetLogStyle().
+    void StartAsync(void);
+
+    //! Write what is queued and log synchronously again.
+    void StopAsync(void);
+
+    //! Log a message (cstring).
+    //! \param[in] eLevel The logging level,
+    //! \param[in] pszunctionName Name of the function as a cstring.
+    //! \param[in] sLineNumber Line number,
+    //! \param[in] pszFormat Format string as a cstring.
+    void LogLevelMessage(LogLevel eLevel,
+                         const char *pszFunctionName,
+                         uint32_t sLineNumber,
+                         const char *pszFormat,
+                         ...);
+
+    //! Log a message (C++ string).
+    //! \param[in] eLevel The logging level,
+    //! \param[in] sFunctionName Name of the function as a C++ string.
+    //! \param[in] sLineNumber Line number,
+    //! \param[in] sFormat Format string as a C++ string.
+    void LogLevelMessage(LogLevel eLevel,
+                         std::string sFunctionName,
+                         uint32_t sLineNumber,
+                         std::string sFormat,
+                         ...);
+
+    //! Log a message (cstring).
+    //! \param[in] eLevel The logging level,
+    //! \param[in] pszunctionName Name of the function as a cstring.
+    //! \param[in] sLineNumber Line number,
+    //! \param[in] prefix Prefix string.
+    //! \param[in] pszFormat Format string as a cstring.
+    void PLogLevelMessage(LogLevel eLevel,
+                         const char *pszFunctionName,
+                         uint32_t sLineNumber,
+                         const std::string &prefix,
+                         const char *pszFormat,
+                         ...);
+
+    //! Log a message (C++ string).
+    //! \param[in] eLevel The logging level,
+    //! \param[in] sFunctionName Name of the function as a C++ string.
+    //! \param[in] sLineNumber Line number,
+    //! \param[in] prefix Prefix string.
+    //! \param[in] sFormat Format string as a C++ string.
+    void PLogLevelMessage(LogLevel eLevel,
+                         std::string sFunctionName,
+                         uint32_t sLineNumber,
+                         const std::string &prefix,
+                         std::string sFormat,
+                         ...);
+
+    //! Log a message (cstring) at preset level.
+    //! \param[in] pszFormat Format string as a cstring.
+    void LogMessage(const char *pszFormat,
+                    ...);
+
+    //! Log a message (C++ string) at preset level.
+    //! \param[in] sFormat Format string as a C++ string.
+    void LogMessage(std::string sFormat,
+                    ...);
+
+private:
+    //! Need private constructor because this is a singleton.
+    CLogger() = default;
+    static std::atomic<int> s_level;
+    LogStyle m_style = LOG_STYLE_NORMAL;
+    CAsyncLog m_asyncLog;
+    std::mutex m_mutex; // serializes synchronous output
+
+    void Output(const LogRecordInfo &info,
+                const char *prefix,
+                const char *pszFormat,
+                va_list ap);
+
+    void LogLevelMessageVa(LogLevel eLevel,
+                           const char *pszFunctionName,
+                           uint32_t sLineNumber,
+                           const char *prefix,
+                           const char *pszFormat,
+                           va_list ap);
+    void LogMessageVa(const char *pszFormat,
+                      va_list ap);
+};
+// CLogger class
+
+#endif
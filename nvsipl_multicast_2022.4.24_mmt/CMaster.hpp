@@ -17,6 +17,9 @@
 #include "NvSIPLPipelineMgr.hpp"
 #include "CUtils.hpp"
 #include "CChannel.hpp"
+#include "CEventReactor.hpp"
+#include "CFenceCompleter.hpp"
+#include "CWorkerPool.hpp"
 #include "CSingleProcessChannel.hpp"
 #include "CIpcProducerChannel.hpp"
 #include "CIpcConsumerChannel.hpp"
@@ -42,12 +45,20 @@ class CMaster
     }
     ~CMaster(void)
     {
+        if (m_upReactor != nullptr) {
+            m_upReactor->Stop();
+        }
+        CWorkerPool::GetInstance().Stop();
+        CFenceCompleter::GetInstance().Stop();
+
         //need to release other nvsci resources before closing modules.
         for (auto i = 0U; i < MAX_NUM_SENSORS; i++) {
             if (nullptr != m_upChannels[i]) {
                 m_upChannels[i].reset();
             }
         }
+        // Block notifiers are gone with the channels, the event service can go now
+        m_upReactor.reset();
 
         LOG_DBG("CMaster release.\n");
 
@@ -61,7 +72,7 @@ class CMaster
           NvSciSyncModuleClose(m_sciSyncModule);
         }
     }
-    SIPLStatus Setup(bool bMultiProcess)
+    SIPLStatus Setup(bool bMultiProcess, uint32_t uNumEventLoops)
     {
         // Camera Master setup
         m_upCamera = INvSIPLCamera::GetInstance();
@@ -80,6 +91,10 @@ class CMaster
         auto nvmStatus = NvMediaImageNvSciBufInit();
         CHK_NVMSTATUS_AND_RETURN(nvmStatus, "NvMediaImageNvSciBufInit");
 
+        m_upReactor = std::make_unique<CEventReactor>();
+        auto status = m_upReactor->Init(uNumEventLoops);
+        CHK_STATUS_AND_RETURN(status, "CEventReactor Init");
+
         return NVSIPL_STATUS_OK;
     }
 
@@ -105,9 +120,13 @@ class CMaster
     {
         for (auto i = 0U; i < MAX_NUM_SENSORS; i++) {
             if (nullptr != m_upChannels[i]) {
-                m_upChannels[i]->Start();
+                auto status = m_upChannels[i]->Start();
+                CHK_STATUS_AND_RETURN(status, "Channel Start");
             }
         }
+        CFenceCompleter::GetInstance().Start();
+        CWorkerPool::GetInstance().Start();
+        m_upReactor->Start();
 
         return NVSIPL_STATUS_OK;
     }
@@ -121,11 +140,14 @@ class CMaster
 
     void StopStream(void)
     {
+        m_upReactor->Stop();
         for (auto i = 0U; i < MAX_NUM_SENSORS; i++) {
             if (nullptr != m_upChannels[i]) {
                 m_upChannels[i]->Stop();
             }
         }
+        CWorkerPool::GetInstance().Stop();
+        CFenceCompleter::GetInstance().Stop();
     }
 
     SIPLStatus StopPipeline(void)
@@ -173,8 +195,11 @@ class CMaster
 
         for (auto i = 0U; i < MAX_NUM_SENSORS; i++) {
             if (nullptr != m_upChannels[i]) {
+                auto status = m_upChannels[i]->AttachEventHandlers();
+                CHK_STATUS_AND_RETURN(status, "CMaster: Channel attach event handlers.");
+
                 LOG_MSG("m_upChannels[%d]->Connect() appType %u\n",i,m_appType);
-                auto status = m_upChannels[i]->Connect();
+                status = m_upChannels[i]->Connect();
                 CHK_STATUS_AND_RETURN(status, "CMaster: Channel connect.");
                 
                 LOG_MSG("m_upChannels[%d]->InitBlocks() appType %u\n",i,m_appType);
@@ -247,10 +272,12 @@ private:
     {
         if (m_appType == SINGLE_PROCESS) {
             return std::unique_ptr<CSingleProcessChannel>(
-                    new CSingleProcessChannel(m_sciBufModule, m_sciSyncModule, pSensorInfo, m_upCamera.get()));
+                    new CSingleProcessChannel(m_sciBufModule, m_sciSyncModule, pSensorInfo, m_upCamera.get(),
+                                              m_upReactor.get()));
         } else if (m_appType == IPC_SIPL_PRODUCER) {
             return std::unique_ptr<CIpcProducerChannel>(
-                    new CIpcProducerChannel(m_sciBufModule, m_sciSyncModule, pSensorInfo, m_upCamera.get()));
+                    new CIpcProducerChannel(m_sciBufModule, m_sciSyncModule, pSensorInfo, m_upCamera.get(),
+                                            m_upReactor.get()));
         } else {
             ConsumerType consumerType;
 
@@ -260,7 +287,8 @@ private:
                 return nullptr;
             } else {
                 return std::unique_ptr<CIpcConsumerChannel>(
-                    new CIpcConsumerChannel(m_sciBufModule, m_sciSyncModule, pSensorInfo, consumerType,consumerId));
+                    new CIpcConsumerChannel(m_sciBufModule, m_sciSyncModule, pSensorInfo, consumerType,consumerId,
+                                            m_upReactor.get()));
             }
         }
     }
@@ -270,6 +298,7 @@ private:
     NvSciSyncModule m_sciSyncModule {nullptr};
     NvSciBufModule m_sciBufModule {nullptr};
     unique_ptr<CChannel> m_upChannels[MAX_NUM_SENSORS] {nullptr};
+    unique_ptr<CEventReactor> m_upReactor {nullptr};
 };
 
 #endif //CMASTER_HPP
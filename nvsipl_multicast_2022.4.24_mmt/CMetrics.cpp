@@ -0,0 +1,283 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CMetrics.hpp"
+#include "CLogger.hpp"
+#include "CThreadPolicy.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+constexpr int METRICS_ACCEPT_POLL_MS = 200;
+constexpr int METRICS_REQUEST_POLL_MS = 50;
+
+thread_local CMetrics::MetricShard *CMetrics::s_pShard = nullptr;
+
+// Escapes a Prometheus label value or a JSON string, both use the same set
+static std::string Escape(const std::string &value)
+{
+    std::string escaped;
+    for (char c : value) {
+        switch (c) {
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            default:
+                escaped += c;
+                break;
+        }
+    }
+    return escaped;
+}
+
+static bool WriteAll(int fd, const std::string &data)
+{
+    size_t offset = 0U;
+    while (offset < data.size()) {
+        ssize_t ret = send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        offset += (size_t)ret;
+    }
+    return true;
+}
+
+CMetrics &CMetrics::GetInstance(void)
+{
+    static CMetrics instance;
+    return instance;
+}
+
+CMetrics::~CMetrics(void)
+{
+    StopExporter();
+    for (auto pShard : m_vpShards) {
+        free(pShard);
+    }
+}
+
+CMetric CMetrics::Register(const std::string &name, const std::string &help, MetricType type,
+                           const MetricLabels &labels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (uint32_t i = 0U; i < m_vInfos.size(); i++) {
+        if (m_vInfos[i].name == name && m_vInfos[i].labels == labels) {
+            return CMetric(i);
+        }
+    }
+    if (m_vInfos.size() >= METRICS_MAX) {
+        LOG_WARN("Metrics: no room for %s, it will not be reported\n", name.c_str());
+        return CMetric();
+    }
+
+    m_vInfos.push_back(MetricInfo{ name, help, type, labels });
+    return CMetric((uint32_t)m_vInfos.size() - 1U);
+}
+
+CMetrics::MetricShard *CMetrics::CreateShard(void)
+{
+    void *pMem = nullptr;
+    if (posix_memalign(&pMem, METRICS_CACHE_LINE, sizeof(MetricShard)) != 0) {
+        throw std::bad_alloc();
+    }
+    MetricShard *pShard = static_cast<MetricShard *>(pMem);
+    for (uint32_t i = 0U; i < METRICS_MAX; i++) {
+        new (&pShard->slots[i].value) std::atomic<int64_t>(0);
+    }
+
+    // Shards outlive their threads so the totals never go backwards
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_vpShards.push_back(pShard);
+    s_pShard = pShard;
+    return pShard;
+}
+
+int64_t CMetrics::Sum(uint32_t id)
+{
+    int64_t sum = 0;
+    for (auto pShard : m_vpShards) {
+        sum += pShard->slots[id].value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+int64_t CMetrics::Read(CMetric metric)
+{
+    if (metric.m_id >= METRICS_MAX) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return Sum(metric.m_id);
+}
+
+void CMetrics::WritePrometheus(std::ostream &os)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<bool> vWritten(m_vInfos.size(), false);
+
+    // Series of one name are grouped under a single HELP/TYPE header
+    for (uint32_t i = 0U; i < m_vInfos.size(); i++) {
+        if (vWritten[i]) {
+            continue;
+        }
+        const MetricInfo &family = m_vInfos[i];
+        os << "# HELP " << family.name << " " << family.help << "\n";
+        os << "# TYPE " << family.name << " " << ((family.type == MetricType::COUNTER) ? "counter" : "gauge") << "\n";
+        for (uint32_t j = i; j < m_vInfos.size(); j++) {
+            const MetricInfo &info = m_vInfos[j];
+            if (vWritten[j] || info.name != family.name) {
+                continue;
+            }
+            os << info.name;
+            for (size_t k = 0U; k < info.labels.size(); k++) {
+                os << ((k == 0U) ? "{" : ",") << info.labels[k].first << "=\"" << Escape(info.labels[k].second) << "\"";
+            }
+            os << (info.labels.empty() ? "" : "}") << " " << Sum(j) << "\n";
+            vWritten[j] = true;
+        }
+    }
+}
+
+void CMetrics::WriteJsonLine(std::ostream &os)
+{
+    auto nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    os << "{\"timestamp_ms\":" << nowMs << ",\"metrics\":[";
+    for (uint32_t i = 0U; i < m_vInfos.size(); i++) {
+        const MetricInfo &info = m_vInfos[i];
+        os << ((i == 0U) ? "" : ",") << "{\"name\":\"" << info.name << "\",\"labels\":{";
+        for (size_t k = 0U; k < info.labels.size(); k++) {
+            os << ((k == 0U) ? "" : ",") << "\"" << info.labels[k].first << "\":\"" << Escape(info.labels[k].second)
+               << "\"";
+        }
+        os << "},\"value\":" << Sum(i) << "}";
+    }
+    os << "]}\n";
+}
+
+bool CMetrics::StartExporter(const std::string &socketPath)
+{
+    struct sockaddr_un addr {};
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        LOG_ERR("Metrics: socket path too long: %s\n", socketPath.c_str());
+        return false;
+    }
+
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (m_listenFd < 0) {
+        LOG_ERR("Metrics: socket failed: %s\n", strerror(errno));
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1U);
+    // A stale socket of an earlier run would make bind() fail
+    unlink(socketPath.c_str());
+    if (bind(m_listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(m_listenFd, 4) != 0) {
+        LOG_ERR("Metrics: cannot listen on %s: %s\n", socketPath.c_str(), strerror(errno));
+        close(m_listenFd);
+        m_listenFd = -1;
+        return false;
+    }
+
+    m_socketPath = socketPath;
+    m_bExporterQuit.store(false, std::memory_order_release);
+    m_exporterThread = std::thread(&CMetrics::ExporterThreadFunc, this);
+    LOG_MSG("Metrics: serving on %s\n", socketPath.c_str());
+    return true;
+}
+
+void CMetrics::StopExporter(void)
+{
+    if (m_exporterThread.joinable()) {
+        m_bExporterQuit.store(true, std::memory_order_release);
+        m_exporterThread.join();
+    }
+    if (m_listenFd >= 0) {
+        close(m_listenFd);
+        m_listenFd = -1;
+        unlink(m_socketPath.c_str());
+    }
+}
+
+bool CMetrics::OpenJsonLog(const std::string &path)
+{
+    m_jsonLog.open(path, std::ios::out | std::ios::app);
+    if (!m_jsonLog.is_open()) {
+        LOG_ERR("Metrics: cannot open %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void CMetrics::AppendJsonLog(void)
+{
+    if (m_jsonLog.is_open()) {
+        WriteJsonLine(m_jsonLog);
+        m_jsonLog.flush();
+    }
+}
+
+void CMetrics::ExporterThreadFunc(void)
+{
+    CThreadPolicy::GetInstance().Apply(ThreadRole::METRICS, THREAD_ANY_INSTANCE, "MetricsExport");
+
+    while (!m_bExporterQuit.load(std::memory_order_acquire)) {
+        struct pollfd pfd { m_listenFd, POLLIN, 0 };
+        int ret = poll(&pfd, 1, METRICS_ACCEPT_POLL_MS);
+        if (ret <= 0) {
+            continue;
+        }
+        int fd = accept4(m_listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        ServeClient(fd);
+        close(fd);
+    }
+}
+
+// Answers HTTP when the client sent a request line, raw text otherwise
+void CMetrics::ServeClient(int fd)
+{
+    char request[512];
+    ssize_t len = 0;
+    struct pollfd pfd { fd, POLLIN, 0 };
+    if (poll(&pfd, 1, METRICS_REQUEST_POLL_MS) > 0) {
+        len = recv(fd, request, sizeof(request), 0);
+    }
+
+    std::ostringstream body;
+    WritePrometheus(body);
+    std::string response;
+    if (len >= 4 && memcmp(request, "GET ", 4) == 0) {
+        response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                   std::to_string(body.str().size()) + "\r\n\r\n";
+    }
+    response += body.str();
+    WriteAll(fd, response);
+}
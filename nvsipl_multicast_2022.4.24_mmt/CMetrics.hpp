@@ -0,0 +1,138 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CMETRICS_HPP
+#define CMETRICS_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+constexpr uint32_t METRICS_MAX = 256U;
+constexpr uint32_t METRICS_INVALID_ID = UINT32_MAX;
+constexpr size_t METRICS_CACHE_LINE = 64U;
+
+enum class MetricType : uint32_t
+{
+    COUNTER = 0, // only goes up
+    GAUGE        // goes up and down, e.g. a queue depth
+};
+
+typedef std::vector<std::pair<std::string, std::string>> MetricLabels;
+
+class CMetrics;
+
+// Handle to one registered time series. Cheap to copy; a default
+// constructed handle ignores all updates.
+class CMetric
+{
+public:
+    CMetric(void) = default;
+
+    // Lock-free, touches only the calling thread's shard.
+    inline void Add(int64_t delta) const;
+    void Inc(void) const
+    {
+        Add(1);
+    }
+
+    bool IsValid(void) const
+    {
+        return m_id != METRICS_INVALID_ID;
+    }
+
+private:
+    friend class CMetrics;
+    explicit CMetric(uint32_t id) : m_id(id) {}
+
+    uint32_t m_id = METRICS_INVALID_ID;
+};
+
+/* Process wide metrics registry.
+ * Every thread that updates a metric gets its own shard with one cache line per
+ * metric, so the frame path never shares a line or takes a lock. Readers sum the
+ * shards. Registration is a setup-time operation. Snapshots are served as
+ * Prometheus text on a Unix domain socket (plain or HTTP/1.0, so
+ * `curl --unix-socket <path> http://localhost/metrics` works) and can be
+ * appended to a file as JSON lines. */
+class CMetrics
+{
+public:
+    static CMetrics &GetInstance(void);
+
+    // The same name and labels always map to the same series.
+    CMetric Register(const std::string &name, const std::string &help, MetricType type, const MetricLabels &labels);
+    int64_t Read(CMetric metric);
+
+    void WritePrometheus(std::ostream &os);
+    void WriteJsonLine(std::ostream &os);
+
+    bool StartExporter(const std::string &socketPath);
+    void StopExporter(void);
+    bool OpenJsonLog(const std::string &path);
+    // Called periodically by the main loop.
+    void AppendJsonLog(void);
+
+private:
+    friend class CMetric;
+
+    struct alignas(METRICS_CACHE_LINE) MetricSlot {
+        std::atomic<int64_t> value;
+    };
+    typedef struct {
+        MetricSlot slots[METRICS_MAX];
+    } MetricShard;
+    typedef struct {
+        std::string name;
+        std::string help;
+        MetricType type;
+        MetricLabels labels;
+    } MetricInfo;
+
+    CMetrics(void) = default;
+    ~CMetrics(void);
+
+    MetricShard *CreateShard(void);
+    int64_t Sum(uint32_t id);
+    void ExporterThreadFunc(void);
+    void ServeClient(int fd);
+
+    static thread_local MetricShard *s_pShard;
+
+    std::mutex m_mutex; // guards m_vInfos and m_vpShards
+    std::vector<MetricInfo> m_vInfos;
+    std::vector<MetricShard *> m_vpShards;
+
+    std::string m_socketPath;
+    int m_listenFd = -1;
+    std::thread m_exporterThread;
+    std::atomic<bool> m_bExporterQuit {false};
+    std::ofstream m_jsonLog;
+};
+
+inline void CMetric::Add(int64_t delta) const
+{
+    if (m_id >= METRICS_MAX) {
+        return;
+    }
+    CMetrics::MetricShard *pShard = CMetrics::s_pShard;
+    if (pShard == nullptr) {
+        pShard = CMetrics::GetInstance().CreateShard();
+    }
+    // Only this thread writes the slot
+    std::atomic<int64_t> &value = pShard->slots[m_id].value;
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+#endif
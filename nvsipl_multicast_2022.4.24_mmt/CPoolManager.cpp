@@ -7,11 +7,14 @@
 // agreement from NVIDIA Corporation is strictly prohibited.
 
 #include "CPoolManager.hpp"
+#include "CTopology.hpp"
 
-CPoolManager::CPoolManager(NvSciStreamBlock handle, uint32_t uSensor) :
+CPoolManager::CPoolManager(NvSciStreamBlock handle, uint32_t uSensor, uint32_t numPackets) :
     CEventHandler("Pool", handle, uSensor)
 {
     m_handle = handle;
+    m_numPackets = numPackets;
+    m_packetHandles.resize(numPackets, 0U);
     m_numPacketReady = 0;
     m_elementsDone = false;
     m_packetsDone = false;
@@ -46,7 +49,7 @@ SIPLStatus CPoolManager::Init(void)
     /* Query number of consumers */
     auto sciErr = NvSciStreamBlockConsumerCountGet(m_handle, &m_numConsumers);
     CHK_NVSCISTATUS_AND_RETURN(sciErr, "Pool: Query number of consumers");
-    if (m_numConsumers > NUM_CONSUMERS+NUM_LOCAL_CONSUMERS) {
+    if (m_numConsumers > MAX_WAIT_SYNCOBJ) {
         LOG_ERR("Pool: Consumer count is too big: %u\n", m_numConsumers);
         return NVSIPL_STATUS_ERROR;
     }
@@ -60,10 +63,10 @@ EventStatus CPoolManager::HandleEvents(void)
     SIPLStatus status = NVSIPL_STATUS_OK;
     NvSciError sciStatus;
 
-    auto sciErr = NvSciStreamBlockEventQuery(m_handle, QUERY_TIMEOUT, &event);
+    // Runs when the block's notifier fired, returns TIMED_OUT once drained
+    auto sciErr = QueryEvent(0, &event);
     if (NvSciError_Success != sciErr) {
         if (NvSciError_Timeout == sciErr) {
-            LOG_WARN("Pool: Event query, timed out.\n");
             return EVENT_STATUS_TIMED_OUT;
         }
         LOG_ERR("Pool: Event query, failed with error 0x%x", sciErr);
@@ -76,7 +79,7 @@ EventStatus CPoolManager::HandleEvents(void)
             status  = HandlePoolBufferSetup();
             break;
         case NvSciStreamEventType_PacketStatus:
-            if (++m_numPacketReady < MAX_PACKETS) {
+            if (++m_numPacketReady < m_numPackets) {
                 break;
             }
             LOG_DBG("Pool: Received all the PacketStatus events.\n");
@@ -217,6 +220,11 @@ SIPLStatus CPoolManager::HandlePoolBufferSetup(void)
     sciErr = NvSciStreamBlockSetupStatusSet(m_handle, NvSciStreamSetup_ElementExport, true);
     CHK_NVSCISTATUS_AND_RETURN(sciErr, "Pool: Complete element export");
 
+    uint64_t packetBytes = 0U;
+    for (e = 0; e < numElem; ++e) {
+        packetBytes += GetBufferSize(m_elems[e].bufAttrList);
+    }
+
     /*
      * Create and send all the packets and their buffers
      * Note: Packets and buffers are not guaranteed to be received by
@@ -224,7 +232,7 @@ SIPLStatus CPoolManager::HandlePoolBufferSetup(void)
      *       status messages sent back guaranteed to preserve ordering.
      *       This is one reason why an event driven model is more robust.
      */
-    for (i = 0; i < MAX_PACKETS; ++i) {
+    for (i = 0; i < m_numPackets; ++i) {
         /*Our pool implementation doesn't need to save any packet-specific
          *   data, but we do need to provide unique cookies, so we just
          *   use the pointer to the location we save the handle.
@@ -270,6 +278,7 @@ SIPLStatus CPoolManager::HandlePoolBufferSetup(void)
      */
     sciErr = NvSciStreamBlockSetupStatusSet(m_handle, NvSciStreamSetup_PacketExport, true);
     CHK_NVSCISTATUS_AND_RETURN(sciErr, "Pool: Complete packet export");
+    CTopology::GetInstance().AddAllocatedBytes(m_uSensorId, packetBytes * m_numPackets);
 
     /* Once all packets are set up, no longer need to keep the attributes */
     for (e = 0; e < numElem; ++e) {
@@ -290,7 +299,7 @@ SIPLStatus CPoolManager::HandlePacketsStatus(void)
     NvSciError sciErr;
 
     /* Check each packet */
-    for (uint32_t p = 0; p < MAX_PACKETS; ++p) {
+    for (uint32_t p = 0; p < m_numPackets; ++p) {
         /* Check packet acceptance */
         bool accept;
         sciErr = NvSciStreamPoolPacketStatusAcceptGet(m_handle, m_packetHandles[p], &accept);
@@ -339,7 +348,8 @@ SIPLStatus CPoolManager::HandlePacketsStatus(void)
     return packetFailure ? NVSIPL_STATUS_ERROR : NVSIPL_STATUS_OK;
 }
 
-SIPLStatus CPoolManager::ReconcileAndAllocBuffers(NvSciBufAttrList& bufAttrList, NvSciBufObj *pInputBuffers)
+SIPLStatus CPoolManager::ReconcileAndAllocBuffers(NvSciBufAttrList& bufAttrList, uint32_t numBuffers,
+                                                  NvSciBufObj *pInputBuffers)
 {
     NvSciBufObj obj = nullptr;
     NvSciBufAttrList reconciledAttrlist = nullptr;
@@ -356,7 +366,7 @@ SIPLStatus CPoolManager::ReconcileAndAllocBuffers(NvSciBufAttrList& bufAttrList,
         NvSciBufAttrListFree(conflictlist);
     }
 
-    for (uint32_t i = 0U; i < MAX_PACKETS; i++) {
+    for (uint32_t i = 0U; i < numBuffers; i++) {
         auto sciErr = NvSciBufObjAlloc(reconciledAttrlist, &obj);
         if (sciErr != NvSciError_Success) {
             LOG_ERR("Pool: NvSciBufObjAlloc failed: 0x%x.\n", sciErr);
@@ -371,3 +381,21 @@ SIPLStatus CPoolManager::ReconcileAndAllocBuffers(NvSciBufAttrList& bufAttrList,
 
     return NVSIPL_STATUS_OK;
 }
+
+uint64_t CPoolManager::GetBufferSize(NvSciBufAttrList reconciledList)
+{
+    NvSciBufAttrKeyValuePair typeAttr = { NvSciBufGeneralAttrKey_Types, nullptr, 0 };
+    if (NvSciBufAttrListGetAttrs(reconciledList, &typeAttr, 1) != NvSciError_Success || typeAttr.value == nullptr) {
+        return 0U;
+    }
+
+    NvSciBufType bufType = *(static_cast<const NvSciBufType *>(typeAttr.value));
+    NvSciBufAttrKeyValuePair sizeAttr = { (bufType == NvSciBufType_Image) ? NvSciBufImageAttrKey_Size
+                                                                           : NvSciBufRawBufferAttrKey_Size,
+                                          nullptr, 0 };
+    if (NvSciBufAttrListGetAttrs(reconciledList, &sizeAttr, 1) != NvSciError_Success || sizeAttr.value == nullptr) {
+        return 0U;
+    }
+
+    return *(static_cast<const uint64_t *>(sizeAttr.value));
+}
@@ -9,6 +9,8 @@
 #ifndef CPOOLMANAGER_HPP
 #define CPOOLMANAGER_HPP
 
+#include <vector>
+
 #include "nvscistream.h"
 #include "Common.hpp"
 #include "CUtils.hpp"
@@ -23,18 +25,21 @@ typedef struct {
 class CPoolManager: public CEventHandler
 {
 public:
-    CPoolManager(NvSciStreamBlock handle, uint32_t uSensor);
+    CPoolManager(NvSciStreamBlock handle, uint32_t uSensor, uint32_t numPackets);
     ~CPoolManager(void);
 
     SIPLStatus Init(void);
     virtual EventStatus HandleEvents(void) override;
-    static SIPLStatus ReconcileAndAllocBuffers(NvSciBufAttrList& bufAttrList, NvSciBufObj *pInputBuffers);
+    static SIPLStatus ReconcileAndAllocBuffers(NvSciBufAttrList& bufAttrList, uint32_t numBuffers, NvSciBufObj *pInputBuffers);
+    // Bytes of one buffer allocated from a reconciled image or raw buffer attribute list
+    static uint64_t GetBufferSize(NvSciBufAttrList reconciledList);
 
 private:
     SIPLStatus HandlePoolBufferSetup(void);
     SIPLStatus HandlePacketsStatus(void);
 
     uint32_t            m_numConsumers;
+    uint32_t            m_numPackets;
     // Producer packet element attributue
     uint32_t            m_numProdElem = 0U;
     ElemAttr            m_prodElems[MAX_ELEMENTS];
@@ -47,8 +52,8 @@ private:
     uint32_t            m_numElem = 0U;
     ElemAttr            m_elems[MAX_ELEMENTS];
 
-    // Packet element descriptions
-    NvSciStreamPacket   m_packetHandles[MAX_PACKETS];
+    // Packet element descriptions, sized once so the cookies stay valid
+    std::vector<NvSciStreamPacket> m_packetHandles;
 
     uint32_t            m_numPacketReady;
     bool                m_elementsDone;
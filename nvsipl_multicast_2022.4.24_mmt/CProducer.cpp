@@ -12,6 +12,9 @@ CProducer::CProducer(std::string name, NvSciStreamBlock handle, uint32_t uSensor
     CClientCommon(name, handle, uSensor)
 {
    m_numBuffersWithConsumer = 0U;
+   m_packetsInFlight = CMetrics::GetInstance().Register("nvsipl_packets_with_consumers",
+                                                        "Packets presented and not yet returned by all consumers",
+                                                        MetricType::GAUGE, GetMetricLabels());
 }
 
 SIPLStatus CProducer::HandleStreamInit(void)
@@ -19,7 +22,7 @@ SIPLStatus CProducer::HandleStreamInit(void)
     /* Query number of consumers */
     auto sciErr = NvSciStreamBlockConsumerCountGet(m_handle, &m_numConsumers);
     CHK_NVSCISTATUS_AND_RETURN(sciErr, "Producer query number of consumers");
-    if (m_numConsumers > NUM_CONSUMERS+NUM_LOCAL_CONSUMERS) {
+    if (m_numConsumers > MAX_WAIT_SYNCOBJ) {
         PLOG_ERR("Consumer count is too big: %u\n", m_numConsumers);
         return NVSIPL_STATUS_ERROR;
     }
@@ -35,7 +38,7 @@ SIPLStatus CProducer::HandleSetupComplete(void)
 
     // Producer receives notification and takes initial ownership of packets
     for (uint32_t i = 0U; i < m_numPacket; i++) {
-        NvSciError sciErr = NvSciStreamBlockEventQuery(m_handle, QUERY_TIMEOUT, &eventType);
+        NvSciError sciErr = QueryEvent(QUERY_TIMEOUT, &eventType);
         PCHK_NVSCISTATUS_AND_RETURN(sciErr, "Get initial ownership of packet");
 
         if (eventType != NvSciStreamEventType_PacketReady) {
@@ -51,6 +54,7 @@ SIPLStatus CProducer::HandleSetupComplete(void)
 
 SIPLStatus CProducer::HandlePayload(void)
 {
+    CTraceScope trace("ProducerHandlePayload");
     NvSciStreamCookie cookie;
     uint32_t packetIndex = 0;
 
@@ -63,12 +67,22 @@ SIPLStatus CProducer::HandlePayload(void)
     PCHK_NVSCISTATUS_AND_RETURN(sciErr, "Obtain packet for payload");
 
     m_numBuffersWithConsumer--;
+    m_packetsInFlight.Add(-1);
     auto status = GetIndexFromCookie(cookie, packetIndex);
     PCHK_STATUS_AND_RETURN(status, "GetIndexFromCookie");
+    trace.SetArg(packetIndex);
+    CFlightRecorder::GetInstance().Record(FLIGHT_PACKET_GET, m_uSensorId, packetIndex);
 
     ClientPacket *packet = GetPacketByCookie(cookie);
     PCHK_PTR_AND_RETURN(packet, "Get packet by cookie\n");
 
+    if (HasCompletionFailed()) {
+        PLOG_ERR("A fence completion failed earlier\n");
+        return NVSIPL_STATUS_ERROR;
+    }
+
+    NvSciSyncFence prefences[MAX_WAIT_SYNCOBJ];
+    uint32_t numPrefences = 0U;
     /* Query fences for this element from each consumer */
     for (uint32_t i = 0U; i < m_numConsumers; ++i) {
         /* If the received waiter obj if NULL,
@@ -79,54 +93,115 @@ SIPLStatus CProducer::HandlePayload(void)
             continue;
         }
 
-        NvSciSyncFence prefence = NvSciSyncFenceInitializer;
+        NvSciSyncFence &prefence = prefences[numPrefences];
+        prefence = NvSciSyncFenceInitializer;
         sciErr = NvSciStreamBlockPacketFenceGet(m_handle, packet->handle, i, 0U, &prefence);
         if (NvSciError_Success != sciErr) {
             PLOG_ERR("Failed (0x%x) to query fence from consumer: %d\n", sciErr, i);
+            ClearFences(prefences, numPrefences);
             return NVSIPL_STATUS_ERROR;
         }
-
-        // Perform CPU wait to WAR the issue of failing to register sync object with ISP.
-        if (m_cpuWaitContext != nullptr) {
-            auto sciErr = NvSciSyncFenceWait(&prefence, m_cpuWaitContext, FENCE_FRAME_TIMEOUT_US);
-            PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciSyncFenceWait prefence");
-        }
+        numPrefences++;
 
         status = InsertPrefence(packetIndex, prefence);
-        NvSciSyncFenceClear(&prefence);
+        if (status != NVSIPL_STATUS_OK) {
+            ClearFences(prefences, numPrefences);
+        }
         PCHK_STATUS_AND_RETURN(status, "Insert prefence");
     }
+
+    // CPU wait to WAR the issue of failing to register sync object with ISP. The
+    // buffer goes back to the pipeline once the consumers are done with it.
+    if (m_cpuWaitContext != nullptr && numPrefences != 0U) {
+        status = CompleteOnFences(prefences, numPrefences, [this, packetIndex](FenceResult result) {
+            if (result == FenceResult::SIGNALED) {
+                OnPacketGotten(packetIndex);
+            }
+        });
+        ClearFences(prefences, numPrefences);
+        PCHK_STATUS_AND_RETURN(status, "CompleteOnFences prefences");
+        return NVSIPL_STATUS_OK;
+    }
+    ClearFences(prefences, numPrefences);
     OnPacketGotten(packetIndex);
 
     return NVSIPL_STATUS_OK;
 }
 
+void CProducer::ClearFences(NvSciSyncFence *pFences, uint32_t numFences)
+{
+    for (uint32_t i = 0U; i < numFences; i++) {
+        NvSciSyncFenceClear(&pFences[i]);
+    }
+}
+
 SIPLStatus CProducer::Post(void *pBuffer)
 {
+    CTraceScope trace("Post");
     uint32_t packetIndex = 0;
+    const uint64_t postTimeNs = CTimeBase::NowNs();
+
+    if (HasCompletionFailed()) {
+        PLOG_ERR("A fence completion failed earlier\n");
+        return NVSIPL_STATUS_ERROR;
+    }
 
     auto status = MapPayload(pBuffer, packetIndex);
     PCHK_STATUS_AND_RETURN(status, "MapPayload");
+    trace.SetArg(packetIndex);
+
+    MetaData *pMeta = GetMetaData(packetIndex);
+    if (pMeta != nullptr) {
+        pMeta->frame_count = m_frameCount;
+        pMeta->postTimeNs = postTimeNs;
+    }
+    m_frameCount++;
 
     NvSciSyncFence postfence = NvSciSyncFenceInitializer;
     status = GetPostfence(packetIndex, &postfence);
     PCHK_STATUS_AND_RETURN(status, "GetPostFence");
 
+    // Presented from the fence completer once the ISP is done with the frame, the
+    // frame completion thread goes back to SIPL right away
     if (m_cpuWaitContext != nullptr) {
-        auto sciErr = NvSciSyncFenceWait(&postfence, m_cpuWaitContext, FENCE_FRAME_TIMEOUT_US);
-        PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciSyncFenceWait post fence");
+        status = CompleteOnFences(&postfence, 1U, [this, packetIndex](FenceResult result) {
+            if (result == FenceResult::SIGNALED) {
+                NvSciSyncFence signaled = NvSciSyncFenceInitializer;
+                if (Present(packetIndex, &signaled) != NVSIPL_STATUS_OK) {
+                    m_bCompletionFailed.store(true, std::memory_order_relaxed);
+                }
+            }
+        });
+        NvSciSyncFenceClear(&postfence);
+        PCHK_STATUS_AND_RETURN(status, "CompleteOnFences postfence");
+        return NVSIPL_STATUS_OK;
     }
 
+    status = Present(packetIndex, &postfence);
+    NvSciSyncFenceClear(&postfence);
+    return status;
+}
+
+SIPLStatus CProducer::Present(uint32_t packetIndex, NvSciSyncFence *pPostfence)
+{
     /* Update postfence for this element */
-    auto sciErr = NvSciStreamBlockPacketFenceSet(m_handle, m_packets[packetIndex].handle, m_dataIndex, &postfence);
+    auto sciErr = NvSciStreamBlockPacketFenceSet(m_handle, m_packets[packetIndex].handle, m_dataIndex, pPostfence);
+    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciStreamBlockPacketFenceSet");
 
+    MetaData *pMeta = GetMetaData(packetIndex);
+    if (pMeta != nullptr) {
+        pMeta->presentTimeNs = CTimeBase::NowNs();
+    }
+    // Counted first, a consumer may return the packet before PacketPresent returns
+    m_numBuffersWithConsumer++;
+    m_packetsInFlight.Inc();
     sciErr = NvSciStreamProducerPacketPresent(m_handle, m_packets[packetIndex].handle);
+    if (sciErr != NvSciError_Success) {
+        m_numBuffersWithConsumer--;
+        m_packetsInFlight.Add(-1);
+    }
     PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciStreamProducerPacketPresent");
-
-    NvSciSyncFenceClear(&postfence);
-    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciStreamProducerPacketPresent");
-
-    m_numBuffersWithConsumer++;
+    CFlightRecorder::GetInstance().Record(FLIGHT_PACKET_PRESENT, m_uSensorId, packetIndex);
     PLOG_DBG("Post, m_numBuffersWithConsumer: %u\n", m_numBuffersWithConsumer.load());
 
     if (m_pProfiler != nullptr) {
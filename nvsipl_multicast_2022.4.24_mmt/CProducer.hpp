@@ -12,6 +12,7 @@
 
 #include "nvscibuf.h"
 #include "CClientCommon.hpp"
+#include "CTracer.hpp"
 
 class CProducer: public CClientCommon
 {
@@ -31,10 +32,19 @@ protected:
     virtual SIPLStatus MapPayload(void *pBuffer, uint32_t& packetIndex) = 0;
     virtual SIPLStatus GetPostfence(uint32_t packetIndex, NvSciSyncFence *pPostfence) = 0;
     virtual NvSciBufAttrValAccessPerm GetMetaPerm(void) override;
+    virtual uint64_t GetMetaSize(void) override {return FRAME_META_SIZE;};
+    // Core of the packet's meta element, started by MapPayload(). nullptr when it is not mapped.
+    virtual MetaData *GetMetaData(uint32_t packetIndex) {return nullptr;};
+    // Sets the postfence and presents the packet, runs on the fence completer when the postfence is CPU-waited
+    SIPLStatus Present(uint32_t packetIndex, NvSciSyncFence *pPostfence);
 
     uint32_t m_numConsumers;
 private:
+    static void ClearFences(NvSciSyncFence *pFences, uint32_t numFences);
+
     std::atomic<uint32_t> m_numBuffersWithConsumer;
+    uint64_t m_frameCount = 0U;
+    CMetric m_packetsInFlight;
 };
 #endif
 
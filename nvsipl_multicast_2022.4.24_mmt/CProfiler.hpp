@@ -9,9 +9,13 @@
  */
 
 #include <mutex>
-#include <condition_variable>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "NvSIPLClient.hpp"
+#include "CLatencyStats.hpp"
+#include "CMetrics.hpp"
 
 #ifndef CPROFILER_HPP
 #define CPROFILER_HPP
@@ -21,28 +25,46 @@ using namespace nvsipl;
 class CProfiler
 {
  public:
-    typedef struct {
-        std::mutex profDataMut;
-        uint64_t uFrameCount;
-        uint64_t uPrevFrameCount;
-    } ProfilingData;
-
     void Init(uint32_t uSensor, INvSIPLClient::ConsumerDesc::OutputType outputType)
     {
         m_uSensor = uSensor;
         m_outputType = outputType;
-
-        m_profData.profDataMut.lock();
-        m_profData.uFrameCount = 0U;
-        m_profData.uPrevFrameCount = 0U;
-        m_profData.profDataMut.unlock();
+        m_frames = CMetrics::GetInstance().Register("nvsipl_producer_frames_total", "Frames posted by the producer",
+                                                    MetricType::COUNTER, { { "sensor", std::to_string(uSensor) } });
+        m_uPrevFrameCount = 0U;
     }
 
+    // Frame path, lock-free
     void OnFrameAvailable(void)
     {
-        m_profData.profDataMut.lock();
-        m_profData.uFrameCount++;
-        m_profData.profDataMut.unlock();
+        m_frames.Inc();
+    }
+
+    // Frames since the previous call, for the main loop only.
+    uint64_t GetFrameCountDelta(void)
+    {
+        uint64_t uFrameCount = (uint64_t)CMetrics::GetInstance().Read(m_frames);
+        uint64_t uDelta = uFrameCount - m_uPrevFrameCount;
+        m_uPrevFrameCount = uFrameCount;
+        return uDelta;
+    }
+
+    // One set of histograms per consumer of this sensor, created during setup.
+    CLatencyStats *AddLatencyStats(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(m_latencyMutex);
+        m_vupLatencyStats.push_back(std::unique_ptr<CLatencyStats>(new CLatencyStats(name)));
+        return m_vupLatencyStats.back().get();
+    }
+
+    // Returns false when no consumer of this sensor lives in this process.
+    bool ReportLatency(std::ostream &os, double elapsedSec)
+    {
+        std::lock_guard<std::mutex> lock(m_latencyMutex);
+        for (auto &upStats : m_vupLatencyStats) {
+            upStats->Report(os, elapsedSec);
+        }
+        return !m_vupLatencyStats.empty();
     }
 
     ~CProfiler()
@@ -51,7 +73,12 @@ class CProfiler
 
     uint32_t m_uSensor = UINT32_MAX;
     INvSIPLClient::ConsumerDesc::OutputType m_outputType;
-    ProfilingData m_profData;
+
+ private:
+    CMetric m_frames;
+    uint64_t m_uPrevFrameCount = 0U;
+    std::mutex m_latencyMutex; // setup and report only, never taken per frame
+    std::vector<std::unique_ptr<CLatencyStats>> m_vupLatencyStats;
 };
 
 #endif // CPROFILER_HPP
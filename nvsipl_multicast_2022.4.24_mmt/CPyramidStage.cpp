@@ -0,0 +1,242 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CPyramidStage.hpp"
+#include "CBlockLinearKernels.hpp"
+#include "CBoxFilter.hpp"
+
+// Level rows start on a cache line
+constexpr uint32_t PYRAMID_PITCH_ALIGN = 64U;
+
+static const uint32_t PLANE_CHANNELS[2] = { 1U, 2U };
+
+static uint32_t AlignPitch(uint32_t bytes)
+{
+    return (bytes + PYRAMID_PITCH_ALIGN - 1U) / PYRAMID_PITCH_ALIGN * PYRAMID_PITCH_ALIGN;
+}
+
+static bool HalvePlane(const PyramidPlane &src, uint32_t channels, PyramidPlane &dst)
+{
+    return CBoxFilter::Halve(src.pData, src.pitch, dst.width, dst.height, channels,
+                             const_cast<uint8_t *>(dst.pData), dst.pitch);
+}
+
+std::vector<std::unique_ptr<CPyramidStage>> CPyramidStage::CreateStages(void)
+{
+    std::vector<std::unique_ptr<CPyramidStage>> stages;
+    for (uint32_t i = 0U; i < MAX_NUM_SENSORS; i++) {
+        stages.emplace_back(new CPyramidStage(i));
+    }
+    return stages;
+}
+
+CPyramidStage &CPyramidStage::GetInstance(uint32_t uSensor)
+{
+    static std::vector<std::unique_ptr<CPyramidStage>> stages = CreateStages();
+    return *stages[(uSensor < MAX_NUM_SENSORS) ? uSensor : 0U];
+}
+
+CPyramidStage::CPyramidStage(uint32_t uSensor) :
+    m_uSensor(uSensor)
+{
+}
+
+void CPyramidStage::Configure(uint32_t numLevels)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (numLevels > PYRAMID_MAX_LEVELS) {
+        numLevels = PYRAMID_MAX_LEVELS;
+    }
+    if (m_bAllocated || numLevels <= m_numLevels) {
+        return;
+    }
+    m_numLevels = numLevels;
+
+    CMetrics &metrics = CMetrics::GetInstance();
+    MetricLabels labels { { "sensor", std::to_string(m_uSensor) } };
+    m_buildsMetric = metrics.Register("nvsipl_pyramid_builds_total", "Frames downscaled by the pyramid stage",
+                                      MetricType::COUNTER, labels);
+    m_sharedMetric = metrics.Register("nvsipl_pyramid_shared_total",
+                                      "Pyramid requests served from a pyramid another consumer built",
+                                      MetricType::COUNTER, labels);
+    m_busyMetric = metrics.Register("nvsipl_pyramid_busy_total",
+                                    "Frames passed on without a pyramid because every buffer was held",
+                                    MetricType::COUNTER, labels);
+}
+
+uint32_t CPyramidStage::GetNumLevels(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_numLevels;
+}
+
+bool CPyramidStage::Matches(const PyramidSource &source) const
+{
+    for (uint32_t p = 0U; p < 2U; p++) {
+        const BlockLinearPlane &a = source.planes[p];
+        const BlockLinearPlane &b = m_sourcePlanes[p];
+        if (a.widthBytes != b.widthBytes || a.height != b.height) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void CPyramidStage::InitSlot(Slot &slot)
+{
+    size_t bytes = 0U;
+    for (uint32_t l = 0U; l < m_numLevels; l++) {
+        for (uint32_t p = 0U; p < 2U; p++) {
+            bytes += (size_t)m_sizes[l][p].pitch * m_sizes[l][p].height;
+        }
+    }
+    slot.buffer.assign(bytes, 0U);
+
+    uint8_t *pData = slot.buffer.data();
+    slot.pyramid.numLevels = m_numLevels;
+    for (uint32_t l = 0U; l < m_numLevels; l++) {
+        PyramidPlane *planes[2] = { &slot.pyramid.levels[l].luma, &slot.pyramid.levels[l].chroma };
+        for (uint32_t p = 0U; p < 2U; p++) {
+            *planes[p] = PyramidPlane{ m_sizes[l][p].width, m_sizes[l][p].height, m_sizes[l][p].pitch, pData };
+            pData += (size_t)m_sizes[l][p].pitch * m_sizes[l][p].height;
+        }
+    }
+}
+
+SIPLStatus CPyramidStage::Allocate(const PyramidSource &source, uint32_t numSlots)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_numLevels == 0U) {
+        return NVSIPL_STATUS_OK;
+    }
+    if (m_bAllocated && !Matches(source)) {
+        LOG_ERR("Pyramid: sensor %u: consumers map frames of different sizes\n", m_uSensor);
+        return NVSIPL_STATUS_BAD_ARGUMENT;
+    }
+
+    if (!m_bAllocated) {
+        for (uint32_t p = 0U; p < 2U; p++) {
+            m_sourcePlanes[p] = source.planes[p];
+            uint32_t width = source.planes[p].widthBytes / PLANE_CHANNELS[p];
+            uint32_t height = source.planes[p].height;
+            for (uint32_t l = 0U; l < m_numLevels; l++) {
+                width /= 2U;
+                height /= 2U;
+                if (width == 0U || height == 0U) {
+                    LOG_ERR("Pyramid: sensor %u: frame too small for %u levels\n", m_uSensor, m_numLevels);
+                    return NVSIPL_STATUS_BAD_ARGUMENT;
+                }
+                m_sizes[l][p] = PlaneSize{ width, height, AlignPitch(width * PLANE_CHANNELS[p]) };
+            }
+        }
+        m_bAllocated = true;
+    }
+
+    size_t oldSlots = m_slots.size();
+    while (m_slots.size() < numSlots) {
+        m_slots.emplace_back(new Slot());
+        InitSlot(*m_slots.back());
+    }
+    if (m_slots.size() != oldSlots) {
+        LOG_INFO("Pyramid: sensor %u: %u levels down to %ux%u, %zu buffers of %zu bytes\n", m_uSensor,
+                 m_numLevels, m_sizes[m_numLevels - 1U][0].width, m_sizes[m_numLevels - 1U][0].height,
+                 m_slots.size(), m_slots.back()->buffer.size());
+    }
+    return NVSIPL_STATUS_OK;
+}
+
+bool CPyramidStage::Build(const PyramidSource &source, Pyramid &pyramid)
+{
+    if (pyramid.numLevels == 0U || pyramid.numLevels > PYRAMID_MAX_LEVELS) {
+        return false;
+    }
+
+    // The first level reads the frame in its own layout, the rest are pitch-linear
+    const PyramidLevel &first = pyramid.levels[0];
+    const PyramidPlane *firstPlanes[2] = { &first.luma, &first.chroma };
+    for (uint32_t p = 0U; p < 2U; p++) {
+        const BlockLinearPlane &plane = source.planes[p];
+        uint8_t *pDst = const_cast<uint8_t *>(firstPlanes[p]->pData);
+        bool bOk = source.bBlockLinear
+                       ? CBlockLinearKernels::Downscale(plane, source.pPlanes[p], 2U, pDst, firstPlanes[p]->pitch,
+                                                        PLANE_CHANNELS[p])
+                       : CBoxFilter::Halve(source.pPlanes[p], plane.pitch, firstPlanes[p]->width,
+                                           firstPlanes[p]->height, PLANE_CHANNELS[p], pDst, firstPlanes[p]->pitch);
+        if (!bOk) {
+            return false;
+        }
+    }
+
+    for (uint32_t l = 1U; l < pyramid.numLevels; l++) {
+        PyramidLevel &level = pyramid.levels[l];
+        if (!HalvePlane(pyramid.levels[l - 1U].luma, 1U, level.luma) ||
+            !HalvePlane(pyramid.levels[l - 1U].chroma, 2U, level.chroma)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const Pyramid *CPyramidStage::Acquire(const PyramidSource &source, uint64_t frameKey)
+{
+    Slot *pSlot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_slots.empty() || !Matches(source)) {
+            return nullptr;
+        }
+        for (auto &upSlot : m_slots) {
+            if (frameKey != 0U && upSlot->frameKey == frameKey) {
+                pSlot = upSlot.get();
+                m_sharedMetric.Inc();
+                break;
+            }
+        }
+        if (pSlot == nullptr) {
+            // Reuse the least recently used free buffer
+            for (auto &upSlot : m_slots) {
+                if (upSlot->refs == 0U && (pSlot == nullptr || upSlot->lastUse < pSlot->lastUse)) {
+                    pSlot = upSlot.get();
+                }
+            }
+            if (pSlot == nullptr) {
+                m_busyMetric.Inc();
+                return nullptr;
+            }
+            pSlot->frameKey = frameKey;
+            pSlot->bBuilt = false;
+        }
+        pSlot->refs++;
+        pSlot->lastUse = ++m_useCount;
+    }
+
+    std::lock_guard<std::mutex> buildLock(pSlot->buildMutex);
+    if (!pSlot->bBuilt) {
+        if (!Build(source, pSlot->pyramid)) {
+            Release(&pSlot->pyramid);
+            return nullptr;
+        }
+        pSlot->bBuilt = true;
+        m_buildsMetric.Inc();
+    }
+    return &pSlot->pyramid;
+}
+
+void CPyramidStage::Release(const Pyramid *pPyramid)
+{
+    if (pPyramid == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &upSlot : m_slots) {
+        if (&upSlot->pyramid == pPyramid && upSlot->refs > 0U) {
+            upSlot->refs--;
+            return;
+        }
+    }
+}
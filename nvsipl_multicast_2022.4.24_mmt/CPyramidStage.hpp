@@ -0,0 +1,115 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CPYRAMIDSTAGE_HPP
+#define CPYRAMIDSTAGE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "CBlockLinear.hpp"
+#include "CMetrics.hpp"
+#include "CUtils.hpp"
+#include "Common.hpp"
+
+// One pitch-linear plane of a pyramid level
+typedef struct {
+    uint32_t width;  // in pixels, UV pairs for the chroma plane
+    uint32_t height;
+    uint32_t pitch;  // in bytes
+    const uint8_t *pData;
+} PyramidPlane;
+
+typedef struct {
+    PyramidPlane luma;
+    PyramidPlane chroma; // interleaved UV
+} PyramidLevel;
+
+// levels[0] is half the frame size, each further level half the previous one
+typedef struct {
+    uint32_t numLevels;
+    PyramidLevel levels[PYRAMID_MAX_LEVELS];
+} Pyramid;
+
+// An NV12 frame, plane 0 luma and plane 1 interleaved UV. For a pitch-linear
+// frame only widthBytes, height and pitch of the planes are used.
+typedef struct {
+    bool bBlockLinear;
+    BlockLinearPlane planes[2];
+    const uint8_t *pPlanes[2];
+} PyramidSource;
+
+/* Downscaled NV12 copies of a sensor's frames, shared by all CPU consumers of
+ * the sensor in this process. Each consumer acquires the pyramid of the frame
+ * it processes: the first one builds it with CBoxFilter, the others get the
+ * same read-only levels. Level buffers are allocated once the reconciled
+ * buffer attributes are known, one set per packet of the pool, since a
+ * pyramid is held no longer than its packet. A chroma plane is half of the
+ * next larger chroma plane, rounded down, like its luma plane.
+ * Acquire() and Release() may be called from any consumer thread. */
+class CPyramidStage
+{
+public:
+    static CPyramidStage &GetInstance(uint32_t uSensor);
+
+    // Levels to build, the largest request of the sensor's consumers wins.
+    void Configure(uint32_t numLevels);
+    uint32_t GetNumLevels(void);
+
+    // Sizes the level buffers for frames like 'source', called per mapped packet.
+    SIPLStatus Allocate(const PyramidSource &source, uint32_t numSlots);
+
+    // Pyramid of the frame identified by frameKey (its capture time, 0 is never
+    // shared), built on first use. Returns nullptr when the stage is disabled or
+    // every buffer is still held. Valid until Release().
+    const Pyramid *Acquire(const PyramidSource &source, uint64_t frameKey);
+    void Release(const Pyramid *pPyramid);
+
+    // Builds the levels of 'source' into a caller's pyramid, used by Acquire()
+    // and by the benchmark.
+    static bool Build(const PyramidSource &source, Pyramid &pyramid);
+
+private:
+    typedef struct {
+        uint32_t width;
+        uint32_t height;
+        uint32_t pitch;
+    } PlaneSize;
+
+    struct Slot {
+        std::vector<uint8_t> buffer;
+        Pyramid pyramid;
+        uint64_t frameKey = 0U;
+        uint32_t refs = 0U;
+        uint64_t lastUse = 0U;
+        bool bBuilt = false;
+        std::mutex buildMutex; // the first user builds, the others wait for it
+    };
+
+    explicit CPyramidStage(uint32_t uSensor);
+    static std::vector<std::unique_ptr<CPyramidStage>> CreateStages(void);
+    bool Matches(const PyramidSource &source) const;
+    void InitSlot(Slot &slot);
+
+    uint32_t m_uSensor;
+    std::mutex m_mutex;
+    uint32_t m_numLevels = 0U;
+    bool m_bAllocated = false;
+    BlockLinearPlane m_sourcePlanes[2] {};
+    PlaneSize m_sizes[PYRAMID_MAX_LEVELS][2] {};
+    std::vector<std::unique_ptr<Slot>> m_slots;
+    uint64_t m_useCount = 0U;
+
+    CMetric m_buildsMetric;
+    CMetric m_sharedMetric;
+    CMetric m_busyMetric;
+};
+
+#endif
@@ -6,25 +6,25 @@
 // of this software and related documentation without an express license
 // agreement from NVIDIA Corporation is strictly prohibited.
 
+#include <algorithm>
+
 #include "CSIPLProducer.hpp"
 #include "CPoolManager.hpp"
+#include "CTopology.hpp"
 
 CSIPLProducer::CSIPLProducer(NvSciStreamBlock handle, uint32_t uSensor, INvSIPLCamera* pCamera) :
     CProducer("CSIPLProducer", handle, uSensor)
 {
     m_pCamera = pCamera;
 
-    for (uint32_t i = 0; i < MAX_PACKETS; i++) {
-        m_rawBufObjs[i] = nullptr;
-        m_ispBufObjs[i] = nullptr;
-    }
     m_ispOutputType = INvSIPLClient::ConsumerDesc::OutputType::ISP0;
+    m_calibrationVersion = CTopology::GetInstance().GetSensor(uSensor).calibrationVersion;
 }
 
 CSIPLProducer::~CSIPLProducer(void)
 {
     PLOG_DBG("Release.\n");
-    for (uint32_t i = 0; i < MAX_PACKETS; i++) {
+    for (uint32_t i = 0; i < m_rawBufObjs.size(); i++) {
         if (m_rawBufObjs[i] != nullptr) {
             NvSciBufObjFree(m_rawBufObjs[i]);
             m_rawBufObjs[i] = nullptr;
@@ -199,11 +199,25 @@ SIPLStatus CSIPLProducer::MapDataBuffer(uint32_t packetIndex)
 }
 
 // Create client buffer objects from NvSciBufObj
+void CSIPLProducer::ResizePackets(uint32_t numPackets)
+{
+    CProducer::ResizePackets(numPackets);
+    m_ispBufObjs.resize(numPackets, nullptr);
+    m_rawBufObjs.resize(numPackets, nullptr);
+    m_nvmBuffers.resize(numPackets, nullptr);
+    m_metaWriters.resize(numPackets);
+}
+
 SIPLStatus CSIPLProducer::MapMetaBuffer(uint32_t packetIndex)
 {
     PLOG_DBG("Mapping meta buffer, packetIndex: %u.\n", packetIndex);
-    auto sciErr = NvSciBufObjGetCpuPtr(m_packets[packetIndex].metaObj, (void**)&m_metaPtrs[packetIndex]);
+    void *pMetaBuf = nullptr;
+    auto sciErr = NvSciBufObjGetCpuPtr(m_packets[packetIndex].metaObj, &pMetaBuf);
     PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciBufObjGetCpuPtr");
+    uint32_t metaSize = 0U;
+    auto status = PopulateMetaSize(m_packets[packetIndex].metaObj, metaSize);
+    PCHK_STATUS_AND_RETURN(status, "PopulateMetaSize");
+    m_metaWriters[packetIndex] = CFrameMetaWriter(pMetaBuf, metaSize);
 
     return NVSIPL_STATUS_OK;
 }
@@ -237,10 +251,16 @@ SIPLStatus CSIPLProducer::HandleSetupComplete(void)
     auto status = CProducer::HandleSetupComplete();
     PCHK_STATUS_AND_RETURN(status, "HandleSetupComplete");
 
-    //Alloc raw buffers
-    status = CPoolManager::ReconcileAndAllocBuffers(m_rawBufAttrList, &m_rawBufObjs[0]);
+    //Alloc raw buffers, one per packet the pool created
+    status = CPoolManager::ReconcileAndAllocBuffers(m_rawBufAttrList, m_numPacket, &m_rawBufObjs[0]);
     PCHK_STATUS_AND_RETURN(status, "CPoolManager::ReconcileAndAllocBuffers");
 
+    NvSciBufAttrList rawAttrList = nullptr;
+    auto sciErr = NvSciBufObjGetAttrList(m_rawBufObjs[0], &rawAttrList);
+    PCHK_NVSCISTATUS_AND_RETURN(sciErr, "NvSciBufObjGetAttrList");
+    CTopology::GetInstance().AddAllocatedBytes(m_uSensorId,
+                                               CPoolManager::GetBufferSize(rawAttrList) * m_numPacket);
+
     status = RegisterBuffers();
     PCHK_STATUS_AND_RETURN(status, "RegisterBuffers");
 
@@ -250,8 +270,8 @@ SIPLStatus CSIPLProducer::HandleSetupComplete(void)
 SIPLStatus CSIPLProducer::RegisterBuffers(void)
 {
     PLOG_DBG("RegisterBuffers\n");
-    m_imageGroupList.resize(MAX_PACKETS);
-    for(auto i = 0u; i < MAX_PACKETS; i++) {
+    m_imageGroupList.resize(m_numPacket);
+    for(auto i = 0u; i < m_numPacket; i++) {
         auto imgGrp =  new (std::nothrow) NvMediaImageGroup;
         PCHK_PTR_AND_RETURN(imgGrp, "new NvMediaImageGroup");
         imgGrp->numImages = 1;
@@ -264,8 +284,8 @@ SIPLStatus CSIPLProducer::RegisterBuffers(void)
     auto status = m_pCamera->RegisterImageGroups(m_uSensorId, m_imageGroupList);
     PCHK_STATUS_AND_RETURN(status, "INvSIPLCamera::RegisterImageGroups");
 
-    m_imageList.resize(MAX_PACKETS);
-    for(auto i = 0u; i < MAX_PACKETS; i++) {
+    m_imageList.resize(m_numPacket);
+    for(auto i = 0u; i < m_numPacket; i++) {
         auto nvmStatus = NvMediaImageCreateFromNvSciBuf(m_upDevice.get(), m_ispBufObjs[i], &m_imageList[i]);
         PCHK_NVMSTATUS_AND_RETURN(nvmStatus, "NvMediaImageCreateFromNvSciBuf");
         nvmStatus = NvMediaImageSetTag(m_imageList[i], (void *)(&m_packets[i].cookie));
@@ -304,6 +324,46 @@ void CSIPLProducer::OnPacketGotten(uint32_t packetIndex)
     m_nvmBuffers[packetIndex]->Release();
 }
 
+void CSIPLProducer::WriteMetaData(CFrameMetaWriter &writer, const INvSIPLClient::ImageMetaData &imageData)
+{
+    MetaData *pCore = writer.Begin();
+    if (pCore == nullptr) {
+        return;
+    }
+    pCore->frameCaptureTSC = imageData.frameCaptureTSC;
+
+    if (imageData.frameSeqNumInfo.frameSeqNumValid) {
+        writer.Add(MetaTag::SEQUENCE, MetaSequence{ imageData.frameSeqNumInfo.frameSequenceNumber });
+    }
+
+    const DevBlkCDIExposure &exposure = imageData.sensorExpInfo;
+    if (exposure.expTimeValid || exposure.gainValid) {
+        MetaExposure section {};
+        section.numExposures = std::min<uint32_t>(imageData.numExposures, FRAME_META_MAX_VALUES);
+        section.bExposureValid = exposure.expTimeValid ? 1U : 0U;
+        section.bGainValid = exposure.gainValid ? 1U : 0U;
+        for (uint32_t i = 0U; i < section.numExposures; i++) {
+            section.exposureTimeMs[i] = exposure.expTimeValid ? exposure.exposureTime[i] * 1000.0F : 0.0F;
+            section.sensorGain[i] = exposure.gainValid ? exposure.sensorGain[i] : 0.0F;
+        }
+        writer.Add(MetaTag::EXPOSURE, section);
+    }
+
+    const DevBlkCDITemperature &temperature = imageData.sensorTempInfo;
+    if (temperature.tempValid) {
+        MetaTemperature section {};
+        section.numTemperatures = std::min<uint32_t>(temperature.numTemperatures, FRAME_META_MAX_VALUES);
+        for (uint32_t i = 0U; i < section.numTemperatures; i++) {
+            section.sensorTempCelsius[i] = temperature.sensorTempCelsius[i];
+        }
+        writer.Add(MetaTag::TEMPERATURE, section);
+    }
+
+    if (m_calibrationVersion != 0U) {
+        writer.Add(MetaTag::CALIBRATION, MetaCalibration{ m_calibrationVersion, 0U });
+    }
+}
+
 SIPLStatus CSIPLProducer::MapPayload(void *pBuffer, uint32_t& packetIndex)
 {
     NvMediaImage *pImage = nullptr;
@@ -320,10 +380,7 @@ SIPLStatus CSIPLProducer::MapPayload(void *pBuffer, uint32_t& packetIndex)
     auto status = GetIndexFromCookie(cookie, packetIndex);
     PCHK_STATUS_AND_RETURN(status, "GetIndexFromCookie");
     PLOG_DBG("MapPayload, packetIndex: %u\n", packetIndex);
-    if (m_metaPtrs[packetIndex] != nullptr) {
-        const INvSIPLClient::ImageMetaData &md = pNvMBuf->GetImageData();
-        m_metaPtrs[packetIndex]->frameCaptureTSC = md.frameCaptureTSC;
-    }
+    WriteMetaData(m_metaWriters[packetIndex], pNvMBuf->GetImageData());
     m_nvmBuffers[packetIndex] = pNvMBuf;
     m_nvmBuffers[packetIndex]->AddRef();
 
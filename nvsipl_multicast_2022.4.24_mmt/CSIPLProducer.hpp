@@ -43,10 +43,14 @@ protected:
     virtual SIPLStatus InsertPrefence(uint32_t packetIndex, NvSciSyncFence &prefence) override;
     virtual SIPLStatus GetPostfence(uint32_t packetIndex, NvSciSyncFence *pPostfence) override;
     virtual SIPLStatus MapPayload(void *pBuffer, uint32_t& packetIndex) override;
-    virtual bool HasCpuWait(void) {return true;};
+    virtual bool HasCpuWait(void) override {return true;}
+    virtual void ResizePackets(uint32_t numPackets) override;
+    virtual MetaData *GetMetaData(uint32_t packetIndex) override {return m_metaWriters[packetIndex].GetCore();};
 
 private:
     SIPLStatus RegisterBuffers(void);
+    // Starts the packet's meta element with what SIPL parsed from the sensor's embedded data
+    void WriteMetaData(CFrameMetaWriter &writer, const INvSIPLClient::ImageMetaData &imageData);
     void DeleteImageGroups(std::vector<NvMediaImageGroup*>& imageGroups);
     void DeleteImages(std::vector<NvMediaImage*>& images);
     SIPLStatus SetBufAttrList(INvSIPLClient::ConsumerDesc::OutputType outputType,
@@ -56,12 +60,13 @@ private:
     INvSIPLClient::ConsumerDesc::OutputType m_ispOutputType;
     std::unique_ptr<NvMediaDevice, CloseNvMediaDevice> m_upDevice;
     NvSciBufAttrList m_rawBufAttrList = nullptr;
-    NvSciBufObj m_ispBufObjs[MAX_PACKETS];
-    NvSciBufObj m_rawBufObjs[MAX_PACKETS];
-    INvSIPLClient::INvSIPLNvMBuffer *m_nvmBuffers[MAX_PACKETS] {nullptr};
+    std::vector<NvSciBufObj> m_ispBufObjs;
+    std::vector<NvSciBufObj> m_rawBufObjs;
+    std::vector<INvSIPLClient::INvSIPLNvMBuffer *> m_nvmBuffers;
     std::vector<NvMediaImageGroup*> m_imageGroupList; // one per packet (ICP only)
     std::vector<NvMediaImage*> m_imageList;           // one per packet
-    /* Virtual address for the meta buffer */
-    MetaData* m_metaPtrs[MAX_PACKETS];
+    /* Writers over the mapped meta buffers */
+    std::vector<CFrameMetaWriter> m_metaWriters;
+    uint32_t m_calibrationVersion = 0U;
 };
 #endif
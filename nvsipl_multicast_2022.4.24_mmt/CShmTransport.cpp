@@ -0,0 +1,579 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CShmTransport.hpp"
+#include "CLatencyStats.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+constexpr uint32_t SHM_MAGIC = 0x53484D31U; // "SHM1"
+constexpr uint32_t SHM_VERSION = 1U;
+// At most MAX_PACKETS frames are ever in flight on a ring
+constexpr uint32_t SHM_RING_SLOTS = MAX_PACKETS;
+constexpr size_t SHM_CACHE_LINE = 64U;
+constexpr int SHM_CONNECT_RETRY_MS = 10;
+constexpr int SHM_SETUP_TIMEOUT_MS = 5000;
+// Control block, ready and release eventfds, then one memfd per packet
+constexpr uint32_t SHM_SETUP_FDS = 3U;
+
+static_assert((SHM_RING_SLOTS & (SHM_RING_SLOTS - 1U)) == 0U, "ring slots must be a power of two");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "the rings need lock-free atomics to work across processes");
+
+// Single-producer single-consumer ring, the two sides live in different processes
+struct ShmRing {
+    std::atomic<uint32_t> tail;
+    char pad0[SHM_CACHE_LINE - sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t> head;
+    char pad1[SHM_CACHE_LINE - sizeof(std::atomic<uint32_t>)];
+    ShmFrame entries[SHM_RING_SLOTS];
+};
+
+struct ShmControl {
+    uint32_t magic;
+    uint32_t version;
+    char pad[SHM_CACHE_LINE - 2U * sizeof(uint32_t)];
+    ShmRing ready;
+    ShmRing release;
+};
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numPackets;
+    uint32_t reserved;
+    uint64_t packetBytes;
+} ShmSetupMsg;
+
+typedef struct {
+    uint32_t magic;
+    int32_t status; // 0 once the consumer mapped every packet
+} ShmSetupReply;
+
+static bool RingPush(ShmRing &ring, const ShmFrame &frame)
+{
+    const uint32_t tail = ring.tail.load(std::memory_order_relaxed);
+    if (tail - ring.head.load(std::memory_order_acquire) >= SHM_RING_SLOTS) {
+        return false;
+    }
+    ring.entries[tail & (SHM_RING_SLOTS - 1U)] = frame;
+    ring.tail.store(tail + 1U, std::memory_order_release);
+    return true;
+}
+
+static bool RingPop(ShmRing &ring, ShmFrame &frame)
+{
+    const uint32_t head = ring.head.load(std::memory_order_relaxed);
+    if (head == ring.tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    frame = ring.entries[head & (SHM_RING_SLOTS - 1U)];
+    ring.head.store(head + 1U, std::memory_order_release);
+    return true;
+}
+
+static void SignalEvent(int eventFd)
+{
+    uint64_t one = 1U;
+    (void)!write(eventFd, &one, sizeof(one));
+}
+
+// The eventfds are non-blocking, clearing an unsignaled one is a no-op
+static void ClearEvent(int eventFd)
+{
+    uint64_t count = 0U;
+    (void)!read(eventFd, &count, sizeof(count));
+}
+
+// Abstract socket namespace, nothing is left behind in the file system
+static socklen_t ChannelAddress(const std::string &channel, sockaddr_un &addr)
+{
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    const std::string name = "nvsipl_shm/" + channel;
+    const size_t len = std::min(name.size(), sizeof(addr.sun_path) - 1U);
+    memcpy(addr.sun_path + 1, name.data(), len);
+    return (socklen_t)(offsetof(sockaddr_un, sun_path) + 1U + len);
+}
+
+static int RemainingMs(std::chrono::steady_clock::time_point deadline, int timeoutMs)
+{
+    if (timeoutMs < 0) {
+        return -1;
+    }
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    return (left.count() > 0) ? (int)left.count() : 0;
+}
+
+static bool PollIn(int fd, int timeoutMs)
+{
+    pollfd pfd { fd, POLLIN, 0 };
+    return poll(&pfd, 1U, timeoutMs) == 1;
+}
+
+static bool CookieToIndex(uint64_t cookie, size_t numPackets, uint32_t &index)
+{
+    if (cookie <= SHM_COOKIE_BASE || cookie - SHM_COOKIE_BASE > numPackets) {
+        return false;
+    }
+    index = (uint32_t)(cookie - SHM_COOKIE_BASE - 1U);
+    return true;
+}
+
+static void *MapFd(int fd, size_t bytes, int prot)
+{
+    void *pMem = mmap(nullptr, bytes, prot, MAP_SHARED, fd, 0);
+    return (pMem == MAP_FAILED) ? nullptr : pMem;
+}
+
+CShmProducer::~CShmProducer(void)
+{
+    for (uint32_t i = 0U; i < SHM_MAX_CONSUMERS; i++) {
+        if ((m_connectedMask & (1U << i)) != 0U) {
+            Disconnect(i);
+        }
+    }
+    if (m_listenSocket >= 0) {
+        close(m_listenSocket);
+    }
+    for (size_t i = 0U; i < m_buffers.size(); i++) {
+        munmap(m_buffers[i], m_packetBytes);
+    }
+    for (int fd : m_packetFds) {
+        close(fd);
+    }
+}
+
+bool CShmProducer::Fail(const std::string &what)
+{
+    m_error = what + ((errno != 0) ? std::string(": ") + strerror(errno) : "");
+    return false;
+}
+
+bool CShmProducer::Init(const std::string &channel, uint32_t numPackets, size_t packetBytes)
+{
+    errno = 0;
+    if (numPackets == 0U || numPackets > MAX_PACKETS || packetBytes == 0U) {
+        return Fail("packets must be 1.." + std::to_string(MAX_PACKETS) + " and not empty");
+    }
+    m_channel = channel;
+    m_packetBytes = packetBytes;
+
+    for (uint32_t i = 0U; i < numPackets; i++) {
+        int fd = memfd_create(("nvsipl_shm_packet" + std::to_string(i)).c_str(), MFD_CLOEXEC);
+        if (fd < 0) {
+            return Fail("memfd_create");
+        }
+        m_packetFds.push_back(fd);
+        if (ftruncate(fd, (off_t)packetBytes) != 0) {
+            return Fail("ftruncate");
+        }
+        void *pMem = MapFd(fd, packetBytes, PROT_READ | PROT_WRITE);
+        if (pMem == nullptr) {
+            return Fail("mmap packet");
+        }
+        m_buffers.push_back(static_cast<uint8_t *>(pMem));
+        m_freePackets.push_back(i);
+    }
+    m_heldMasks.assign(numPackets, 0U);
+
+    sockaddr_un addr;
+    socklen_t addrLen = ChannelAddress(channel, addr);
+    m_listenSocket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (m_listenSocket < 0) {
+        return Fail("socket");
+    }
+    if (bind(m_listenSocket, reinterpret_cast<sockaddr *>(&addr), addrLen) != 0) {
+        return Fail("bind " + channel);
+    }
+    if (listen(m_listenSocket, (int)SHM_MAX_CONSUMERS) != 0) {
+        return Fail("listen " + channel);
+    }
+    return true;
+}
+
+bool CShmProducer::Accept(void)
+{
+    errno = 0;
+    int sock = accept4(m_listenSocket, nullptr, nullptr, SOCK_CLOEXEC);
+    if (sock < 0) {
+        return Fail("accept");
+    }
+    uint32_t index = 0U;
+    while (index < SHM_MAX_CONSUMERS && (m_connectedMask & (1U << index)) != 0U) {
+        index++;
+    }
+    if (index == SHM_MAX_CONSUMERS) {
+        close(sock);
+        return Fail("at most " + std::to_string(SHM_MAX_CONSUMERS) + " consumers");
+    }
+
+    Connection conn { sock, -1, -1, nullptr };
+    int controlFd = memfd_create("nvsipl_shm_control", MFD_CLOEXEC);
+    void *pMem = nullptr;
+    bool bOk = (controlFd >= 0) && (ftruncate(controlFd, sizeof(ShmControl)) == 0) &&
+               ((pMem = MapFd(controlFd, sizeof(ShmControl), PROT_READ | PROT_WRITE)) != nullptr);
+    if (bOk) {
+        conn.pControl = new (pMem) ShmControl();
+        conn.pControl->magic = SHM_MAGIC;
+        conn.pControl->version = SHM_VERSION;
+        conn.readyEvent = eventfd(0U, EFD_CLOEXEC | EFD_NONBLOCK);
+        conn.releaseEvent = eventfd(0U, EFD_CLOEXEC | EFD_NONBLOCK);
+        bOk = (conn.readyEvent >= 0) && (conn.releaseEvent >= 0);
+    }
+
+    if (bOk) {
+        // The packets go out like NvSciStream packet creation, the reply is the packet status
+        ShmSetupMsg msg { SHM_MAGIC, SHM_VERSION, (uint32_t)m_buffers.size(), 0U, m_packetBytes };
+        std::vector<int> fds { controlFd, conn.readyEvent, conn.releaseEvent };
+        fds.insert(fds.end(), m_packetFds.begin(), m_packetFds.end());
+        std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()), 0);
+        iovec iov { &msg, sizeof(msg) };
+        msghdr hdr {};
+        hdr.msg_iov = &iov;
+        hdr.msg_iovlen = 1U;
+        hdr.msg_control = control.data();
+        hdr.msg_controllen = control.size();
+        cmsghdr *pCmsg = CMSG_FIRSTHDR(&hdr);
+        pCmsg->cmsg_level = SOL_SOCKET;
+        pCmsg->cmsg_type = SCM_RIGHTS;
+        pCmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        memcpy(CMSG_DATA(pCmsg), fds.data(), sizeof(int) * fds.size());
+        bOk = sendmsg(sock, &hdr, MSG_NOSIGNAL) == (ssize_t)sizeof(msg);
+
+        ShmSetupReply reply {};
+        bOk = bOk && PollIn(sock, SHM_SETUP_TIMEOUT_MS) && recv(sock, &reply, sizeof(reply), 0) == sizeof(reply) &&
+              reply.magic == SHM_MAGIC && reply.status == 0;
+    }
+    if (controlFd >= 0) {
+        close(controlFd);
+    }
+
+    m_connections[index] = conn;
+    m_connectedMask |= 1U << index;
+    if (!bOk) {
+        Disconnect(index);
+        return Fail("consumer setup");
+    }
+    return true;
+}
+
+bool CShmProducer::Connect(uint32_t numConsumers, int timeoutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeoutMs, 0));
+    while (GetNumConsumers() < numConsumers) {
+        errno = 0;
+        if (!PollIn(m_listenSocket, RemainingMs(deadline, timeoutMs))) {
+            return Fail("waiting for consumers on " + m_channel + ", " + std::to_string(GetNumConsumers()) + " of " +
+                        std::to_string(numConsumers) + " connected");
+        }
+        if (!Accept()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t CShmProducer::GetNumConsumers(void) const
+{
+    uint32_t count = 0U;
+    for (uint32_t mask = m_connectedMask; mask != 0U; mask &= mask - 1U) {
+        count++;
+    }
+    return count;
+}
+
+void CShmProducer::ReleaseToProducer(uint32_t packetIndex, uint32_t connection)
+{
+    const uint32_t bit = 1U << connection;
+    if ((m_heldMasks[packetIndex] & bit) != 0U) {
+        m_heldMasks[packetIndex] &= ~bit;
+        if (m_heldMasks[packetIndex] == 0U) {
+            m_freePackets.push_back(packetIndex);
+        }
+    }
+}
+
+void CShmProducer::DrainReleases(uint32_t index)
+{
+    ShmFrame frame;
+    while (RingPop(m_connections[index].pControl->release, frame)) {
+        uint32_t packetIndex = 0U;
+        if (CookieToIndex(frame.cookie, m_buffers.size(), packetIndex)) {
+            ReleaseToProducer(packetIndex, index);
+        }
+    }
+}
+
+void CShmProducer::Disconnect(uint32_t index)
+{
+    Connection &conn = m_connections[index];
+    if (conn.pControl != nullptr) {
+        DrainReleases(index);
+        munmap(conn.pControl, sizeof(ShmControl));
+    }
+    // Whatever the consumer still held comes back
+    for (uint32_t i = 0U; i < m_heldMasks.size(); i++) {
+        ReleaseToProducer(i, index);
+    }
+    for (int fd : { conn.socket, conn.readyEvent, conn.releaseEvent }) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    conn = Connection{ -1, -1, -1, nullptr };
+    m_connectedMask &= ~(1U << index);
+}
+
+bool CShmProducer::GetPacket(uint64_t &cookie, int timeoutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeoutMs, 0));
+    while (true) {
+        // Clear before draining, a release pushed in between signals again
+        for (uint32_t i = 0U; i < SHM_MAX_CONSUMERS; i++) {
+            if ((m_connectedMask & (1U << i)) != 0U) {
+                ClearEvent(m_connections[i].releaseEvent);
+                DrainReleases(i);
+            }
+        }
+        if (!m_freePackets.empty()) {
+            cookie = SHM_COOKIE_BASE + m_freePackets.front() + 1U;
+            m_freePackets.pop_front();
+            return true;
+        }
+        errno = 0;
+        if (m_connectedMask == 0U) {
+            return Fail("no free packet and no consumer to release one");
+        }
+
+        pollfd fds[2U * SHM_MAX_CONSUMERS];
+        uint32_t owners[2U * SHM_MAX_CONSUMERS];
+        nfds_t count = 0U;
+        for (uint32_t i = 0U; i < SHM_MAX_CONSUMERS; i++) {
+            if ((m_connectedMask & (1U << i)) != 0U) {
+                owners[count] = i;
+                fds[count++] = pollfd{ m_connections[i].releaseEvent, POLLIN, 0 };
+                owners[count] = i;
+                fds[count++] = pollfd{ m_connections[i].socket, POLLIN, 0 };
+            }
+        }
+        int ready = poll(fds, count, RemainingMs(deadline, timeoutMs));
+        if (ready == 0) {
+            return Fail("timed out waiting for a released packet");
+        }
+        if (ready < 0 && errno != EINTR) {
+            return Fail("poll");
+        }
+        // Consumers send nothing while streaming, a readable socket is a hang-up
+        for (nfds_t f = 1U; f < count; f += 2U) {
+            if (fds[f].revents != 0) {
+                Disconnect(owners[f]);
+            }
+        }
+    }
+}
+
+uint8_t *CShmProducer::GetBuffer(uint64_t cookie)
+{
+    uint32_t index = 0U;
+    return CookieToIndex(cookie, m_buffers.size(), index) ? m_buffers[index] : nullptr;
+}
+
+bool CShmProducer::Present(uint64_t cookie, const ShmFrame &frame)
+{
+    errno = 0;
+    uint32_t index = 0U;
+    if (!CookieToIndex(cookie, m_buffers.size(), index) || m_heldMasks[index] != 0U) {
+        return Fail("present of a packet the producer does not own");
+    }
+
+    ShmFrame out = frame;
+    out.cookie = cookie;
+    out.presentNs = CTimeBase::NowNs();
+    for (uint32_t i = 0U; i < SHM_MAX_CONSUMERS; i++) {
+        if ((m_connectedMask & (1U << i)) != 0U && RingPush(m_connections[i].pControl->ready, out)) {
+            m_heldMasks[index] |= 1U << i;
+            SignalEvent(m_connections[i].readyEvent);
+        }
+    }
+    if (m_heldMasks[index] == 0U) {
+        m_freePackets.push_back(index);
+    }
+    return true;
+}
+
+CShmConsumer::~CShmConsumer(void)
+{
+    for (const uint8_t *pBuffer : m_buffers) {
+        munmap(const_cast<uint8_t *>(pBuffer), m_packetBytes);
+    }
+    if (m_pControl != nullptr) {
+        munmap(m_pControl, sizeof(ShmControl));
+    }
+    for (int fd : { m_socket, m_readyEvent, m_releaseEvent }) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+bool CShmConsumer::Fail(const std::string &what)
+{
+    m_error = what + ((errno != 0) ? std::string(": ") + strerror(errno) : "");
+    return false;
+}
+
+bool CShmConsumer::Connect(const std::string &channel, int timeoutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeoutMs, 0));
+    sockaddr_un addr;
+    socklen_t addrLen = ChannelAddress(channel, addr);
+    while (true) {
+        errno = 0;
+        m_socket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (m_socket < 0) {
+            return Fail("socket");
+        }
+        if (connect(m_socket, reinterpret_cast<sockaddr *>(&addr), addrLen) == 0) {
+            break;
+        }
+        // Like an NvSciIpc endpoint, wait for the producer to come up
+        bool bRetry = (errno == ECONNREFUSED || errno == ENOENT) && RemainingMs(deadline, timeoutMs) != 0;
+        if (!bRetry) {
+            return Fail("connect " + channel);
+        }
+        close(m_socket);
+        m_socket = -1;
+        std::this_thread::sleep_for(std::chrono::milliseconds(SHM_CONNECT_RETRY_MS));
+    }
+
+    ShmSetupMsg msg {};
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * (SHM_SETUP_FDS + MAX_PACKETS)), 0);
+    iovec iov { &msg, sizeof(msg) };
+    msghdr hdr {};
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1U;
+    hdr.msg_control = control.data();
+    hdr.msg_controllen = control.size();
+    errno = 0;
+    if (!PollIn(m_socket, SHM_SETUP_TIMEOUT_MS) || recvmsg(m_socket, &hdr, MSG_CMSG_CLOEXEC) != sizeof(msg)) {
+        return Fail("receiving the packets");
+    }
+    std::vector<int> fds;
+    for (cmsghdr *pCmsg = CMSG_FIRSTHDR(&hdr); pCmsg != nullptr; pCmsg = CMSG_NXTHDR(&hdr, pCmsg)) {
+        if (pCmsg->cmsg_level == SOL_SOCKET && pCmsg->cmsg_type == SCM_RIGHTS) {
+            const size_t num = (pCmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            fds.resize(num);
+            memcpy(fds.data(), CMSG_DATA(pCmsg), sizeof(int) * num);
+        }
+    }
+
+    bool bOk = msg.magic == SHM_MAGIC && msg.version == SHM_VERSION && msg.numPackets != 0U &&
+               msg.numPackets <= MAX_PACKETS && fds.size() == SHM_SETUP_FDS + msg.numPackets &&
+               (hdr.msg_flags & MSG_CTRUNC) == 0;
+    if (bOk) {
+        m_packetBytes = msg.packetBytes;
+        m_readyEvent = fds[1];
+        m_releaseEvent = fds[2];
+        m_pControl = static_cast<ShmControl *>(MapFd(fds[0], sizeof(ShmControl), PROT_READ | PROT_WRITE));
+        bOk = m_pControl != nullptr && m_pControl->magic == SHM_MAGIC;
+        // Read-only like the consumers' NvSciBuf access permission
+        for (uint32_t i = 0U; bOk && i < msg.numPackets; i++) {
+            void *pMem = MapFd(fds[SHM_SETUP_FDS + i], m_packetBytes, PROT_READ);
+            bOk = pMem != nullptr;
+            if (bOk) {
+                m_buffers.push_back(static_cast<const uint8_t *>(pMem));
+            }
+        }
+    }
+    // The mappings keep the memory, only the eventfds stay open
+    for (size_t i = 0U; i < fds.size(); i++) {
+        if (fds[i] != m_readyEvent && fds[i] != m_releaseEvent) {
+            close(fds[i]);
+        }
+    }
+
+    ShmSetupReply reply { SHM_MAGIC, bOk ? 0 : -1 };
+    if (send(m_socket, &reply, sizeof(reply), MSG_NOSIGNAL) != sizeof(reply)) {
+        return Fail("sending the packet status");
+    }
+    return bOk || Fail("setting up the packets from " + channel);
+}
+
+bool CShmConsumer::Acquire(ShmFrame &frame, int timeoutMs)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeoutMs, 0));
+    while (true) {
+        ClearEvent(m_readyEvent);
+        bool bGot = false;
+        ShmFrame next;
+        while (RingPop(m_pControl->ready, next)) {
+            if (bGot) {
+                (void)Release(frame.cookie);
+                m_droppedFrames++;
+            }
+            frame = next;
+            bGot = true;
+            if (!m_bMailbox) {
+                break;
+            }
+        }
+        if (bGot) {
+            return true;
+        }
+
+        errno = 0;
+        pollfd fds[2] = { { m_readyEvent, POLLIN, 0 }, { m_socket, POLLIN, 0 } };
+        int ready = poll(fds, 2U, RemainingMs(deadline, timeoutMs));
+        if (ready == 0) {
+            return Fail("timed out waiting for a frame");
+        }
+        if (ready < 0 && errno != EINTR) {
+            return Fail("poll");
+        }
+        if (fds[1].revents != 0) {
+            errno = 0;
+            return Fail("producer disconnected");
+        }
+    }
+}
+
+const uint8_t *CShmConsumer::GetBuffer(uint64_t cookie) const
+{
+    uint32_t index = 0U;
+    return CookieToIndex(cookie, m_buffers.size(), index) ? m_buffers[index] : nullptr;
+}
+
+bool CShmConsumer::Release(uint64_t cookie)
+{
+    errno = 0;
+    uint32_t index = 0U;
+    if (!CookieToIndex(cookie, m_buffers.size(), index)) {
+        return Fail("release of an unknown packet");
+    }
+    ShmFrame frame {};
+    frame.cookie = cookie;
+    if (!RingPush(m_pControl->release, frame)) {
+        return Fail("release ring full");
+    }
+    SignalEvent(m_releaseEvent);
+    return true;
+}
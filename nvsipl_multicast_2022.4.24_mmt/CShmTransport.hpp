@@ -0,0 +1,152 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CSHMTRANSPORT_HPP
+#define CSHMTRANSPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "Common.hpp"
+
+// Packets are numbered like the NvSciStream cookies, see cookieBase in CClientCommon.hpp
+constexpr uint64_t SHM_COOKIE_BASE = 0xC00C1E4U;
+constexpr uint32_t SHM_MAX_CONSUMERS = MAX_IPC_CONSUMERS;
+
+// One presented frame as carried by the rings
+typedef struct {
+    uint64_t cookie;
+    uint64_t frameCount;
+    uint64_t captureNs;
+    uint64_t presentNs; // CTimeBase stamp taken by Present(), for the IPC latency
+} ShmFrame;
+
+struct ShmControl;
+
+/* Stand-in for the NvSciIpc/NvSciStream IPC path on plain Linux.
+ * The producer owns the packet buffers, one memfd each, and listens on a Unix
+ * socket named after the channel. A consumer connects, receives the packet
+ * memfds together with a shared control block and two eventfds over
+ * SCM_RIGHTS, and maps the buffers read-only. Frames then travel through two
+ * lock-free rings in the control block, ready (producer to consumer) and
+ * release (consumer to producer), each paired with an eventfd that wakes the
+ * other side. A packet returns to the producer once every consumer it was
+ * presented to has released it, the packets of a consumer that disconnects
+ * are reclaimed. The CPU writes to a buffer are complete when Present()
+ * publishes it, so no fences are exchanged. Each object is used by a single
+ * thread. Linux only, needs no NVIDIA libraries. */
+class CShmProducer
+{
+public:
+    CShmProducer(void) = default;
+    ~CShmProducer(void);
+
+    CShmProducer(const CShmProducer &) = delete;
+    CShmProducer &operator=(const CShmProducer &) = delete;
+
+    // Creates the packets and starts listening on the channel.
+    bool Init(const std::string &channel, uint32_t numPackets, size_t packetBytes);
+    // Setup phase, returns once numConsumers consumers have taken the packets.
+    bool Connect(uint32_t numConsumers, int timeoutMs);
+
+    // Waits for a packet that no consumer holds, a negative timeout waits forever.
+    bool GetPacket(uint64_t &cookie, int timeoutMs);
+    uint8_t *GetBuffer(uint64_t cookie);
+    // Hands the packet to every connected consumer, frame.cookie is ignored.
+    bool Present(uint64_t cookie, const ShmFrame &frame);
+
+    uint32_t GetNumConsumers(void) const;
+    const std::string &GetError(void) const
+    {
+        return m_error;
+    }
+
+private:
+    typedef struct {
+        int socket;
+        int readyEvent;   // producer -> consumer
+        int releaseEvent; // consumer -> producer
+        ShmControl *pControl;
+    } Connection;
+
+    bool Accept(void);
+    void Disconnect(uint32_t index);
+    void ReleaseToProducer(uint32_t packetIndex, uint32_t connection);
+    void DrainReleases(uint32_t index);
+    bool Fail(const std::string &what);
+
+    std::string m_channel;
+    int m_listenSocket = -1;
+    size_t m_packetBytes = 0U;
+    std::vector<int> m_packetFds;
+    std::vector<uint8_t *> m_buffers;
+    std::vector<uint32_t> m_heldMasks;   // consumers holding each packet, by connection
+    std::deque<uint32_t> m_freePackets; // in release order
+    Connection m_connections[SHM_MAX_CONSUMERS];
+    uint32_t m_connectedMask = 0U;
+    std::string m_error;
+};
+
+class CShmConsumer
+{
+public:
+    CShmConsumer(void) = default;
+    ~CShmConsumer(void);
+
+    CShmConsumer(const CShmConsumer &) = delete;
+    CShmConsumer &operator=(const CShmConsumer &) = delete;
+
+    // Retries until the producer listens or the timeout expires, then maps the packets.
+    bool Connect(const std::string &channel, int timeoutMs);
+    // Like a mailbox queue: Acquire() returns the newest frame and releases the older ones.
+    void SetMailbox(bool bMailbox)
+    {
+        m_bMailbox = bMailbox;
+    }
+
+    // Waits for the next frame, false on timeout or once the producer is gone.
+    bool Acquire(ShmFrame &frame, int timeoutMs);
+    const uint8_t *GetBuffer(uint64_t cookie) const;
+    bool Release(uint64_t cookie);
+
+    uint32_t GetNumPackets(void) const
+    {
+        return (uint32_t)m_buffers.size();
+    }
+    size_t GetPacketBytes(void) const
+    {
+        return m_packetBytes;
+    }
+    // Frames a mailbox released unprocessed
+    uint64_t GetDroppedFrames(void) const
+    {
+        return m_droppedFrames;
+    }
+    const std::string &GetError(void) const
+    {
+        return m_error;
+    }
+
+private:
+    bool Fail(const std::string &what);
+
+    int m_socket = -1;
+    int m_readyEvent = -1;
+    int m_releaseEvent = -1;
+    ShmControl *m_pControl = nullptr;
+    size_t m_packetBytes = 0U;
+    std::vector<const uint8_t *> m_buffers;
+    bool m_bMailbox = false;
+    uint64_t m_droppedFrames = 0U;
+    std::string m_error;
+};
+
+#endif
@@ -22,8 +22,8 @@ class CSingleProcessChannel: public CChannel
 public:
     CSingleProcessChannel() = delete;
     CSingleProcessChannel(NvSciBufModule& bufMod,
-        NvSciSyncModule& syncMod, SensorInfo *pSensorInfo, INvSIPLCamera* pCamera) :
-        CChannel("SingleProcChan", bufMod, syncMod, pSensorInfo)
+        NvSciSyncModule& syncMod, SensorInfo *pSensorInfo, INvSIPLCamera* pCamera, CEventReactor *pReactor) :
+        CChannel("SingleProcChan", bufMod, syncMod, pSensorInfo, pReactor)
     {
         m_pCamera = pCamera;
     }
@@ -67,7 +67,16 @@ public:
     {
         PLOG_DBG("CreateBlocks.\n");
 
-        m_upPoolManager = CFactory::CreatePoolManager(m_pSensorInfo->id);
+        const SensorTopology &topology = CTopology::GetInstance().GetSensor(m_pSensorInfo->id);
+        if (topology.vLocalConsumers.empty()) {
+            PLOG_ERR("Topology lists no local consumer for sensor %u.\n", m_pSensorInfo->id);
+            return NVSIPL_STATUS_BAD_ARGUMENT;
+        }
+        if (!topology.vIpcEndpoints.empty() && CTopology::GetInstance().IsLoaded()) {
+            PLOG_WARN("IPC endpoints of sensor %u are ignored in single process mode.\n", m_pSensorInfo->id);
+        }
+
+        m_upPoolManager = CFactory::CreatePoolManager(m_pSensorInfo->id, topology.numPackets);
         CHK_PTR_AND_RETURN(m_upPoolManager, "CFactory::CreatePoolManager.");
         PLOG_DBG("PoolManager is created.\n");
 
@@ -78,20 +87,18 @@ public:
         upProducer->SetProfiler(pProfiler);
         m_vClients.push_back(std::move(upProducer));
 
-        std::unique_ptr<CConsumer> upCUDAConsumer = CFactory::CreateConsumer(CUDA_CONSUMER, m_pSensorInfo);
-        PCHK_PTR_AND_RETURN(upCUDAConsumer, "CFactory::Create CUDA consumer");
-        m_vClients.push_back(std::move(upCUDAConsumer));
-        PLOG_DBG("CUDA consumer is created.\n");
-
-        if (NUM_CONSUMERS > 1U) {
-            auto status = CFactory::CreateMulticastBlock(NUM_CONSUMERS, m_multicastHandle);
+        if (topology.vLocalConsumers.size() > 1U) {
+            auto status = CFactory::CreateMulticastBlock((uint32_t)topology.vLocalConsumers.size(), m_multicastHandle);
             PCHK_STATUS_AND_RETURN(status, "CFactory::CreateMulticastBlock");
             PLOG_DBG("Multicast block is created.\n");
+        }
 
-            std::unique_ptr<CConsumer> upEncConsumer = CFactory::CreateConsumer(ENC_CONSUMER, m_pSensorInfo);
-            PCHK_PTR_AND_RETURN(upEncConsumer, "CFactory::Create encoder consumer");
-            m_vClients.push_back(std::move(upEncConsumer));
-            PLOG_DBG("Encoder consumer is created.\n");
+        for (const auto &consumer : topology.vLocalConsumers) {
+            std::unique_ptr<CConsumer> upConsumer = CFactory::CreateConsumer(consumer, m_pSensorInfo);
+            PCHK_PTR_AND_RETURN(upConsumer, "CFactory::CreateConsumer");
+            upConsumer->SetProfiler(pProfiler);
+            PLOG_DBG("%s is created.\n", upConsumer->GetName().c_str());
+            m_vClients.push_back(std::move(upConsumer));
         }
 
         return NVSIPL_STATUS_OK;
@@ -103,7 +110,7 @@ public:
 
         PLOG_DBG("Connect.\n");
 
-        if (NUM_CONSUMERS == 1U) {
+        if (m_multicastHandle == 0U) {
             auto sciErr = NvSciStreamBlockConnect(m_vClients[0]->GetHandle(), m_vClients[1]->GetHandle());
             PCHK_NVSCISTATUS_AND_RETURN(sciErr, ("Producer connect to" + m_vClients[1]->GetName()).c_str());
         } else {
@@ -122,11 +129,11 @@ public:
 
         LOG_MSG("Connecting to the stream...\n");
         //query producer
-        auto sciErr = NvSciStreamBlockEventQuery(m_vClients[0]->GetHandle(), QUERY_TIMEOUT_FOREVER, &event);
+        auto sciErr = m_vClients[0]->QueryEvent(QUERY_TIMEOUT_FOREVER, &event);
         PCHK_NVSCICONNECT_AND_RETURN(sciErr, event, "producer");
         PLOG_DBG("Producer is connected.\n");
 
-        sciErr = NvSciStreamBlockEventQuery(m_upPoolManager->GetHandle(), QUERY_TIMEOUT_FOREVER, &event);
+        sciErr = m_upPoolManager->QueryEvent(QUERY_TIMEOUT_FOREVER, &event);
         PCHK_NVSCICONNECT_AND_RETURN(sciErr, event, "pool");
         PLOG_DBG("Pool is connected.\n");
 
@@ -137,7 +144,7 @@ public:
             PCHK_NVSCICONNECT_AND_RETURN(sciErr, event, "queue");
             PLOG_DBG("Queue:%u is connected.\n", (i-1));
 
-            sciErr = NvSciStreamBlockEventQuery(pConsumer->GetHandle(), QUERY_TIMEOUT_FOREVER, &event);
+            sciErr = pConsumer->QueryEvent(QUERY_TIMEOUT_FOREVER, &event);
             PCHK_NVSCICONNECT_AND_RETURN(sciErr, event, "consumer");
             PLOG_DBG("Consumer:%u is connected.\n", (i-1));
         }
@@ -169,7 +176,7 @@ public:
     }
 
 protected:
-    virtual void GetEventThreadHandlers(bool isStreamRunning, std::vector<CEventHandler*>& vEventHandlers)
+    virtual void GetEventHandlers(bool isStreamRunning, std::vector<CEventHandler*>& vEventHandlers)
     {
         if (!isStreamRunning) {
             vEventHandlers.push_back(m_upPoolManager.get());
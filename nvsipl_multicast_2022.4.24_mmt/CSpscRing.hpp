@@ -0,0 +1,93 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CSPSCRING_HPP
+#define CSPSCRING_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#define CACHE_LINE_SIZE (64U)
+
+/* Bounded lock-free ring for exactly one producer thread and one consumer
+ * thread. Capacity is rounded up to a power of two. */
+template <typename T>
+class CSpscRing
+{
+public:
+    explicit CSpscRing(uint32_t capacity)
+    {
+        uint32_t size = 1U;
+        while (size < capacity) {
+            size <<= 1U;
+        }
+        m_mask = size - 1U;
+        m_items.resize(size);
+    }
+
+    CSpscRing(const CSpscRing &) = delete;
+    CSpscRing &operator=(const CSpscRing &) = delete;
+
+    // Producer side, returns false when the ring is full.
+    bool Push(const T &item)
+    {
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_headCache > m_mask) {
+            m_headCache = m_head.load(std::memory_order_acquire);
+            if (tail - m_headCache > m_mask) {
+                return false;
+            }
+        }
+        m_items[tail & m_mask] = item;
+        m_tail.store(tail + 1U, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, returns false when the ring is empty.
+    bool Pop(T &item)
+    {
+        const uint32_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tailCache) {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tailCache) {
+                return false;
+            }
+        }
+        item = m_items[head & m_mask];
+        m_head.store(head + 1U, std::memory_order_release);
+        return true;
+    }
+
+    uint32_t GetCapacity(void) const
+    {
+        return m_mask + 1U;
+    }
+
+    // Approximate when called concurrently with Push/Pop.
+    uint32_t GetSize(void) const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> m_items;
+    uint32_t m_mask = 0U;
+
+    // Producer and consumer indices are padded onto separate cache lines.
+    // Padding rather than alignas, C++14 new does not honor over-alignment.
+    char m_pad0[CACHE_LINE_SIZE];
+    std::atomic<uint32_t> m_tail {0U};
+    uint32_t m_headCache = 0U;
+    char m_pad1[CACHE_LINE_SIZE];
+    std::atomic<uint32_t> m_head {0U};
+    uint32_t m_tailCache = 0U;
+    char m_pad2[CACHE_LINE_SIZE];
+};
+
+#endif
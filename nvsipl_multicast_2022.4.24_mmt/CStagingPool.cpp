@@ -0,0 +1,73 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CStagingPool.hpp"
+
+#include <cstdlib>
+
+void *CHostStagingAllocator::Alloc(size_t size)
+{
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, STAGING_ALIGNMENT, size) != 0) {
+        return nullptr;
+    }
+    return ptr;
+}
+
+void CHostStagingAllocator::Free(void *ptr)
+{
+    free(ptr);
+}
+
+CStagingPool::CStagingPool(std::unique_ptr<CStagingAllocator> upAllocator, uint32_t numSlots) :
+    m_upAllocator(std::move(upAllocator)),
+    m_slots(numSlots, StagingSlot{ nullptr, 0U })
+{
+}
+
+CStagingPool::~CStagingPool(void)
+{
+    for (auto &slot : m_slots) {
+        if (slot.pBuf != nullptr) {
+            m_upAllocator->Free(slot.pBuf);
+            slot.pBuf = nullptr;
+        }
+    }
+}
+
+void CStagingPool::Resize(uint32_t numSlots)
+{
+    if (numSlots > m_slots.size()) {
+        m_slots.resize(numSlots, StagingSlot{ nullptr, 0U });
+    }
+}
+
+bool CStagingPool::Reserve(uint32_t slot, size_t size)
+{
+    if (slot >= m_slots.size() || size == 0U) {
+        return false;
+    }
+
+    StagingSlot &entry = m_slots[slot];
+    if (entry.pBuf != nullptr && entry.capacity >= size) {
+        return true;
+    }
+
+    uint8_t *pBuf = static_cast<uint8_t *>(m_upAllocator->Alloc(size));
+    if (pBuf == nullptr) {
+        return false;
+    }
+    if (entry.pBuf != nullptr) {
+        m_upAllocator->Free(entry.pBuf);
+    }
+    entry.pBuf = pBuf;
+    entry.capacity = size;
+    m_allocCount++;
+
+    return true;
+}
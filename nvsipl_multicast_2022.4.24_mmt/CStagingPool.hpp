@@ -0,0 +1,95 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CSTAGINGPOOL_HPP
+#define CSTAGINGPOOL_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+enum class StagingMemType
+{
+    HOST = 0,
+    PINNED,
+    DEVICE
+};
+
+// Backend that owns the actual memory of a staging pool.
+class CStagingAllocator
+{
+public:
+    virtual ~CStagingAllocator(void) = default;
+
+    virtual void *Alloc(size_t size) = 0;
+    virtual void Free(void *ptr) = 0;
+    virtual StagingMemType GetType(void) const = 0;
+};
+
+constexpr size_t STAGING_ALIGNMENT = 64U;
+
+// Plain host memory, aligned to STAGING_ALIGNMENT (a cache line).
+class CHostStagingAllocator : public CStagingAllocator
+{
+public:
+    virtual void *Alloc(size_t size) override;
+    virtual void Free(void *ptr) override;
+    virtual StagingMemType GetType(void) const override
+    {
+        return StagingMemType::HOST;
+    }
+};
+
+/* One staging buffer per packet. Slots are sized when a packet is mapped and
+ * reused for every frame carried by that packet, so steady-state streaming does
+ * not allocate. A slot is only reallocated when a larger size is reserved. */
+class CStagingPool
+{
+public:
+    CStagingPool(std::unique_ptr<CStagingAllocator> upAllocator, uint32_t numSlots);
+    ~CStagingPool(void);
+
+    CStagingPool(const CStagingPool &) = delete;
+    CStagingPool &operator=(const CStagingPool &) = delete;
+
+    // Adds empty slots up to numSlots, never shrinks.
+    void Resize(uint32_t numSlots);
+    // Makes sure the slot holds at least size bytes.
+    bool Reserve(uint32_t slot, size_t size);
+
+    uint8_t *GetBuffer(uint32_t slot) const
+    {
+        return (slot < m_slots.size()) ? m_slots[slot].pBuf : nullptr;
+    }
+    size_t GetCapacity(uint32_t slot) const
+    {
+        return (slot < m_slots.size()) ? m_slots[slot].capacity : 0U;
+    }
+    StagingMemType GetType(void) const
+    {
+        return m_upAllocator->GetType();
+    }
+    // Number of backend allocations made so far, constant once streaming.
+    uint64_t GetAllocCount(void) const
+    {
+        return m_allocCount;
+    }
+
+private:
+    typedef struct {
+        uint8_t *pBuf;
+        size_t capacity;
+    } StagingSlot;
+
+    std::unique_ptr<CStagingAllocator> m_upAllocator;
+    std::vector<StagingSlot> m_slots;
+    uint64_t m_allocCount = 0U;
+};
+
+#endif
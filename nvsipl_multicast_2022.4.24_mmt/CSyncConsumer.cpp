@@ -0,0 +1,30 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CSyncConsumer.hpp"
+
+CSyncConsumer::CSyncConsumer(NvSciStreamBlock handle, uint32_t uSensor, NvSciStreamBlock queueHandle) :
+    CCpuConsumer("SyncConsumer", handle, uSensor, queueHandle)
+{
+    SetFrameCallback([this](const CpuFrame &frame) {
+        uint64_t captureNs = (frame.pMeta != nullptr && frame.pMeta->frameCaptureTSC != 0U)
+                                 ? CTimeBase::TscToNs(frame.pMeta->frameCaptureTSC)
+                                 : CTimeBase::NowNs();
+        CFrameSync::GetInstance().Push(SyncFrame{ m_uSensorId, frame.packetIndex, captureNs, &frame });
+        return NVSIPL_STATUS_OK;
+    });
+    CFrameSync::GetInstance().AddSensor(m_uSensorId, [this](uint32_t packetIndex) {
+        ReleasePyramid(packetIndex);
+        (void)ReleaseDeferred(packetIndex);
+    });
+}
+
+CSyncConsumer::~CSyncConsumer(void)
+{
+    CFrameSync::GetInstance().RemoveSensor(m_uSensorId);
+}
@@ -0,0 +1,30 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CSYNCCONSUMER_H
+#define CSYNCCONSUMER_H
+
+#include "CCpuConsumer.hpp"
+#include "CFrameSync.hpp"
+
+// CPU consumer that hands its frames to CFrameSync and keeps each packet
+// until the synchronizer has delivered or dropped the frame's group.
+// The SyncFrame's pFrame points to the CpuFrame of the packet.
+class CSyncConsumer: public CCpuConsumer
+{
+    public:
+        CSyncConsumer() = delete;
+        CSyncConsumer(NvSciStreamBlock handle, uint32_t uSensor, NvSciStreamBlock queueHandle);
+        virtual ~CSyncConsumer(void);
+
+    protected:
+        virtual bool DefersRelease(void) const override {return true;};
+        // CFrameSync expects each sensor's frames in capture order
+        virtual bool HasOrderedProcessing(void) const override {return true;};
+};
+#endif
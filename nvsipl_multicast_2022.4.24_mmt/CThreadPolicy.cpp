@@ -0,0 +1,366 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CThreadPolicy.hpp"
+#include "CFlightRecorder.hpp"
+#include "CLogger.hpp"
+
+#include <alloca.h>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <map>
+#include <pthread.h>
+#include <sstream>
+#include <sys/mman.h>
+
+static const char *const ROLE_NAMES[] = { "frame", "pipeline", "devblk", "event", "dump", "metrics", "trace",
+                                          "log", "fence", "worker" };
+
+static bool ParseRole(const std::string &token, ThreadRole &role)
+{
+    for (uint32_t i = 0U; i < (uint32_t)ThreadRole::COUNT; i++) {
+        if (token == ROLE_NAMES[i]) {
+            role = (ThreadRole)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// "0-1,4" style list
+static bool ParseCpuList(const std::string &token, cpu_set_t &cpus)
+{
+    CPU_ZERO(&cpus);
+    std::stringstream ss(token);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        char *pEnd = nullptr;
+        unsigned long first = strtoul(range.c_str(), &pEnd, 10);
+        unsigned long last = first;
+        if (pEnd == range.c_str()) {
+            return false;
+        }
+        if (*pEnd == '-') {
+            const char *pLast = pEnd + 1;
+            last = strtoul(pLast, &pEnd, 10);
+            if (pEnd == pLast) {
+                return false;
+            }
+        }
+        if (*pEnd != '\0' || first > last || last >= CPU_SETSIZE) {
+            return false;
+        }
+        for (unsigned long cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, &cpus);
+        }
+    }
+    return CPU_COUNT(&cpus) > 0;
+}
+
+static bool ParseSchedPolicy(const std::string &token, int &policy)
+{
+    if (token == "other") {
+        policy = SCHED_OTHER;
+    } else if (token == "fifo") {
+        policy = SCHED_FIFO;
+    } else if (token == "rr") {
+        policy = SCHED_RR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static const char *SchedPolicyName(int policy)
+{
+    switch (policy) {
+        case SCHED_FIFO:
+            return "SCHED_FIFO";
+        case SCHED_RR:
+            return "SCHED_RR";
+        case SCHED_OTHER:
+            return "SCHED_OTHER";
+        default:
+            return "SCHED_?";
+    }
+}
+
+std::string CpuListString(const cpu_set_t &cpus)
+{
+    std::string str;
+    int first = -1;
+    for (int cpu = 0; cpu <= CPU_SETSIZE; cpu++) {
+        bool bSet = (cpu < CPU_SETSIZE) && CPU_ISSET(cpu, &cpus);
+        if (bSet && first < 0) {
+            first = cpu;
+        } else if (!bSet && first >= 0) {
+            if (!str.empty()) {
+                str += ",";
+            }
+            str += std::to_string(first);
+            if (cpu - 1 > first) {
+                str += "-" + std::to_string(cpu - 1);
+            }
+            first = -1;
+        }
+    }
+    return str;
+}
+
+// topology/<name> of the CPU, -1 when the kernel does not export it
+static int ReadCpuTopologyId(int cpu, const char *name)
+{
+    std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/" + name);
+    int id = -1;
+    return (file >> id) ? id : -1;
+}
+
+// NUMA node of the CPU from its nodeN link, -1 without NUMA support
+static int ReadCpuNode(int cpu)
+{
+    DIR *pDir = opendir(("/sys/devices/system/cpu/cpu" + std::to_string(cpu)).c_str());
+    if (pDir == nullptr) {
+        return -1;
+    }
+    int node = -1;
+    struct dirent *pEntry = nullptr;
+    while ((pEntry = readdir(pDir)) != nullptr) {
+        if (strncmp(pEntry->d_name, "node", 4U) == 0 && isdigit((unsigned char)pEntry->d_name[4])) {
+            node = atoi(pEntry->d_name + 4);
+            break;
+        }
+    }
+    closedir(pDir);
+    return node;
+}
+
+std::vector<cpu_set_t> GetCpuClusters(void)
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return {};
+    }
+
+    // Older kernels have no cluster_id, the package then stands in for the cluster
+    std::map<std::pair<int, int>, cpu_set_t> clusters;
+    std::vector<std::pair<int, int>> order;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        int cluster = ReadCpuTopologyId(cpu, "cluster_id");
+        if (cluster < 0) {
+            cluster = ReadCpuTopologyId(cpu, "physical_package_id");
+        }
+        std::pair<int, int> key(ReadCpuNode(cpu), cluster);
+        if (clusters.find(key) == clusters.end()) {
+            CPU_ZERO(&clusters[key]);
+            order.push_back(key);
+        }
+        CPU_SET(cpu, &clusters[key]);
+    }
+
+    std::vector<cpu_set_t> vClusters;
+    for (const auto &key : order) {
+        vClusters.push_back(clusters[key]);
+    }
+    return vClusters;
+}
+
+// Touches the next bytes of the stack so later growth does not page fault
+static void PrefaultStack(size_t size)
+{
+    volatile uint8_t *pStack = static_cast<volatile uint8_t *>(alloca(size));
+    for (size_t i = 0U; i < size; i += 4096U) {
+        pStack[i] = 0U;
+    }
+}
+
+CThreadPolicy &CThreadPolicy::GetInstance(void)
+{
+    static CThreadPolicy instance;
+    return instance;
+}
+
+bool CThreadPolicy::Load(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        LOG_ERR("ThreadPolicy: cannot open %s\n", path.c_str());
+        return false;
+    }
+
+    std::string line;
+    uint32_t lineNum = 0U;
+    while (std::getline(file, line)) {
+        lineNum++;
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.resize(comment);
+        }
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        if (!ParseLine(line, lineNum)) {
+            LOG_ERR("ThreadPolicy: %s:%u: invalid rule\n", path.c_str(), lineNum);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CThreadPolicy::ParseLine(const std::string &line, uint32_t lineNum)
+{
+    std::stringstream ss(line);
+    std::string roleToken, instanceToken, cpusToken, policyToken;
+    int priority = 0;
+
+    ss >> roleToken;
+    if (roleToken == "mlock") {
+        size_t prefaultKb = 0U;
+        if (!(ss >> prefaultKb) || prefaultKb > THREAD_MAX_PREFAULT_KB) {
+            return false;
+        }
+        m_bLockMemory = true;
+        m_prefaultBytes = prefaultKb * 1024U;
+        return true;
+    }
+
+    ThreadRule rule {};
+    if (!ParseRole(roleToken, rule.role) || !(ss >> instanceToken >> cpusToken >> policyToken)) {
+        return false;
+    }
+    if (instanceToken == "*") {
+        rule.instance = THREAD_ANY_INSTANCE;
+    } else {
+        char *pEnd = nullptr;
+        rule.instance = (uint32_t)strtoul(instanceToken.c_str(), &pEnd, 10);
+        if (*pEnd != '\0') {
+            return false;
+        }
+    }
+    if (cpusToken != "*") {
+        if (!ParseCpuList(cpusToken, rule.cpus)) {
+            return false;
+        }
+        rule.bHasCpus = true;
+    }
+    if (policyToken != "*") {
+        if (!ParseSchedPolicy(policyToken, rule.policy)) {
+            return false;
+        }
+        ss >> priority;
+        if (priority < sched_get_priority_min(rule.policy) || priority > sched_get_priority_max(rule.policy)) {
+            LOG_ERR("ThreadPolicy: line %u: priority %d out of range for %s\n", lineNum, priority,
+                    SchedPolicyName(rule.policy));
+            return false;
+        }
+        rule.priority = priority;
+        rule.bHasSched = true;
+    }
+
+    m_vRules.push_back(rule);
+    return true;
+}
+
+const ThreadRule *CThreadPolicy::FindRule(ThreadRole role, uint32_t instance) const
+{
+    const ThreadRule *pMatch = nullptr;
+    for (const auto &rule : m_vRules) {
+        if (rule.role != role) {
+            continue;
+        }
+        if (rule.instance == instance) {
+            pMatch = &rule;
+        } else if (rule.instance == THREAD_ANY_INSTANCE &&
+                   (pMatch == nullptr || pMatch->instance == THREAD_ANY_INSTANCE)) {
+            pMatch = &rule;
+        }
+    }
+    return pMatch;
+}
+
+bool CThreadPolicy::LockMemory(void)
+{
+    if (!m_bLockMemory) {
+        return true;
+    }
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        LOG_ERR("ThreadPolicy: mlockall failed: %s\n", strerror(errno));
+        return false;
+    }
+    m_bMemoryLocked = true;
+    if (m_prefaultBytes > 0U) {
+        PrefaultStack(m_prefaultBytes);
+    }
+
+    return true;
+}
+
+void CThreadPolicy::Report(void)
+{
+    LOG_MSG("ThreadPolicy: %u rules, memory %s, stack prefault %u KiB\n", (uint32_t)m_vRules.size(),
+            m_bMemoryLocked ? "locked" : "not locked", (uint32_t)(m_prefaultBytes / 1024U));
+    for (const auto &rule : m_vRules) {
+        std::string instance = (rule.instance == THREAD_ANY_INSTANCE) ? "*" : std::to_string(rule.instance);
+        LOG_MSG("ThreadPolicy: %s %s cpus %s %s %d\n", ROLE_NAMES[(uint32_t)rule.role], instance.c_str(),
+                rule.bHasCpus ? CpuListString(rule.cpus).c_str() : "*",
+                rule.bHasSched ? SchedPolicyName(rule.policy) : "*", rule.priority);
+    }
+}
+
+void CThreadPolicy::Apply(ThreadRole role, uint32_t instance, const std::string &name)
+{
+    pthread_t self = pthread_self();
+    pthread_setname_np(self, name.c_str());
+
+    const ThreadRule *pRule = FindRule(role, instance);
+    if (pRule != nullptr && pRule->bHasCpus) {
+        int ret = pthread_setaffinity_np(self, sizeof(cpu_set_t), &pRule->cpus);
+        if (ret != 0) {
+            LOG_WARN("%s: pthread_setaffinity_np failed: %s\n", name.c_str(), strerror(ret));
+        }
+    }
+    if (pRule != nullptr && pRule->bHasSched) {
+        struct sched_param param {};
+        param.sched_priority = pRule->priority;
+        int ret = pthread_setschedparam(self, pRule->policy, &param);
+        if (ret != 0) {
+            // Real-time classes need CAP_SYS_NICE or an RLIMIT_RTPRIO allowance
+            LOG_WARN("%s: pthread_setschedparam(%s, %d) failed: %s\n", name.c_str(),
+                     SchedPolicyName(pRule->policy), pRule->priority, strerror(ret));
+        }
+    }
+    if (m_bMemoryLocked && m_prefaultBytes > 0U) {
+        PrefaultStack(m_prefaultBytes);
+    }
+
+    // Report what the kernel actually applied, not what was asked for
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    int policy = SCHED_OTHER;
+    struct sched_param param {};
+    pthread_getaffinity_np(self, sizeof(cpu_set_t), &cpus);
+    pthread_getschedparam(self, &policy, &param);
+    std::string roleStr = ROLE_NAMES[(uint32_t)role];
+    if (instance != THREAD_ANY_INSTANCE) {
+        roleStr += " " + std::to_string(instance);
+    }
+    LOG_MSG("ThreadPolicy: %s (%s): cpus %s, %s %d\n", name.c_str(), roleStr.c_str(),
+            CpuListString(cpus).c_str(), SchedPolicyName(policy), param.sched_priority);
+
+    // Named by now, the ring takes the name
+    CFlightRecorder::GetInstance().RegisterThread();
+}
@@ -0,0 +1,87 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CTHREADPOLICY_HPP
+#define CTHREADPOLICY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <sched.h>
+#include <string>
+#include <vector>
+
+enum class ThreadRole : uint32_t
+{
+    FRAME_QUEUE = 0,  // SIPL frame completion queue, instance is the sensor
+    PIPELINE_EVENT,   // SIPL pipeline notifications, instance is the sensor
+    DEVBLK_EVENT,     // SIPL device block notifications, instance is the device block
+    EVENT_LOOP,       // CEventReactor loop, instance is the loop index
+    DUMP_WRITER,      // CDumpWriter I/O thread, instance is the sensor
+    METRICS,          // CMetrics exporter, a single thread
+    TRACE,            // CTracer dump thread, a single thread
+    LOG,              // CAsyncLog writer thread, a single thread
+    FENCE,            // CFenceCompleter thread, a single thread
+    WORKER,           // CWorkerPool worker, instance is the worker index
+    COUNT
+};
+
+constexpr uint32_t THREAD_ANY_INSTANCE = UINT32_MAX;
+constexpr size_t THREAD_MAX_PREFAULT_KB = 1024U;
+
+// "0-3,6" form of a CPU set
+std::string CpuListString(const cpu_set_t &cpus);
+
+/* CPUs this process may run on, one set per NUMA node and CPU cluster as
+ * listed under /sys/devices/system/cpu, ordered by their first CPU. A single
+ * set when the topology is not exposed. */
+std::vector<cpu_set_t> GetCpuClusters(void);
+
+typedef struct {
+    ThreadRole role;
+    uint32_t instance;
+    bool bHasCpus;
+    cpu_set_t cpus;
+    bool bHasSched;
+    int policy;
+    int priority;
+} ThreadRule;
+
+/* Scheduling policy for the threads of this process.
+ * Rules come from a text file, one per line:
+ *     <role> <instance|*> <cpus|*> <other|fifo|rr|*> [priority]
+ *     mlock <stack prefault KiB>
+ * Roles are frame, pipeline, devblk, event, dump, metrics, trace, log, fence and worker. A rule for a given
+ * instance wins over a '*' rule. Each process (producer or consumer) loads its
+ * own file. Rules are read-only once the pipeline threads are running. */
+class CThreadPolicy
+{
+public:
+    static CThreadPolicy &GetInstance(void);
+
+    bool Load(const std::string &path);
+    // mlockall() and pre-faulting, when the loaded file asks for it.
+    bool LockMemory(void);
+    void Report(void);
+
+    // Called first thing on the new thread: names it, applies the matching
+    // rule and logs the resulting affinity and scheduling.
+    void Apply(ThreadRole role, uint32_t instance, const std::string &name);
+
+private:
+    CThreadPolicy(void) = default;
+
+    bool ParseLine(const std::string &line, uint32_t lineNum);
+    const ThreadRule *FindRule(ThreadRole role, uint32_t instance) const;
+
+    std::vector<ThreadRule> m_vRules;
+    bool m_bLockMemory = false;
+    size_t m_prefaultBytes = 0U;
+    bool m_bMemoryLocked = false;
+};
+
+#endif
@@ -0,0 +1,590 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CTopology.hpp"
+#include "CConfigNode.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Packets the producer side holds: one in capture/ISP, one queued in SIPL
+constexpr uint32_t PACKETS_IN_PRODUCER = 2U;
+// Frame periods a consumer is assumed to hold a packet when hold_ms is not given
+constexpr double DEFAULT_HOLD_FRAMES = 2.0;
+// Assumed when the sensor mode does not report a frame rate
+constexpr double DEFAULT_FPS = 30.0;
+// RAW12 capture buffer (2 bytes) plus NV12 ISP output (1.5 bytes) per pixel
+constexpr double PACKET_BYTES_PER_PIXEL = 3.5;
+constexpr double BYTES_PER_MIB = 1024.0 * 1024.0;
+// The built-in encoder consumer encodes every other frame of a 30 fps sensor
+constexpr double ENC_DEFAULT_FPS = 15.0;
+
+static const char *CONSUMER_NAMES[] = { "cuda", "enc", "cpu", "sync" };
+static const char *QUEUE_NAMES[] = { "mailbox", "fifo" };
+
+const char *QueueTypeName(QueueType queueType)
+{
+    return QUEUE_NAMES[(uint32_t)queueType];
+}
+
+static bool ParseDecimation(const CConfigNode *pItem, DecimationConfig &decimation)
+{
+    decimation = DecimationConfig{ 0.0, false };
+    if (!pItem->IsMap()) {
+        return true;
+    }
+    const CConfigNode *pFps = pItem->Get("fps");
+    if (pFps != nullptr && (!pFps->AsDouble(decimation.maxFps) || decimation.maxFps < 0.0)) {
+        return false;
+    }
+    const CConfigNode *pAdaptive = pItem->Get("adaptive");
+    return pAdaptive == nullptr || pAdaptive->AsBool(decimation.bAdaptive);
+}
+
+// "", "/15fps", "/15fps adaptive" or "/adaptive"
+static std::string DecimationName(const DecimationConfig &decimation)
+{
+    char fps[32] = "";
+    if (decimation.maxFps > 0.0) {
+        snprintf(fps, sizeof(fps), "/%gfps", decimation.maxFps);
+    }
+    if (decimation.bAdaptive) {
+        return std::string(fps) + ((fps[0] != '\0') ? " adaptive" : "/adaptive");
+    }
+    return fps;
+}
+
+// "" or "/<100ms"
+static std::string DeadlineName(double deadlineMs)
+{
+    char name[32] = "";
+    if (deadlineMs > 0.0) {
+        snprintf(name, sizeof(name), "/<%gms", deadlineMs);
+    }
+    return name;
+}
+
+static bool ParseDeadline(const CConfigNode *pItem, double &deadlineMs)
+{
+    deadlineMs = 0.0;
+    const CConfigNode *pDeadline = pItem->IsMap() ? pItem->Get("deadline_ms") : nullptr;
+    return pDeadline == nullptr || (pDeadline->AsDouble(deadlineMs) && deadlineMs >= 0.0);
+}
+
+// "" or "/pyramid3"
+static std::string PyramidName(uint32_t pyramidLevels)
+{
+    return (pyramidLevels != 0U) ? "/pyramid" + std::to_string(pyramidLevels) : "";
+}
+
+static bool ParsePyramid(const CConfigNode *pItem, uint32_t &pyramidLevels)
+{
+    pyramidLevels = 0U;
+    const CConfigNode *pPyramid = pItem->IsMap() ? pItem->Get("pyramid") : nullptr;
+    return pPyramid == nullptr || (pPyramid->AsUint(pyramidLevels) && pyramidLevels <= PYRAMID_MAX_LEVELS);
+}
+
+// "" or "/x2"
+static std::string InFlightName(uint32_t inFlight)
+{
+    return (inFlight > 1U) ? "/x" + std::to_string(inFlight) : "";
+}
+
+static bool ParseInFlight(const CConfigNode *pItem, uint32_t &inFlight)
+{
+    inFlight = 1U;
+    const CConfigNode *pInFlight = pItem->IsMap() ? pItem->Get("inflight") : nullptr;
+    return pInFlight == nullptr || (pInFlight->AsUint(inFlight) && inFlight >= 1U && inFlight <= MAX_INFLIGHT);
+}
+
+static bool ParseConsumerType(const std::string &name, ConsumerType &type)
+{
+    for (uint32_t i = 0U; i < sizeof(CONSUMER_NAMES) / sizeof(CONSUMER_NAMES[0]); i++) {
+        if (name == CONSUMER_NAMES[i]) {
+            type = (ConsumerType)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ParseQueueType(const CConfigNode *pNode, QueueType &type)
+{
+    if (pNode == nullptr) {
+        type = QueueType::MAILBOX;
+        return true;
+    }
+    for (uint32_t i = 0U; i < sizeof(QUEUE_NAMES) / sizeof(QUEUE_NAMES[0]); i++) {
+        if (pNode->AsString() == QUEUE_NAMES[i]) {
+            type = (QueueType)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+CTopology &CTopology::GetInstance(void)
+{
+    static CTopology instance;
+    return instance;
+}
+
+CTopology::CTopology(void)
+{
+    SensorTopology builtin;
+    builtin.numPackets = DEFAULT_PACKETS;
+    builtin.bAutoPackets = false;
+    builtin.holdMs = 0.0;
+    builtin.calibrationVersion = 0U;
+    builtin.vLocalConsumers.push_back(ConsumerConfig{ CUDA_CONSUMER, QueueType::MAILBOX, { 0.0, false }, 0.0, 0U, 1U });
+    builtin.vLocalConsumers.push_back(
+        ConsumerConfig{ ENC_CONSUMER, QueueType::MAILBOX, { ENC_DEFAULT_FPS, false }, 0.0, 0U, 1U });
+    for (uint32_t i = 0U; i < MAX_IPC_CONSUMERS; i++) {
+        builtin.vIpcEndpoints.push_back(IpcEndpointConfig{ i, QueueType::MAILBOX, { 0.0, false }, 0.0, 0U, 1U });
+    }
+    for (auto &sensor : m_sensors) {
+        sensor = builtin;
+    }
+}
+
+bool CTopology::Load(const std::string &path)
+{
+    if (path.empty()) {
+        return true;
+    }
+
+    std::string error;
+    std::unique_ptr<CConfigNode> upRoot = CConfigNode::ParseFile(path, error);
+    if (upRoot == nullptr) {
+        LOG_ERR("Topology: %s\n", error.c_str());
+        return false;
+    }
+    if (!upRoot->IsMap()) {
+        LOG_ERR("Topology: %s: expected 'default' and 'sensors' keys\n", path.c_str());
+        return false;
+    }
+    m_path = path;
+
+    for (const auto &member : upRoot->GetMembers()) {
+        if (member.first != "default" && member.first != "sensors" && member.first != "memory_budget_mb" &&
+            member.first != "sync") {
+            LOG_ERR("Topology: %s:%u: unknown key '%s'\n", path.c_str(), member.second->GetLine(),
+                    member.first.c_str());
+            return false;
+        }
+    }
+
+    const CConfigNode *pBudget = upRoot->Get("memory_budget_mb");
+    if (pBudget != nullptr) {
+        uint32_t budgetMb = 0U;
+        if (!pBudget->AsUint(budgetMb)) {
+            LOG_ERR("Topology: %s:%u: 'memory_budget_mb' must be a number\n", path.c_str(), pBudget->GetLine());
+            return false;
+        }
+        m_budgetBytes = (uint64_t)budgetMb * 1024U * 1024U;
+    }
+
+    const CConfigNode *pSync = upRoot->Get("sync");
+    if (pSync != nullptr && !ParseSync(*pSync)) {
+        return false;
+    }
+
+    SensorTopology defaults = m_sensors[0];
+    const CConfigNode *pDefault = upRoot->Get("default");
+    if (pDefault != nullptr && !ParseSensor(*pDefault, defaults)) {
+        return false;
+    }
+    for (auto &sensor : m_sensors) {
+        sensor = defaults;
+    }
+
+    const CConfigNode *pSensors = upRoot->Get("sensors");
+    if (pSensors != nullptr) {
+        if (!pSensors->IsSequence()) {
+            LOG_ERR("Topology: %s:%u: 'sensors' must be a list\n", path.c_str(), pSensors->GetLine());
+            return false;
+        }
+        for (size_t i = 0U; i < pSensors->Size(); i++) {
+            const CConfigNode *pSensor = pSensors->At(i);
+            const CConfigNode *pId = pSensor->IsMap() ? pSensor->Get("id") : nullptr;
+            uint32_t uSensor = 0U;
+            if (pId == nullptr || !pId->AsUint(uSensor) || uSensor >= MAX_NUM_SENSORS) {
+                LOG_ERR("Topology: %s:%u: sensor entry needs an 'id' below %u\n", path.c_str(), pSensor->GetLine(),
+                        MAX_NUM_SENSORS);
+                return false;
+            }
+            if (!ParseSensor(*pSensor, m_sensors[uSensor])) {
+                return false;
+            }
+        }
+    }
+
+    for (uint32_t i = 0U; i < MAX_NUM_SENSORS; i++) {
+        if (!Validate(i, m_sensors[i])) {
+            return false;
+        }
+    }
+    m_bLoaded = true;
+
+    return true;
+}
+
+bool CTopology::ParseSensor(const CConfigNode &node, SensorTopology &topology)
+{
+    if (!node.IsMap()) {
+        LOG_ERR("Topology: %s:%u: expected a map\n", m_path.c_str(), node.GetLine());
+        return false;
+    }
+
+    for (const auto &member : node.GetMembers()) {
+        const std::string &key = member.first;
+        const CConfigNode &value = *member.second;
+
+        if (key == "id") {
+            continue;
+        } else if (key == "packets") {
+            topology.bAutoPackets = (value.AsString() == "auto");
+            if (!topology.bAutoPackets && !value.AsUint(topology.numPackets)) {
+                LOG_ERR("Topology: %s:%u: 'packets' must be a number or auto\n", m_path.c_str(), value.GetLine());
+                return false;
+            }
+        } else if (key == "hold_ms") {
+            if (!value.AsDouble(topology.holdMs) || topology.holdMs < 0.0) {
+                LOG_ERR("Topology: %s:%u: 'hold_ms' must be a positive number\n", m_path.c_str(), value.GetLine());
+                return false;
+            }
+        } else if (key == "calibration_version") {
+            if (!value.AsUint(topology.calibrationVersion)) {
+                LOG_ERR("Topology: %s:%u: 'calibration_version' must be a number\n", m_path.c_str(),
+                        value.GetLine());
+                return false;
+            }
+        } else if (key == "local") {
+            if (!value.IsSequence()) {
+                LOG_ERR("Topology: %s:%u: 'local' must be a list\n", m_path.c_str(), value.GetLine());
+                return false;
+            }
+            topology.vLocalConsumers.clear();
+            for (size_t i = 0U; i < value.Size(); i++) {
+                // "- cuda" or "- { type: cuda, queue: fifo, fps: 10, adaptive: true }"
+                const CConfigNode *pItem = value.At(i);
+                const CConfigNode *pType = pItem->IsMap() ? pItem->Get("type") : pItem;
+                ConsumerConfig consumer;
+                if (pType == nullptr || !ParseConsumerType(pType->AsString(), consumer.type)) {
+                    LOG_ERR("Topology: %s:%u: consumer type must be cuda, enc, cpu or sync\n", m_path.c_str(),
+                            pItem->GetLine());
+                    return false;
+                }
+                if (!ParseQueueType(pItem->IsMap() ? pItem->Get("queue") : nullptr, consumer.queueType)) {
+                    LOG_ERR("Topology: %s:%u: queue must be mailbox or fifo\n", m_path.c_str(), pItem->GetLine());
+                    return false;
+                }
+                if (!ParseDecimation(pItem, consumer.decimation)) {
+                    LOG_ERR("Topology: %s:%u: fps must be a positive number, adaptive true or false\n",
+                            m_path.c_str(), pItem->GetLine());
+                    return false;
+                }
+                if (!ParseDeadline(pItem, consumer.deadlineMs)) {
+                    LOG_ERR("Topology: %s:%u: deadline_ms must be a positive number\n", m_path.c_str(),
+                            pItem->GetLine());
+                    return false;
+                }
+                if (!ParsePyramid(pItem, consumer.pyramidLevels)) {
+                    LOG_ERR("Topology: %s:%u: pyramid must be 0..%u levels\n", m_path.c_str(), pItem->GetLine(),
+                            PYRAMID_MAX_LEVELS);
+                    return false;
+                }
+                if (!ParseInFlight(pItem, consumer.inFlight)) {
+                    LOG_ERR("Topology: %s:%u: inflight must be 1..%u frames\n", m_path.c_str(), pItem->GetLine(),
+                            MAX_INFLIGHT);
+                    return false;
+                }
+                if (consumer.pyramidLevels != 0U && consumer.type != CPU_CONSUMER &&
+                    consumer.type != SYNC_CONSUMER) {
+                    LOG_ERR("Topology: %s:%u: pyramid needs a cpu or sync consumer\n", m_path.c_str(),
+                            pItem->GetLine());
+                    return false;
+                }
+                topology.vLocalConsumers.push_back(consumer);
+            }
+        } else if (key == "ipc") {
+            if (!value.IsSequence()) {
+                LOG_ERR("Topology: %s:%u: 'ipc' must be a list\n", m_path.c_str(), value.GetLine());
+                return false;
+            }
+            topology.vIpcEndpoints.clear();
+            for (size_t i = 0U; i < value.Size(); i++) {
+                // "- 0" or "- { id: 0, queue: fifo, fps: 10 }"
+                const CConfigNode *pItem = value.At(i);
+                const CConfigNode *pId = pItem->IsMap() ? pItem->Get("id") : pItem;
+                IpcEndpointConfig endpoint;
+                if (pId == nullptr || !pId->AsUint(endpoint.id)) {
+                    LOG_ERR("Topology: %s:%u: IPC endpoint needs a numeric id\n", m_path.c_str(), pItem->GetLine());
+                    return false;
+                }
+                if (!ParseQueueType(pItem->IsMap() ? pItem->Get("queue") : nullptr, endpoint.queueType)) {
+                    LOG_ERR("Topology: %s:%u: queue must be mailbox or fifo\n", m_path.c_str(), pItem->GetLine());
+                    return false;
+                }
+                if (!ParseDecimation(pItem, endpoint.decimation)) {
+                    LOG_ERR("Topology: %s:%u: fps must be a positive number, adaptive true or false\n",
+                            m_path.c_str(), pItem->GetLine());
+                    return false;
+                }
+                if (!ParseDeadline(pItem, endpoint.deadlineMs)) {
+                    LOG_ERR("Topology: %s:%u: deadline_ms must be a positive number\n", m_path.c_str(),
+                            pItem->GetLine());
+                    return false;
+                }
+                if (!ParsePyramid(pItem, endpoint.pyramidLevels)) {
+                    LOG_ERR("Topology: %s:%u: pyramid must be 0..%u levels\n", m_path.c_str(), pItem->GetLine(),
+                            PYRAMID_MAX_LEVELS);
+                    return false;
+                }
+                if (!ParseInFlight(pItem, endpoint.inFlight)) {
+                    LOG_ERR("Topology: %s:%u: inflight must be 1..%u frames\n", m_path.c_str(), pItem->GetLine(),
+                            MAX_INFLIGHT);
+                    return false;
+                }
+                topology.vIpcEndpoints.push_back(endpoint);
+            }
+        } else {
+            LOG_ERR("Topology: %s:%u: unknown key '%s'\n", m_path.c_str(), value.GetLine(), key.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CTopology::ParseSync(const CConfigNode &node)
+{
+    if (!node.IsMap()) {
+        LOG_ERR("Topology: %s:%u: 'sync' must be a map\n", m_path.c_str(), node.GetLine());
+        return false;
+    }
+    for (const auto &member : node.GetMembers()) {
+        const std::string &key = member.first;
+        const CConfigNode &value = *member.second;
+        bool bValid = false;
+        if (key == "tolerance_ms") {
+            bValid = value.AsDouble(m_syncConfig.toleranceMs) && m_syncConfig.toleranceMs >= 0.0;
+        } else if (key == "min_sensors") {
+            bValid = value.AsUint(m_syncConfig.minSensors);
+        } else if (key == "max_pending") {
+            bValid = value.AsUint(m_syncConfig.maxPending) && m_syncConfig.maxPending > 0U;
+        } else if (key == "max_wait_ms") {
+            bValid = value.AsDouble(m_syncConfig.maxWaitMs) && m_syncConfig.maxWaitMs > 0.0;
+        } else {
+            LOG_ERR("Topology: %s:%u: unknown key '%s'\n", m_path.c_str(), value.GetLine(), key.c_str());
+            return false;
+        }
+        if (!bValid) {
+            LOG_ERR("Topology: %s:%u: invalid '%s'\n", m_path.c_str(), value.GetLine(), key.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool CTopology::HasSyncConsumer(const SensorTopology &topology) const
+{
+    for (const auto &consumer : topology.vLocalConsumers) {
+        if (consumer.type == SYNC_CONSUMER) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t CTopology::MaxInFlight(const SensorTopology &topology) const
+{
+    uint32_t maxInFlight = 1U;
+    for (const auto &consumer : topology.vLocalConsumers) {
+        maxInFlight = std::max(maxInFlight, consumer.inFlight);
+    }
+    for (const auto &endpoint : topology.vIpcEndpoints) {
+        maxInFlight = std::max(maxInFlight, endpoint.inFlight);
+    }
+    return maxInFlight;
+}
+
+uint32_t CTopology::MinPackets(const SensorTopology &topology) const
+{
+    // A consumer holding inflight frames needs one more for the producer to fill
+    uint32_t minPackets = std::max(MIN_PACKETS, MaxInFlight(topology) + 1U);
+    // The synchronizer keeps up to max_pending packets of the sensor
+    if (HasSyncConsumer(topology)) {
+        minPackets = std::max(minPackets, PACKETS_IN_PRODUCER + m_syncConfig.maxPending + 1U);
+    }
+    return minPackets;
+}
+
+bool CTopology::Validate(uint32_t uSensor, const SensorTopology &topology)
+{
+    if (!topology.bAutoPackets && (topology.numPackets < MinPackets(topology) || topology.numPackets > MAX_PACKETS)) {
+        LOG_ERR("Topology: sensor %u: packets must be %u..%u with inflight %u%s, got %u\n", uSensor,
+                MinPackets(topology), MAX_PACKETS, MaxInFlight(topology),
+                HasSyncConsumer(topology) ? " and a sync consumer" : "", topology.numPackets);
+        return false;
+    }
+    // Not fatal, the consumer just gets that many frames ahead less often
+    if (!topology.bAutoPackets && topology.numPackets < PACKETS_IN_PRODUCER + MaxInFlight(topology) + 1U) {
+        LOG_WARN("Topology: sensor %u: %u packets rarely let the producer keep inflight %u busy\n", uSensor, topology.numPackets,
+                 MaxInFlight(topology));
+    }
+    if (topology.vLocalConsumers.size() > MAX_LOCAL_CONSUMERS) {
+        LOG_ERR("Topology: sensor %u: at most %u local consumers\n", uSensor, MAX_LOCAL_CONSUMERS);
+        return false;
+    }
+    if (topology.vLocalConsumers.empty() && topology.vIpcEndpoints.empty()) {
+        LOG_ERR("Topology: sensor %u: needs at least one consumer\n", uSensor);
+        return false;
+    }
+
+    uint32_t usedIds = 0U;
+    for (const auto &endpoint : topology.vIpcEndpoints) {
+        if (endpoint.id >= MAX_IPC_CONSUMERS) {
+            LOG_ERR("Topology: sensor %u: IPC endpoint id must be below %u, got %u\n", uSensor, MAX_IPC_CONSUMERS,
+                    endpoint.id);
+            return false;
+        }
+        if ((usedIds & (1U << endpoint.id)) != 0U) {
+            LOG_ERR("Topology: sensor %u: IPC endpoint %u listed twice\n", uSensor, endpoint.id);
+            return false;
+        }
+        usedIds |= 1U << endpoint.id;
+    }
+
+    return true;
+}
+
+const SensorTopology &CTopology::GetSensor(uint32_t uSensor) const
+{
+    return m_sensors[(uSensor < MAX_NUM_SENSORS) ? uSensor : 0U];
+}
+
+void CTopology::Report(void)
+{
+    LOG_MSG("Topology: %s\n", m_bLoaded ? m_path.c_str() : "built-in");
+    for (uint32_t i = 0U; i < MAX_NUM_SENSORS; i++) {
+        const SensorTopology &sensor = m_sensors[i];
+        std::string local;
+        for (const auto &consumer : sensor.vLocalConsumers) {
+            local += std::string(local.empty() ? "" : ", ") + CONSUMER_NAMES[consumer.type] + "/" +
+                     QueueTypeName(consumer.queueType) + DecimationName(consumer.decimation) +
+                     DeadlineName(consumer.deadlineMs) + PyramidName(consumer.pyramidLevels) +
+                     InFlightName(consumer.inFlight);
+        }
+        std::string ipc;
+        for (const auto &endpoint : sensor.vIpcEndpoints) {
+            ipc += std::string(ipc.empty() ? "" : ", ") + std::to_string(endpoint.id) + "/" +
+                   QueueTypeName(endpoint.queueType) + DecimationName(endpoint.decimation) +
+                   DeadlineName(endpoint.deadlineMs) + PyramidName(endpoint.pyramidLevels) +
+                   InFlightName(endpoint.inFlight);
+        }
+        LOG_DBG("Topology: sensor %u: %u packets%s, local [%s], ipc [%s]\n", i, sensor.numPackets,
+                sensor.bAutoPackets ? " (auto)" : "", local.c_str(), ipc.c_str());
+    }
+}
+
+bool CTopology::PlanPackets(const std::vector<SensorMode> &vModes)
+{
+    std::vector<uint64_t> vPacketBytes(vModes.size(), 0U);
+    uint64_t totalBytes = 0U;
+
+    for (size_t i = 0U; i < vModes.size(); i++) {
+        const SensorMode &mode = vModes[i];
+        if (mode.id >= MAX_NUM_SENSORS) {
+            LOG_ERR("Topology: sensor id %u out of range\n", mode.id);
+            return false;
+        }
+        SensorTopology &sensor = m_sensors[mode.id];
+        vPacketBytes[i] = (uint64_t)((double)mode.width * (double)mode.height * PACKET_BYTES_PER_PIXEL);
+        if (sensor.bAutoPackets) {
+            // Packets in flight: the producer's share plus every frame that
+            // arrives while a consumer still holds one, plus one spare
+            double fps = (mode.fps > 0.0) ? mode.fps : DEFAULT_FPS;
+            double holdMs = (sensor.holdMs > 0.0) ? sensor.holdMs : DEFAULT_HOLD_FRAMES * 1000.0 / fps;
+            uint32_t held = (uint32_t)std::ceil(fps * holdMs / 1000.0);
+            if (HasSyncConsumer(sensor)) {
+                held = std::max(held, m_syncConfig.maxPending);
+            }
+            held = std::max(held, MaxInFlight(sensor));
+            uint32_t numPackets = PACKETS_IN_PRODUCER + held + 1U;
+            sensor.numPackets = std::min(std::max(numPackets, MIN_PACKETS), MAX_PACKETS);
+        }
+        totalBytes += vPacketBytes[i] * sensor.numPackets;
+    }
+
+    // Over budget: take packets from the auto pool holding the most memory
+    while (m_budgetBytes != 0U && totalBytes > m_budgetBytes) {
+        size_t largest = vModes.size();
+        uint64_t largestBytes = 0U;
+        for (size_t i = 0U; i < vModes.size(); i++) {
+            const SensorTopology &sensor = m_sensors[vModes[i].id];
+            uint64_t poolBytes = vPacketBytes[i] * sensor.numPackets;
+            if (sensor.bAutoPackets && sensor.numPackets > MinPackets(sensor) && poolBytes > largestBytes) {
+                largest = i;
+                largestBytes = poolBytes;
+            }
+        }
+        if (largest == vModes.size()) {
+            LOG_ERR("Topology: packet pools need %.1f MiB, budget is %.1f MiB\n", (double)totalBytes / BYTES_PER_MIB,
+                    (double)m_budgetBytes / BYTES_PER_MIB);
+            return false;
+        }
+        m_sensors[vModes[largest].id].numPackets--;
+        totalBytes -= vPacketBytes[largest];
+    }
+
+    for (size_t i = 0U; i < vModes.size(); i++) {
+        const SensorMode &mode = vModes[i];
+        const SensorTopology &sensor = m_sensors[mode.id];
+        m_plannedBytes[mode.id] = vPacketBytes[i] * sensor.numPackets;
+        LOG_MSG("Topology: sensor %u: %ux%u @ %.1f fps, hold %.1f ms: %u packets (%s), ~%.1f MiB\n", mode.id,
+                mode.width, mode.height, mode.fps, sensor.holdMs, sensor.numPackets,
+                sensor.bAutoPackets ? "auto" : "fixed", (double)m_plannedBytes[mode.id] / BYTES_PER_MIB);
+    }
+    if (m_budgetBytes != 0U) {
+        LOG_MSG("Topology: packet pools ~%.1f MiB of %.1f MiB budget\n", (double)totalBytes / BYTES_PER_MIB,
+                (double)m_budgetBytes / BYTES_PER_MIB);
+    } else {
+        LOG_MSG("Topology: packet pools ~%.1f MiB\n", (double)totalBytes / BYTES_PER_MIB);
+    }
+
+    return true;
+}
+
+void CTopology::AddAllocatedBytes(uint32_t uSensor, uint64_t bytes)
+{
+    if (uSensor < MAX_NUM_SENSORS) {
+        m_allocatedBytes[uSensor].fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+void CTopology::ReportAllocations(void)
+{
+    uint64_t totalBytes = 0U;
+    for (uint32_t i = 0U; i < MAX_NUM_SENSORS; i++) {
+        uint64_t bytes = m_allocatedBytes[i].load(std::memory_order_relaxed);
+        if (bytes == 0U) {
+            continue;
+        }
+        LOG_MSG("Topology: sensor %u: %u packets, %.1f MiB allocated (planned ~%.1f MiB)\n", i,
+                m_sensors[i].numPackets, (double)bytes / BYTES_PER_MIB, (double)m_plannedBytes[i] / BYTES_PER_MIB);
+        totalBytes += bytes;
+    }
+    if (m_budgetBytes != 0U) {
+        LOG_MSG("Topology: %.1f MiB of packet buffers allocated, budget %.1f MiB\n", (double)totalBytes / BYTES_PER_MIB,
+                (double)m_budgetBytes / BYTES_PER_MIB);
+    } else {
+        LOG_MSG("Topology: %.1f MiB of packet buffers allocated\n", (double)totalBytes / BYTES_PER_MIB);
+    }
+}
@@ -0,0 +1,154 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CTOPOLOGY_HPP
+#define CTOPOLOGY_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "CFrameSync.hpp"
+#include "Common.hpp"
+#include "CUtils.hpp"
+
+class CConfigNode;
+
+enum class QueueType : uint32_t
+{
+    MAILBOX = 0, // keeps only the newest packet, the producer never waits
+    FIFO         // keeps every packet in order
+};
+
+typedef struct {
+    double maxFps;   // output rate limit, 0 processes every frame
+    bool bAdaptive;  // lower the limit while the consumer cannot keep up
+} DecimationConfig;
+
+typedef struct {
+    ConsumerType type;
+    QueueType queueType;
+    DecimationConfig decimation;
+    double deadlineMs; // frames older than this at acquire are released unprocessed, 0 never
+    uint32_t pyramidLevels; // downscaled copies handed to a CPU consumer, see CPyramidStage
+    uint32_t inFlight;      // frames processed before the oldest is released, 1 is serial
+} ConsumerConfig;
+
+typedef struct {
+    uint32_t id;         // selects the nvscistream_<n> channel pair, 0..MAX_IPC_CONSUMERS-1
+    QueueType queueType; // queue of the consumer process attached to it
+    DecimationConfig decimation;
+    double deadlineMs;
+    uint32_t pyramidLevels;
+    uint32_t inFlight;
+} IpcEndpointConfig;
+
+typedef struct {
+    uint32_t numPackets;
+    bool bAutoPackets;   // numPackets is chosen by PlanPackets()
+    double holdMs;       // how long consumers keep a packet, 0 when not measured
+    uint32_t calibrationVersion; // written to each frame's meta, 0 leaves it out
+    std::vector<ConsumerConfig> vLocalConsumers;
+    std::vector<IpcEndpointConfig> vIpcEndpoints;
+} SensorTopology;
+
+// Capture mode of a registered sensor, input of the packet planning
+typedef struct {
+    uint32_t id;
+    uint32_t width;
+    uint32_t height;
+    double fps;
+} SensorMode;
+
+// "mailbox" or "fifo", as written in the topology file
+const char *QueueTypeName(QueueType queueType);
+
+/* Per-sensor stream graph: packet count, consumers living in the producer
+ * process and the IPC endpoints served to consumer processes. Read from a
+ * YAML or JSON file:
+ *     default:
+ *       packets: 6
+ *       local:
+ *         - { type: cuda, queue: mailbox }
+ *         - { type: enc, queue: fifo, fps: 15, adaptive: true, deadline_ms: 100, inflight: 2 }
+ *         - { type: cpu, pyramid: 3 }
+ *       ipc: [0, 1]
+ *     sensors:
+ *       - id: 2
+ *         local: []
+ *         ipc: [{ id: 0, queue: fifo }]
+ *         packets: auto
+ *         hold_ms: 70
+ *         calibration_version: 12
+ *     memory_budget_mb: 512
+ *     sync: { tolerance_ms: 5, min_sensors: 2, max_pending: 2, max_wait_ms: 100 }
+ * A sensor entry overrides only the keys it lists. 'packets: auto' sizes the
+ * pool from the sensor's fps and hold_ms, the p99 present-to-release time of
+ * its slowest consumer as printed by the latency report of an earlier run.
+ * Auto pools shrink, largest first, until all pools fit memory_budget_mb.
+ * 'fps' and 'adaptive' set a consumer's decimation, see CDecimator. Frames
+ * whose capture is older than 'deadline_ms' when acquired are not processed.
+ * 'pyramid' gives cpu and sync consumers that many halved copies of each frame.
+ * 'inflight' lets a consumer start up to that many frames before the oldest
+ * is done, releases stay in acquire order. Auto pools keep that many packets
+ * for the consumer.
+ * 'calibration_version' is handed to consumers in every frame's meta, see CFrameMeta.
+ * Local 'sync' consumers of all sensors feed one CFrameSync set up by 'sync'.
+ * Without a file every sensor gets the built-in graph: DEFAULT_PACKETS packets,
+ * a CUDA and an encoder consumer (ENC_DEFAULT_FPS) and IPC endpoints
+ * 0..MAX_IPC_CONSUMERS-1.
+ * Read-only once the channels are created. */
+class CTopology
+{
+public:
+    static CTopology &GetInstance(void);
+
+    // An empty path keeps the built-in graph.
+    bool Load(const std::string &path);
+    void Report(void);
+
+    // Picks the packet count of 'auto' sensors and checks the memory budget.
+    bool PlanPackets(const std::vector<SensorMode> &vModes);
+
+    const SensorTopology &GetSensor(uint32_t uSensor) const;
+    const SyncConfig &GetSyncConfig(void) const
+    {
+        return m_syncConfig;
+    }
+
+    // Packet buffer bytes actually allocated, reported by the pools and producers
+    void AddAllocatedBytes(uint32_t uSensor, uint64_t bytes);
+    void ReportAllocations(void);
+    bool IsLoaded(void) const
+    {
+        return m_bLoaded;
+    }
+
+private:
+    CTopology(void);
+
+    bool ParseSensor(const CConfigNode &node, SensorTopology &topology);
+    bool Validate(uint32_t uSensor, const SensorTopology &topology);
+    bool ParseSync(const CConfigNode &node);
+    bool HasSyncConsumer(const SensorTopology &topology) const;
+    // Deepest 'inflight' of the sensor's local consumers and IPC endpoints
+    uint32_t MaxInFlight(const SensorTopology &topology) const;
+    // Smallest pool the sensor's consumers can run with
+    uint32_t MinPackets(const SensorTopology &topology) const;
+
+    SensorTopology m_sensors[MAX_NUM_SENSORS];
+    bool m_bLoaded = false;
+    std::string m_path;
+    SyncConfig m_syncConfig { 5.0, 1U, 2U, 100.0 };
+    uint64_t m_budgetBytes = 0U; // 0 is unlimited
+    uint64_t m_plannedBytes[MAX_NUM_SENSORS] {};
+    std::atomic<uint64_t> m_allocatedBytes[MAX_NUM_SENSORS] {};
+};
+
+#endif
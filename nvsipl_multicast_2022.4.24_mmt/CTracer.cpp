@@ -0,0 +1,209 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CTracer.hpp"
+#include "CLogger.hpp"
+#include "CThreadPolicy.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+constexpr std::chrono::milliseconds TRACE_POLL_INTERVAL(100);
+
+thread_local CTracer::TraceRing *CTracer::s_pRing = nullptr;
+
+// Set from the SIGUSR1 handler, lock-free atomics are async-signal-safe
+static std::atomic<bool> s_bDumpRequested {false};
+
+static void TraceSigHandler(int signum)
+{
+    s_bDumpRequested.store(true, std::memory_order_relaxed);
+}
+
+CTracer &CTracer::GetInstance(void)
+{
+    static CTracer instance;
+    return instance;
+}
+
+CTracer::~CTracer(void)
+{
+    Disable();
+    for (auto pRing : m_vpRings) {
+        free(pRing);
+    }
+}
+
+bool CTracer::Enable(const std::string &dir, uint32_t windowSec, uint32_t spikeThresholdMs)
+{
+    if (IsEnabled()) {
+        return true;
+    }
+
+    m_dir = dir.empty() ? "." : dir;
+    m_windowNs = (uint64_t)((windowSec > 0U) ? windowSec : TRACE_DEFAULT_WINDOW_S) * 1000000000ULL;
+    m_spikeThresholdNs = (uint64_t)spikeThresholdMs * 1000000ULL;
+
+    struct sigaction action {};
+    action.sa_handler = TraceSigHandler;
+    sigaction(SIGUSR1, &action, nullptr);
+
+    m_bQuit.store(false, std::memory_order_release);
+    m_dumpThread = std::thread(&CTracer::DumpThreadFunc, this);
+    m_bEnabled.store(true, std::memory_order_release);
+    LOG_MSG("Tracer: enabled, window %u s, spike threshold %u ms, 'kill -USR1 %d' dumps to %s\n",
+            (uint32_t)(m_windowNs / 1000000000ULL), spikeThresholdMs, getpid(), m_dir.c_str());
+
+    return true;
+}
+
+void CTracer::Disable(void)
+{
+    m_bEnabled.store(false, std::memory_order_release);
+    if (m_dumpThread.joinable()) {
+        m_bQuit.store(true, std::memory_order_release);
+        m_dumpThread.join();
+    }
+}
+
+CTracer::TraceRing *CTracer::CreateRing(void)
+{
+    void *pMem = nullptr;
+    if (posix_memalign(&pMem, 64U, sizeof(TraceRing)) != 0) {
+        return nullptr;
+    }
+    TraceRing *pRing = static_cast<TraceRing *>(pMem);
+    new (&pRing->head) std::atomic<uint64_t>(0U);
+    pRing->tid = (uint32_t)syscall(SYS_gettid);
+    // Threads are named by CThreadPolicy::Apply() before their first trace point
+    if (pthread_getname_np(pthread_self(), pRing->name, sizeof(pRing->name)) != 0) {
+        snprintf(pRing->name, sizeof(pRing->name), "%u", pRing->tid);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_vpRings.push_back(pRing);
+    s_pRing = pRing;
+    return pRing;
+}
+
+void CTracer::Instant(const char *pName, uint32_t arg)
+{
+    if (IsEnabled()) {
+        Record(TraceEvent{ CTimeBase::NowNs(), 0U, pName, arg, TRACE_INSTANT });
+    }
+}
+
+void CTracer::CheckLatency(uint64_t latencyNs)
+{
+    if (m_spikeThresholdNs == 0U || latencyNs <= m_spikeThresholdNs || !IsEnabled()) {
+        return;
+    }
+    Instant("LatencySpike", (uint32_t)std::min<uint64_t>(latencyNs / 1000U, UINT32_MAX));
+    m_spikeLatencyNs.store(latencyNs, std::memory_order_relaxed);
+    m_bSpikePending.store(true, std::memory_order_release);
+}
+
+void CTracer::DumpThreadFunc(void)
+{
+    CThreadPolicy::GetInstance().Apply(ThreadRole::TRACE, THREAD_ANY_INSTANCE, "TraceDump");
+
+    auto lastSpikeDump = std::chrono::steady_clock::time_point();
+    bool bFirstSpike = true;
+    while (!m_bQuit.load(std::memory_order_acquire)) {
+        std::this_thread::sleep_for(TRACE_POLL_INTERVAL);
+
+        if (s_bDumpRequested.exchange(false, std::memory_order_relaxed)) {
+            Dump("request");
+        }
+        if (m_bSpikePending.exchange(false, std::memory_order_acquire)) {
+            auto now = std::chrono::steady_clock::now();
+            // One spike usually drags the next frames along, keep only the first dump
+            if (bFirstSpike || now - lastSpikeDump >= std::chrono::seconds(TRACE_SPIKE_COOLDOWN_S)) {
+                LOG_WARN("Tracer: frame latency %.3f ms over threshold\n",
+                         m_spikeLatencyNs.load(std::memory_order_relaxed) / 1000000.0);
+                Dump("spike");
+                lastSpikeDump = now;
+                bFirstSpike = false;
+            }
+        }
+    }
+}
+
+bool CTracer::Dump(const char *pReason)
+{
+    const uint64_t nowNs = CTimeBase::NowNs();
+    const uint64_t fromNs = (nowNs > m_windowNs) ? nowNs - m_windowNs : 0U;
+    std::string path = m_dir + "/trace_" + std::to_string(getpid()) + "_" + std::to_string(m_dumpCount++) + "_" +
+                       pReason + ".json";
+    FILE *pFile = fopen(path.c_str(), "w");
+    if (pFile == nullptr) {
+        LOG_ERR("Tracer: cannot open %s: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    std::vector<TraceRing *> vpRings;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        vpRings = m_vpRings;
+    }
+
+    const int pid = getpid();
+    std::unique_ptr<TraceEvent[]> upEvents(new TraceEvent[TRACE_RING_EVENTS]);
+    uint32_t numEvents = 0U;
+    bool bFirst = true;
+    fprintf(pFile, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (auto pRing : vpRings) {
+        fprintf(pFile, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                bFirst ? "" : ",", pid, pRing->tid, pRing->name);
+        bFirst = false;
+
+        // The owner keeps writing while we copy. Anything it may have lapped
+        // during the copy is dropped, the rest is consistent.
+        uint64_t head = pRing->head.load(std::memory_order_acquire);
+        uint64_t first = (head > TRACE_RING_EVENTS) ? head - TRACE_RING_EVENTS : 0U;
+        for (uint64_t i = first; i < head; i++) {
+            upEvents[i - first] = pRing->events[i & (TRACE_RING_EVENTS - 1U)];
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t headAfter = pRing->head.load(std::memory_order_relaxed);
+        uint64_t valid = (headAfter >= TRACE_RING_EVENTS) ? headAfter - TRACE_RING_EVENTS + 1U : 0U;
+
+        for (uint64_t i = std::max(first, valid); i < head; i++) {
+            const TraceEvent &event = upEvents[i - first];
+            if (event.startNs + event.durNs < fromNs) {
+                continue;
+            }
+            if (event.type == TRACE_INSTANT) {
+                fprintf(pFile, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u,"
+                        "\"args\":{\"arg\":%u}}",
+                        event.pName, event.startNs / 1000.0, pid, pRing->tid, event.arg);
+            } else {
+                fprintf(pFile, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u,"
+                        "\"args\":{\"arg\":%u}}",
+                        event.pName, event.startNs / 1000.0, event.durNs / 1000.0, pid, pRing->tid, event.arg);
+            }
+            numEvents++;
+        }
+    }
+    fprintf(pFile, "\n]}\n");
+    bool bOk = (fclose(pFile) == 0);
+
+    LOG_MSG("Tracer: %u events of the last %u s written to %s\n", numEvents,
+            (uint32_t)(m_windowNs / 1000000000ULL), path.c_str());
+    return bOk;
+}
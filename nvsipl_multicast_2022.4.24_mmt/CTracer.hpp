@@ -0,0 +1,150 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CTRACER_HPP
+#define CTRACER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CLatencyStats.hpp"
+
+constexpr uint32_t TRACE_RING_EVENTS = 8192U; // per thread, power of two
+constexpr uint32_t TRACE_DEFAULT_WINDOW_S = 5U;
+constexpr uint32_t TRACE_SPIKE_COOLDOWN_S = 10U;
+constexpr uint32_t TRACE_THREAD_NAME_LEN = 16U;
+
+enum TraceEventType : uint32_t
+{
+    TRACE_COMPLETE = 0, // a span with a duration
+    TRACE_INSTANT
+};
+
+typedef struct {
+    uint64_t startNs;
+    uint64_t durNs;
+    const char *pName; // must be a string literal
+    uint32_t arg;
+    uint32_t type;
+} TraceEvent;
+
+/* Per-thread trace rings, dumped as Chrome trace-event JSON.
+ * Each thread appends to its own ring without locks or atomics beyond one
+ * release store, so a trace point costs a clock read and a 32 byte write. A
+ * disabled tracer costs one relaxed load. A dump thread writes the last window
+ * of every ring on SIGUSR1, or when a frame's capture-to-done latency exceeds
+ * the spike threshold. The files load in chrome://tracing and ui.perfetto.dev. */
+class CTracer
+{
+public:
+    static CTracer &GetInstance(void);
+
+    // spikeThresholdMs 0 disables the latency watchdog.
+    bool Enable(const std::string &dir, uint32_t windowSec, uint32_t spikeThresholdMs);
+    void Disable(void);
+
+    bool IsEnabled(void) const
+    {
+        return m_bEnabled.load(std::memory_order_relaxed);
+    }
+
+    inline void Complete(const char *pName, uint64_t startNs, uint64_t endNs, uint32_t arg);
+    void Instant(const char *pName, uint32_t arg);
+    // Consumers report each frame's capture-to-done latency here.
+    void CheckLatency(uint64_t latencyNs);
+
+private:
+    typedef struct {
+        std::atomic<uint64_t> head;
+        uint32_t tid;
+        char name[TRACE_THREAD_NAME_LEN];
+        TraceEvent events[TRACE_RING_EVENTS];
+    } TraceRing;
+
+    CTracer(void) = default;
+    ~CTracer(void);
+
+    TraceRing *CreateRing(void);
+    inline void Record(const TraceEvent &event);
+    void DumpThreadFunc(void);
+    bool Dump(const char *pReason);
+
+    static thread_local TraceRing *s_pRing;
+
+    std::atomic<bool> m_bEnabled {false};
+    std::string m_dir;
+    uint64_t m_windowNs = 0U;
+    uint64_t m_spikeThresholdNs = 0U;
+
+    std::mutex m_mutex; // guards m_vpRings
+    std::vector<TraceRing *> m_vpRings;
+
+    std::thread m_dumpThread;
+    std::atomic<bool> m_bQuit {false};
+    std::atomic<bool> m_bSpikePending {false};
+    std::atomic<uint64_t> m_spikeLatencyNs {0U};
+    uint32_t m_dumpCount = 0U;
+};
+
+// Records a span from construction to destruction when tracing is enabled.
+class CTraceScope
+{
+public:
+    explicit CTraceScope(const char *pName, uint32_t arg = 0U) :
+        m_pName(pName),
+        m_arg(arg),
+        m_startNs(CTracer::GetInstance().IsEnabled() ? CTimeBase::NowNs() : 0U)
+    {
+    }
+
+    ~CTraceScope(void)
+    {
+        if (m_startNs != 0U) {
+            CTracer::GetInstance().Complete(m_pName, m_startNs, CTimeBase::NowNs(), m_arg);
+        }
+    }
+
+    CTraceScope(const CTraceScope &) = delete;
+    CTraceScope &operator=(const CTraceScope &) = delete;
+
+    // For args that are only known inside the scope, e.g. the packet index
+    void SetArg(uint32_t arg)
+    {
+        m_arg = arg;
+    }
+
+private:
+    const char *m_pName;
+    uint32_t m_arg;
+    uint64_t m_startNs;
+};
+
+inline void CTracer::Record(const TraceEvent &event)
+{
+    TraceRing *pRing = s_pRing;
+    if (pRing == nullptr) {
+        pRing = CreateRing();
+        if (pRing == nullptr) {
+            return;
+        }
+    }
+    uint64_t head = pRing->head.load(std::memory_order_relaxed);
+    pRing->events[head & (TRACE_RING_EVENTS - 1U)] = event;
+    pRing->head.store(head + 1U, std::memory_order_release);
+}
+
+inline void CTracer::Complete(const char *pName, uint64_t startNs, uint64_t endNs, uint32_t arg)
+{
+    Record(TraceEvent{ startNs, endNs - startNs, pName, arg, TRACE_COMPLETE });
+}
+
+#endif
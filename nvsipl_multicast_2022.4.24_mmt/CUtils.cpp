@@ -10,151 +10,9 @@
 
 #include "CUtils.hpp"
 #include <cstring>
-#include <sys/time.h>
 
 using namespace std;
 
-// Log utils
-CLogger& CLogger::GetInstance()
-{
-    static CLogger instance;
-    return instance;
-}
-
-void CLogger::SetLogLevel(LogLevel level)
-{
-    m_level = (level > LEVEL_DBG) ? LEVEL_DBG : level;
-}
-
-CLogger::LogLevel CLogger::GetLogLevel(void)
-{
-    return m_level;
-}
-
-void CLogger::SetLogStyle(LogStyle style)
-{
-    m_style = (style > LOG_STYLE_FUNCTION_LINE) ? LOG_STYLE_FUNCTION_LINE
-                                                : style;
-}
-
-void CLogger::LogLevelMessageVa(LogLevel level, const char *functionName,
-                                       uint32_t lineNumber, const char *prefix, const char *format,
-                                                                    va_list ap)
-{
-    char str[256] = {'\0',};
-
-    if (level > m_level) {
-        return;
-    }
-
-    struct timeval tv;
-    gettimeofday(&tv,nullptr);
-    sprintf(str,"[%ld.%06ld]",tv.tv_sec,tv.tv_usec);
-
-    strcpy(str, "nvsipl_multicast: ");
-    switch (level) {
-        case LEVEL_NONE:
-            break;
-        case LEVEL_ERR:
-            strcat(str, "ERROR: ");
-            break;
-        case LEVEL_WARN:
-            strcat(str, "WARNING: ");
-            break;
-        case LEVEL_INFO:
-            break;
-        case LEVEL_DBG:
-            // Empty
-            break;
-    }
-
-    if (strlen(prefix) != 0) {
-        strcat(str, prefix);
-    }
-
-    vsnprintf(str + strlen(str), sizeof(str) - strlen(str), format, ap);
-
-    if (m_style == LOG_STYLE_NORMAL) {
-        if (strlen(str) != 0 && str[strlen(str) - 1] == '\n') {
-            strcat(str, "\n");
-        }
-    } else if (m_style == LOG_STYLE_FUNCTION_LINE) {
-        if (strlen(str) != 0 && str[strlen(str) - 1] == '\n') {
-            str[strlen(str) - 1] = 0;
-        }
-        snprintf(str + strlen(str), sizeof(str) - strlen(str), " at %s():%d\n",
-                                                     functionName, lineNumber);
-    }
-
-    cout << str;
-}
-
-void CLogger::LogLevelMessage(LogLevel level, const char *functionName,
-                               uint32_t lineNumber, const char *format, ...)
-{
-    va_list ap;
-    va_start(ap, format);
-    LogLevelMessageVa(level, functionName, lineNumber, "", format, ap);
-    va_end(ap);
-}
-
-void CLogger::LogLevelMessage(LogLevel level, std::string functionName,
-                               uint32_t lineNumber, std::string format, ...)
-{
-    va_list ap;
-    va_start(ap, format);
-    LogLevelMessageVa(level, functionName.c_str(), lineNumber, "",
-                                                       format.c_str(), ap);
-    va_end(ap);
-}
-
-void CLogger::PLogLevelMessage(LogLevel level, const char *functionName,
-                               uint32_t lineNumber, std::string prefix, const char *format, ...)
-{
-    va_list ap;
-    va_start(ap, format);
-    
-    LogLevelMessageVa(level, functionName, lineNumber, prefix.c_str(), format, ap);
-    va_end(ap);
-}
-
-void CLogger::PLogLevelMessage(LogLevel level, std::string functionName,
-                               uint32_t lineNumber, std::string prefix, std::string format, ...)
-{
-    va_list ap;
-    va_start(ap, format);
-    LogLevelMessageVa(level, functionName.c_str(), lineNumber, prefix.c_str(),
-                                                       format.c_str(), ap);
-    va_end(ap);
-}
-
-void CLogger::LogMessageVa(const char *format, va_list ap)
-{
-    char str[128] = {'\0',};
-    struct timeval tv;
-    gettimeofday(&tv,nullptr);
-    int n = sprintf(str,"[%ld.%06ld]",tv.tv_sec,tv.tv_usec);
-
-    vsnprintf(str+n, sizeof(str) - n, format, ap);
-    cout << str;
-}
-
-void CLogger::LogMessage(const char *format, ...)
-{
-    va_list ap;
-    va_start(ap, format);
-    LogMessageVa(format, ap);
-    va_end(ap);
-}
-
-void CLogger::LogMessage(std::string format, ...)
-{
-    va_list ap;
-    va_start(ap, format);
-    LogMessageVa(format.c_str(), ap);
-    va_end(ap);
-}
-
 /* Loads NITO file for given camera module.
  The function assumes the .nito files to be named same as camera module name.
  */
@@ -231,6 +89,12 @@ SIPLStatus GetConsumerTypeFromAppType(AppType appType, ConsumerType& consumerTyp
         case IPC_ENC_CONSUMER:
             consumerType = ENC_CONSUMER;
             break;
+        case IPC_CPU_CONSUMER:
+            consumerType = CPU_CONSUMER;
+            break;
+        case IPC_SYNC_CONSUMER:
+            consumerType = SYNC_CONSUMER;
+            break;
         default:
             status = NVSIPL_STATUS_BAD_ARGUMENT;
             break;
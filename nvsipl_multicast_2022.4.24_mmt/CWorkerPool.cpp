@@ -0,0 +1,280 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#include "CWorkerPool.hpp"
+#include "CLatencyStats.hpp"
+#include "CThreadPolicy.hpp"
+#include "CUtils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <pthread.h>
+#include <string>
+
+CWorkerPool &CWorkerPool::GetInstance(void)
+{
+    static CWorkerPool instance;
+    return instance;
+}
+
+CWorkerPool::~CWorkerPool(void)
+{
+    Stop();
+}
+
+void CWorkerPool::Configure(uint32_t numWorkers)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bConfigured = true;
+    m_numWorkers = numWorkers;
+}
+
+void CWorkerPool::CreateWorkers(uint32_t numWorkers)
+{
+    std::vector<cpu_set_t> vClusters = GetCpuClusters();
+    if (vClusters.empty()) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (uint32_t cpu = 0U; cpu < std::max(std::thread::hardware_concurrency(), 1U); cpu++) {
+            CPU_SET(cpu, &cpus);
+        }
+        vClusters.push_back(cpus);
+    }
+    // Cluster of every usable CPU, in cluster order
+    std::vector<uint32_t> vCpuClusters;
+    for (uint32_t c = 0U; c < vClusters.size(); c++) {
+        vCpuClusters.insert(vCpuClusters.end(), (size_t)CPU_COUNT(&vClusters[c]), c);
+    }
+    if (numWorkers == 0U) {
+        numWorkers = (uint32_t)vCpuClusters.size();
+    }
+
+    // Spread over the CPUs, so each cluster gets workers in proportion to its CPUs
+    std::vector<uint32_t> vWorkerClusters(numWorkers);
+    CMetrics &metrics = CMetrics::GetInstance();
+    for (uint32_t i = 0U; i < numWorkers; i++) {
+        vWorkerClusters[i] = vCpuClusters[(size_t)i * vCpuClusters.size() / numWorkers];
+        std::unique_ptr<Worker> upWorker(new Worker());
+        upWorker->cpus = vClusters[vWorkerClusters[i]];
+        MetricLabels labels { { "worker", std::to_string(i) } };
+        upWorker->tasksMetric = metrics.Register("nvsipl_worker_tasks_total", "Tasks run by the pool worker",
+                                                 MetricType::COUNTER, labels);
+        upWorker->busyNsMetric = metrics.Register("nvsipl_worker_busy_ns_total", "Time the pool worker ran tasks",
+                                                  MetricType::COUNTER, labels);
+        m_vWorkers.push_back(std::move(upWorker));
+    }
+    for (uint32_t i = 0U; i < numWorkers; i++) {
+        // Neighbours in the cluster first, then the other clusters, each starting after the worker itself
+        for (bool bSameCluster : { true, false }) {
+            for (uint32_t n = 1U; n < numWorkers; n++) {
+                uint32_t victim = (i + n) % numWorkers;
+                if ((vWorkerClusters[victim] == vWorkerClusters[i]) == bSameCluster) {
+                    m_vWorkers[i]->victims.push_back(victim);
+                }
+            }
+        }
+    }
+    m_stealsMetric = metrics.Register("nvsipl_worker_steals_total", "Tasks run by another worker than their home",
+                                      MetricType::COUNTER, {});
+    m_queuedMetric = metrics.Register("nvsipl_worker_queued", "Tasks waiting in the pool worker queues",
+                                      MetricType::GAUGE, {});
+
+    LOG_MSG("WorkerPool: %u workers on %zu CPU clusters\n", numWorkers, vClusters.size());
+    for (uint32_t c = 0U; c < vClusters.size(); c++) {
+        LOG_INFO("WorkerPool: cluster %u, cpus %s, %ld workers\n", c, CpuListString(vClusters[c]).c_str(),
+                 (long)std::count(vWorkerClusters.begin(), vWorkerClusters.end(), c));
+    }
+}
+
+void CWorkerPool::Start(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_bConfigured || m_bRunning) {
+        return;
+    }
+    if (m_vWorkers.empty()) {
+        CreateWorkers(m_numWorkers);
+    }
+    m_bQuit = false;
+    m_bRunning = true;
+    for (uint32_t i = 0U; i < m_vWorkers.size(); i++) {
+        m_vThreads.emplace_back(&CWorkerPool::WorkerThreadFunc, this, i);
+    }
+}
+
+void CWorkerPool::Stop(void)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_bRunning) {
+            return;
+        }
+        m_bQuit = true;
+    }
+    m_cond.notify_all();
+    for (auto &thread : m_vThreads) {
+        thread.join();
+    }
+    m_vThreads.clear();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_bRunning = false;
+}
+
+bool CWorkerPool::IsRunning(void)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_bRunning && !m_bQuit;
+}
+
+void CWorkerPool::Submit(const void *pOwner, uint32_t home, bool bOrdered, WorkerTask task)
+{
+    bool bQueued = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_bRunning && !m_bQuit) {
+            OwnerState &owner = m_owners[pOwner];
+            owner.numPending++;
+            if (bOrdered && owner.bBusy) {
+                owner.waiting.push_back(std::move(task));
+                return;
+            }
+            owner.bBusy = bOrdered;
+            bQueued = true;
+        }
+    }
+
+    if (bQueued) {
+        Enqueue(pOwner, home, bOrdered, std::move(task));
+    } else {
+        task();
+    }
+}
+
+void CWorkerPool::Drain(const void *pOwner)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_drainCond.wait(lock, [this, pOwner]() { return m_owners.count(pOwner) == 0U; });
+}
+
+void CWorkerPool::Enqueue(const void *pOwner, uint32_t home, bool bOrdered, WorkerTask task)
+{
+    // Counted first, so m_numQueued never falls below the tasks in the queues
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_numQueued++;
+    }
+    m_queuedMetric.Inc();
+    Worker &worker = *m_vWorkers[home % m_vWorkers.size()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back([this, pOwner, home, bOrdered, task]() {
+            task();
+            OnTaskDone(pOwner, home, bOrdered);
+        });
+    }
+    m_cond.notify_one();
+}
+
+bool CWorkerPool::Take(uint32_t index, WorkerTask &task, bool &bStolen)
+{
+    Worker &self = *m_vWorkers[index];
+    bStolen = false;
+    {
+        std::lock_guard<std::mutex> lock(self.mutex);
+        if (!self.tasks.empty()) {
+            task = std::move(self.tasks.front());
+            self.tasks.pop_front();
+        }
+    }
+    // The oldest task of a victim, it has waited the longest
+    for (size_t i = 0U; task == nullptr && i < self.victims.size(); i++) {
+        Worker &victim = *m_vWorkers[self.victims[i]];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            bStolen = true;
+        }
+    }
+    if (task == nullptr) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_numQueued--;
+    }
+    m_queuedMetric.Add(-1);
+    return true;
+}
+
+void CWorkerPool::OnTaskDone(const void *pOwner, uint32_t home, bool bOrdered)
+{
+    WorkerTask next;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_owners.find(pOwner);
+        if (it == m_owners.end()) {
+            return;
+        }
+        OwnerState &owner = it->second;
+        owner.numPending--;
+        if (bOrdered && !owner.waiting.empty()) {
+            next = std::move(owner.waiting.front());
+            owner.waiting.pop_front();
+        } else if (bOrdered) {
+            owner.bBusy = false;
+        }
+        if (owner.numPending == 0U) {
+            m_owners.erase(it);
+            m_drainCond.notify_all();
+        }
+    }
+    // The owner stays busy, its next task takes the slot of the finished one
+    if (next != nullptr) {
+        Enqueue(pOwner, home, bOrdered, std::move(next));
+    }
+}
+
+void CWorkerPool::WorkerThreadFunc(uint32_t index)
+{
+    Worker &worker = *m_vWorkers[index];
+    // The cluster is the default placement, a 'worker' rule of the thread policy replaces it
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &worker.cpus);
+    if (ret != 0) {
+        LOG_WARN("WorkerPool: worker %u stays unpinned: %s\n", index, strerror(ret));
+    }
+    CThreadPolicy::GetInstance().Apply(ThreadRole::WORKER, index, "Worker" + std::to_string(index));
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond.wait(lock, [this]() { return m_bQuit || m_numQueued != 0U; });
+            // Stop() only returns once every queued task ran
+            if (m_numQueued == 0U) {
+                break;
+            }
+        }
+
+        WorkerTask task;
+        bool bStolen = false;
+        if (!Take(index, task, bStolen)) {
+            // Counted but not pushed yet, or taken by another worker that has not uncounted it
+            std::this_thread::yield();
+            continue;
+        }
+        const uint64_t startNs = CTimeBase::NowNs();
+        task();
+        worker.busyNsMetric.Add((int64_t)(CTimeBase::NowNs() - startNs));
+        worker.tasksMetric.Inc();
+        if (bStolen) {
+            m_stealsMetric.Inc();
+        }
+    }
+}
@@ -0,0 +1,95 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+#ifndef CWORKERPOOL_HPP
+#define CWORKERPOOL_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sched.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "CMetrics.hpp"
+
+typedef std::function<void(void)> WorkerTask;
+
+/* Process-wide pool running the consumers' frame processing, so the event
+ * threads only acquire and release packets. Every worker owns a queue; a task
+ * goes to the queue of its home worker and a worker whose queue is empty
+ * steals the oldest task of another, looking in its own CPU cluster first.
+ * Workers are spread over the clusters in proportion to their CPUs and run
+ * on the CPUs of their cluster, unless the thread policy has a 'worker' rule.
+ * Tasks of an ordered owner run one at a time in submission order, those of
+ * other owners in parallel.
+ * Start() does nothing until Configure(). Until Start() and after Stop(),
+ * Submit() runs the task inline. */
+class CWorkerPool
+{
+public:
+    static CWorkerPool &GetInstance(void);
+    ~CWorkerPool(void);
+
+    // 0 starts one worker per CPU the process may run on
+    void Configure(uint32_t numWorkers);
+    void Start(void);
+    // Runs every queued task, then joins the workers.
+    void Stop(void);
+    bool IsRunning(void);
+
+    // home picks the worker queue, e.g. the sensor id, so one sensor's tasks stay close
+    void Submit(const void *pOwner, uint32_t home, bool bOrdered, WorkerTask task);
+    // Returns once none of the owner's tasks is queued or running
+    void Drain(const void *pOwner);
+
+private:
+    typedef struct {
+        std::mutex mutex;
+        std::deque<WorkerTask> tasks;
+        cpu_set_t cpus;                // the worker's cluster
+        std::vector<uint32_t> victims; // steal order, own cluster first
+        CMetric tasksMetric;
+        CMetric busyNsMetric;
+    } Worker;
+
+    typedef struct {
+        uint32_t numPending;            // queued, waiting or running
+        bool bBusy;                     // an ordered owner's task is queued or running
+        std::deque<WorkerTask> waiting; // ordered tasks behind it
+    } OwnerState;
+
+    CWorkerPool(void) = default;
+
+    void CreateWorkers(uint32_t numWorkers);
+    void WorkerThreadFunc(uint32_t index);
+    void Enqueue(const void *pOwner, uint32_t home, bool bOrdered, WorkerTask task);
+    bool Take(uint32_t index, WorkerTask &task, bool &bStolen);
+    void OnTaskDone(const void *pOwner, uint32_t home, bool bOrdered);
+
+    std::mutex m_mutex;                  // owners, m_numQueued and the pool state
+    std::condition_variable m_cond;      // queued tasks and Stop()
+    std::condition_variable m_drainCond; // finished tasks
+    std::unordered_map<const void *, OwnerState> m_owners;
+    std::vector<std::unique_ptr<Worker>> m_vWorkers;
+    std::vector<std::thread> m_vThreads;
+    uint32_t m_numQueued = 0U; // tasks in the worker queues
+    bool m_bConfigured = false;
+    uint32_t m_numWorkers = 0U;
+    bool m_bRunning = false;
+    bool m_bQuit = false;
+
+    CMetric m_stealsMetric;
+    CMetric m_queuedMetric;
+};
+
+#endif
@@ -9,23 +9,27 @@
 #ifndef COMMON_HPP
 #define COMMON_HPP
 #define SUPPORT_MMT
-    constexpr uint32_t NUM_LOCAL_ENC_CONSUMERS = 1U;
-    constexpr uint32_t NUM_LOCAL_CUDA_CONSUMERS = 1U;
-    constexpr uint32_t NUM_LOCAL_CONSUMERS = NUM_LOCAL_CUDA_CONSUMERS + NUM_LOCAL_ENC_CONSUMERS;
-
     constexpr uint32_t MAX_NUM_SENSORS= 16U;
-    constexpr uint32_t MAX_PACKETS = 6U;
+    constexpr uint32_t MAX_PACKETS = 16U; /* Upper bound per sensor, per-packet state is sized to the actual count */
+    constexpr uint32_t DEFAULT_PACKETS = 6U;
+    constexpr uint32_t MIN_PACKETS = 3U; /* Smallest pool, deeper inflight or a sync consumer need more */
     constexpr uint32_t MAX_ELEMENTS = 2U; /* Maximum number of elements supported */
     constexpr uint32_t DATA_ELEMENT_INDEX = 0U;
     constexpr uint32_t META_ELEMENT_INDEX = 1U;
-    constexpr uint32_t NUM_CONSUMERS = 6U;
-    constexpr uint32_t MAX_WAIT_SYNCOBJ = NUM_CONSUMERS + NUM_LOCAL_CONSUMERS;
+    constexpr uint32_t MAX_IPC_CONSUMERS = 6U; /* IPC endpoints per sensor, also spaces the nvscistream_<n> channels */
+    constexpr uint32_t MAX_LOCAL_CONSUMERS = 4U; /* Consumers in the producer process per sensor */
+    constexpr uint32_t PYRAMID_MAX_LEVELS = 3U; /* Downscaled copies per frame: 1/2, 1/4, 1/8 */
+    constexpr uint32_t MAX_INFLIGHT = 4U; /* Frames a consumer processes ahead of its oldest release */
+    constexpr uint32_t MAX_WAIT_SYNCOBJ = MAX_IPC_CONSUMERS + MAX_LOCAL_CONSUMERS;
     constexpr uint32_t MAX_NUM_SYNCS = 8U;
     constexpr uint32_t MAX_QUERY_TIMEOUTS = 10U;
     constexpr int QUERY_TIMEOUT = 1000000; // usecs
     constexpr int QUERY_TIMEOUT_FOREVER = -1;
+    constexpr uint32_t NUM_EVENT_LOOPS = 2U;
     constexpr uint32_t NVMEDIA_IMAGE_STATUS_TIMEOUT_MS = 100U;
     constexpr uint32_t DUMP_START_FRAME = 60U;
     constexpr uint32_t DUMP_END_FRAME = 100U;
+    constexpr uint32_t DUMP_QUEUE_DEPTH = 4U;
     constexpr int64_t FENCE_FRAME_TIMEOUT_US = 100000U;
+    constexpr int64_t FENCE_WAIT_SLICE_US = 1000; /* Longest block on one fence while others are pending */
 #endif
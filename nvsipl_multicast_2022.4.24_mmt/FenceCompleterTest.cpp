@@ -0,0 +1,246 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+// Drives CFenceCompleter with CSoftFence standing in for NvSciSync fences:
+// per-owner callback order, the FENCE_WAIT_SLICE_US slices and their retries,
+// timeouts, and failed completions reaching a client's completion-failed flag.
+// Needs no NVIDIA headers or libraries, so it also builds on a host:
+//   g++ -O2 -std=c++14 -o nvsipl_fence_completer_test FenceCompleterTest.cpp CFenceCompleter.cpp
+//       CFlightRecorder.cpp CThreadPolicy.cpp CMetrics.cpp CLatencyStats.cpp CAsyncLog.cpp CLogger.cpp -lpthread
+
+#include "CFenceCompleter.hpp"
+#include "CLatencyStats.hpp"
+#include "Common.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static uint32_t s_numFailures = 0U;
+
+#define CHECK(cond)                                                   \
+    do {                                                              \
+        if (!(cond)) {                                                \
+            printf("  FAILED line %d: %s\n", __LINE__, #cond);        \
+            s_numFailures++;                                          \
+        }                                                             \
+    } while (0)
+
+constexpr int64_t TEST_TIMEOUT_US = 2000000;
+
+// Callback names in the order they ran
+class CCallbackLog
+{
+public:
+    FenceCallback Entry(const std::string &name)
+    {
+        return [this, name](FenceResult result) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_entries.push_back(name + ":" + FenceResultName(result));
+        };
+    }
+
+    std::vector<std::string> Get(void)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::vector<std::string> m_entries;
+};
+
+// Waits on a CSoftFence and records the timeouts the completer asks for
+class CCountedFence
+{
+public:
+    FenceWaitFunc WaitFunc(void)
+    {
+        return [this](int64_t timeoutUs) {
+            m_numWaits++;
+            if (timeoutUs > m_maxTimeoutUs) {
+                m_maxTimeoutUs = timeoutUs;
+            }
+            return m_fence.Wait(timeoutUs);
+        };
+    }
+
+    CSoftFence m_fence;
+    // Only touched on the completer thread until Drain() returns
+    uint32_t m_numWaits = 0U;
+    int64_t m_maxTimeoutUs = 0;
+};
+
+// Turns a completion into the client's failed flag like CClientCommon::CompleteOnFences()
+class CStubClient
+{
+public:
+    void Complete(FenceWaitFunc wait, FenceCallback callback, int64_t timeoutUs)
+    {
+        CFenceCompleter::GetInstance().Submit(this, wait, [this, callback](FenceResult result) {
+            if (result != FenceResult::SIGNALED) {
+                m_bCompletionFailed.store(true, std::memory_order_relaxed);
+            }
+            callback(result);
+        }, timeoutUs);
+    }
+
+    bool HasCompletionFailed(void) const
+    {
+        return m_bCompletionFailed.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<bool> m_bCompletionFailed {false};
+};
+
+// One owner's callbacks wait for its oldest fence, another owner's do not
+static void TestOwnerOrder(void)
+{
+    printf("owner order\n");
+    CFenceCompleter &completer = CFenceCompleter::GetInstance();
+    CCallbackLog log;
+    CSoftFence a1, a2, b1;
+    const int ownerA = 0;
+    const int ownerB = 1;
+    a2.Signal();
+    b1.Signal();
+    completer.Submit(&ownerA, [&a1](int64_t timeoutUs) { return a1.Wait(timeoutUs); }, log.Entry("a1"),
+                     TEST_TIMEOUT_US);
+    completer.Submit(&ownerA, [&a2](int64_t timeoutUs) { return a2.Wait(timeoutUs); }, log.Entry("a2"),
+                     TEST_TIMEOUT_US);
+    completer.Submit(&ownerB, [&b1](int64_t timeoutUs) { return b1.Wait(timeoutUs); }, log.Entry("b1"),
+                     TEST_TIMEOUT_US);
+
+    completer.Drain(&ownerB);
+    CHECK(log.Get() == std::vector<std::string>({ "b1:signaled" }));
+    CHECK(completer.GetNumPending() == 2U);
+
+    a1.Signal();
+    completer.Drain(&ownerA);
+    CHECK(log.Get() == std::vector<std::string>({ "b1:signaled", "a1:signaled", "a2:signaled" }));
+    CHECK(completer.GetNumPending() == 0U);
+}
+
+// A slow fence is waited on in slices of at most FENCE_WAIT_SLICE_US, retried
+// until it signals well within its timeout
+static void TestWaitSlices(void)
+{
+    printf("wait slices\n");
+    CFenceCompleter &completer = CFenceCompleter::GetInstance();
+    CCallbackLog log;
+    CCountedFence slow;
+    const int owner = 0;
+    completer.Submit(&owner, slow.WaitFunc(), log.Entry("slow"), TEST_TIMEOUT_US);
+
+    std::this_thread::sleep_for(std::chrono::microseconds(FENCE_WAIT_SLICE_US * 10));
+    slow.m_fence.Signal();
+    completer.Drain(&owner);
+    CHECK(log.Get() == std::vector<std::string>({ "slow:signaled" }));
+    CHECK(slow.m_numWaits > 1U);
+    CHECK(slow.m_maxTimeoutUs > 0);
+    CHECK(slow.m_maxTimeoutUs <= FENCE_WAIT_SLICE_US);
+}
+
+// A fence that never signals completes as TIMED_OUT once its timeout passed,
+// and the owner's later callbacks follow it
+static void TestTimeout(void)
+{
+    printf("timeout\n");
+    CFenceCompleter &completer = CFenceCompleter::GetInstance();
+    CCallbackLog log;
+    CCountedFence stuck;
+    CSoftFence next;
+    const int owner = 0;
+    const int64_t timeoutUs = FENCE_WAIT_SLICE_US * 20;
+    next.Signal();
+    const uint64_t startNs = CTimeBase::NowNs();
+    completer.Submit(&owner, stuck.WaitFunc(), log.Entry("stuck"), timeoutUs);
+    completer.Submit(&owner, [&next](int64_t waitUs) { return next.Wait(waitUs); }, log.Entry("next"),
+                     TEST_TIMEOUT_US);
+
+    completer.Drain(&owner);
+    const uint64_t elapsedUs = (CTimeBase::NowNs() - startNs) / 1000U;
+    CHECK(log.Get() == std::vector<std::string>({ "stuck:timeout", "next:signaled" }));
+    CHECK(elapsedUs >= (uint64_t)timeoutUs);
+    CHECK(elapsedUs < (uint64_t)timeoutUs + 500000U);
+    CHECK(stuck.m_numWaits > 1U);
+    CHECK(stuck.m_maxTimeoutUs <= FENCE_WAIT_SLICE_US);
+}
+
+// Failed and timed out completions set the client's flag, signaled ones do not
+static void TestFailurePropagation(void)
+{
+    printf("failure propagation\n");
+    CFenceCompleter &completer = CFenceCompleter::GetInstance();
+    CCallbackLog log;
+
+    CStubClient good;
+    CSoftFence signaled;
+    signaled.Signal();
+    good.Complete([&signaled](int64_t timeoutUs) { return signaled.Wait(timeoutUs); }, log.Entry("good"),
+                  TEST_TIMEOUT_US);
+    completer.Drain(&good);
+    CHECK(!good.HasCompletionFailed());
+
+    CStubClient failing;
+    failing.Complete([](int64_t) { return FenceResult::FAILED; }, log.Entry("failed"), TEST_TIMEOUT_US);
+    failing.Complete([&signaled](int64_t timeoutUs) { return signaled.Wait(timeoutUs); }, log.Entry("after"),
+                     TEST_TIMEOUT_US);
+    completer.Drain(&failing);
+    CHECK(failing.HasCompletionFailed());
+
+    CStubClient late;
+    CSoftFence never;
+    late.Complete([&never](int64_t timeoutUs) { return never.Wait(timeoutUs); }, log.Entry("late"),
+                  FENCE_WAIT_SLICE_US * 3);
+    completer.Drain(&late);
+    CHECK(late.HasCompletionFailed());
+
+    CHECK(log.Get() == std::vector<std::string>({ "good:signaled", "failed:error", "after:signaled", "late:timeout" }));
+}
+
+// Stopped, Submit() waits and calls back on the calling thread
+static void TestInline(void)
+{
+    printf("inline\n");
+    CFenceCompleter &completer = CFenceCompleter::GetInstance();
+    CCallbackLog log;
+    CSoftFence fence;
+    const int owner = 0;
+    fence.Signal();
+    const std::thread::id caller = std::this_thread::get_id();
+    std::thread::id callbackThread;
+    completer.Submit(&owner, [&fence](int64_t timeoutUs) { return fence.Wait(timeoutUs); },
+                     [&](FenceResult result) {
+                         callbackThread = std::this_thread::get_id();
+                         log.Entry("inline")(result);
+                     },
+                     TEST_TIMEOUT_US);
+    CHECK(log.Get() == std::vector<std::string>({ "inline:signaled" }));
+    CHECK(callbackThread == caller);
+}
+
+int main(void)
+{
+    CFenceCompleter &completer = CFenceCompleter::GetInstance();
+    completer.Start();
+    TestOwnerOrder();
+    TestWaitSlices();
+    TestTimeout();
+    TestFailurePropagation();
+    completer.Stop();
+    TestInline();
+    printf("%s, %u failures\n", (s_numFailures == 0U) ? "PASSED" : "FAILED", s_numFailures);
+    return (s_numFailures == 0U) ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+// Prints a flight recorder dump (flight_<pid>_*.bin) as one line per event,
+// oldest first across all threads. Needs no NVIDIA libraries, so it also
+// builds on a host: g++ -std=c++14 -o nvsipl_flight_decode FlightDecode.cpp
+
+#include "CFlightRecorder.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+typedef struct {
+    FlightEvent event;
+    uint32_t ring;
+} DecodedEvent;
+
+typedef struct {
+    uint32_t tid;
+    std::string name;
+} ThreadInfo;
+
+static const char *EventName(uint16_t type)
+{
+    switch (type) {
+        case FLIGHT_FRAME_CAPTURED:
+            return "FRAME_CAPTURED";
+        case FLIGHT_PACKET_GET:
+            return "PACKET_GET";
+        case FLIGHT_PACKET_PRESENT:
+            return "PACKET_PRESENT";
+        case FLIGHT_PACKET_ACQUIRE:
+            return "PACKET_ACQUIRE";
+        case FLIGHT_PACKET_RELEASE:
+            return "PACKET_RELEASE";
+        case FLIGHT_FENCE_WAIT:
+            return "FENCE_WAIT";
+        case FLIGHT_PIPELINE_NOTIF:
+            return "PIPELINE_NOTIF";
+        case FLIGHT_DEVBLK_NOTIF:
+            return "DEVBLK_NOTIF";
+        case FLIGHT_ERROR:
+            return "ERROR";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+static void PrintArg(const FlightEvent &event)
+{
+    switch (event.type) {
+        case FLIGHT_PACKET_GET:
+        case FLIGHT_PACKET_PRESENT:
+        case FLIGHT_PACKET_ACQUIRE:
+        case FLIGHT_PACKET_RELEASE:
+            printf("packet %u", event.arg);
+            break;
+        case FLIGHT_FENCE_WAIT:
+            printf("%s (0x%x)", (event.arg == 0U) ? "ok" : "failed", event.arg);
+            break;
+        case FLIGHT_PIPELINE_NOTIF:
+        case FLIGHT_DEVBLK_NOTIF:
+            printf("notification %u", event.arg);
+            break;
+        case FLIGHT_ERROR:
+            printf("status 0x%x", event.arg);
+            break;
+        default:
+            printf("%u", event.arg);
+            break;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <flight_<pid>_<reason>_<n>.bin>\n", argv[0]);
+        return 1;
+    }
+    FILE *pFile = fopen(argv[1], "rb");
+    if (pFile == nullptr) {
+        fprintf(stderr, "Cannot open %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+
+    FlightFileHeader header;
+    if (fread(&header, sizeof(header), 1U, pFile) != 1U || header.magic != FLIGHT_FILE_MAGIC) {
+        fprintf(stderr, "%s is not a flight recorder dump\n", argv[1]);
+        fclose(pFile);
+        return 1;
+    }
+    if (header.version != FLIGHT_FILE_VERSION || header.ringEvents == 0U ||
+        (header.ringEvents & (header.ringEvents - 1U)) != 0U || header.ticksPerSecond == 0U) {
+        fprintf(stderr, "Unsupported dump version %u\n", header.version);
+        fclose(pFile);
+        return 1;
+    }
+
+    std::vector<ThreadInfo> vThreads;
+    std::vector<DecodedEvent> vEvents;
+    std::vector<FlightEvent> vSlots(header.ringEvents);
+    for (uint32_t r = 0U; r < header.numRings; r++) {
+        FlightRingHeader ringHeader;
+        if (fread(&ringHeader, sizeof(ringHeader), 1U, pFile) != 1U ||
+            fread(vSlots.data(), sizeof(FlightEvent), header.ringEvents, pFile) != header.ringEvents) {
+            fprintf(stderr, "Truncated dump, %u of %u threads read\n", r, header.numRings);
+            break;
+        }
+        ringHeader.name[sizeof(ringHeader.name) - 1U] = '\0';
+        vThreads.push_back(ThreadInfo{ ringHeader.tid, ringHeader.name });
+
+        // The slot at head may have been half written when the dump was taken
+        uint64_t first = (ringHeader.head >= header.ringEvents) ? ringHeader.head - header.ringEvents + 1U : 0U;
+        for (uint64_t i = first; i < ringHeader.head; i++) {
+            const FlightEvent &event = vSlots[i & (header.ringEvents - 1U)];
+            if (event.type != 0U) {
+                vEvents.push_back(DecodedEvent{ event, r });
+            }
+        }
+    }
+    fclose(pFile);
+
+    std::stable_sort(vEvents.begin(), vEvents.end(), [](const DecodedEvent &a, const DecodedEvent &b) {
+        return a.event.ticks < b.event.ticks;
+    });
+
+    if (header.signum != 0) {
+        printf("pid %d, dumped on signal %d (%s)\n", header.pid, header.signum, strsignal(header.signum));
+    } else {
+        printf("pid %d, dumped on pipeline error\n", header.pid);
+    }
+    printf("%zu events from %zu threads, times are relative to the dump\n", vEvents.size(), vThreads.size());
+
+    for (const auto &decoded : vEvents) {
+        const FlightEvent &event = decoded.event;
+        // Events recorded after the dump started have ticks past dumpTicks
+        double relMs = ((double)event.ticks - (double)header.dumpTicks) * 1000.0 / (double)header.ticksPerSecond;
+        double wallSec = (double)header.dumpRealtimeNs / 1e9 + relMs / 1000.0;
+        const ThreadInfo &thread = vThreads[decoded.ring];
+        printf("[%.6f] %+12.3f ms  %-15s %6u  %-15s id %-3u ", wallSec, relMs, thread.name.c_str(), thread.tid,
+               EventName(event.type), event.id);
+        PrintArg(event);
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,457 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+// Drives CFrameSync with simulated sensors that capture into host-memory
+// packets and hold them until the synchronizer releases them: complete groups
+// under jitter, partial groups above min_sensors, dropped groups below it, late
+// frames after max_pending closed their group, the tolerance window, max_wait
+// and Flush. Every packet must be released exactly once and only after its
+// group's callback. Needs no NVIDIA headers or libraries, so it also builds on a host:
+//   g++ -O2 -std=c++14 -o nvsipl_frame_sync_test FrameSyncTest.cpp CFrameSync.cpp CMetrics.cpp
+//       CLatencyStats.cpp CThreadPolicy.cpp CFlightRecorder.cpp CAsyncLog.cpp CLogger.cpp -lpthread
+
+#include "CFrameSync.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static uint32_t s_numFailures = 0U;
+
+#define CHECK(cond)                                                   \
+    do {                                                              \
+        if (!(cond)) {                                                \
+            printf("  FAILED line %d: %s\n", __LINE__, #cond);        \
+            s_numFailures++;                                          \
+        }                                                             \
+    } while (0)
+
+constexpr uint64_t MS = 1000000U;
+constexpr uint64_t FRAME_PERIOD_NS = 33U * MS;
+constexpr uint32_t NUM_PACKETS = 6U;
+constexpr size_t FRAME_SIZE = 4096U;
+
+// Stand-in for a sensor and its sync consumer: captures into a free host
+// packet, pushes it and keeps it until the synchronizer releases it
+class CSimSensor
+{
+public:
+    CSimSensor(CFrameSync &sync, uint32_t uSensor) :
+        m_sync(sync),
+        m_uSensor(uSensor),
+        m_packets(NUM_PACKETS, std::vector<uint8_t>(FRAME_SIZE)),
+        m_bHeld(NUM_PACKETS, false)
+    {
+        m_sync.AddSensor(m_uSensor, [this](uint32_t packetIndex) { Release(packetIndex); });
+    }
+
+    // False when every packet is still held by the synchronizer
+    bool Capture(uint64_t captureNs)
+    {
+        uint32_t packetIndex = 0U;
+        while (packetIndex < NUM_PACKETS && m_bHeld[packetIndex]) {
+            packetIndex++;
+        }
+        if (packetIndex == NUM_PACKETS) {
+            return false;
+        }
+        m_bHeld[packetIndex] = true;
+        memset(m_packets[packetIndex].data(), (int)(m_numCaptured & 0xFFU), FRAME_SIZE);
+        m_numCaptured++;
+        m_sync.Push(SyncFrame{ m_uSensor, packetIndex, captureNs, m_packets[packetIndex].data() });
+        return true;
+    }
+
+    bool IsHeld(uint32_t packetIndex) const
+    {
+        return packetIndex < NUM_PACKETS && m_bHeld[packetIndex];
+    }
+
+    const void *GetPacket(uint32_t packetIndex) const
+    {
+        return m_packets[packetIndex].data();
+    }
+
+    uint32_t GetNumHeld(void) const
+    {
+        uint32_t numHeld = 0U;
+        for (bool bHeld : m_bHeld) {
+            numHeld += bHeld ? 1U : 0U;
+        }
+        return numHeld;
+    }
+
+    uint32_t GetNumReleased(void) const
+    {
+        return m_numReleased;
+    }
+
+    uint32_t GetNumBadReleases(void) const
+    {
+        return m_numBadReleases;
+    }
+
+private:
+    void Release(uint32_t packetIndex)
+    {
+        if (!IsHeld(packetIndex)) {
+            m_numBadReleases++;
+            return;
+        }
+        m_bHeld[packetIndex] = false;
+        m_numReleased++;
+    }
+
+    CFrameSync &m_sync;
+    uint32_t m_uSensor;
+    std::vector<std::vector<uint8_t>> m_packets;
+    std::vector<bool> m_bHeld;
+    uint32_t m_numCaptured = 0U;
+    uint32_t m_numReleased = 0U;
+    uint32_t m_numBadReleases = 0U;
+};
+
+typedef struct {
+    uint64_t captureNs;
+    uint32_t sensorMask;
+    bool bComplete;
+    uint32_t numFrames;
+    uint64_t skewNs;
+} DeliveredGroup;
+
+// A synchronizer with numSensors simulated sensors that records what it delivers
+class CSyncHarness
+{
+public:
+    CSyncHarness(uint32_t numSensors, const SyncConfig &config)
+    {
+        m_sync.Configure(config);
+        for (uint32_t i = 0U; i < numSensors; i++) {
+            m_sensors.emplace_back(new CSimSensor(m_sync, i));
+        }
+        m_sync.SetGroupCallback([this](const SyncGroup &group) { OnGroup(group); });
+    }
+
+    bool Capture(uint32_t uSensor, uint64_t captureNs)
+    {
+        return m_sensors[uSensor]->Capture(captureNs);
+    }
+
+    // Nothing held, nothing released twice, every frame released once
+    void CheckAllReleased(uint32_t numCaptured)
+    {
+        uint32_t numReleased = 0U;
+        for (const auto &upSensor : m_sensors) {
+            CHECK(upSensor->GetNumHeld() == 0U);
+            CHECK(upSensor->GetNumBadReleases() == 0U);
+            numReleased += upSensor->GetNumReleased();
+        }
+        CHECK(numReleased == numCaptured);
+    }
+
+    CFrameSync m_sync;
+    std::vector<std::unique_ptr<CSimSensor>> m_sensors;
+    std::vector<DeliveredGroup> m_groups;
+    bool m_bFramesValid = true;
+
+private:
+    void OnGroup(const SyncGroup &group)
+    {
+        DeliveredGroup delivered { group.captureNs, group.sensorMask, group.bComplete, group.numFrames, 0U };
+        uint64_t minNs = UINT64_MAX;
+        uint64_t maxNs = 0U;
+        uint32_t mask = 0U;
+        for (uint32_t i = 0U; i < group.numFrames; i++) {
+            const SyncFrame &frame = group.pFrames[i];
+            // Ordered by sensor, still held by it and pointing to its packet
+            m_bFramesValid = m_bFramesValid && (i == 0U || frame.uSensorId > group.pFrames[i - 1U].uSensorId) &&
+                             frame.uSensorId < m_sensors.size() &&
+                             m_sensors[frame.uSensorId]->IsHeld(frame.packetIndex) &&
+                             frame.pFrame == m_sensors[frame.uSensorId]->GetPacket(frame.packetIndex);
+            mask |= 1U << frame.uSensorId;
+            minNs = (frame.captureNs < minNs) ? frame.captureNs : minNs;
+            maxNs = (frame.captureNs > maxNs) ? frame.captureNs : maxNs;
+        }
+        m_bFramesValid = m_bFramesValid && (mask == group.sensorMask) && (group.numFrames != 0U);
+        delivered.skewNs = maxNs - minNs;
+        m_groups.push_back(delivered);
+    }
+};
+
+// Capture time of a frame with up to +-jitterNs of noise
+static uint64_t Jittered(uint64_t baseNs, uint64_t jitterNs)
+{
+    return baseNs + (uint64_t)(rand() % (int)(2U * jitterNs + 1U)) - jitterNs;
+}
+
+// Three sensors with 1 ms jitter against a 5 ms tolerance, pushed in varying order
+static void TestComplete(void)
+{
+    printf("complete groups\n");
+    constexpr uint32_t numSensors = 3U;
+    constexpr uint32_t numFrames = 200U;
+    CSyncHarness harness(numSensors, SyncConfig { 5.0, 1U, 2U, 1000.0 });
+
+    for (uint32_t frame = 0U; frame < numFrames; frame++) {
+        const uint64_t baseNs = 1000U * MS + frame * FRAME_PERIOD_NS;
+        const uint32_t first = frame % numSensors;
+        for (uint32_t i = 0U; i < numSensors; i++) {
+            CHECK(harness.Capture((first + i) % numSensors, Jittered(baseNs, 1U * MS)));
+        }
+    }
+    CHECK(harness.m_groups.size() == numFrames);
+    CHECK(harness.m_bFramesValid);
+    uint64_t prevNs = 0U;
+    bool bAllComplete = true;
+    for (const auto &group : harness.m_groups) {
+        bAllComplete = bAllComplete && group.bComplete && group.numFrames == numSensors &&
+                       group.sensorMask == 0x7U && group.skewNs <= 2U * MS && group.captureNs > prevNs;
+        prevNs = group.captureNs;
+    }
+    CHECK(bAllComplete);
+
+    const CFrameSync::SyncCounts counts = harness.m_sync.GetCounts();
+    CHECK(counts.complete == numFrames);
+    CHECK(counts.partial == 0U && counts.dropped == 0U && counts.late == 0U);
+    harness.CheckAllReleased(numSensors * numFrames);
+}
+
+// Sensor 2 misses every fourth frame, the groups without it are partial
+static void TestPartial(void)
+{
+    printf("partial groups\n");
+    constexpr uint32_t numFrames = 100U;
+    CSyncHarness harness(3U, SyncConfig { 5.0, 2U, 2U, 1000.0 });
+
+    uint32_t numCaptured = 0U;
+    for (uint32_t frame = 0U; frame < numFrames; frame++) {
+        const uint64_t baseNs = 1000U * MS + frame * FRAME_PERIOD_NS;
+        for (uint32_t uSensor = 0U; uSensor < 3U; uSensor++) {
+            if (uSensor == 2U && (frame % 4U) == 1U) {
+                continue;
+            }
+            CHECK(harness.Capture(uSensor, Jittered(baseNs, 1U * MS)));
+            numCaptured++;
+        }
+    }
+    CHECK(harness.m_groups.size() == numFrames);
+    CHECK(harness.m_bFramesValid);
+    uint32_t numPartial = 0U;
+    for (uint32_t i = 0U; i < harness.m_groups.size(); i++) {
+        const DeliveredGroup &group = harness.m_groups[i];
+        if ((i % 4U) == 1U) {
+            CHECK(!group.bComplete && group.sensorMask == 0x3U && group.numFrames == 2U);
+            numPartial++;
+        } else {
+            CHECK(group.bComplete);
+        }
+    }
+    const CFrameSync::SyncCounts counts = harness.m_sync.GetCounts();
+    CHECK(counts.partial == numPartial);
+    CHECK(counts.complete == numFrames - numPartial);
+    CHECK(counts.dropped == 0U && counts.late == 0U);
+    harness.CheckAllReleased(numCaptured);
+}
+
+// Groups below min_sensors are released without a callback
+static void TestDropped(void)
+{
+    printf("dropped groups\n");
+    constexpr uint32_t numFrames = 60U;
+    CSyncHarness harness(3U, SyncConfig { 5.0, 2U, 2U, 1000.0 });
+
+    uint32_t numCaptured = 0U;
+    uint32_t numExpectedDropped = 0U;
+    for (uint32_t frame = 0U; frame < numFrames; frame++) {
+        const uint64_t baseNs = 1000U * MS + frame * FRAME_PERIOD_NS;
+        // Sensors 1 and 2 both miss every third frame, sensor 0 is left alone
+        const bool bAlone = (frame % 3U) == 2U;
+        numExpectedDropped += bAlone ? 1U : 0U;
+        for (uint32_t uSensor = 0U; uSensor < 3U; uSensor++) {
+            if (bAlone && uSensor != 0U) {
+                continue;
+            }
+            CHECK(harness.Capture(uSensor, Jittered(baseNs, 1U * MS)));
+            numCaptured++;
+        }
+    }
+    // The last frame is one of sensor 0's lone ones, nothing moves past it
+    harness.m_sync.Flush();
+    CHECK(harness.m_bFramesValid);
+    CHECK(harness.m_groups.size() == numFrames - numExpectedDropped);
+    bool bAllComplete = true;
+    for (const auto &group : harness.m_groups) {
+        bAllComplete = bAllComplete && group.bComplete;
+    }
+    CHECK(bAllComplete);
+    const CFrameSync::SyncCounts counts = harness.m_sync.GetCounts();
+    CHECK(counts.dropped == numExpectedDropped);
+    CHECK(counts.complete == numFrames - numExpectedDropped);
+    CHECK(counts.partial == 0U && counts.late == 0U);
+    harness.CheckAllReleased(numCaptured);
+}
+
+// Sensor 1 stalls for three frames, max_pending closes its groups and its
+// delayed frames are released as late as soon as they are pushed
+static void TestLate(void)
+{
+    printf("late frames\n");
+    CSyncHarness harness(2U, SyncConfig { 5.0, 1U, 2U, 1000.0 });
+    const uint64_t baseNs = 1000U * MS;
+
+    for (uint32_t frame = 0U; frame < 3U; frame++) {
+        CHECK(harness.Capture(0U, baseNs + frame * FRAME_PERIOD_NS));
+    }
+    // Three pending groups, one more than max_pending, the oldest went out partial
+    CHECK(harness.m_groups.size() == 1U);
+    CHECK(harness.m_sensors[0]->GetNumHeld() == 2U);
+
+    CHECK(harness.Capture(1U, baseNs + 1U * MS));
+    CHECK(harness.m_sensors[1]->GetNumHeld() == 0U);
+    CHECK(harness.m_sensors[1]->GetNumReleased() == 1U);
+    CHECK(harness.m_sync.GetCounts().late == 1U);
+
+    // Catches up with the still pending second group
+    CHECK(harness.Capture(1U, baseNs + FRAME_PERIOD_NS - 1U * MS));
+    CHECK(harness.m_groups.size() == 2U);
+    CHECK(harness.m_groups[1].bComplete);
+
+    CHECK(harness.Capture(1U, baseNs + 2U * FRAME_PERIOD_NS + 1U * MS));
+    CHECK(harness.m_groups.size() == 3U);
+    CHECK(harness.m_groups[2].bComplete);
+    CHECK(harness.m_bFramesValid);
+
+    const CFrameSync::SyncCounts counts = harness.m_sync.GetCounts();
+    CHECK(counts.partial == 1U && counts.complete == 2U && counts.late == 1U && counts.dropped == 0U);
+    harness.CheckAllReleased(6U);
+}
+
+// Two sensors at a fixed capture offset, matched up to the tolerance and not beyond
+static void RunSkew(uint64_t offsetNs, bool bExpectMatched)
+{
+    constexpr uint32_t numFrames = 30U;
+    CSyncHarness harness(2U, SyncConfig { 5.0, 2U, 2U, 1000.0 });
+    for (uint32_t frame = 0U; frame < numFrames; frame++) {
+        const uint64_t baseNs = 1000U * MS + frame * FRAME_PERIOD_NS;
+        CHECK(harness.Capture(0U, baseNs));
+        CHECK(harness.Capture(1U, baseNs + offsetNs));
+    }
+    harness.m_sync.Flush();
+    CHECK(harness.m_bFramesValid);
+
+    const CFrameSync::SyncCounts counts = harness.m_sync.GetCounts();
+    if (bExpectMatched) {
+        CHECK(counts.complete == numFrames && counts.dropped == 0U);
+        bool bSkewOk = true;
+        for (const auto &group : harness.m_groups) {
+            bSkewOk = bSkewOk && group.skewNs == offsetNs;
+        }
+        CHECK(bSkewOk);
+    } else {
+        // Every frame stays alone, below min_sensors
+        CHECK(counts.complete == 0U && counts.dropped == 2U * numFrames);
+        CHECK(harness.m_groups.empty());
+    }
+    CHECK(counts.partial == 0U && counts.late == 0U);
+    harness.CheckAllReleased(2U * numFrames);
+}
+
+static void TestSkewWindow(void)
+{
+    printf("skew window\n");
+    RunSkew(0U, true);
+    RunSkew(4U * MS, true);
+    RunSkew(5U * MS, true);
+    RunSkew(5U * MS + 1U, false);
+    RunSkew(12U * MS, false);
+
+    // A frame between two pending groups joins the closer one
+    CSyncHarness harness(3U, SyncConfig { 5.0, 1U, 4U, 1000.0 });
+    const uint64_t baseNs = 1000U * MS;
+    CHECK(harness.Capture(0U, baseNs));
+    CHECK(harness.Capture(1U, baseNs + 8U * MS));
+    CHECK(harness.Capture(2U, baseNs + 5U * MS));
+    harness.m_sync.Flush();
+    CHECK(harness.m_groups.size() == 2U);
+    if (harness.m_groups.size() == 2U) {
+        CHECK(harness.m_groups[0].sensorMask == 0x1U);
+        CHECK(harness.m_groups[1].sensorMask == 0x6U);
+        CHECK(harness.m_groups[1].skewNs == 3U * MS);
+    }
+    harness.CheckAllReleased(3U);
+}
+
+// A silent sensor holds the group until max_wait_ms, checked on the next push
+static void TestMaxWait(void)
+{
+    printf("max wait\n");
+    CSyncHarness harness(2U, SyncConfig { 5.0, 1U, 8U, 20.0 });
+    const uint64_t baseNs = 1000U * MS;
+
+    CHECK(harness.Capture(0U, baseNs));
+    CHECK(harness.Capture(0U, baseNs + FRAME_PERIOD_NS));
+    CHECK(harness.m_groups.empty());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    CHECK(harness.Capture(0U, baseNs + 2U * FRAME_PERIOD_NS));
+    // Every group waited too long except the one just opened
+    CHECK(harness.m_groups.size() == 2U);
+    CHECK(harness.m_sensors[0]->GetNumHeld() == 1U);
+    CHECK(harness.m_sync.GetCounts().partial == 2U);
+
+    CHECK(harness.Capture(1U, baseNs + 2U * FRAME_PERIOD_NS));
+    CHECK(harness.m_groups.size() == 3U);
+    CHECK(harness.m_groups.back().bComplete);
+    CHECK(harness.m_bFramesValid);
+    harness.CheckAllReleased(4U);
+}
+
+// Flush closes what is pending, a removed sensor no longer blocks completion
+static void TestFlushAndRemove(void)
+{
+    printf("flush and remove\n");
+    CSyncHarness harness(3U, SyncConfig { 5.0, 1U, 4U, 1000.0 });
+    const uint64_t baseNs = 1000U * MS;
+
+    CHECK(harness.Capture(0U, baseNs));
+    CHECK(harness.Capture(1U, baseNs));
+    CHECK(harness.m_groups.empty());
+    harness.m_sync.Flush();
+    CHECK(harness.m_groups.size() == 1U);
+    CHECK(harness.m_sync.GetCounts().partial == 1U);
+    harness.CheckAllReleased(2U);
+
+    harness.m_sync.RemoveSensor(2U);
+    CHECK(harness.Capture(0U, baseNs + FRAME_PERIOD_NS));
+    CHECK(harness.Capture(1U, baseNs + FRAME_PERIOD_NS));
+    CHECK(harness.m_groups.size() == 2U);
+    CHECK(harness.m_groups.back().bComplete);
+    // Frames of a removed sensor are ignored
+    CHECK(harness.Capture(2U, baseNs + 2U * FRAME_PERIOD_NS));
+    CHECK(harness.m_sensors[2]->GetNumReleased() == 0U);
+    CHECK(harness.m_groups.size() == 2U);
+    CHECK(harness.m_bFramesValid);
+}
+
+int main(void)
+{
+    srand(1U);
+    TestComplete();
+    TestPartial();
+    TestDropped();
+    TestLate();
+    TestSkewWindow();
+    TestMaxWait();
+    TestFlushAndRemove();
+    printf("%s, %u failures\n", (s_numFailures == 0U) ? "PASSED" : "FAILED", s_numFailures);
+    return (s_numFailures == 0U) ? 0 : 1;
+}
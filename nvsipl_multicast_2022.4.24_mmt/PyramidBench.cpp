@@ -0,0 +1,158 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+// Per-level throughput of the pyramid stage's 2x2 box filters on synthetic
+// NV12 frames, SIMD against the scalar reference, and the block-linear first
+// level. Every SIMD result is compared with the reference. Needs no NVIDIA
+// libraries, so it also builds on a host:
+//   g++ -O2 -std=c++14 -o nvsipl_pyramid_bench PyramidBench.cpp CBoxFilter.cpp
+//       CBlockLinearKernels.cpp CBlockLinear.cpp -lpthread
+
+#include "CBlockLinear.hpp"
+#include "CBlockLinearKernels.hpp"
+#include "CBoxFilter.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+constexpr uint32_t BENCH_LEVELS = 3U;
+constexpr double BENCH_MIN_SECONDS = 0.2;
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+} Resolution;
+
+static const Resolution RESOLUTIONS[] = { { 3840U, 2160U }, { 1920U, 1208U } };
+
+typedef struct {
+    uint32_t width; // in pixels
+    uint32_t height;
+    uint32_t channels;
+    uint32_t pitch;
+    std::vector<uint8_t> data;
+} Plane;
+
+static Plane MakePlane(uint32_t width, uint32_t height, uint32_t channels)
+{
+    Plane plane { width, height, channels, (width * channels + 63U) / 64U * 64U, {} };
+    plane.data.resize((size_t)plane.pitch * height);
+    return plane;
+}
+
+// Seconds per call, repeated until BENCH_MIN_SECONDS have passed
+static double TimeCall(const std::function<void(void)> &func)
+{
+    func(); // warm up caches and page in the destination
+    uint32_t calls = 0U;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    do {
+        func();
+        calls++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    } while (elapsed < BENCH_MIN_SECONDS);
+    return elapsed / calls;
+}
+
+static bool SameRows(const Plane &a, const Plane &b)
+{
+    for (uint32_t y = 0U; y < a.height; y++) {
+        if (memcmp(&a.data[(size_t)y * a.pitch], &b.data[(size_t)y * b.pitch], a.width * a.channels) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void PrintRow(const char *name, uint32_t level, const Plane &src, const Plane &dst, double seconds,
+                     double refSeconds, bool bMatch)
+{
+    const double srcBytes = (double)src.width * src.height * src.channels;
+    printf("  %-9s 1/%-3u %5ux%-5u %8.3f ms %8.1f Mpix/s %7.2f GB/s", name, 1U << level, dst.width, dst.height,
+           seconds * 1000.0, dst.width * (double)dst.height / seconds / 1e6, srcBytes / seconds / 1e9);
+    if (refSeconds > 0.0) {
+        printf("  x%.1f vs scalar%s", refSeconds / seconds, bMatch ? "" : "  MISMATCH");
+    }
+    printf("\n");
+}
+
+static bool RunResolution(const Resolution &res)
+{
+    printf("NV12 %ux%u\n", res.width, res.height);
+    bool bAllMatch = true;
+
+    // Level 0 is the frame, planes[1] is the interleaved UV plane
+    std::vector<Plane> levels[2];
+    levels[0].push_back(MakePlane(res.width, res.height, 1U));
+    levels[1].push_back(MakePlane(res.width / 2U, res.height / 2U, 2U));
+    srand(1U);
+    for (uint32_t p = 0U; p < 2U; p++) {
+        for (auto &byte : levels[p][0].data) {
+            byte = (uint8_t)rand();
+        }
+    }
+
+    const char *PLANE_NAMES[2] = { "luma", "chroma" };
+    for (uint32_t l = 1U; l <= BENCH_LEVELS; l++) {
+        for (uint32_t p = 0U; p < 2U; p++) {
+            const Plane &src = levels[p][l - 1U];
+            Plane dst = MakePlane(src.width / 2U, src.height / 2U, src.channels);
+            Plane ref = MakePlane(src.width / 2U, src.height / 2U, src.channels);
+            double refSeconds = TimeCall([&]() {
+                CBoxFilter::HalveScalar(src.data.data(), src.pitch, ref.width, ref.height, ref.channels,
+                                        ref.data.data(), ref.pitch);
+            });
+            double seconds = TimeCall([&]() {
+                (void)CBoxFilter::Halve(src.data.data(), src.pitch, dst.width, dst.height, dst.channels,
+                                        dst.data.data(), dst.pitch);
+            });
+            bool bMatch = SameRows(dst, ref);
+            bAllMatch = bAllMatch && bMatch;
+            PrintRow(PLANE_NAMES[p], l, src, dst, seconds, refSeconds, bMatch);
+
+            if (l == 1U) {
+                // The same first level read from a block-linear surface
+                BlockLinearPlane blPlane;
+                blPlane.widthBytes = src.width * src.channels;
+                blPlane.height = src.height;
+                blPlane.pitch = src.pitch;
+                blPlane.alignedHeight = (src.height + 127U) / 128U * 128U;
+                blPlane.blockHeightLog2 = CBlockLinear::DefaultBlockHeightLog2(blPlane.height, blPlane.alignedHeight);
+                std::vector<uint8_t> surface(CBlockLinear::PlaneSize(blPlane));
+                CBlockLinear::PlToBlRows(blPlane, src.data.data(), src.pitch, surface.data(), 0U, src.height);
+
+                Plane blDst = MakePlane(dst.width, dst.height, dst.channels);
+                double blSeconds = TimeCall([&]() {
+                    (void)CBlockLinearKernels::Downscale(blPlane, surface.data(), 2U, blDst.data.data(),
+                                                         blDst.pitch, blDst.channels);
+                });
+                bool bBlMatch = SameRows(blDst, ref);
+                bAllMatch = bAllMatch && bBlMatch;
+                std::string name = std::string(PLANE_NAMES[p]) + "/BL";
+                PrintRow(name.c_str(), l, src, blDst, blSeconds, refSeconds, bBlMatch);
+            }
+            levels[p].push_back(std::move(dst));
+        }
+    }
+    return bAllMatch;
+}
+
+int main(void)
+{
+    bool bAllMatch = true;
+    for (const auto &res : RESOLUTIONS) {
+        bAllMatch = RunResolution(res) && bAllMatch;
+    }
+    return bAllMatch ? 0 : 1;
+}
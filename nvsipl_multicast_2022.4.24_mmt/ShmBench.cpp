@@ -0,0 +1,290 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+// Producer and consumer processes streaming synthetic NV12 frames over
+// CShmTransport, to run the multi-process mode and measure its per-frame
+// overhead off-target. Needs no NVIDIA libraries, so it also builds on a host:
+//   g++ -O2 -std=c++14 -o nvsipl_shm_bench ShmBench.cpp CShmTransport.cpp CLatencyStats.cpp -lpthread
+// Run it without -p or -c to fork the producer and the consumers in one go.
+
+#include "CLatencyStats.hpp"
+#include "CShmTransport.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <getopt.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+constexpr int BENCH_CONNECT_TIMEOUT_MS = 10000;
+constexpr int BENCH_FRAME_TIMEOUT_MS = 2000;
+constexpr uint64_t NS_PER_SECOND = 1000000000U;
+
+typedef enum {
+    ROLE_ALL = 0, // fork the producer and the consumers
+    ROLE_PRODUCER,
+    ROLE_CONSUMER
+} BenchRole;
+
+typedef struct {
+    BenchRole role;
+    std::string channel;
+    std::string consumerType; // cpu reads every byte, null releases at once
+    bool bMailbox;
+    bool bWriteFrames;        // the producer rewrites every byte of each frame
+    uint32_t numConsumers;
+    uint32_t numPackets;
+    uint32_t width;
+    uint32_t height;
+    double fps;               // 0 streams as fast as the consumers release
+    double seconds;
+} BenchOptions;
+
+static void PrintUsage(const char *pName)
+{
+    printf("Usage: %s [-p | -c cpu|null] [options]\n", pName);
+    printf("  without -p or -c      fork a producer and -n consumers of the -F type\n");
+    printf("  -p                    producer process, waits for -n consumers\n");
+    printf("  -c cpu|null           consumer process, cpu reads each frame, null only releases it\n");
+    printf("  -F cpu|null           type of the forked consumers, default cpu\n");
+    printf("  -n <consumers>        default 1, at most %u\n", SHM_MAX_CONSUMERS);
+    printf("  -k <packets>          default %u, at most %u\n", DEFAULT_PACKETS, MAX_PACKETS);
+    printf("  -s <width>x<height>   NV12 frame size, default 1920x1208\n");
+    printf("  -r <fps>              default 30, 0 streams as fast as the packets come back\n");
+    printf("  -t <seconds>          default 5\n");
+    printf("  -q mailbox|fifo       consumer queue, default fifo\n");
+    printf("  -w                    producer writes every byte of each frame\n");
+    printf("  -C <channel>          default nvsipl_shm_0\n");
+}
+
+static std::string Us(const LatencySummary &summary)
+{
+    char text[96];
+    snprintf(text, sizeof(text), "%.1f / %.1f / %.1f / %.1f", summary.p50Ns / 1000.0, summary.p99Ns / 1000.0,
+             summary.p999Ns / 1000.0, summary.maxNs / 1000.0);
+    return text;
+}
+
+static int RunProducer(const BenchOptions &opts)
+{
+    const size_t frameBytes = (size_t)opts.width * opts.height * 3U / 2U;
+    CShmProducer producer;
+    if (!producer.Init(opts.channel, opts.numPackets, frameBytes) ||
+        !producer.Connect(opts.numConsumers, BENCH_CONNECT_TIMEOUT_MS)) {
+        fprintf(stderr, "Producer: %s\n", producer.GetError().c_str());
+        return 1;
+    }
+    printf("Producer\t%u consumers, %u packets of %zu bytes on %s\n", producer.GetNumConsumers(), opts.numPackets,
+           frameBytes, opts.channel.c_str());
+
+    CLatencyHistogram waitHist;    // GetPacket(), time until a consumer released one
+    CLatencyHistogram presentHist; // Present() call
+    const uint64_t periodNs = (opts.fps > 0.0) ? (uint64_t)(NS_PER_SECOND / opts.fps) : 0U;
+    const uint64_t startNs = CTimeBase::NowNs();
+    const uint64_t endNs = startNs + (uint64_t)(opts.seconds * NS_PER_SECOND);
+    uint64_t nextFrameNs = startNs;
+    uint64_t nextReportNs = startNs + NS_PER_SECOND;
+    uint64_t frames = 0U;
+    uint64_t reportedFrames = 0U;
+
+    while (CTimeBase::NowNs() < endNs) {
+        uint64_t cookie = 0U;
+        uint64_t t0 = CTimeBase::NowNs();
+        if (!producer.GetPacket(cookie, BENCH_FRAME_TIMEOUT_MS)) {
+            fprintf(stderr, "Producer: %s\n", producer.GetError().c_str());
+            return 1;
+        }
+        uint64_t t1 = CTimeBase::NowNs();
+        waitHist.Record(t1 - t0);
+
+        uint8_t *pBuffer = producer.GetBuffer(cookie);
+        if (opts.bWriteFrames) {
+            memset(pBuffer, (int)(frames & 0xFFU), frameBytes);
+        }
+        // The consumers check the frame number against the ring entry
+        memcpy(pBuffer, &frames, sizeof(frames));
+
+        ShmFrame frame { 0U, frames, t1, 0U };
+        uint64_t t2 = CTimeBase::NowNs();
+        if (!producer.Present(cookie, frame)) {
+            fprintf(stderr, "Producer: %s\n", producer.GetError().c_str());
+            return 1;
+        }
+        presentHist.Record(CTimeBase::NowNs() - t2);
+        frames++;
+
+        uint64_t nowNs = CTimeBase::NowNs();
+        if (nowNs >= nextReportNs) {
+            printf("Producer\t%.1f fps, %u consumers, (us) p50/p99/p99.9/max packet wait %s, present %s\n",
+                   (frames - reportedFrames) * 1e9 / (nowNs - nextReportNs + NS_PER_SECOND),
+                   producer.GetNumConsumers(), Us(waitHist.ReadInterval()).c_str(),
+                   Us(presentHist.ReadInterval()).c_str());
+            reportedFrames = frames;
+            nextReportNs = nowNs + NS_PER_SECOND;
+        }
+        if (periodNs != 0U) {
+            nextFrameNs += periodNs;
+            if (nextFrameNs > nowNs) {
+                std::this_thread::sleep_for(std::chrono::nanoseconds(nextFrameNs - nowNs));
+            }
+        }
+    }
+    printf("Producer\t%llu frames in %.1f s\n", (unsigned long long)frames, opts.seconds);
+    return 0;
+}
+
+static int RunConsumer(const BenchOptions &opts)
+{
+    CShmConsumer consumer;
+    if (!consumer.Connect(opts.channel, BENCH_CONNECT_TIMEOUT_MS)) {
+        fprintf(stderr, "Consumer: %s\n", consumer.GetError().c_str());
+        return 1;
+    }
+    consumer.SetMailbox(opts.bMailbox);
+    const std::string name = "Consumer" + std::to_string(getpid());
+    const bool bRead = (opts.consumerType == "cpu");
+
+    CLatencyHistogram deliveryHist; // Present() to Acquire() returning, the IPC latency
+    CLatencyHistogram releaseHist;  // Release() call
+    uint64_t frames = 0U;
+    uint64_t reportedFrames = 0U;
+    uint64_t mismatches = 0U;
+    uint64_t checksum = 0U;
+    uint64_t nextReportNs = CTimeBase::NowNs() + NS_PER_SECOND;
+
+    ShmFrame frame;
+    while (consumer.Acquire(frame, BENCH_FRAME_TIMEOUT_MS)) {
+        deliveryHist.Record(CTimeBase::NowNs() - frame.presentNs);
+        const uint8_t *pBuffer = consumer.GetBuffer(frame.cookie);
+        uint64_t frameCount = 0U;
+        memcpy(&frameCount, pBuffer, sizeof(frameCount));
+        mismatches += (frameCount != frame.frameCount) ? 1U : 0U;
+        if (bRead) {
+            const size_t words = consumer.GetPacketBytes() / sizeof(uint64_t);
+            const uint64_t *pWords = reinterpret_cast<const uint64_t *>(pBuffer);
+            for (size_t i = 0U; i < words; i++) {
+                checksum += pWords[i];
+            }
+        }
+        uint64_t t0 = CTimeBase::NowNs();
+        if (!consumer.Release(frame.cookie)) {
+            break;
+        }
+        releaseHist.Record(CTimeBase::NowNs() - t0);
+        frames++;
+
+        uint64_t nowNs = CTimeBase::NowNs();
+        if (nowNs >= nextReportNs) {
+            printf("%s\t%.1f fps, %llu dropped, (us) p50/p99/p99.9/max present to acquire %s, release %s\n",
+                   name.c_str(), (frames - reportedFrames) * 1e9 / (nowNs - nextReportNs + NS_PER_SECOND),
+                   (unsigned long long)consumer.GetDroppedFrames(), Us(deliveryHist.ReadInterval()).c_str(),
+                   Us(releaseHist.ReadInterval()).c_str());
+            reportedFrames = frames;
+            nextReportNs = nowNs + NS_PER_SECOND;
+        }
+    }
+    printf("%s\t%llu frames, %llu dropped, %llu corrupt (checksum %llx), %s\n", name.c_str(),
+           (unsigned long long)frames, (unsigned long long)consumer.GetDroppedFrames(),
+           (unsigned long long)mismatches, (unsigned long long)checksum, consumer.GetError().c_str());
+    // The producer hanging up ends the stream
+    return (consumer.GetError() == "producer disconnected" && mismatches == 0U) ? 0 : 1;
+}
+
+static bool ParseOptions(int argc, char *argv[], BenchOptions &opts)
+{
+    opts = BenchOptions{ ROLE_ALL, "nvsipl_shm_0", "cpu", false, false, 1U, DEFAULT_PACKETS, 1920U, 1208U, 30.0, 5.0 };
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "pc:F:n:k:s:r:t:q:wC:h")) != -1) {
+        switch (opt) {
+            case 'p':
+                opts.role = ROLE_PRODUCER;
+                break;
+            case 'c':
+                opts.role = ROLE_CONSUMER;
+                opts.consumerType = optarg;
+                break;
+            case 'F':
+                opts.consumerType = optarg;
+                break;
+            case 'n':
+                opts.numConsumers = (uint32_t)atoi(optarg);
+                break;
+            case 'k':
+                opts.numPackets = (uint32_t)atoi(optarg);
+                break;
+            case 's':
+                if (sscanf(optarg, "%ux%u", &opts.width, &opts.height) != 2) {
+                    return false;
+                }
+                break;
+            case 'r':
+                opts.fps = atof(optarg);
+                break;
+            case 't':
+                opts.seconds = atof(optarg);
+                break;
+            case 'q':
+                opts.bMailbox = (std::string(optarg) == "mailbox");
+                break;
+            case 'w':
+                opts.bWriteFrames = true;
+                break;
+            case 'C':
+                opts.channel = optarg;
+                break;
+            default:
+                return false;
+        }
+    }
+    return (opts.consumerType == "cpu" || opts.consumerType == "null") && opts.numConsumers >= 1U &&
+           opts.numConsumers <= SHM_MAX_CONSUMERS && opts.width >= 2U && opts.height >= 2U && opts.fps >= 0.0;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchOptions opts;
+    if (!ParseOptions(argc, argv, opts)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    if (opts.role == ROLE_PRODUCER) {
+        return RunProducer(opts);
+    }
+    if (opts.role == ROLE_CONSUMER) {
+        return RunConsumer(opts);
+    }
+
+    // The consumers retry until the producer listens
+    fflush(stdout);
+    for (uint32_t i = 0U; i < opts.numConsumers; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            int ret = RunConsumer(opts);
+            fflush(stdout);
+            _exit(ret);
+        }
+        if (pid < 0) {
+            perror("fork");
+            return 1;
+        }
+    }
+    int ret = RunProducer(opts);
+    fflush(stdout);
+    for (uint32_t i = 0U; i < opts.numConsumers; i++) {
+        int status = 0;
+        if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ret = 1;
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,219 @@
+// Copyright (c) 2022 NVIDIA Corporation. All rights reserved.
+//
+// NVIDIA Corporation and its licensors retain all intellectual property and
+// proprietary rights in and to this software, related documentation and any
+// modifications thereto. Any use, reproduction, disclosure or distribution
+// of this software and related documentation without an express license
+// agreement from NVIDIA Corporation is strictly prohibited.
+
+// Drives CStagingPool on the host backend: slots grow on a larger Reserve and
+// are reused otherwise, steady-state streaming makes no allocation, Resize
+// keeps the existing slots, buffers are STAGING_ALIGNMENT aligned and a failed
+// allocation leaves the slot as it was. Needs no NVIDIA libraries, so it also
+// builds on a host:
+//   g++ -O2 -std=c++14 -o nvsipl_staging_pool_test StagingPoolTest.cpp CStagingPool.cpp
+
+#include "CStagingPool.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+static uint32_t s_numFailures = 0U;
+
+#define CHECK(cond)                                                   \
+    do {                                                              \
+        if (!(cond)) {                                                \
+            printf("  FAILED line %d: %s\n", __LINE__, #cond);        \
+            s_numFailures++;                                          \
+        }                                                             \
+    } while (0)
+
+// Host backend that counts its calls and can be told to fail
+class CCountingAllocator : public CHostStagingAllocator
+{
+public:
+    CCountingAllocator(uint32_t &numLive, bool &bFail) :
+        m_numLive(numLive),
+        m_bFail(bFail)
+    {
+    }
+
+    virtual void *Alloc(size_t size) override
+    {
+        if (m_bFail) {
+            return nullptr;
+        }
+        void *ptr = CHostStagingAllocator::Alloc(size);
+        if (ptr != nullptr) {
+            m_numLive++;
+        }
+        return ptr;
+    }
+
+    virtual void Free(void *ptr) override
+    {
+        m_numLive--;
+        CHostStagingAllocator::Free(ptr);
+    }
+
+private:
+    uint32_t &m_numLive;
+    bool &m_bFail;
+};
+
+static bool IsAligned(const void *ptr)
+{
+    return (reinterpret_cast<uintptr_t>(ptr) % STAGING_ALIGNMENT) == 0U;
+}
+
+// A slot only reallocates when a larger size is reserved, the old buffer is freed
+static void TestGrowAndReuse(void)
+{
+    printf("grow and reuse\n");
+    uint32_t numLive = 0U;
+    bool bFail = false;
+    {
+        CStagingPool pool(std::unique_ptr<CStagingAllocator>(new CCountingAllocator(numLive, bFail)), 2U);
+        CHECK(pool.GetType() == StagingMemType::HOST);
+        CHECK(pool.GetBuffer(0U) == nullptr);
+        CHECK(pool.GetCapacity(0U) == 0U);
+
+        CHECK(pool.Reserve(0U, 1000U));
+        uint8_t *pFirst = pool.GetBuffer(0U);
+        CHECK(pFirst != nullptr);
+        CHECK(pool.GetCapacity(0U) == 1000U);
+        CHECK(pool.GetAllocCount() == 1U);
+
+        CHECK(pool.Reserve(0U, 1000U));
+        CHECK(pool.Reserve(0U, 10U));
+        CHECK(pool.GetBuffer(0U) == pFirst);
+        CHECK(pool.GetCapacity(0U) == 1000U);
+        CHECK(pool.GetAllocCount() == 1U);
+
+        CHECK(pool.Reserve(0U, 4096U));
+        CHECK(pool.GetCapacity(0U) == 4096U);
+        CHECK(pool.GetAllocCount() == 2U);
+        CHECK(numLive == 1U);
+        CHECK(pool.GetBuffer(1U) == nullptr);
+
+        CHECK(!pool.Reserve(0U, 0U));
+        CHECK(!pool.Reserve(2U, 16U));
+        CHECK(pool.GetAllocCount() == 2U);
+    }
+    CHECK(numLive == 0U);
+}
+
+// Every packet reserves its frame size per frame, only the first round allocates
+static void TestSteadyState(void)
+{
+    printf("steady state\n");
+    constexpr uint32_t numSlots = 6U;
+    constexpr size_t frameSize = 1920U * 1208U * 3U / 2U;
+    uint32_t numLive = 0U;
+    bool bFail = false;
+    CStagingPool pool(std::unique_ptr<CStagingAllocator>(new CCountingAllocator(numLive, bFail)), numSlots);
+
+    uint8_t *pBufs[numSlots];
+    for (uint32_t slot = 0U; slot < numSlots; slot++) {
+        CHECK(pool.Reserve(slot, frameSize));
+        pBufs[slot] = pool.GetBuffer(slot);
+    }
+    const uint64_t allocCount = pool.GetAllocCount();
+    CHECK(allocCount == numSlots);
+
+    bool bSameBuffers = true;
+    for (uint32_t frame = 0U; frame < 1000U; frame++) {
+        const uint32_t slot = frame % numSlots;
+        CHECK(pool.Reserve(slot, frameSize - (frame % 3U)));
+        bSameBuffers = bSameBuffers && (pool.GetBuffer(slot) == pBufs[slot]);
+    }
+    CHECK(bSameBuffers);
+    CHECK(pool.GetAllocCount() == allocCount);
+    CHECK(numLive == numSlots);
+}
+
+// Resize adds empty slots, keeps the existing buffers and their bytes, never shrinks
+static void TestResize(void)
+{
+    printf("resize\n");
+    uint32_t numLive = 0U;
+    bool bFail = false;
+    CStagingPool pool(std::unique_ptr<CStagingAllocator>(new CCountingAllocator(numLive, bFail)), 2U);
+    CHECK(pool.Reserve(0U, 256U));
+    CHECK(pool.Reserve(1U, 512U));
+    uint8_t *pSlot0 = pool.GetBuffer(0U);
+    uint8_t *pSlot1 = pool.GetBuffer(1U);
+    memset(pSlot0, 0x11, 256U);
+    memset(pSlot1, 0x22, 512U);
+
+    pool.Resize(5U);
+    CHECK(pool.GetBuffer(0U) == pSlot0);
+    CHECK(pool.GetBuffer(1U) == pSlot1);
+    CHECK(pool.GetCapacity(0U) == 256U);
+    CHECK(pool.GetCapacity(1U) == 512U);
+    CHECK(pSlot0[255] == 0x11 && pSlot1[511] == 0x22);
+    for (uint32_t slot = 2U; slot < 5U; slot++) {
+        CHECK(pool.GetBuffer(slot) == nullptr);
+        CHECK(pool.GetCapacity(slot) == 0U);
+    }
+    CHECK(pool.GetBuffer(5U) == nullptr);
+    CHECK(pool.GetCapacity(5U) == 0U);
+
+    CHECK(pool.Reserve(4U, 128U));
+    CHECK(pool.GetCapacity(4U) == 128U);
+
+    pool.Resize(1U);
+    CHECK(pool.GetBuffer(4U) != nullptr);
+    CHECK(pool.GetCapacity(4U) == 128U);
+    CHECK(pool.GetAllocCount() == 3U);
+    CHECK(numLive == 3U);
+}
+
+// Every buffer starts on a STAGING_ALIGNMENT boundary, whatever its size
+static void TestAlignment(void)
+{
+    printf("alignment\n");
+    static const size_t sizes[] = { 1U, 3U, 63U, 64U, 65U, 1000U, 4097U, 1U << 20U };
+    constexpr uint32_t numSizes = sizeof(sizes) / sizeof(sizes[0]);
+    CStagingPool pool(std::unique_ptr<CStagingAllocator>(new CHostStagingAllocator()), numSizes);
+    for (uint32_t slot = 0U; slot < numSizes; slot++) {
+        CHECK(pool.Reserve(slot, sizes[slot]));
+        CHECK(IsAligned(pool.GetBuffer(slot)));
+    }
+    CHECK(pool.Reserve(0U, 100000U));
+    CHECK(IsAligned(pool.GetBuffer(0U)));
+}
+
+// A failed allocation leaves the slot with its old buffer
+static void TestAllocFailure(void)
+{
+    printf("allocation failure\n");
+    uint32_t numLive = 0U;
+    bool bFail = false;
+    CStagingPool pool(std::unique_ptr<CStagingAllocator>(new CCountingAllocator(numLive, bFail)), 1U);
+    CHECK(pool.Reserve(0U, 64U));
+    uint8_t *pBuf = pool.GetBuffer(0U);
+
+    bFail = true;
+    CHECK(!pool.Reserve(0U, 128U));
+    CHECK(pool.GetBuffer(0U) == pBuf);
+    CHECK(pool.GetCapacity(0U) == 64U);
+    CHECK(pool.GetAllocCount() == 1U);
+    CHECK(pool.Reserve(0U, 32U));
+
+    bFail = false;
+    CHECK(pool.Reserve(0U, 128U));
+    CHECK(pool.GetCapacity(0U) == 128U);
+    CHECK(numLive == 1U);
+}
+
+int main(void)
+{
+    TestGrowAndReuse();
+    TestSteadyState();
+    TestResize();
+    TestAlignment();
+    TestAllocFailure();
+    printf("%s, %u failures\n", (s_numFailures == 0U) ? "PASSED" : "FAILED", s_numFailures);
+    return (s_numFailures == 0U) ? 0 : 1;
+}
@@ -10,6 +10,7 @@
 
 /* STL Headers */
 #include <unistd.h>
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <csignal>
@@ -33,6 +34,13 @@
 #include "CMaster.hpp"
 #include "CProfiler.hpp"
 #include "CCmdLineParser.hpp"
+#include "CThreadPolicy.hpp"
+#include "CMetrics.hpp"
+#include "CTracer.hpp"
+#include "CFlightRecorder.hpp"
+#include "CTopology.hpp"
+#include "CFrameSync.hpp"
+#include "CWorkerPool.hpp"
 #include "platform/sf3324.hpp"
 #include "platform/ar0820.hpp"
 
@@ -253,6 +261,8 @@ private:
     //! Notifier function
     void OnEvent(NotificationData &oNotificationData)
     {
+        CFlightRecorder::GetInstance().Record(FLIGHT_DEVBLK_NOTIF, m_uDevBlkIndex,
+                                              (uint32_t)oNotificationData.eNotifType);
         switch (oNotificationData.eNotifType) {
         case NOTIF_ERROR_DESERIALIZER_FAILURE:
             LOG_ERR("DeviceBlock: %u, NOTIF_ERROR_DESERIALIZER_FAILURE\n", m_uDevBlkIndex);
@@ -307,7 +317,7 @@ private:
             return;
         }
 
-        pthread_setname_np(pthread_self(), "DevBlkEvent");
+        CThreadPolicy::GetInstance().Apply(ThreadRole::DEVBLK_EVENT, pThis->m_uDevBlkIndex, "DevBlkEvent");
 
         while (!pThis->m_bQuit) {
             status = pThis->m_pNotificationQueue->Get(notificationData, EVENT_QUEUE_TIMEOUT_US);
@@ -351,6 +361,8 @@ public:
         }
         m_uSensor = uSensor;
         m_pNotificationQueue = notificationQueue;
+        m_frameDrops = CMetrics::GetInstance().Register("nvsipl_capture_drops_total", "Frames dropped by the capture pipeline",
+                                                        MetricType::COUNTER, { { "sensor", std::to_string(uSensor) } });
         m_upThread.reset(new std::thread(EventQueueThreadFunc, this));
         return NVSIPL_STATUS_OK;
     }
@@ -395,6 +407,8 @@ private:
     //! Notifier function
     void OnEvent(NotificationData &oNotificationData)
     {
+        CFlightRecorder::GetInstance().Record(FLIGHT_PIPELINE_NOTIF, oNotificationData.uIndex,
+                                              (uint32_t)oNotificationData.eNotifType);
         switch (oNotificationData.eNotifType) {
         case NOTIF_INFO_ICP_PROCESSING_DONE:
             LOG_INFO("Pipeline: %u, NOTIF_INFO_ICP_PROCESSING_DONE\n", oNotificationData.uIndex);
@@ -411,6 +425,7 @@ private:
         case NOTIF_WARN_ICP_FRAME_DROP:
             LOG_WARN("Pipeline: %u, NOTIF_WARN_ICP_FRAME_DROP\n", oNotificationData.uIndex);
             m_uNumFrameDrops++;
+            m_frameDrops.Inc();
             break;
         case NOTIF_WARN_ICP_FRAME_DISCONTINUITY:
             LOG_WARN("Pipeline: %u, NOTIF_WARN_ICP_FRAME_DISCONTINUITY\n", oNotificationData.uIndex);
@@ -468,7 +483,7 @@ private:
             return;
         }
 
-        pthread_setname_np(pthread_self(), "PipelineEvent");
+        CThreadPolicy::GetInstance().Apply(ThreadRole::PIPELINE_EVENT, pThis->m_uSensor, "PipelineEvent");
 
         while (!pThis->m_bQuit) {
             status = pThis->m_pNotificationQueue->Get(notificationData, EVENT_QUEUE_TIMEOUT_US);
@@ -487,6 +502,7 @@ private:
     }
 
     uint32_t m_uNumFrameDrops = 0U;
+    CMetric m_frameDrops;
     bool m_bInError = false;
     std::unique_ptr<std::thread> m_upThread = nullptr;
     INvSIPLNotificationQueue *m_pNotificationQueue = nullptr;
@@ -520,13 +536,16 @@ public:
     {
         SIPLStatus status = NVSIPL_STATUS_OK;
         INvSIPLClient::INvSIPLBuffer *pBuffer = nullptr;
+        uint32_t uFrameNum = 0U;
 
-        pthread_setname_np(pthread_self(), "FrameQueue");
+        CThreadPolicy::GetInstance().Apply(ThreadRole::FRAME_QUEUE, pThis->m_uSensor, "FrameQueue");
 
         while (!pThis->m_bQuit) {
             status = pThis->m_pFrameCompletionQueue->Get(pBuffer, IMAGE_QUEUE_TIMEOUT_US);
             LOG_DBG("FrameCompletionQueueThreadFunc, status: %u\n", status);
             if (status == NVSIPL_STATUS_OK) {
+                CTraceScope trace("FrameQueue", pThis->m_uSensor);
+                CFlightRecorder::GetInstance().Record(FLIGHT_FRAME_CAPTURED, pThis->m_uSensor, uFrameNum++);
                 status = pThis->m_pMaster->OnFrameAvailable(pThis->m_uSensor, pBuffer);
                 if (status != NVSIPL_STATUS_OK) {
                     LOG_ERR("OnFrameAvailable failed. (status:%u)\n", status);
@@ -574,6 +593,10 @@ static AppType GetAppType(CCmdLineParser &cmdline)
        return IPC_SIPL_PRODUCER;
    } else if (cmdline.bIsConsumer && cmdline.sConsumerType == "cuda") {
        return IPC_CUDA_CONSUMER;
+   } else if (cmdline.bIsConsumer && cmdline.sConsumerType == "cpu") {
+       return IPC_CPU_CONSUMER;
+   } else if (cmdline.bIsConsumer && cmdline.sConsumerType == "sync") {
+       return IPC_SYNC_CONSUMER;
    } else {
        return IPC_ENC_CONSUMER;
    }
@@ -615,8 +638,60 @@ int main(int argc, char *argv[])
 #endif // !NV_IS_SAFETY
     CLogger::GetInstance().SetLogLevel((CLogger::LogLevel) cmdline.verbosity);
 
+    // Before any pipeline thread exists, so every thread starts under the policy
+    CThreadPolicy &threadPolicy = CThreadPolicy::GetInstance();
+    if (!cmdline.sThreadPolicyFile.empty() && !threadPolicy.Load(cmdline.sThreadPolicyFile)) {
+        return -1;
+    }
+    if (!threadPolicy.LockMemory()) {
+        return -1;
+    }
+    threadPolicy.Report();
+    // Under the thread policy, so the log writer thread gets its rule too
+    CLogger::GetInstance().StartAsync();
+    // Before the consumers are created
+    CConsumer::SetDumpDir(cmdline.sDumpDir);
+    // Workers start with the stream
+    if (cmdline.bWorkerPool) {
+        CWorkerPool::GetInstance().Configure(cmdline.uNumWorkers);
+    }
+
+    CMetrics &metrics = CMetrics::GetInstance();
+    if (!cmdline.sMetricsSocket.empty() && !metrics.StartExporter(cmdline.sMetricsSocket)) {
+        return -1;
+    }
+    if (!cmdline.sMetricsJsonFile.empty() && !metrics.OpenJsonLog(cmdline.sMetricsJsonFile)) {
+        return -1;
+    }
+    if (!cmdline.sTraceDir.empty() &&
+        !CTracer::GetInstance().Enable(cmdline.sTraceDir, cmdline.uTraceWindowSec, cmdline.uTraceSpikeMs)) {
+        return -1;
+    }
+
+    // Before any channel is created, the channels build their blocks from it
+    CTopology &topology = CTopology::GetInstance();
+    if (!topology.Load(cmdline.sTopologyFile)) {
+        return -1;
+    }
+    topology.Report();
+    CFrameSync::GetInstance().Configure(topology.GetSyncConfig());
+    // Applications hook their multi-sensor processing here, the sample traces the groups
+    CFrameSync::GetInstance().SetGroupCallback([](const SyncGroup &group) {
+        uint64_t minNs = group.pFrames[0].captureNs;
+        uint64_t maxNs = minNs;
+        for (uint32_t i = 1U; i < group.numFrames; i++) {
+            minNs = std::min(minNs, group.pFrames[i].captureNs);
+            maxNs = std::max(maxNs, group.pFrames[i].captureNs);
+        }
+        LOG_DBG("Sync group, %s, sensors 0x%x, skew %.3f ms\n", group.bComplete ? "complete" : "partial",
+                group.sensorMask, (maxNs - minNs) / 1000000.0);
+    });
+
     LOG_MSG("Setting up signal handler\n");
     SigSetup();
+    if (!CFlightRecorder::GetInstance().InstallCrashHandlers(cmdline.sFlightDir)) {
+        return -1;
+    }
 
     PlatformCfg pPlatformCfg;
 
@@ -655,7 +730,7 @@ int main(int argc, char *argv[])
     CHK_PTR_AND_RETURN(upMaster, "Master creation");
 
     LOG_MSG("Setting up master appType %u\n",appType);
-    auto status = upMaster->Setup(cmdline.bMultiProcess);
+    auto status = upMaster->Setup(cmdline.bMultiProcess, cmdline.uNumEventLoops);
     CHK_STATUS_AND_RETURN(status, "Master setup");
 
     std::vector<CameraModuleInfo> vCameraModules;
@@ -723,6 +798,19 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (producerResident) {
+        // Packet counts must be known before the pools are created in RegisterSource
+        std::vector<SensorMode> vModes;
+        for (const auto& module : vCameraModules) {
+            const auto& vcInfo = module.sensorInfo.vcInfo;
+            vModes.push_back(SensorMode{ module.sensorInfo.id, vcInfo.resolution.width, vcInfo.resolution.height,
+                                         (double)vcInfo.fps });
+        }
+        if (!CTopology::GetInstance().PlanPackets(vModes)) {
+            return -1;
+        }
+    }
+
     LOG_MSG("RegisterSource. appType %u\n",appType);
     for (auto& module : vCameraModules) {
         unique_ptr<CProfiler> upProfiler = unique_ptr<CProfiler>(new CProfiler());
@@ -739,6 +827,9 @@ int main(int argc, char *argv[])
     LOG_MSG("start upMaster->InitStream  appType %u\n",appType);
     status = upMaster->InitStream();
     CHK_STATUS_AND_RETURN(status, "Init stream");
+    if (producerResident) {
+        CTopology::GetInstance().ReportAllocations();
+    }
 
     if (producerResident) {
         for (const auto& module : vCameraModules) {
@@ -791,31 +882,43 @@ int main(int argc, char *argv[])
         cout << "Output" << endl;
 
         for (auto &prof : vupProfilers) {
-            prof->m_profData.profDataMut.lock();
-            uFrameCountDelta = prof->m_profData.uFrameCount - prof->m_profData.uPrevFrameCount;
-            prof->m_profData.uPrevFrameCount = prof->m_profData.uFrameCount;
-            prof->m_profData.profDataMut.unlock();
+            uFrameCountDelta = prof->GetFrameCountDelta();
+            // Consumers report frame rate together with their latencies
+            if (prof->ReportLatency(cout, uTimeElapsedMs / 1000.0)) {
+                continue;
+            }
             auto fps = uFrameCountDelta / (uTimeElapsedMs / 1000.0);
             string profName = "Sensor" + to_string(prof->m_uSensor) + "_Out"
                               + to_string(int(prof->m_outputType)) + "\t";
             cout << profName << "Frame rate (fps):\t\t" << fps << endl;
         }
+        if (CFrameSync::GetInstance().HasSensors()) {
+            CFrameSync::GetInstance().Report(cout, uTimeElapsedMs / 1000.0);
+        }
         cout << endl;
+        CMetrics::GetInstance().AppendJsonLog();
 
         if (producerResident) {
             // Check for any asynchronous fatal errors reported by pipeline threads in the library
+            bool bInError = false;
             for (auto &notificationHandler : vupNotificationHandler) {
                 if (notificationHandler->IsPipelineInError()) {
-                    bQuit = true;
+                    bInError = true;
                 }
             }
             
             // Check for any asynchronous errors reported by the device blocks
             for (auto &notificationHandler : vupDeviceBlockNotifyHandler) {
                 if (notificationHandler->IsDeviceBlockInError()) {
-                    bQuit = true;
+                    bInError = true;
                 }
             }
+
+            // Keep what led up to the error before the teardown adds to the rings
+            if (bInError) {
+                CFlightRecorder::GetInstance().Dump(0);
+                bQuit = true;
+            }
         }
     }
 
@@ -844,6 +947,8 @@ int main(int argc, char *argv[])
         }
     }
     
+    // Hand the held packets back before the streams go down
+    CFrameSync::GetInstance().Flush();
     if (upMaster != nullptr) {
         LOG_INFO("Stopping channels\n");
         upMaster->StopStream();
@@ -856,6 +961,12 @@ int main(int argc, char *argv[])
         }
     }
 
+    // Final totals stay scrapeable until here
+    CMetrics::GetInstance().AppendJsonLog();
+    CMetrics::GetInstance().StopExporter();
+    CTracer::GetInstance().Disable();
+    CLogger::GetInstance().StopAsync();
+
     if (bPipelineError) {
         LOG_ERR("Pipeline failure\n");
         return -1;